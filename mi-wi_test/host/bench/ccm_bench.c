@@ -0,0 +1,389 @@
+/**
+* \file  ccm_bench.c
+*
+* \brief Benchmark of the CCM* engine against the per block encryption it replaces
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include <string.h>
+#include "compiler.h"
+#include "sal.h"
+#include "mimac_ccm.h"
+#include "bench.h"
+
+/************************ DEFINITIONS ******************************/
+#define BENCH_SECURITY_LEVEL    4       /* SEC_LEVEL_CCM_32 */
+#define BENCH_MIC_SIZE          4
+#define BENCH_PAYLOAD_MAX       100     /* TX_BUFFER_SIZE */
+#define BENCH_FUZZ_FRAMES       100000UL
+
+/* Cost of the AT86RF2xx SAL on the SPI bus: command and address byte
+ * per transfer, 4 MHz clock (AT86RFX_SPI_BAUDRATE) and the fixed wait
+ * of sal_aes_wrrd() for every AES operation */
+#define BENCH_SPI_HEADER        2
+#define BENCH_SPI_NS_PER_BYTE   2000
+#define BENCH_AES_WAIT_NS       24000
+
+/************************ TYPE DEFINITIONS ******************************/
+typedef union
+{
+	uint32_t Val;
+	uint8_t v[4];
+} BenchCounter_t;
+
+typedef struct _BenchCost_t
+{
+	uint32_t transfers;
+	uint32_t bytes;
+	uint32_t operations;
+} BenchCost_t;
+
+/************************ VARIABLES ********************************/
+static uint8_t benchKey[AES_KEYSIZE];
+static BenchCost_t benchCost;
+static bool benchAfterSetup;
+
+/* Results of the replaced code */
+static uint8_t legacyCbcMic[16], legacyCtrMic[16], legacyFinalMic[16];
+
+/************************ FUNCTIONS ********************************/
+bool __real_sal_aes_setup(uint8_t *key, uint8_t enc_mode, uint8_t dir);
+void __real_sal_aes_wrrd(uint8_t *idata, uint8_t *odata);
+void __real_sal_aes_read(uint8_t *data);
+
+/* The SAL calls are wrapped by the linker to count their SPI traffic.
+ * A key is written to the AES SRAM, a mode change only takes effect
+ * with the next block, which then also rewrites the control byte. */
+bool __wrap_sal_aes_setup(uint8_t *key, uint8_t enc_mode, uint8_t dir)
+{
+	if (NULL != key)
+	{
+		benchCost.transfers++;
+		benchCost.bytes += BENCH_SPI_HEADER + 1 + AES_KEYSIZE;
+	}
+	benchAfterSetup = true;
+	return __real_sal_aes_setup(key, enc_mode, dir);
+}
+
+void __wrap_sal_aes_wrrd(uint8_t *idata, uint8_t *odata)
+{
+	benchCost.transfers++;
+	benchCost.bytes += BENCH_SPI_HEADER + AES_BLOCKSIZE + (benchAfterSetup ? 2 : 1);
+	benchCost.operations++;
+	benchAfterSetup = false;
+	__real_sal_aes_wrrd(idata, odata);
+}
+
+void __wrap_sal_aes_read(uint8_t *data)
+{
+	benchCost.transfers++;
+	benchCost.bytes += BENCH_SPI_HEADER + AES_BLOCKSIZE;
+	__real_sal_aes_read(data);
+}
+
+static uint32_t benchCostNs(const BenchCost_t *cost)
+{
+	return (cost->bytes * BENCH_SPI_NS_PER_BYTE) + (cost->operations * BENCH_AES_WAIT_NS);
+}
+
+/*********************************************************************
+* The replaced code of mimac_at86rf.c: PHY_EncryptReq() per block,
+* every call loading the key again
+********************************************************************/
+static void legacyEncryptReq(uint8_t *text)
+{
+	sal_aes_setup(benchKey, AES_MODE_ECB, AES_DIR_ENCRYPT);
+	sal_aes_wrrd(text, NULL);
+	sal_aes_read(text);
+}
+
+static void legacyMic(uint8_t *payload, uint8_t len, uint8_t frameControl, BenchCounter_t frameCounter, uint8_t *address)
+{
+	uint8_t i, j, iterations, copy[128], header[16], iv[16];
+
+	iterations = (len + 15) / 16;
+	iv[0] = 0x49;
+	header[0] = 0x00;
+	header[1] = 0x0d;
+	header[2] = frameControl;
+	for (i = 0; i < 8; i++)
+	{
+		iv[i + 1] = address[i];
+		header[i + 7] = address[i];
+	}
+	for (i = 0; i < 4; i++)
+	{
+		iv[i + 9] = frameCounter.v[i];
+		header[i + 3] = frameCounter.v[i];
+	}
+	header[15] = 0x00;
+	iv[13] = BENCH_SECURITY_LEVEL;
+	iv[14] = 0x00;
+	iv[15] = len;
+	legacyEncryptReq(iv);
+	memcpy(copy, header, 16);
+	memcpy(&copy[16], payload, len);
+	memset(&copy[16 + len], 0, (iterations * 16) - len);
+	for (i = 0; i < iterations + 1; i++)
+	{
+		for (j = 0; j < 16; j++)
+		{
+			iv[j] ^= copy[j + (i * 16)];
+		}
+		legacyEncryptReq(iv);
+	}
+	memcpy(legacyCbcMic, iv, 16);
+}
+
+static void legacyCtr(uint8_t *data, uint8_t len, BenchCounter_t frameCounter, uint8_t *address, uint8_t *s0)
+{
+	uint8_t i, j, iterations, block[16], counter[16];
+
+	iterations = (len + 15) / 16;
+	counter[0] = 0x01;
+	memcpy(&counter[1], address, 8);
+	memcpy(&counter[9], frameCounter.v, 4);
+	counter[13] = BENCH_SECURITY_LEVEL;
+	counter[14] = 0x00;
+	counter[15] = 0x00;
+	for (i = 0; i < iterations + 1; i++)
+	{
+		memcpy(block, counter, 16);
+		legacyEncryptReq(block);
+		for (j = 0; j < 16; j++)
+		{
+			if (0 == counter[15])
+			{
+				s0[j] = block[j];
+			}
+			else
+			{
+				data[j + (i - 1) * 16] ^= block[j];
+			}
+		}
+		counter[15]++;
+	}
+}
+
+static void legacyEncrypt(uint8_t *payload, uint8_t len, BenchCounter_t frameCounter, uint8_t frameControl, uint8_t *address)
+{
+	uint8_t data[BENCH_PAYLOAD_MAX + 16];
+
+	memcpy(data, payload, len);
+	legacyMic(payload, len, frameControl, frameCounter, address);
+	legacyCtr(data, len, frameCounter, address, legacyCtrMic);
+	for (uint8_t j = 0; j < 16; j++)
+	{
+		legacyFinalMic[j] = legacyCtrMic[j] ^ legacyCbcMic[j];
+	}
+	memcpy(payload, data, len);
+}
+
+/* len includes the MIC, which is decrypted along */
+static bool legacyDecrypt(uint8_t *payload, uint8_t *len, BenchCounter_t frameCounter, uint8_t frameControl,
+	uint8_t *address, uint8_t *receivedMic)
+{
+	uint8_t data[BENCH_PAYLOAD_MAX + BENCH_MIC_SIZE + 16];
+
+	memcpy(data, payload, *len);
+	legacyCtr(data, *len, frameCounter, address, legacyCtrMic);
+	*len -= BENCH_MIC_SIZE;
+	legacyMic(data, *len, frameControl, frameCounter, address);
+	for (uint8_t j = 0; j < 16; j++)
+	{
+		legacyFinalMic[j] = legacyCtrMic[j] ^ legacyCbcMic[j];
+	}
+	memcpy(payload, data, *len);
+	/* only two MIC bytes were compared */
+	return (legacyFinalMic[0] == receivedMic[0]) && (legacyFinalMic[1] == receivedMic[1]);
+}
+
+/*********************************************************************
+* The CCM* engine with the nonce and header of DataEncrypt()
+********************************************************************/
+static void engineParams(uint8_t *nonce, uint8_t *aData, uint8_t frameControl, BenchCounter_t frameCounter, uint8_t *address)
+{
+	memcpy(&nonce[0], address, 8);
+	memcpy(&nonce[8], frameCounter.v, 4);
+	nonce[12] = BENCH_SECURITY_LEVEL;
+	aData[0] = frameControl;
+	memcpy(&aData[1], frameCounter.v, 4);
+	memcpy(&aData[5], address, 8);
+}
+
+static void engineEncrypt(uint8_t *payload, uint8_t len, BenchCounter_t frameCounter, uint8_t frameControl,
+	uint8_t *address, uint8_t *mic)
+{
+	uint8_t nonce[CCM_NONCE_LENGTH], aData[13];
+
+	engineParams(nonce, aData, frameControl, frameCounter, address);
+	MiMAC_CcmEncrypt(benchKey, nonce, aData, sizeof(aData), payload, len, mic, BENCH_MIC_SIZE);
+}
+
+static bool engineDecrypt(uint8_t *payload, uint8_t len, BenchCounter_t frameCounter, uint8_t frameControl,
+	uint8_t *address, uint8_t *mic)
+{
+	uint8_t nonce[CCM_NONCE_LENGTH], aData[13];
+
+	engineParams(nonce, aData, frameControl, frameCounter, address);
+	return MiMAC_CcmDecrypt(benchKey, nonce, aData, sizeof(aData), payload, len, mic, BENCH_MIC_SIZE);
+}
+
+/*********************************************************************
+* Function:         static uint32_t benchCompare(void)
+*
+* Overview:         Encrypts random frames with both implementations and
+*                   decrypts them with the engine, and with one bit of
+*                   the frame or MIC flipped. Counts the frames in which
+*                   cipher text or MIC differ, the plain text does not
+*                   come back or a flipped bit passes the engine.
+********************************************************************/
+static uint32_t benchCompare(uint32_t *legacyForgeries)
+{
+	uint32_t mismatches = 0;
+
+	*legacyForgeries = 0;
+	for (uint32_t i = 0; i < BENCH_FUZZ_FRAMES; i++)
+	{
+		uint8_t plain[BENCH_PAYLOAD_MAX], legacy[BENCH_PAYLOAD_MAX + BENCH_MIC_SIZE], engine[BENCH_PAYLOAD_MAX];
+		uint8_t address[8], mic[BENCH_MIC_SIZE], len, legacyLen, flip;
+		BenchCounter_t frameCounter;
+		uint8_t frameControl = (uint8_t)benchRandom(256) | 0x08;
+		bool ok;
+
+		len = (uint8_t)benchRandom(BENCH_PAYLOAD_MAX + 1);
+		frameCounter.Val = benchRandom(UINT32_MAX);
+		for (uint8_t j = 0; j < 8; j++)
+		{
+			address[j] = (uint8_t)benchRandom(256);
+		}
+		for (uint8_t j = 0; j < len; j++)
+		{
+			plain[j] = (uint8_t)benchRandom(256);
+		}
+
+		memcpy(legacy, plain, len);
+		memcpy(engine, plain, len);
+		legacyEncrypt(legacy, len, frameCounter, frameControl, address);
+		engineEncrypt(engine, len, frameCounter, frameControl, address, mic);
+		ok = (0 == memcmp(legacy, engine, len)) && (0 == memcmp(legacyFinalMic, mic, BENCH_MIC_SIZE));
+
+		/* The legacy decryption of the engine's frame */
+		memcpy(&legacy[len], mic, BENCH_MIC_SIZE);
+		legacyLen = len + BENCH_MIC_SIZE;
+		ok = ok && legacyDecrypt(legacy, &legacyLen, frameCounter, frameControl, address, mic) &&
+			(legacyLen == len) && (0 == memcmp(legacy, plain, len));
+
+		ok = ok && engineDecrypt(engine, len, frameCounter, frameControl, address, mic) &&
+			(0 == memcmp(engine, plain, len));
+
+		/* A flipped bit in the cipher text or in the MIC */
+		engineEncrypt(engine, len, frameCounter, frameControl, address, mic);
+		flip = (uint8_t)benchRandom(len + BENCH_MIC_SIZE);
+		if (flip < len)
+		{
+			engine[flip] ^= (uint8_t)(1 << benchRandom(8));
+		}
+		else
+		{
+			mic[flip - len] ^= (uint8_t)(1 << benchRandom(8));
+		}
+		memcpy(legacy, engine, len);
+		memcpy(&legacy[len], mic, BENCH_MIC_SIZE);
+		legacyLen = len + BENCH_MIC_SIZE;
+		if (legacyDecrypt(legacy, &legacyLen, frameCounter, frameControl, address, mic))
+		{
+			(*legacyForgeries)++;
+		}
+		ok = ok && !engineDecrypt(engine, len, frameCounter, frameControl, address, mic);
+
+		if (!ok)
+		{
+			if (0 == mismatches)
+			{
+				printf("first mismatch: frame %lu, length %u\n", (unsigned long)i, len);
+			}
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+/* SPI traffic and time of encrypting one frame */
+static void benchFrameCost(uint8_t len)
+{
+	uint8_t payload[BENCH_PAYLOAD_MAX + BENCH_MIC_SIZE] = {0};
+	uint8_t address[8] = {0}, mic[BENCH_MIC_SIZE];
+	BenchCounter_t frameCounter = {0};
+	BenchCost_t legacy, engine;
+
+	memset(&benchCost, 0, sizeof(benchCost));
+	legacyEncrypt(payload, len, frameCounter, 0x49, address);
+	legacy = benchCost;
+	memset(&benchCost, 0, sizeof(benchCost));
+	engineEncrypt(payload, len, frameCounter, 0x49, address, mic);
+	engine = benchCost;
+
+	printf("%7u %6lu %5lu %6lu %7.1f %6lu %5lu %6lu %7.1f\n", len,
+		(unsigned long)legacy.operations, (unsigned long)legacy.transfers, (unsigned long)legacy.bytes,
+		benchCostNs(&legacy) / 1000.0,
+		(unsigned long)engine.operations, (unsigned long)engine.transfers, (unsigned long)engine.bytes,
+		benchCostNs(&engine) / 1000.0);
+}
+
+int main(void)
+{
+	static const uint8_t lengths[] = {2, 4, 16, 32, 64, BENCH_PAYLOAD_MAX};
+	uint32_t legacyForgeries;
+	uint32_t mismatches;
+
+	for (uint8_t i = 0; i < AES_KEYSIZE; i++)
+	{
+		benchKey[i] = (uint8_t)benchRandom(256);
+	}
+	mismatches = benchCompare(&legacyForgeries);
+	printf("CCM* engine, %lu random frames\n", (unsigned long)BENCH_FUZZ_FRAMES);
+	printf("%20s %8lu\n", "mismatch", (unsigned long)mismatches);
+	printf("%20s %8lu\n", "legacy forgeries", (unsigned long)legacyForgeries);
+
+	printf("%7s %29s %29s\n", "", "per block PHY_EncryptReq", "CCM* engine");
+	printf("%7s %6s %5s %6s %7s %6s %5s %6s %7s\n", "payload", "aes", "xfers", "bytes", "us",
+		"aes", "xfers", "bytes", "us");
+	for (uint8_t i = 0; i < sizeof(lengths); i++)
+	{
+		benchFrameCost(lengths[i]);
+	}
+	return (0 == mismatches) ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+/**
+* \file  crypto_bench.c
+*
+* \brief Test vectors and throughput of the AES backends of the CCM* engine
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include <string.h>
+#include "compiler.h"
+#include "sal.h"
+#include "mimac_ccm.h"
+#include "mimac_crypto.h"
+#include "bench.h"
+
+/************************ DEFINITIONS ******************************/
+#define BENCH_PAYLOAD_MAX       100     /* TX_BUFFER_SIZE */
+#define BENCH_HEADER_LENGTH     13      /* aData of DataEncrypt() */
+#define BENCH_MIC_SIZE          4       /* SEC_LEVEL_CCM_32 */
+#define BENCH_CROSS_FRAMES      20000UL
+#define BENCH_TIMED_FRAMES      20000UL
+
+/* Cost of the AT86RF2xx engine on the SPI bus, as in ccm_bench.c:
+ * command and address byte per transfer, 4 MHz clock and the fixed
+ * wait of sal_aes_wrrd() for every AES operation */
+#define BENCH_SPI_HEADER        2
+#define BENCH_SPI_NS_PER_BYTE   2000
+#define BENCH_AES_WAIT_NS       24000
+
+/************************ TYPE DEFINITIONS ******************************/
+typedef struct _BenchVector_t
+{
+	const char *name;
+	uint8_t nonce[CCM_NONCE_LENGTH];
+	uint8_t aData[32];
+	uint8_t aLen;
+	uint8_t mData[4];
+	uint8_t mLen;
+	uint8_t cData[4];
+	uint8_t mic[8];
+	uint8_t micLen;
+} BenchVector_t;
+
+/************************ VARIABLES ********************************/
+/* IEEE 802.15.4-2006 Annex C.2, key C0..CF, extended source address
+ * ACDE480000000001 and frame counter 5 */
+static const uint8_t benchVectorKey[16] =
+{
+	0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF
+};
+
+static const BenchVector_t benchVectors[] =
+{
+	{
+		"C.2.1 beacon, MIC-64",
+		{0xAC, 0xDE, 0x48, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x05, 0x02},
+		{0x08, 0xD0, 0x84, 0x21, 0x43, 0x01, 0x00, 0x00, 0x00, 0x00, 0x48, 0xDE, 0xAC, 0x02, 0x05, 0x00,
+		 0x00, 0x00, 0x55, 0xCF, 0x00, 0x00, 0x51, 0x52, 0x53, 0x54}, 26,
+		{0}, 0,
+		{0},
+		{0x22, 0x3B, 0xC1, 0xEC, 0x84, 0x1A, 0xB5, 0x53}, 8
+	},
+	{
+		"C.2.2 data, ENC",
+		{0xAC, 0xDE, 0x48, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x05, 0x04},
+		{0x69, 0xDC, 0x84, 0x21, 0x43, 0x02, 0x00, 0x00, 0x00, 0x00, 0x48, 0xDE, 0xAC, 0x01, 0x00, 0x00,
+		 0x00, 0x00, 0x48, 0xDE, 0xAC, 0x04, 0x05, 0x00, 0x00, 0x00}, 26,
+		{0x61, 0x62, 0x63, 0x64}, 4,
+		{0xD4, 0x3E, 0x02, 0x2B},
+		{0}, 0
+	},
+	{
+		"C.2.3 command, ENC-MIC-64",
+		{0xAC, 0xDE, 0x48, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x05, 0x06},
+		{0x2B, 0xDC, 0x84, 0x21, 0x43, 0x02, 0x00, 0x00, 0x00, 0x00, 0x48, 0xDE, 0xAC, 0xFF, 0xFF, 0x01,
+		 0x00, 0x00, 0x00, 0x00, 0x48, 0xDE, 0xAC, 0x06, 0x05, 0x00, 0x00, 0x00, 0x01}, 29,
+		{0xCE}, 1,
+		{0xD8},
+		{0x4F, 0xDE, 0x52, 0x90, 0x61, 0xF9, 0xC6, 0xF1}, 8
+	}
+};
+
+/* FIPS-197 Appendix C.1 */
+static const uint8_t benchFipsKey[16] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+};
+static const uint8_t benchFipsPlain[16] =
+{
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+};
+static const uint8_t benchFipsCipher[16] =
+{
+	0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A
+};
+
+static uint32_t benchSpiBytes, benchAesOperations;
+static bool benchAfterSetup;
+
+/************************ FUNCTIONS ********************************/
+/* The transceiver backend, counting the SPI traffic of its calls. A key
+ * is written to the AES SRAM, a mode change only takes effect with the
+ * next block, which then also rewrites the control byte. */
+static void countKeySetup(uint8_t *key)
+{
+	benchSpiBytes += BENCH_SPI_HEADER + 1 + AES_KEYSIZE;
+	benchAfterSetup = true;
+	MiMAC_CryptoTransceiver.keySetup(key);
+}
+
+static void countChain(bool enable)
+{
+	benchAfterSetup = true;
+	MiMAC_CryptoTransceiver.chain(enable);
+}
+
+static void countBlockWriteRead(uint8_t *input, uint8_t *output)
+{
+	benchSpiBytes += BENCH_SPI_HEADER + AES_BLOCKSIZE + (benchAfterSetup ? 2 : 1);
+	benchAesOperations++;
+	benchAfterSetup = false;
+	MiMAC_CryptoTransceiver.blockWriteRead(input, output);
+}
+
+static void countBlockRead(uint8_t *output)
+{
+	benchSpiBytes += BENCH_SPI_HEADER + AES_BLOCKSIZE;
+	MiMAC_CryptoTransceiver.blockRead(output);
+}
+
+static const MiMAC_CryptoBackend_t benchTransceiver =
+{
+	countKeySetup,
+	countChain,
+	countBlockWriteRead,
+	countBlockRead
+};
+
+static bool benchFips(const MiMAC_CryptoBackend_t *backend)
+{
+	uint8_t block[16];
+
+	memcpy(block, benchFipsPlain, sizeof(block));
+	backend->keySetup((uint8_t *)benchFipsKey);
+	backend->blockWriteRead(block, NULL);
+	backend->blockRead(block);
+	return 0 == memcmp(block, benchFipsCipher, sizeof(block));
+}
+
+/*********************************************************************
+* Function:         static uint8_t benchVectorsCheck(const MiMAC_CryptoBackend_t *backend)
+*
+* Overview:         Secures the frames of Annex C.2 with the backend and
+*                   compares cipher text and MIC, then unsecures them
+*                   again, once unchanged and once with a flipped MIC
+*                   bit. Returns the number of failed checks.
+********************************************************************/
+static uint8_t benchVectorsCheck(const MiMAC_CryptoBackend_t *backend)
+{
+	uint8_t failures = 0;
+
+	MiMAC_CcmSetBackend(backend);
+	if (!benchFips(backend))
+	{
+		printf("%28s %s\n", "FIPS-197 C.1", "FAIL");
+		failures++;
+	}
+	for (uint8_t i = 0; i < sizeof(benchVectors) / sizeof(benchVectors[0]); i++)
+	{
+		const BenchVector_t *v = &benchVectors[i];
+		uint8_t data[4], mic[8];
+		bool ok;
+
+		memcpy(data, v->mData, v->mLen);
+		ok = MiMAC_CcmEncrypt((uint8_t *)benchVectorKey, (uint8_t *)v->nonce, (uint8_t *)v->aData, v->aLen,
+			data, v->mLen, mic, v->micLen);
+		ok = ok && (0 == memcmp(data, v->cData, v->mLen)) && (0 == memcmp(mic, v->mic, v->micLen));
+		ok = ok && MiMAC_CcmDecrypt((uint8_t *)benchVectorKey, (uint8_t *)v->nonce, (uint8_t *)v->aData, v->aLen,
+			data, v->mLen, mic, v->micLen) && (0 == memcmp(data, v->mData, v->mLen));
+		if (v->micLen)
+		{
+			memcpy(data, v->cData, v->mLen);
+			mic[0] ^= 0x01;
+			ok = ok && !MiMAC_CcmDecrypt((uint8_t *)benchVectorKey, (uint8_t *)v->nonce, (uint8_t *)v->aData,
+				v->aLen, data, v->mLen, mic, v->micLen);
+		}
+		if (!ok)
+		{
+			printf("%28s %s\n", v->name, "FAIL");
+			failures++;
+		}
+	}
+	return failures;
+}
+
+/* Random frames secured by both backends must be identical */
+static uint32_t benchCross(void)
+{
+	uint32_t mismatches = 0;
+
+	for (uint32_t i = 0; i < BENCH_CROSS_FRAMES; i++)
+	{
+		uint8_t key[16], nonce[CCM_NONCE_LENGTH], aData[BENCH_HEADER_LENGTH];
+		uint8_t trx[BENCH_PAYLOAD_MAX], sw[BENCH_PAYLOAD_MAX], trxMic[16], swMic[16];
+		uint8_t len = (uint8_t)benchRandom(BENCH_PAYLOAD_MAX + 1);
+		uint8_t micLen = (uint8_t)(4 << benchRandom(3));
+
+		/* A new key now and then, to exercise the cached key schedule */
+		for (uint8_t j = 0; j < sizeof(key); j++)
+		{
+			key[j] = (benchRandom(8) == 0) ? (uint8_t)benchRandom(256) : (uint8_t)j;
+		}
+		for (uint8_t j = 0; j < sizeof(nonce); j++)
+		{
+			nonce[j] = (uint8_t)benchRandom(256);
+		}
+		for (uint8_t j = 0; j < sizeof(aData); j++)
+		{
+			aData[j] = (uint8_t)benchRandom(256);
+		}
+		for (uint8_t j = 0; j < len; j++)
+		{
+			trx[j] = sw[j] = (uint8_t)benchRandom(256);
+		}
+
+		MiMAC_CcmSetBackend(&MiMAC_CryptoTransceiver);
+		MiMAC_CcmEncrypt(key, nonce, aData, sizeof(aData), trx, len, trxMic, micLen);
+		MiMAC_CcmSetBackend(&MiMAC_CryptoSoftware);
+		MiMAC_CcmEncrypt(key, nonce, aData, sizeof(aData), sw, len, swMic, micLen);
+		if ((0 != memcmp(trx, sw, len)) || (0 != memcmp(trxMic, swMic, micLen)) ||
+			!MiMAC_CcmDecrypt(key, nonce, aData, sizeof(aData), sw, len, trxMic, micLen))
+		{
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+/*********************************************************************
+* Function:         static void benchThroughput(uint8_t len)
+*
+* Overview:         Prints the time to secure a frame of the firmware
+*                   with the transceiver, from its SPI traffic, and the
+*                   time the software backend takes on this host.
+********************************************************************/
+static void benchThroughput(uint8_t len)
+{
+	uint8_t key[16] = {0}, nonce[CCM_NONCE_LENGTH] = {0}, aData[BENCH_HEADER_LENGTH] = {0};
+	uint8_t payload[BENCH_PAYLOAD_MAX] = {0}, mic[BENCH_MIC_SIZE];
+	uint32_t trxNs;
+	uint64_t start, swNs;
+
+	benchSpiBytes = 0;
+	benchAesOperations = 0;
+	MiMAC_CcmSetBackend(&benchTransceiver);
+	MiMAC_CcmEncrypt(key, nonce, aData, sizeof(aData), payload, len, mic, BENCH_MIC_SIZE);
+	trxNs = (benchSpiBytes * BENCH_SPI_NS_PER_BYTE) + (benchAesOperations * BENCH_AES_WAIT_NS);
+
+	MiMAC_CcmSetBackend(&MiMAC_CryptoSoftware);
+	start = benchNow();
+	for (uint32_t i = 0; i < BENCH_TIMED_FRAMES; i++)
+	{
+		MiMAC_CcmEncrypt(key, nonce, aData, sizeof(aData), payload, len, mic, BENCH_MIC_SIZE);
+	}
+	swNs = (benchNow() - start) / BENCH_TIMED_FRAMES;
+
+	printf("%7u %6lu %9.1f %9lu %9.2f\n", len, (unsigned long)benchAesOperations, trxNs / 1000.0,
+		(unsigned long)swNs, (len * 8.0 * 1000.0) / (double)Max(swNs, 1ULL));
+}
+
+int main(void)
+{
+	static const uint8_t lengths[] = {4, 16, 32, 64, BENCH_PAYLOAD_MAX};
+	uint32_t failures, mismatches;
+
+#if defined(SOFTWARE_AES_ONE_TABLE)
+	printf("Software AES with one round table\n");
+#else
+	printf("Software AES with four round tables\n");
+#endif
+	failures = benchVectorsCheck(&MiMAC_CryptoTransceiver);
+	failures += benchVectorsCheck(&MiMAC_CryptoSoftware);
+	printf("%28s %8lu\n", "test vector failures", (unsigned long)failures);
+	mismatches = benchCross();
+	printf("%28s %8lu\n", "backend mismatches", (unsigned long)mismatches);
+
+	printf("%7s %16s %19s\n", "", "transceiver", "software");
+	printf("%7s %6s %9s %9s %9s\n", "payload", "aes", "us", "ns", "Mbit/s");
+	for (uint8_t i = 0; i < sizeof(lengths); i++)
+	{
+		benchThroughput(lengths[i]);
+	}
+	return ((0 == failures) && (0 == mismatches)) ? 0 : 1;
+}
@@ -0,0 +1,433 @@
+/**
+* \file  mac_header_bench.c
+*
+* \brief Fuzz test and benchmark of the MAC header parser
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include "compiler.h"
+/* The firmware configuration comes with the MAC headers, the one in
+ * bench/ only stands in for it in the allocator and timer benchmarks */
+#include "mimac_header.h"
+#include "bench.h"
+
+/************************ DEFINITIONS ******************************/
+/* Receive bank as filled by the PHY: PSDU, then LQI and RSSI */
+#define BENCH_FRAME_SIZE        127     /* aMaxPHYPacketSize */
+#define BENCH_BANK_SIZE         (BENCH_FRAME_SIZE + 2)
+#define BENCH_BANK_TRAILER      4       /* FCS, LQI, RSSI */
+
+#define BENCH_FUZZ_FRAMES       1000000UL
+#define BENCH_TIMED_FRAMES      4096
+#define BENCH_TIMED_ROUNDS      200
+
+/* Outcome of comparing both parsers on one frame */
+typedef enum
+{
+	BENCH_SAME = 0,
+	BENCH_LEGACY_TRUNCATED,     /* legacy accepts a frame shorter than its header */
+	BENCH_LEGACY_8C_SOURCE,     /* legacy reads long dest / short source one byte early */
+	BENCH_LEGACY_08_LENGTH,     /* legacy counts one payload byte too many without source */
+	BENCH_MISMATCH,
+	BENCH_OUTCOMES
+} BenchOutcome_t;
+
+/************************ VARIABLES ********************************/
+static const char *benchOutcomeName[BENCH_OUTCOMES] =
+{
+	"same", "legacy truncated", "legacy 0x8C source", "legacy 0x08 length", "mismatch"
+};
+static uint32_t benchOutcomes[BENCH_OUTCOMES];
+static uint8_t benchBanks[BENCH_TIMED_FRAMES][BENCH_BANK_SIZE];
+static uint8_t benchBankLen[BENCH_TIMED_FRAMES];
+static volatile uint32_t benchSink;
+
+/************************ FUNCTIONS ********************************/
+/*********************************************************************
+* Function:         static bool legacyParse(uint8_t *bank, uint8_t bankLen,
+*                                           MAC_RECEIVED_PACKET *packet)
+*
+* Overview:         The addressing mode switch MiMAC_ReceivedPacket used
+*                   before the layout table, for a P2P/Star build that is
+*                   not TARGET_SMALL. bankLen is the length of the
+*                   receive bank, FCS, LQI and RSSI included.
+********************************************************************/
+static bool legacyParse(uint8_t *bank, uint8_t bankLen, MAC_RECEIVED_PACKET *packet)
+{
+	bool bIntraPAN = (bank[0] & 0x40) != 0;
+
+	packet->flags.Val = 0;
+	packet->altSourceAddress = false;
+	packet->SourcePANID.Val = 0xFFFF;
+
+	switch (bank[1] & 0xCC)
+	{
+		case 0xC8: // short dest, long source
+		if (bank[5] == 0xFF && bank[6] == 0xFF)
+		{
+			packet->flags.bits.broadcast = 1;
+		}
+		packet->flags.bits.sourcePrsnt = 1;
+		if (bIntraPAN)
+		{
+			packet->SourcePANID.v[0] = bank[3];
+			packet->SourcePANID.v[1] = bank[4];
+			packet->SourceAddress = &bank[7];
+			packet->PayloadLen = bankLen - 19;
+			packet->Payload = &bank[15];
+		}
+		else
+		{
+			packet->SourcePANID.v[0] = bank[7];
+			packet->SourcePANID.v[1] = bank[8];
+			packet->SourceAddress = &bank[9];
+			packet->PayloadLen = bankLen - 21;
+			packet->Payload = &bank[17];
+		}
+		break;
+
+		case 0xCC: // long dest, long source
+		packet->flags.bits.sourcePrsnt = 1;
+		if (bIntraPAN)
+		{
+			packet->SourcePANID.v[0] = bank[3];
+			packet->SourcePANID.v[1] = bank[4];
+			packet->SourceAddress = &bank[13];
+			packet->PayloadLen = bankLen - 25;
+			packet->Payload = &bank[21];
+		}
+		else
+		{
+			packet->SourcePANID.v[0] = bank[13];
+			packet->SourcePANID.v[1] = bank[14];
+			packet->SourceAddress = &bank[15];
+			packet->PayloadLen = bankLen - 27;
+			packet->Payload = &bank[23];
+		}
+		break;
+
+		case 0x80: // short source only, beacon
+		packet->flags.bits.broadcast = 1;
+		packet->flags.bits.sourcePrsnt = 1;
+		packet->altSourceAddress = true;
+		packet->SourcePANID.v[0] = bank[3];
+		packet->SourcePANID.v[1] = bank[4];
+		packet->SourceAddress = &bank[5];
+		packet->PayloadLen = bankLen - 11;
+		packet->Payload = &bank[7];
+		break;
+
+		case 0x88: // short dest, short source
+		if (bank[5] == 0xFF && bank[6] == 0xFF)
+		{
+			packet->flags.bits.broadcast = 1;
+		}
+		packet->flags.bits.sourcePrsnt = 1;
+		packet->altSourceAddress = true;
+		if (bIntraPAN == false)
+		{
+			packet->SourcePANID.v[0] = bank[7];
+			packet->SourcePANID.v[1] = bank[8];
+			packet->SourceAddress = &bank[9];
+			packet->PayloadLen = bankLen - 15;
+			packet->Payload = &bank[11];
+		}
+		else
+		{
+			packet->SourcePANID.v[0] = bank[3];
+			packet->SourcePANID.v[1] = bank[4];
+			packet->SourceAddress = &bank[7];
+			packet->PayloadLen = bankLen - 13;
+			packet->Payload = &bank[9];
+		}
+		break;
+
+		case 0x8C: // long dest, short source
+		packet->flags.bits.sourcePrsnt = 1;
+		packet->altSourceAddress = true;
+		if (bIntraPAN)
+		{
+			packet->SourcePANID.v[0] = bank[3];
+			packet->SourcePANID.v[1] = bank[4];
+			packet->SourceAddress = &bank[12];
+			packet->PayloadLen = bankLen - 19;
+			packet->Payload = &bank[15];
+		}
+		else
+		{
+			packet->SourcePANID.v[0] = bank[12];
+			packet->SourcePANID.v[1] = bank[13];
+			packet->SourceAddress = &bank[14];
+			packet->PayloadLen = bankLen - 21;
+			packet->Payload = &bank[17];
+		}
+		break;
+
+		case 0x08: // short dest, no source
+		if (bank[5] == 0xFF && bank[6] == 0xFF)
+		{
+			packet->flags.bits.broadcast = 1;
+		}
+		packet->PayloadLen = bankLen - 10;
+		packet->Payload = &bank[7];
+		break;
+
+		default:
+		return false;
+	}
+	return true;
+}
+
+/* Table driven parse as done by MiMAC_ReceivedPacket */
+static bool tableParse(uint8_t *bank, uint8_t bankLen, MAC_RECEIVED_PACKET *packet)
+{
+	packet->flags.Val = 0;
+	if (bankLen < BENCH_BANK_TRAILER)
+	{
+		return false;
+	}
+	return MiMAC_HeaderParse(bank, bankLen - BENCH_BANK_TRAILER, packet);
+}
+
+/* Random frame, mostly with the addressing modes MiWi sends */
+static uint8_t benchFrame(uint8_t *bank)
+{
+	static const uint8_t modes[] = {0xC8, 0xCC, 0x80, 0x88, 0x8C, 0x08};
+	uint8_t bankLen;
+
+	for (uint8_t i = 0; i < BENCH_BANK_SIZE; i++)
+	{
+		bank[i] = (uint8_t)benchRandom(256);
+	}
+	if (benchRandom(8))
+	{
+		bank[1] = (bank[1] & ~0xCC) | modes[benchRandom(sizeof(modes))];
+	}
+	if (benchRandom(4) == 0)
+	{
+		/* broadcast destination */
+		bank[5] = 0xFF;
+		bank[6] = 0xFF;
+	}
+	/* a quarter of the frames around the header length */
+	bankLen = benchRandom(4) ? (uint8_t)(1 + benchRandom(BENCH_BANK_SIZE)) : (uint8_t)(benchRandom(32));
+	return bankLen;
+}
+
+static bool benchSameSource(const MAC_RECEIVED_PACKET *a, const MAC_RECEIVED_PACKET *b)
+{
+	return (a->SourceAddress == b->SourceAddress) && (a->SourcePANID.Val == b->SourcePANID.Val);
+}
+
+static BenchOutcome_t benchCompare(uint8_t *bank, uint8_t bankLen)
+{
+	MAC_RECEIVED_PACKET legacy, table;
+	bool legacyOk, tableOk;
+	uint8_t mode = bank[1] & 0xCC;
+
+	memset(&legacy, 0, sizeof(legacy));
+	memset(&table, 0, sizeof(table));
+	legacyOk = legacyParse(bank, bankLen, &legacy);
+	tableOk = tableParse(bank, bankLen, &table);
+
+	if (tableOk)
+	{
+		const MAC_HEADER_LAYOUT *layout = &MACHeaderLayout[MAC_HEADER_INDEX(bank[0], bank[1])];
+
+		/* everything the table hands out lies within the frame */
+		if ((table.Payload != &bank[layout->headerLength]) ||
+			(table.Payload + table.PayloadLen != &bank[bankLen - BENCH_BANK_TRAILER]) ||
+			(table.flags.bits.sourcePrsnt &&
+			(table.SourceAddress + (table.altSourceAddress ? 2 : 8) > table.Payload)))
+		{
+			return BENCH_MISMATCH;
+		}
+	}
+	if (legacyOk != tableOk)
+	{
+		if (legacyOk && (bankLen < BENCH_BANK_TRAILER + MACHeaderLayout[MAC_HEADER_INDEX(bank[0], bank[1])].headerLength))
+		{
+			return BENCH_LEGACY_TRUNCATED;
+		}
+		return BENCH_MISMATCH;
+	}
+	if (!tableOk)
+	{
+		return BENCH_SAME;
+	}
+
+	if ((legacy.flags.Val != table.flags.Val) || (legacy.altSourceAddress != table.altSourceAddress))
+	{
+		return BENCH_MISMATCH;
+	}
+	if ((0x8C == mode) && !benchSameSource(&legacy, &table) && (legacy.Payload == table.Payload))
+	{
+		return BENCH_LEGACY_8C_SOURCE;
+	}
+	if ((0x08 == mode) && (legacy.PayloadLen == (uint8_t)(table.PayloadLen + 1)) && (legacy.Payload == table.Payload))
+	{
+		return BENCH_LEGACY_08_LENGTH;
+	}
+	if (!benchSameSource(&legacy, &table) || (legacy.Payload != table.Payload) ||
+		(legacy.PayloadLen != table.PayloadLen))
+	{
+		return BENCH_MISMATCH;
+	}
+	return BENCH_SAME;
+}
+
+/*********************************************************************
+* Function:         static bool benchRoundTrip(void)
+*
+* Overview:         Builds a header for every supported layout the way
+*                   MiMAC_SendPacket does and checks that the parser
+*                   finds the source, PAN ID and payload again.
+********************************************************************/
+static bool benchRoundTrip(void)
+{
+	uint8_t frame[BENCH_FRAME_SIZE];
+	bool ok = true;
+
+	for (uint8_t index = 0; index < MAC_HEADER_LAYOUTS; index++)
+	{
+		const MAC_HEADER_LAYOUT *layout = &MACHeaderLayout[index];
+		uint8_t dstMode = index & 0x03;
+		uint8_t srcMode = (index >> 2) & 0x03;
+		MAC_RECEIVED_PACKET packet;
+
+		if (0 == layout->headerLength)
+		{
+			continue;
+		}
+		memset(frame, 0, sizeof(frame));
+		frame[0] = 0x01 | ((index & 0x10) ? MAC_FCF_PANID_COMP : 0);
+		frame[1] = (srcMode << 6) | (dstMode << 2);
+		if (layout->dstAddrOffset)
+		{
+			frame[layout->dstPanIdOffset] = 0x34;
+			frame[layout->dstPanIdOffset + 1] = 0x12;
+			memset(&frame[layout->dstAddrOffset], 0xD0, MAC_ADDR_LEN(dstMode));
+		}
+		if (layout->srcAddrOffset && (layout->srcPanIdOffset != layout->dstPanIdOffset))
+		{
+			frame[layout->srcPanIdOffset] = 0x78;
+			frame[layout->srcPanIdOffset + 1] = 0x56;
+		}
+		if (layout->srcAddrOffset)
+		{
+			memset(&frame[layout->srcAddrOffset], 0x5A, MAC_ADDR_LEN(srcMode));
+		}
+		frame[layout->headerLength] = 0xA5;
+
+		memset(&packet, 0, sizeof(packet));
+		if (!MiMAC_HeaderParse(frame, layout->headerLength + 1, &packet) ||
+			(packet.PayloadLen != 1) || (packet.Payload[0] != 0xA5) ||
+			(packet.flags.bits.sourcePrsnt != (srcMode != MAC_ADDR_MODE_NONE)) ||
+			(packet.flags.bits.sourcePrsnt && (packet.SourceAddress[0] != 0x5A ||
+			packet.SourceAddress[MAC_ADDR_LEN(srcMode) - 1] != 0x5A ||
+			packet.SourcePANID.Val != ((layout->srcPanIdOffset != layout->dstPanIdOffset) ? 0x5678 : 0x1234))))
+		{
+			printf("round trip failed for layout %u\n", index);
+			ok = false;
+		}
+		/* one byte short of the header must be refused */
+		if (MiMAC_HeaderParse(frame, layout->headerLength - 1, &packet))
+		{
+			printf("truncated header accepted for layout %u\n", index);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+/* Best round in picoseconds per frame */
+static uint32_t benchTime(bool (*parse)(uint8_t *, uint8_t, MAC_RECEIVED_PACKET *))
+{
+	MAC_RECEIVED_PACKET packet;
+	uint64_t best = UINT64_MAX;
+
+	for (uint32_t round = 0; round < BENCH_TIMED_ROUNDS; round++)
+	{
+		uint64_t start = benchNow();
+		uint32_t sum = 0;
+
+		for (uint32_t i = 0; i < BENCH_TIMED_FRAMES; i++)
+		{
+			if (parse(benchBanks[i], benchBankLen[i], &packet))
+			{
+				sum += packet.PayloadLen;
+			}
+		}
+		benchSink += sum;
+		best = Min(best, benchNow() - start);
+	}
+	return (uint32_t)((best * 1000) / BENCH_TIMED_FRAMES);
+}
+
+int main(void)
+{
+	static uint8_t bank[BENCH_BANK_SIZE];
+	bool ok;
+
+	ok = benchRoundTrip();
+
+	for (uint32_t i = 0; i < BENCH_FUZZ_FRAMES; i++)
+	{
+		uint8_t bankLen = benchFrame(bank);
+		BenchOutcome_t outcome = benchCompare(bank, bankLen);
+
+		if ((BENCH_MISMATCH == outcome) && (0 == benchOutcomes[BENCH_MISMATCH]))
+		{
+			printf("first mismatch: fcf %02x %02x, bank length %u\n", bank[0], bank[1], bankLen);
+		}
+		benchOutcomes[outcome]++;
+	}
+	printf("MAC header parser, %lu random frames\n", (unsigned long)BENCH_FUZZ_FRAMES);
+	for (uint8_t i = 0; i < BENCH_OUTCOMES; i++)
+	{
+		printf("%20s %8lu\n", benchOutcomeName[i], (unsigned long)benchOutcomes[i]);
+	}
+
+	/* well formed frames only for the timing */
+	for (uint32_t i = 0; i < BENCH_TIMED_FRAMES; i++)
+	{
+		do
+		{
+			benchBankLen[i] = benchFrame(benchBanks[i]);
+		} while (benchBankLen[i] < BENCH_BANK_TRAILER + 27);
+	}
+	printf("%20s %8.2f ns/frame\n", "legacy switch", benchTime(legacyParse) / 1000.0);
+	printf("%20s %8.2f ns/frame\n", "layout table", benchTime(tableParse) / 1000.0);
+	return (ok && (0 == benchOutcomes[BENCH_MISMATCH])) ? 0 : 1;
+}
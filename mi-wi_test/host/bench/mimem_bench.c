@@ -0,0 +1,268 @@
+/**
+* \file  mimem_bench.c
+*
+* \brief Allocation latency and fragmentation benchmark of MiMem
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include "compiler.h"
+#include "miwi_config.h"
+#include "mimem.h"
+#include "bench.h"
+
+/************************ DEFINITIONS ******************************/
+/* Allocation sizes of the SAMR30 build of the stack */
+#define BENCH_DATA_FRAME_SIZE   156     /* P2PStarDataFrame_t */
+#define BENCH_TX_FRAME_SIZE     44      /* TxFrame_t */
+#define BENCH_PHY_FRAME_SIZE    16      /* PhyTxFrame_t */
+#define BENCH_CMD_FRAME_SIZE    TX_BUFFER_SIZE
+#define BENCH_CMD_SMALL_MAX     6       /* PACKETLEN_* command payloads */
+
+#define BENCH_STEPS             200000UL
+#define BENCH_MAX_LIVE          256
+#define BENCH_LATENCY_BINS      1000    /* 10 ns bins */
+#define BENCH_LATENCY_BIN_NS    10
+
+/************************ TYPE DEFINITIONS ******************************/
+typedef struct _BenchBuffer_t
+{
+	void *ptr;
+	uint32_t expiry;
+} BenchBuffer_t;
+
+typedef struct _BenchLatency_t
+{
+	uint64_t count;
+	uint64_t sumNs;
+	uint32_t bins[BENCH_LATENCY_BINS];
+} BenchLatency_t;
+
+/************************ VARIABLES ********************************/
+static BenchBuffer_t benchLive[BENCH_MAX_LIVE];
+static uint16_t benchLiveCount;
+static BenchLatency_t benchAllocLatency, benchFreeLatency;
+static uint32_t benchFailures;
+static uint64_t benchTimerOverheadNs;
+
+/************************ FUNCTIONS ********************************/
+static void benchRecord(BenchLatency_t *latency, uint64_t startNs, uint64_t endNs)
+{
+	uint64_t ns = endNs - startNs;
+	uint64_t bin;
+
+	ns = (ns > benchTimerOverheadNs) ? (ns - benchTimerOverheadNs) : 0;
+	bin = Min(ns / BENCH_LATENCY_BIN_NS, (uint64_t)(BENCH_LATENCY_BINS - 1));
+	latency->count++;
+	latency->sumNs += ns;
+	latency->bins[bin]++;
+}
+
+static uint32_t benchPercentile(const BenchLatency_t *latency, uint8_t percent)
+{
+	uint64_t target = (latency->count * percent + 99) / 100;
+	uint64_t seen = 0;
+
+	for (uint32_t i = 0; i < BENCH_LATENCY_BINS; i++)
+	{
+		seen += latency->bins[i];
+		if (seen >= target)
+		{
+			return (i + 1) * BENCH_LATENCY_BIN_NS;
+		}
+	}
+	return BENCH_LATENCY_BINS * BENCH_LATENCY_BIN_NS;
+}
+
+/* Cost of the clock reads around every measured call */
+static void benchCalibrate(void)
+{
+	uint64_t best = UINT64_MAX;
+
+	for (uint32_t i = 0; i < 10000; i++)
+	{
+		uint64_t start = benchNow();
+		uint64_t end = benchNow();
+
+		best = Min(best, end - start);
+	}
+	benchTimerOverheadNs = best;
+}
+
+static void benchAlloc(uint8_t size, uint32_t lifetime, uint32_t now)
+{
+	uint64_t start, end;
+	void *ptr;
+
+	if (benchLiveCount >= BENCH_MAX_LIVE)
+	{
+		return;
+	}
+	start = benchNow();
+	ptr = MiMem_AllocNoClear(size);
+	end = benchNow();
+
+	if (NULL == ptr)
+	{
+		benchFailures++;
+		return;
+	}
+	benchRecord(&benchAllocLatency, start, end);
+	/* Touch the buffer like the stack does */
+	memset(ptr, 0xA5, size);
+	benchLive[benchLiveCount].ptr = ptr;
+	benchLive[benchLiveCount].expiry = now + lifetime;
+	benchLiveCount++;
+}
+
+static void benchFree(uint16_t index)
+{
+	uint64_t start, end;
+
+	start = benchNow();
+	MiMem_Free(benchLive[index].ptr);
+	end = benchNow();
+	benchRecord(&benchFreeLatency, start, end);
+
+	benchLive[index] = benchLive[--benchLiveCount];
+}
+
+/* Size classes as the stack registers them on initialization */
+static void benchInit(void)
+{
+	MiMem_Init();
+#if defined(ENABLE_MIMEM_SLAB)
+	if (!MiMem_SlabCreate(BENCH_PHY_FRAME_SIZE, MIMEM_SLAB_PHY_FRAMES) ||
+		!MiMem_SlabCreate(BENCH_DATA_FRAME_SIZE, MIMEM_SLAB_DATA_FRAMES) ||
+		!MiMem_SlabCreate(BENCH_TX_FRAME_SIZE, MIMEM_SLAB_TX_FRAMES) ||
+		!MiMem_SlabCreate(BENCH_CMD_FRAME_SIZE, MIMEM_SLAB_CMD_FRAMES))
+	{
+		Assert(false);
+	}
+#endif
+	benchLiveCount = 0;
+	benchFailures = 0;
+	memset(&benchAllocLatency, 0, sizeof(benchAllocLatency));
+	memset(&benchFreeLatency, 0, sizeof(benchFreeLatency));
+}
+
+/*********************************************************************
+* Function:         static void benchRun(uint8_t frames)
+*
+* Overview:         Replays the allocations of a node with up to the
+*                   given number of data frames in flight. A frame takes
+*                   a data frame buffer that waits for the application
+*                   acknowledgement, a transmit entry until the MAC
+*                   confirm and a PHY request for a single step; command
+*                   frames of random size come in between. Afterwards
+*                   the heap is filled with data frames to show how much
+*                   of the free memory is still usable.
+********************************************************************/
+static void benchRun(uint8_t frames)
+{
+	uint16_t headroom = 0;
+	uint8_t freePercent;
+	void *fill[64];
+
+	benchInit();
+	for (uint32_t step = 0; step < BENCH_STEPS; step++)
+	{
+		for (uint16_t i = 0; i < benchLiveCount; )
+		{
+			if (benchLive[i].expiry <= step)
+			{
+				benchFree(i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		if (benchRandom(4) == 0)
+		{
+			uint32_t lifetime = 1 + benchRandom(4U * frames);
+
+			benchAlloc(BENCH_DATA_FRAME_SIZE, lifetime, step);
+			benchAlloc(BENCH_TX_FRAME_SIZE, 1 + benchRandom(lifetime), step);
+			benchAlloc(BENCH_PHY_FRAME_SIZE, 1, step);
+		}
+		if (benchRandom(16) == 0)
+		{
+			uint8_t size = benchRandom(2) ? BENCH_CMD_FRAME_SIZE : (uint8_t)(1 + benchRandom(BENCH_CMD_SMALL_MAX));
+
+			benchAlloc(size, 1 + benchRandom(8), step);
+		}
+	}
+
+	freePercent = MiMem_PercentageOfFreeBuffers();
+	while ((headroom < 64) && (NULL != (fill[headroom] = MiMem_AllocNoClear(BENCH_DATA_FRAME_SIZE))))
+	{
+		headroom++;
+	}
+
+	printf("%6u %8u %8u %8u %8u %8lu %6u%% %8u\n", frames,
+		(unsigned)(benchAllocLatency.sumNs / Max(benchAllocLatency.count, 1ULL)),
+		benchPercentile(&benchAllocLatency, 99),
+		(unsigned)(benchFreeLatency.sumNs / Max(benchFreeLatency.count, 1ULL)),
+		benchPercentile(&benchFreeLatency, 99),
+		(unsigned long)benchFailures, freePercent, headroom);
+
+	while (headroom)
+	{
+		MiMem_Free(fill[--headroom]);
+	}
+	while (benchLiveCount)
+	{
+		benchFree(benchLiveCount - 1);
+	}
+}
+
+int main(void)
+{
+	static const uint8_t loads[] = {2, 4, 8, 16, 24};
+
+	benchCalibrate();
+#if defined(ENABLE_MIMEM_SLAB)
+	printf("MiMem with size classes\n");
+#else
+	printf("MiMem best fit heap\n");
+#endif
+	printf("%6s %8s %8s %8s %8s %8s %7s %8s\n", "frames", "alloc_ns", "a_p99_ns",
+		"free_ns", "f_p99_ns", "failed", "free", "headroom");
+	for (uint8_t i = 0; i < sizeof(loads); i++)
+	{
+		benchRun(loads[i]);
+	}
+	return 0;
+}
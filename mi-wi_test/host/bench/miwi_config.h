@@ -0,0 +1,57 @@
+/**
+* \file  miwi_config.h
+*
+* \brief Configuration of the MiMem allocator and system timer benchmarks
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+#ifndef MIWI_CONFIG_H
+#define MIWI_CONFIG_H
+
+/* Stands in for config/miwi_config.h, so that mimem.c can be built
+ * with and without the size classes from the same sources. The pool
+ * sizes and the timer wheel follow the firmware configuration. */
+#if defined(BENCH_SLAB)
+#define ENABLE_MIMEM_SLAB
+#endif
+
+#define TX_BUFFER_SIZE              100
+
+#define MIMEM_SLAB_DATA_FRAMES      8
+#define MIMEM_SLAB_TX_FRAMES        8
+#define MIMEM_SLAB_PHY_FRAMES       4
+#define MIMEM_SLAB_CMD_FRAMES       4
+#define MIMEM_SLAB_CLASSES          4
+
+#define SYS_TIMER_WHEEL_SIZE        32
+
+#endif
@@ -0,0 +1,385 @@
+/**
+* \file  timer_bench.c
+*
+* \brief Benchmark of the system timer wheel against the delta list it replaces
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include <string.h>
+#include "compiler.h"
+#include "common_hw_timer.h"
+#include "miwi_config.h"
+#include "sysTimer.h"
+#include "bench.h"
+
+/************************ DEFINITIONS ******************************/
+#define BENCH_TIMERS            1000
+#define BENCH_STEPS             200000UL
+#define BENCH_TIMED_OPS         100000UL
+#define BENCH_TIMED_ROUNDS      5
+
+/************************ TYPE DEFINITIONS ******************************/
+/* SYS_Timer_t before the timer wheel */
+typedef struct LegacyTimer_t {
+	struct LegacyTimer_t *next;
+	uint32_t timeout;
+	uint32_t interval;
+	SYS_TimerMode_t mode;
+	void (*handler)(struct LegacyTimer_t *timer);
+} LegacyTimer_t;
+
+/* Timers expired in the current step, in order */
+typedef struct _BenchLog_t
+{
+	uint16_t count;
+	uint16_t index[2 * BENCH_TIMERS];
+} BenchLog_t;
+
+/************************ VARIABLES ********************************/
+extern volatile uint32_t SysTimerIrqCount;
+
+static SYS_Timer_t wheelTimers[BENCH_TIMERS];
+static LegacyTimer_t legacyTimers[BENCH_TIMERS];
+static LegacyTimer_t *legacyList;
+static BenchLog_t wheelLog, legacyLog;
+
+/************************ FUNCTIONS ********************************/
+/* The hardware timer is not used, the benchmark counts the ticks */
+void common_tc_init(void) {}
+uint16_t common_tc_read_count(void) { return 0; }
+void common_tc_delay(uint16_t value) { (void)value; }
+void common_tc_compare_stop(void) {}
+void common_tc_overflow_stop(void) {}
+void common_tc_stop(void) {}
+void set_common_tc_overflow_callback(tmr_callback_t callback) { (void)callback; }
+void set_common_tc_expiry_callback(tmr_callback_t callback) { (void)callback; }
+
+/*********************************************************************
+* The delta list of sysTimer.c, as it was
+********************************************************************/
+static void legacyPlace(LegacyTimer_t *timer)
+{
+	if (legacyList) {
+		LegacyTimer_t *prev = NULL;
+		uint32_t timeout = timer->interval;
+
+		for (LegacyTimer_t *t = legacyList; t; t = t->next) {
+			if (timeout < t->timeout) {
+				t->timeout -= timeout;
+				break;
+			} else {
+				timeout -= t->timeout;
+			}
+
+			prev = t;
+		}
+
+		timer->timeout = timeout;
+
+		if (prev) {
+			timer->next = prev->next;
+			prev->next = timer;
+		} else {
+			timer->next = legacyList;
+			legacyList = timer;
+		}
+	} else {
+		timer->next = NULL;
+		timer->timeout = timer->interval;
+		legacyList = timer;
+	}
+}
+
+static bool legacyStarted(LegacyTimer_t *timer)
+{
+	for (LegacyTimer_t *t = legacyList; t; t = t->next) {
+		if (t == timer) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void legacyStart(LegacyTimer_t *timer)
+{
+	if (!legacyStarted(timer)) {
+		legacyPlace(timer);
+	}
+}
+
+static void legacyStop(LegacyTimer_t *timer)
+{
+	LegacyTimer_t *prev = NULL;
+
+	for (LegacyTimer_t *t = legacyList; t; t = t->next) {
+		if (t == timer) {
+			if (prev) {
+				prev->next = t->next;
+			} else {
+				legacyList = t->next;
+			}
+
+			if (t->next) {
+				t->next->timeout += timer->timeout;
+			}
+
+			break;
+		}
+
+		prev = t;
+	}
+}
+
+static void legacyTaskHandler(uint32_t cnt)
+{
+	uint32_t elapsed = cnt * SYS_TIMER_INTERVAL;
+
+	while (legacyList && (legacyList->timeout <= elapsed)) {
+		LegacyTimer_t *timer = legacyList;
+
+		elapsed -= legacyList->timeout;
+		legacyList = legacyList->next;
+		if (SYS_TIMER_PERIODIC_MODE == timer->mode) {
+			legacyPlace(timer);
+		}
+
+		if (timer->handler) {
+			timer->handler(timer);
+		}
+	}
+
+	if (legacyList) {
+		legacyList->timeout -= elapsed;
+	}
+}
+
+static uint32_t legacyRemaining(LegacyTimer_t *timer)
+{
+	uint32_t remainingTime = 0;
+
+	for (LegacyTimer_t *t = legacyList; t; t = t->next) {
+		remainingTime += t->timeout;
+		if (t == timer) {
+			return remainingTime;
+		}
+	}
+	return 0;
+}
+
+/*********************************************************************
+* Both implementations see the same timers. A quarter of the one shot
+* timers restart themselves from their handler, like the keepalive and
+* retry timers of the stack do.
+********************************************************************/
+static bool benchRestarts(uint16_t index)
+{
+	return 0 == (index & 3);
+}
+
+static void wheelHandler(SYS_Timer_t *timer)
+{
+	uint16_t index = (uint16_t)(timer - wheelTimers);
+
+	wheelLog.index[wheelLog.count++ % (2 * BENCH_TIMERS)] = index;
+	if ((SYS_TIMER_INTERVAL_MODE == timer->mode) && benchRestarts(index)) {
+		SYS_TimerStart(timer);
+	}
+}
+
+static void legacyHandler(LegacyTimer_t *timer)
+{
+	uint16_t index = (uint16_t)(timer - legacyTimers);
+
+	legacyLog.index[legacyLog.count++ % (2 * BENCH_TIMERS)] = index;
+	if ((SYS_TIMER_INTERVAL_MODE == timer->mode) && benchRestarts(index)) {
+		legacyStart(timer);
+	}
+}
+
+/* Mostly seconds, some below a second and some up to a minute, and
+ * not on the tick so that the rounding shows */
+static uint32_t benchInterval(void)
+{
+	switch (benchRandom(4)) {
+	case 0:
+		return 1 + benchRandom(1000);
+	case 3:
+		return 10000 + benchRandom(50000);
+	default:
+		return 1000 + benchRandom(9000);
+	}
+}
+
+static void benchInit(void)
+{
+	SYS_TimerInit();
+	legacyList = NULL;
+	memset(wheelTimers, 0, sizeof(wheelTimers));
+	memset(legacyTimers, 0, sizeof(legacyTimers));
+	for (uint16_t i = 0; i < BENCH_TIMERS; i++) {
+		wheelTimers[i].interval = benchInterval();
+		wheelTimers[i].mode = benchRandom(4) ? SYS_TIMER_INTERVAL_MODE : SYS_TIMER_PERIODIC_MODE;
+		wheelTimers[i].handler = wheelHandler;
+		legacyTimers[i].interval = wheelTimers[i].interval;
+		legacyTimers[i].mode = wheelTimers[i].mode;
+		legacyTimers[i].handler = legacyHandler;
+		SYS_TimerStart(&wheelTimers[i]);
+		legacyStart(&legacyTimers[i]);
+	}
+}
+
+/*********************************************************************
+* Function:         static uint32_t benchCompare(void)
+*
+* Overview:         Runs both implementations side by side through
+*                   random restarts, stops, changed intervals and
+*                   sleeps of several ticks, and counts the steps in
+*                   which they expire other timers, in another order, or
+*                   report another remaining time.
+********************************************************************/
+static uint32_t benchCompare(void)
+{
+	uint32_t mismatches = 0;
+
+	benchInit();
+	for (uint32_t step = 0; step < BENCH_STEPS; step++) {
+		uint16_t index = (uint16_t)benchRandom(BENCH_TIMERS);
+		uint32_t cnt = 1;
+
+		switch (benchRandom(8)) {
+		case 0:
+			SYS_TimerStop(&wheelTimers[index]);
+			legacyStop(&legacyTimers[index]);
+			break;
+		case 1:
+			wheelTimers[index].interval = benchInterval();
+			legacyTimers[index].interval = wheelTimers[index].interval;
+			/* fall through */
+		case 2:
+		case 3:
+			SYS_TimerStop(&wheelTimers[index]);
+			legacyStop(&legacyTimers[index]);
+			SYS_TimerStart(&wheelTimers[index]);
+			legacyStart(&legacyTimers[index]);
+			break;
+		default:
+			break;
+		}
+		if (0 == benchRandom(1000)) {
+			cnt += benchRandom(1000);
+		}
+
+		wheelLog.count = 0;
+		legacyLog.count = 0;
+		SysTimerIrqCount = cnt;
+		SYS_TimerTaskHandler();
+		legacyTaskHandler(cnt);
+
+		index = (uint16_t)benchRandom(BENCH_TIMERS);
+		if ((wheelLog.count != legacyLog.count) ||
+			memcmp(wheelLog.index, legacyLog.index, Min(wheelLog.count, 2 * BENCH_TIMERS) * sizeof(uint16_t)) ||
+			(SYS_TimerStarted(&wheelTimers[index]) != legacyStarted(&legacyTimers[index])) ||
+			(SYS_TimerRemainingTimeout(&wheelTimers[index]) != legacyRemaining(&legacyTimers[index]))) {
+			if (0 == mismatches) {
+				printf("first mismatch in step %lu\n", (unsigned long)step);
+			}
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+/* Best round in nanoseconds per restart of a running timer */
+static uint32_t benchTimeRestart(bool wheel)
+{
+	uint64_t best = UINT64_MAX;
+
+	for (uint32_t round = 0; round < BENCH_TIMED_ROUNDS; round++) {
+		uint64_t start;
+
+		benchInit();
+		start = benchNow();
+		for (uint32_t i = 0; i < BENCH_TIMED_OPS; i++) {
+			uint16_t index = (uint16_t)benchRandom(BENCH_TIMERS);
+
+			if (wheel) {
+				SYS_TimerStop(&wheelTimers[index]);
+				SYS_TimerStart(&wheelTimers[index]);
+			} else {
+				legacyStop(&legacyTimers[index]);
+				legacyStart(&legacyTimers[index]);
+			}
+		}
+		best = Min(best, benchNow() - start);
+	}
+	return (uint32_t)(best / BENCH_TIMED_OPS);
+}
+
+/* Best round in nanoseconds per tick, expiries included */
+static uint32_t benchTimeTick(bool wheel)
+{
+	uint64_t best = UINT64_MAX;
+
+	for (uint32_t round = 0; round < BENCH_TIMED_ROUNDS; round++) {
+		uint64_t start;
+
+		benchInit();
+		start = benchNow();
+		for (uint32_t i = 0; i < BENCH_TIMED_OPS; i++) {
+			wheelLog.count = 0;
+			legacyLog.count = 0;
+			if (wheel) {
+				SysTimerIrqCount = 1;
+				SYS_TimerTaskHandler();
+			} else {
+				legacyTaskHandler(1);
+			}
+		}
+		best = Min(best, benchNow() - start);
+	}
+	return (uint32_t)(best / BENCH_TIMED_OPS);
+}
+
+int main(void)
+{
+	uint32_t mismatches = benchCompare();
+
+	printf("System timers, %u timers, %lu steps, wheel of %u slots\n", BENCH_TIMERS,
+		(unsigned long)BENCH_STEPS, SYS_TIMER_WHEEL_SIZE);
+	printf("%20s %8lu\n", "mismatch", (unsigned long)mismatches);
+	printf("%20s %8s %8s\n", "", "restart", "tick");
+	printf("%20s %5u ns %5u ns\n", "delta list", benchTimeRestart(false), benchTimeTick(false));
+	printf("%20s %5u ns %5u ns\n", "timer wheel", benchTimeRestart(true), benchTimeTick(true));
+	return (0 == mismatches) ? 0 : 1;
+}
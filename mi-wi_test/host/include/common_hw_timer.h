@@ -0,0 +1,56 @@
+/**
+* \file  common_hw_timer.h
+*
+* \brief Host stand-in for the common hardware timer driven by simulated time
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+#ifndef COMMON_HW_TIMER_H
+#define COMMON_HW_TIMER_H
+
+#include <stdint.h>
+
+#define DEF_1MHZ        (1000000)
+#define TIMER_PERIOD  UINT16_MAX
+
+typedef void (*tmr_callback_t)(void);
+
+void common_tc_init(void);
+uint16_t common_tc_read_count(void);
+void common_tc_delay(uint16_t value);
+void common_tc_compare_stop(void);
+void common_tc_overflow_stop(void);
+void common_tc_stop(void);
+void set_common_tc_overflow_callback(tmr_callback_t callback);
+void set_common_tc_expiry_callback(tmr_callback_t callback);
+
+#endif /* COMMON_HW_TIMER_H */
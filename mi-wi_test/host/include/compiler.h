@@ -0,0 +1,91 @@
+/**
+* \file  compiler.h
+*
+* \brief Host stand-in for the SAM0 compiler abstraction used by the MiWi stack
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+#ifndef UTILS_COMPILER_H_INCLUDED
+#define UTILS_COMPILER_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*- Definitions ------------------------------------------------------------*/
+#define UNUSED(v)           (void)(v)
+#define COMPILER_PACK_SET(alignment)
+#define COMPILER_PACK_RESET()
+#define COMPILER_WORD_ALIGNED   __attribute__((__aligned__(4)))
+#define COMPILER_ALIGNED(a)     __attribute__((__aligned__(a)))
+
+#define Assert(expr)        assert(expr)
+
+#define nop()               do { } while (0)
+
+#ifndef Min
+#define Min(a, b)           (((a) < (b)) ?  (a) : (b))
+#endif
+#ifndef Max
+#define Max(a, b)           (((a) > (b)) ?  (a) : (b))
+#endif
+
+/*- Types ------------------------------------------------------------------*/
+typedef void (*FUNC_PTR)(void);
+typedef uint32_t irqflags_t;
+
+/*- Implementations --------------------------------------------------------*/
+/* The simulated nodes run to completion on a single host thread; interrupt
+ * service routines are replayed between task calls, so critical sections
+ * reduce to no-ops. */
+static inline irqflags_t cpu_irq_save(void)
+{
+	return 0;
+}
+
+static inline void cpu_irq_restore(irqflags_t flags)
+{
+	(void)flags;
+}
+
+#define cpu_irq_enable()    do { } while (0)
+#define cpu_irq_disable()   do { } while (0)
+
+static inline uint16_t convert_byte_array_to_16_bit(uint8_t *data)
+{
+	return (data[0] | ((uint16_t)data[1] << 8));
+}
+
+#endif /* UTILS_COMPILER_H_INCLUDED */
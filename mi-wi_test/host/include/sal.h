@@ -0,0 +1,63 @@
+/**
+* \file  sal.h
+*
+* \brief Host stand-in for the security abstraction layer (software AES-128)
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+#ifndef SAL_H
+#define SAL_H
+
+#include "compiler.h"
+
+#define AT86RF2xx                    (1)
+
+#define AES_BLOCKSIZE                (16)
+#define AES_KEYSIZE                  (16)
+
+#define AES_DIR_ENCRYPT              (0)
+#define AES_DIR_DECRYPT              (1)
+
+#define AES_MODE_ECB                 (0)
+#define AES_MODE_KEY                 (1)
+#define AES_MODE_CBC                 (2)
+
+void sal_init(void);
+bool sal_aes_setup(uint8_t *key, uint8_t enc_mode, uint8_t dir);
+void sal_aes_wrrd(uint8_t *idata, uint8_t *odata);
+void sal_aes_exec(uint8_t *data);
+void sal_aes_read(uint8_t *data);
+void sal_aes_restart(void);
+void _sal_aes_clean_up(void);
+#define sal_aes_clean_up()      _sal_aes_clean_up()
+
+#endif /* SAL_H */
@@ -0,0 +1,78 @@
+/**
+* \file  trx_access.h
+*
+* \brief Host stand-in for the transceiver access layer backed by the AT86RF212B model
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+#ifndef TRX_ACCESS_H
+#define TRX_ACCESS_H
+
+#include "compiler.h"
+
+typedef void (*irq_handler_t)(void);
+
+/* SLP_TR and RST lines are wired straight into the transceiver model. */
+void sim_trx_slp_tr(bool level);
+void sim_trx_rst(bool level);
+
+#define TRX_TRIG_DELAY()                {nop(); nop(); }
+
+#define TRX_RST_HIGH()                  sim_trx_rst(true)
+#define TRX_RST_LOW()                   sim_trx_rst(false)
+#define TRX_SLP_TR_HIGH()               sim_trx_slp_tr(true)
+#define TRX_SLP_TR_LOW()                sim_trx_slp_tr(false)
+
+#define ENABLE_TRX_IRQ()                do { } while (0)
+#define DISABLE_TRX_IRQ()               do { } while (0)
+#define CLEAR_TRX_IRQ()                 do { } while (0)
+#define trx_irq_flag_clr()              CLEAR_TRX_IRQ()
+
+#define ENTER_TRX_CRITICAL_REGION()     {uint8_t flags = cpu_irq_save();
+#define LEAVE_TRX_CRITICAL_REGION()     cpu_irq_restore(flags); }
+
+void trx_irq_init(FUNC_PTR trx_irq_cb);
+void trx_frame_read(uint8_t *data, uint8_t length);
+void trx_frame_write(uint8_t *data, uint8_t length);
+uint8_t trx_reg_read(uint8_t addr);
+void trx_reg_write(uint8_t addr, uint8_t data);
+uint8_t trx_bit_read(uint8_t addr, uint8_t mask, uint8_t pos);
+void trx_bit_write(uint8_t reg_addr, uint8_t mask, uint8_t pos, uint8_t new_value);
+void trx_sram_read(uint8_t addr, uint8_t *data, uint8_t length);
+void trx_sram_write(uint8_t addr, uint8_t *data, uint8_t length);
+void trx_aes_wrrd(uint8_t addr, uint8_t *idata, uint8_t length);
+void trx_spi_init(void);
+void PhyReset(void);
+void trx_spi_disable(void);
+void trx_spi_enable(void);
+
+#endif /* TRX_ACCESS_H */
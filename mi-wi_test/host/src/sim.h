@@ -0,0 +1,353 @@
+/**
+* \file  sim.h
+*
+* \brief Host simulation of MiWi nodes on a simulated AT86RF212B radio
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+/************************ HEADERS **********************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "compiler.h"
+#include "common_hw_timer.h"
+
+/************************ DEFINITIONS ******************************/
+/* Frame buffer holds PHR, up to 127 bytes of PSDU and the LQI byte */
+#define SIM_TRX_FRAME_BUFFER_SIZE   (1 + 127 + 1)
+#define SIM_TRX_REGISTER_COUNT      (0x40)
+
+/* Energy detect measurement duration (8 symbols of O-QPSK 1000 kb/s) */
+#define SIM_TRX_ED_DURATION_US      (128)
+
+/* Output power at TX_PWR 0 of PHY_TX_PWR, about 1 dB less per step */
+#define SIM_TRX_TX_POWER_MAX_DBM    (5)
+
+/* Weakest frame the receiver synchronises to */
+#define SIM_TRX_SENSITIVITY_DBM     (-94)
+
+/* Received power of every link at the power the PHY driver sets
+ * (TX_PWR 1) when the nodes are not placed, and of the interferer */
+#define SIM_DEFAULT_RX_POWER_DBM    (-60)
+#define SIM_DEFAULT_PATH_LOSS_DB    (SIM_TRX_TX_POWER_MAX_DBM - 1 - SIM_DEFAULT_RX_POWER_DBM)
+
+/* Log-distance path loss between placed nodes */
+#define SIM_PATH_LOSS_1M_DB         (32)
+#define SIM_PATH_LOSS_EXPONENT      (3.0)
+
+#define SIM_TIME_NEVER              UINT64_MAX
+
+/************************ DATA TYPES *******************************/
+typedef enum _SimRole_t
+{
+	SIM_ROLE_PAN_COORDINATOR = 0,
+	SIM_ROLE_END_DEVICE
+} SimRole_t;
+
+/* Per node parameters handed to the node application at start-up */
+typedef struct _SimNodeConfig_t
+{
+	uint16_t id;
+	SimRole_t role;
+	uint8_t channel;
+	/* Application data period in milliseconds, 0 disables traffic */
+	uint32_t dataIntervalMs;
+	uint8_t dataLen;
+	/* PAN coordinator also sends to its end devices, one per period */
+	bool downlink;
+	/* End devices send to each other through the PAN coordinator
+	 * instead of to the PAN coordinator */
+	bool peer;
+	/* End devices send this many bulk frames and then an alarm per
+	 * period instead of one normal frame */
+	uint8_t bulkFrames;
+	/* PAN coordinator runs a background energy detection scan of all
+	 * channels with this period in milliseconds, 0 for none */
+	uint32_t edScanPeriodMs;
+} SimNodeConfig_t;
+
+/* Counters collected outside the node image so they survive context swaps */
+typedef struct _SimNodeStats_t
+{
+	bool connected;
+	uint64_t connectedAtUs;
+	uint32_t linkFailures;
+	uint32_t frameTx;
+	/* Output power of the frames sent, acknowledgements aside */
+	int64_t frameTxPowerSumDbm;
+	uint32_t frameTxNoAck;
+	uint32_t frameTxChannelBusy;
+	uint32_t frameRx;
+	uint32_t frameRxFiltered;
+	uint32_t frameRxOverrun;
+	uint32_t frameRxCollision;
+	uint64_t airtimeUs;
+	uint32_t appTx;
+	uint32_t appTxSuccess;
+	uint32_t appTxFailure;
+	uint32_t appRx;
+	uint64_t appRxLatencySumUs;
+	uint32_t appRxLatencyMaxUs;
+	uint32_t appRxAlarm;
+	uint64_t appRxAlarmLatencySumUs;
+	uint32_t appRxAlarmLatencyMaxUs;
+	uint8_t memFreePercentMin;
+	uint8_t txQueueMax;
+	uint8_t indirectQueueMax;
+	uint64_t sleptUs;
+	uint32_t edScans;
+	uint32_t edScanChannels;
+	uint32_t edScanSamples;
+	int8_t edScanEnergyMax;
+	uint8_t edScanOptimalChannel;
+} SimNodeStats_t;
+
+struct _SimTx_t;
+
+/* Transmit procedure of the extended operating mode in progress */
+typedef enum _SimTxPhase_t
+{
+	SIM_TX_IDLE = 0,
+	SIM_TX_BACKOFF,
+	SIM_TX_CCA,
+	SIM_TX_FRAME,
+	SIM_TX_ACK_WAIT,
+	/* Receiver sending an automatic acknowledgement */
+	SIM_TX_ACK_REPLY
+} SimTxPhase_t;
+
+/* Register level model of the AT86RF212B */
+typedef struct _SimTrx_t
+{
+	uint8_t regs[SIM_TRX_REGISTER_COUNT];
+	uint8_t frameBuffer[SIM_TRX_FRAME_BUFFER_SIZE];
+	uint8_t status;
+	uint8_t tracStatus;
+	uint8_t irqStatus;
+	uint8_t edLevel;
+	/* Energy detection ending with an interrupt is in progress */
+	bool edPending;
+	uint64_t edEndUs;
+	bool slpTr;
+	bool crcValid;
+	FUNC_PTR irqHandler;
+
+	/* Medium state: frame being received and transmit procedure */
+	struct _SimTx_t *rxFrame;
+	bool rxCorrupted;
+	SimTxPhase_t txPhase;
+	bool txExtended;
+	bool ccaBusy;
+	uint8_t csmaBackoffs;
+	uint8_t csmaBe;
+	uint8_t frameRetries;
+	uint8_t ackSeq;
+	/* Transmission requested while an acknowledgement is sent */
+	bool txPending;
+	bool txPendingExtended;
+	/* Bumped whenever a transmit procedure ends, invalidates its events */
+	uint32_t txToken;
+} SimTrx_t;
+
+/* Model of the 16-bit 1 MHz counter behind common_hw_timer */
+typedef struct _SimHwTimer_t
+{
+	bool running;
+	bool overflowEnabled;
+	bool compareArmed;
+	uint64_t now;
+	uint64_t epoch;
+	uint64_t nextOverflow;
+	uint64_t compareAt;
+	uint16_t frozenCount;
+	tmr_callback_t overflowCb;
+	tmr_callback_t expiryCb;
+} SimHwTimer_t;
+
+struct _SimImageState_t;
+
+/* Firmware image: the MiWi stack plus node application linked into one
+ * relocatable object whose .data and .bss are collected into dedicated
+ * sections, so that every node can own a private copy of them. */
+typedef struct _SimImage_t
+{
+	const char *name;
+	uint8_t *dataStart;
+	uint8_t *dataEnd;
+	uint8_t *bssStart;
+	uint8_t *bssEnd;
+	void (*init)(void);
+	void (*task)(void);
+	/* True while the main loop waits for time to pass without an
+	 * interrupt to come, the node then keeps running it */
+	bool (*busy)(void);
+	/* Prints the heap statistics of the current node */
+	void (*memReport)(void);
+} SimImage_t;
+
+typedef struct _SimNode_t
+{
+	SimNodeConfig_t cfg;
+	const SimImage_t *image;
+	struct _SimImageState_t *imageState;
+	uint8_t *context;
+	bool booted;
+	/* Local clock, ahead of simTimeUs while the node busy-waits */
+	uint64_t timeUs;
+	/* Pending wake-up of the main loop, SIM_TIME_NEVER if none */
+	uint64_t wakeAt;
+	/* End of the current MCU sleep */
+	uint64_t sleepUntil;
+	SimTrx_t trx;
+	/* Position in metres, used when simRadiusM is set */
+	double x;
+	double y;
+	SimHwTimer_t timer;
+	uint32_t rngState;
+	SimNodeStats_t stats;
+} SimNode_t;
+
+/* Events of the discrete event scheduler */
+typedef enum _SimEventType_t
+{
+	SIM_EVENT_NODE_WAKE = 0,
+	SIM_EVENT_BACKOFF_END,
+	SIM_EVENT_CCA_END,
+	SIM_EVENT_TX_START,
+	SIM_EVENT_FRAME_END,
+	SIM_EVENT_ACK_START,
+	SIM_EVENT_ACK_WAIT_END,
+	SIM_EVENT_ED_END
+} SimEventType_t;
+
+typedef struct _SimEvent_t
+{
+	uint64_t time;
+	/* Insertion order, keeps simultaneous events deterministic */
+	uint64_t seq;
+	SimEventType_t type;
+	uint32_t token;
+	SimNode_t *node;
+	struct _SimTx_t *tx;
+} SimEvent_t;
+
+/* Medium wide counters */
+typedef struct _SimMediumStats_t
+{
+	uint32_t transmissions;
+	uint32_t acks;
+	uint32_t collisions;
+	/* Frames lost at a receiver to the interferer */
+	uint32_t interfered;
+	/* Sum of the transmissions, overlapping ones counted each */
+	uint64_t airtimeUs;
+	/* Time any transmission was on air */
+	uint64_t busyUs;
+	uint64_t busyUntil;
+} SimMediumStats_t;
+
+/* Another system sending on one channel from startUs on, in bursts
+ * that fill dutyPercent of the time */
+typedef struct _SimInterferer_t
+{
+	bool enabled;
+	uint8_t channel;
+	uint8_t dutyPercent;
+	uint64_t startUs;
+} SimInterferer_t;
+
+/************************ VARIABLES ********************************/
+extern uint64_t simTimeUs;
+extern SimNode_t *simCurrentNode;
+extern SimNode_t **simNodes;
+extern uint16_t simNodeCount;
+extern bool simTrace;
+extern SimMediumStats_t simMediumStats;
+extern SimInterferer_t simInterferer;
+/* End devices are spread over a disc of this radius around the PAN
+ * coordinator, 0 for the same path loss on every link */
+extern double simRadiusM;
+
+/* Firmware image built from the repository configuration (FFD) */
+extern const SimImage_t simImageFfd;
+/* FFD with indirect messaging, PAN coordinator of sleeping devices */
+extern const SimImage_t simImageCoord;
+/* Sleeping end device (ENABLE_SLEEP_FEATURE) */
+extern const SimImage_t simImageRfd;
+
+/************************ Prototypes ********************************/
+/* Nodes */
+SimNode_t *SimNode_Create(const SimImage_t *image, const SimNodeConfig_t *cfg);
+void SimNode_Switch(SimNode_t *node);
+void SimNode_Run(SimNode_t *node);
+void SimNode_Wake(SimNode_t *node, uint64_t at);
+void SimNode_Sleep(uint32_t ms);
+void SimNode_DestroyAll(void);
+uint32_t SimNode_Random(SimNode_t *node);
+
+/* Time and events */
+uint64_t SimTime_Now(void);
+void SimTime_Block(uint32_t us);
+void SimEvent_Schedule(uint64_t time, SimEventType_t type, SimNode_t *node, struct _SimTx_t *tx, uint32_t token);
+void SimEvent_RunUntil(uint64_t endUs);
+void SimEvent_Reset(void);
+
+/* Hardware timer */
+void SimHwTimer_Reset(SimHwTimer_t *timer);
+void SimHwTimer_Sync(SimNode_t *node);
+uint64_t SimHwTimer_Next(const SimNode_t *node);
+
+/* Transceiver */
+void SimTrx_Reset(SimTrx_t *trx);
+bool SimTrx_Deliver(SimNode_t *node, const uint8_t *psdu, uint8_t len, int8_t rxPowerDbm);
+void SimTrx_TxDone(SimNode_t *node, uint8_t trac);
+void SimTrx_EdEnd(SimNode_t *node);
+uint8_t SimTrx_Channel(const SimTrx_t *trx);
+bool SimTrx_IsReceiving(const SimTrx_t *trx);
+
+/* Statistics */
+void SimStats_Latency(bool uplink, uint64_t latencyUs);
+void SimStats_Report(uint64_t durationUs, bool perNode);
+void SimStats_ReportLine(uint64_t durationUs, bool header);
+
+/* Medium */
+void SimMedium_TxRequest(SimNode_t *node, bool extended);
+void SimMedium_TxAbort(SimNode_t *node);
+void SimMedium_Event(const SimEvent_t *event);
+int8_t SimMedium_Energy(SimNode_t *node);
+uint32_t SimMedium_Airtime(uint8_t psduLen);
+void SimMedium_Reset(void);
+
+#endif /* SIM_H */
@@ -0,0 +1,526 @@
+/**
+* \file  sim_app.c
+*
+* \brief Node application linked into every simulated firmware image
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "miwi_api.h"
+#include "mimac_at86rf.h"
+#include "mimem.h"
+#include "miqueue.h"
+#include "phy.h"
+#include "trx_access.h"
+#include "sysTimer.h"
+#include "sim.h"
+
+/************************ DEFINITIONS ******************************/
+#if !defined(SIM_IMAGE_NAME) || !defined(SIM_IMAGE_SECTION)
+#error "SIM_IMAGE_NAME and SIM_IMAGE_SECTION must be defined for a simulated image"
+#endif
+
+#define SIM_PASTE_(a, b, c)     a##b##c
+#define SIM_PASTE(a, b, c)      SIM_PASTE_(a, b, c)
+#define SIM_STR_(a)             #a
+#define SIM_STR(a)              SIM_STR_(a)
+
+/* Linker generated bounds of the node private sections */
+#define SIM_DATA_START   SIM_PASTE(__start_, SIM_IMAGE_SECTION, _data)
+#define SIM_DATA_STOP    SIM_PASTE(__stop_, SIM_IMAGE_SECTION, _data)
+#define SIM_BSS_START    SIM_PASTE(__start_, SIM_IMAGE_SECTION, _bss)
+#define SIM_BSS_STOP     SIM_PASTE(__stop_, SIM_IMAGE_SECTION, _bss)
+
+/* Application payload: send time stamp, transmit class and filler */
+#define SIM_APP_TIMESTAMP_SIZE  (sizeof(uint64_t))
+#define SIM_APP_CLASS_OFFSET    SIM_APP_TIMESTAMP_SIZE
+
+/* The PAN coordinator prefixes frames it forwards between end devices
+ * with the short address of the sender */
+#define SIM_APP_PEER_HEADER_SIZE    3
+
+/* Pause before a failed join is retried. It doubles on every failure
+ * and is spread per node, so that the devices a full PAN turned away
+ * do not keep the channel busy. */
+#define SIM_APP_JOIN_RETRY_MS       1000
+#define SIM_APP_JOIN_RETRY_MAX_MS   32000
+
+/* Background energy detection scan of the PAN coordinator: channels 0
+ * to 10 of the sub-GHz band, about 0.3 s each */
+#define SIM_APP_ED_SCAN_CHANNELS    0x000007FFUL
+#define SIM_APP_ED_SCAN_DURATION    3
+
+#ifdef ENABLE_SLEEP_FEATURE
+/* Shortest sleep worth entering standby for, as in the sleep manager */
+#if defined(ENABLE_TICKLESS_IDLE)
+#define SIM_APP_MIN_SLEEP_MS    (2 * SYS_TIMER_INTERVAL)
+#else
+#define SIM_APP_MIN_SLEEP_MS    1000
+#endif
+#endif
+
+/************************ VARIABLES ********************************/
+extern uint8_t SIM_DATA_START[], SIM_DATA_STOP[], SIM_BSS_START[], SIM_BSS_STOP[];
+
+/* Stack queues sampled for the statistics */
+extern uint8_t frameTxQueued;
+#ifdef ENABLE_INDIRECT_MESSAGE
+extern uint8_t indirectFrameCount;
+#endif
+
+#if ADDITIONAL_NODE_ID_SIZE > 0
+uint8_t AdditionalNodeID[ADDITIONAL_NODE_ID_SIZE] = {0x01};
+#endif
+
+/* Connection Table Memory */
+CONNECTION_ENTRY connectionTable[CONNECTION_SIZE];
+
+#ifdef ENABLE_ACTIVE_SCAN
+/* Active Scan Results Table Memory */
+ACTIVE_SCAN_RESULT activeScanResults[ACTIVE_SCAN_RESULT_SIZE];
+#endif
+
+defaultParametersRomOrRam_t defaultParamsRomOrRam = {
+	.ConnectionTable = &connectionTable[0],
+#ifdef ENABLE_ACTIVE_SCAN
+	.ActiveScanResults = &activeScanResults[0],
+#endif
+#if ADDITIONAL_NODE_ID_SIZE > 0
+	.AdditionalNodeID = &AdditionalNodeID[0],
+#endif
+	.networkFreezerRestore = 0,
+};
+
+defaultParametersRamOnly_t defaultParamsRamOnly = {
+	.dummy = 0,
+};
+
+static SYS_Timer_t simAppDataTimer;
+static SYS_Timer_t simAppJoinTimer;
+static SYS_Timer_t simAppEdScanTimer;
+static uint8_t simAppMsgHandle;
+static uint8_t simAppChannel;
+static bool simAppJoinPending;
+static uint32_t simAppJoinRetryMs = SIM_APP_JOIN_RETRY_MS;
+static uint8_t simAppDownlinkIndex;
+static uint8_t simAppPeerIndex;
+#ifdef ENABLE_SLEEP_FEATURE
+static uint32_t simAppSleptMs;
+#endif
+
+/************************ FUNCTIONS ********************************/
+static void simAppDataConf(uint8_t msgConfHandle, miwi_status_t status, uint8_t *msgPointer)
+{
+	(void)msgConfHandle;
+	(void)msgPointer;
+
+	if (SUCCESS == status)
+	{
+		simCurrentNode->stats.appTxSuccess++;
+	}
+	else
+	{
+		simCurrentNode->stats.appTxFailure++;
+	}
+}
+
+static void simAppDataInd(RECEIVED_MESSAGE *ind)
+{
+	SimNodeStats_t *stats = &simCurrentNode->stats;
+	bool peer = simCurrentNode->cfg.peer && (END_DEVICE == role);
+	uint8_t *payload = ind->Payload;
+	uint8_t payloadSize = ind->PayloadSize;
+	uint64_t sentAt;
+	uint64_t latency;
+
+	if (peer)
+	{
+		payload += Min(payloadSize, SIM_APP_PEER_HEADER_SIZE);
+		payloadSize -= Min(payloadSize, SIM_APP_PEER_HEADER_SIZE);
+	}
+	stats->appRx++;
+	if (payloadSize >= SIM_APP_TIMESTAMP_SIZE)
+	{
+		memcpy(&sentAt, payload, SIM_APP_TIMESTAMP_SIZE);
+		latency = SimTime_Now() - sentAt;
+		SimStats_Latency((END_DEVICE != role) || peer, latency);
+		stats->appRxLatencySumUs += latency;
+		if (latency > stats->appRxLatencyMaxUs)
+		{
+			stats->appRxLatencyMaxUs = (uint32_t)latency;
+		}
+		if ((payloadSize > SIM_APP_CLASS_OFFSET) && (TX_CLASS_ALARM == payload[SIM_APP_CLASS_OFFSET]))
+		{
+			stats->appRxAlarm++;
+			stats->appRxAlarmLatencySumUs += latency;
+			if (latency > stats->appRxAlarmLatencyMaxUs)
+			{
+				stats->appRxAlarmLatencyMaxUs = (uint32_t)latency;
+			}
+		}
+	}
+}
+
+static void simAppLinkFailure(void)
+{
+	simCurrentNode->stats.connected = false;
+	simCurrentNode->stats.linkFailures++;
+}
+
+static void simAppSend(uint8_t addrLen, uint8_t *addr, miwi_tx_class_t txClass)
+{
+	SimNode_t *node = simCurrentNode;
+	uint8_t payload[TX_BUFFER_SIZE];
+	uint8_t len = node->cfg.dataLen;
+	uint64_t now = SimTime_Now();
+
+	if (len <= SIM_APP_CLASS_OFFSET)
+	{
+		len = SIM_APP_CLASS_OFFSET + 1;
+	}
+	else if (len > TX_BUFFER_SIZE)
+	{
+		len = TX_BUFFER_SIZE;
+	}
+	memset(payload, (uint8_t)node->cfg.id, len);
+	memcpy(payload, &now, SIM_APP_TIMESTAMP_SIZE);
+	payload[SIM_APP_CLASS_OFFSET] = (uint8_t)txClass;
+
+	node->stats.appTx++;
+	if (!MiApp_SendDataWithClass(addrLen, addr, len, payload, simAppMsgHandle++, true, txClass, simAppDataConf))
+	{
+		node->stats.appTxFailure++;
+	}
+}
+
+/* Next other end device of the connection table the PAN coordinator
+ * shares, NULL while none is known */
+static uint8_t *simAppNextPeer(void)
+{
+	uint8_t count = Min(end_nodes, CONNECTION_SIZE);
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		END_DEVICES_Unique_Short_Address *peer = &END_DEVICES_Short_Address[simAppPeerIndex % count];
+
+		simAppPeerIndex = (uint8_t)((simAppPeerIndex % count) + 1);
+		if (((0xFF != peer->Address[0]) || (0xFF != peer->Address[1]) || (0xFF != peer->Address[2])) &&
+			memcmp(peer->Address, myLongAddress, SIM_APP_PEER_HEADER_SIZE))
+		{
+			return peer->Address;
+		}
+	}
+	return NULL;
+}
+
+/*********************************************************************
+* Function:         static void simAppDataTimerHandler(SYS_Timer_t *timer)
+*
+* Overview:         End devices report to the PAN coordinator
+*                   periodically once they joined, optionally as a
+*                   burst of bulk frames followed by an alarm. With
+*                   peer traffic they send to the other end devices in
+*                   turn instead, once they know them. With downlink
+*                   traffic the PAN coordinator also sends to one of its
+*                   end devices in turn.
+********************************************************************/
+static void simAppDataTimerHandler(SYS_Timer_t *timer)
+{
+	SimNode_t *node = simCurrentNode;
+
+	(void)timer;
+
+	if (!node->stats.connected)
+	{
+		return;
+	}
+
+	if ((END_DEVICE == role) && node->cfg.peer)
+	{
+		uint8_t *peer = simAppNextPeer();
+
+		if (NULL != peer)
+		{
+			simAppSend(SIM_APP_PEER_HEADER_SIZE, peer, TX_CLASS_NORMAL);
+		}
+	}
+	else if ((END_DEVICE == role) && node->cfg.bulkFrames)
+	{
+		for (uint8_t i = 0; i < node->cfg.bulkFrames; i++)
+		{
+			simAppSend(LONG_ADDR_LEN, connectionTable[0].Address, TX_CLASS_BULK);
+		}
+		simAppSend(LONG_ADDR_LEN, connectionTable[0].Address, TX_CLASS_ALARM);
+	}
+	else if (END_DEVICE == role)
+	{
+		simAppSend(LONG_ADDR_LEN, connectionTable[0].Address, TX_CLASS_NORMAL);
+	}
+	else if (node->cfg.downlink)
+	{
+		for (uint8_t i = 0; i < CONNECTION_SIZE; i++)
+		{
+			CONNECTION_ENTRY *entry = &connectionTable[simAppDownlinkIndex];
+
+			simAppDownlinkIndex = (uint8_t)((simAppDownlinkIndex + 1) % CONNECTION_SIZE);
+			if (entry->status.bits.isValid)
+			{
+				simAppSend(LONG_ADDR_LEN, entry->Address, TX_CLASS_NORMAL);
+				break;
+			}
+		}
+	}
+}
+
+static void simAppEdScanInd(EdScanResult_t *result)
+{
+	SimNodeStats_t *s = &simCurrentNode->stats;
+
+	s->edScanChannels++;
+	s->edScanSamples += result->samples;
+	if (result->samples && ((1 == s->edScanChannels) || (result->maxEnergy > s->edScanEnergyMax)))
+	{
+		s->edScanEnergyMax = result->maxEnergy;
+	}
+}
+
+static void simAppEdScanConf(uint8_t optimalChannel)
+{
+	simCurrentNode->stats.edScans++;
+	simCurrentNode->stats.edScanOptimalChannel = optimalChannel;
+}
+
+/* A scan still running when the period is over just skips this one */
+static void simAppEdScanTimerHandler(SYS_Timer_t *timer)
+{
+	MiApp_EdScanStart(SIM_APP_ED_SCAN_CHANNELS, SIM_APP_ED_SCAN_DURATION, simAppEdScanInd, simAppEdScanConf);
+	(void)timer;
+}
+
+/* The stack clears its callback after the confirm returns, so the new
+ * attempt is started from the main loop */
+static void simAppJoinTimerHandler(SYS_Timer_t *timer)
+{
+	simAppJoinPending = true;
+	(void)timer;
+}
+
+static void simAppConnectionConfirm(miwi_status_t status)
+{
+	SimNode_t *node = simCurrentNode;
+
+	if ((SUCCESS == status) || (ALREADY_EXISTS == status))
+	{
+		node->stats.connected = true;
+		node->stats.connectedAtUs = SimTime_Now();
+
+		if (node->cfg.dataIntervalMs)
+		{
+			simAppDataTimer.interval = node->cfg.dataIntervalMs;
+			simAppDataTimer.mode = SYS_TIMER_PERIODIC_MODE;
+			simAppDataTimer.handler = simAppDataTimerHandler;
+			SYS_TimerStart(&simAppDataTimer);
+		}
+		if ((SIM_ROLE_PAN_COORDINATOR == node->cfg.role) && node->cfg.edScanPeriodMs)
+		{
+			simAppEdScanTimer.interval = node->cfg.edScanPeriodMs;
+			simAppEdScanTimer.mode = SYS_TIMER_PERIODIC_MODE;
+			simAppEdScanTimer.handler = simAppEdScanTimerHandler;
+			SYS_TimerStart(&simAppEdScanTimer);
+		}
+	}
+	else if (SIM_ROLE_PAN_COORDINATOR == node->cfg.role)
+	{
+		MiApp_StartConnection(START_CONN_DIRECT, 10, (1L << simAppChannel), simAppConnectionConfirm);
+	}
+	else
+	{
+		/* Keep trying until a PAN coordinator answers */
+		simAppJoinTimer.interval = simAppJoinRetryMs + (node->cfg.id % SIM_APP_JOIN_RETRY_MS);
+		if (simAppJoinRetryMs < SIM_APP_JOIN_RETRY_MAX_MS)
+		{
+			simAppJoinRetryMs *= 2;
+		}
+		simAppJoinTimer.mode = SYS_TIMER_INTERVAL_MODE;
+		simAppJoinTimer.handler = simAppJoinTimerHandler;
+		SYS_TimerStart(&simAppJoinTimer);
+	}
+}
+
+static void simAppJoin(void)
+{
+	uint16_t broadcastAddr = 0xFFFF;
+
+	simAppJoinPending = false;
+	MiApp_EstablishConnection(simAppChannel, 0, (uint8_t *)&broadcastAddr, 0, simAppConnectionConfirm);
+}
+
+/*********************************************************************
+* Function:         static void simAppInit(void)
+*
+* Overview:         Node start-up, following Initialize_Demo() of
+*                   the firmware application
+********************************************************************/
+static void simAppInit(void)
+{
+	SimNode_t *node = simCurrentNode;
+
+	/* Board start-up of the reference application */
+	SYS_TimerInit();
+	/* Heap is otherwise set up lazily by the first allocation, which
+	 * would make the free-memory samples read as empty until then */
+	MiMem_Init();
+
+	MiApp_SubscribeDataIndicationCallback(simAppDataInd);
+	MiApp_SubscribeLinkFailureCallback(simAppLinkFailure);
+
+	/* Unique IEEE address; the star protocol also uses its first
+	 * three bytes as the short address of the node */
+	myLongAddress[0] = (uint8_t)node->cfg.id;
+	myLongAddress[1] = (uint8_t)(node->cfg.id >> 8);
+
+	if (SUCCESS != MiApp_ProtocolInit(&defaultParamsRomOrRam, &defaultParamsRamOnly))
+	{
+		fprintf(stderr, "sim: node %u protocol init failed\n", (unsigned)node->cfg.id);
+		exit(EXIT_FAILURE);
+	}
+	PHY_SetIEEEAddr((uint8_t *)&myLongAddress);
+	MiApp_ConnectionMode(ENABLE_ALL_CONN);
+
+	simAppChannel = node->cfg.channel;
+	MiApp_Set(CHANNEL, &simAppChannel);
+
+	if (SIM_ROLE_PAN_COORDINATOR == node->cfg.role)
+	{
+		MiApp_StartConnection(START_CONN_DIRECT, 10, (1L << simAppChannel), simAppConnectionConfirm);
+	}
+	else
+	{
+		simAppJoin();
+	}
+}
+
+#ifdef ENABLE_SLEEP_FEATURE
+/*********************************************************************
+* Function:         static void simAppSleep(uint32_t interval)
+*
+* Overview:         Counterpart of sleepMgr_sleep(): transceiver SPI
+*                   off and MCU in standby. The simulation cannot block
+*                   here, so the exit procedure runs in the next pass
+*                   of the main loop, once the node wakes up.
+********************************************************************/
+static void simAppSleep(uint32_t interval)
+{
+	if (interval < SIM_APP_MIN_SLEEP_MS)
+	{
+		return;
+	}
+	trx_spi_disable();
+	SimNode_Sleep(interval);
+	simAppSleptMs = interval;
+}
+
+static void simAppSleepExit(void)
+{
+	trx_spi_enable();
+	SYS_TimerAdjust_SleptTime(simAppSleptMs);
+	simAppSleptMs = 0;
+}
+#endif
+
+static void simAppTask(void)
+{
+	SimNodeStats_t *stats = &simCurrentNode->stats;
+	uint8_t mem;
+#ifdef ENABLE_SLEEP_FEATURE
+	uint32_t sleepTime;
+
+	if (simAppSleptMs)
+	{
+		simAppSleepExit();
+	}
+#endif
+
+	if (simAppJoinPending)
+	{
+		simAppJoin();
+	}
+	P2PTasks();
+
+	mem = MiMem_PercentageOfFreeBuffers();
+	if (mem < stats->memFreePercentMin)
+	{
+		stats->memFreePercentMin = mem;
+	}
+	if (frameTxQueued > stats->txQueueMax)
+	{
+		stats->txQueueMax = frameTxQueued;
+	}
+#ifdef ENABLE_INDIRECT_MESSAGE
+	if (indirectFrameCount > stats->indirectQueueMax)
+	{
+		stats->indirectQueueMax = indirectFrameCount;
+	}
+#endif
+
+#ifdef ENABLE_SLEEP_FEATURE
+	if (MiApp_ReadyToSleep(&sleepTime))
+	{
+		simAppSleep(sleepTime);
+	}
+#endif
+}
+
+static bool simAppBusy(void)
+{
+	return MiMAC_TxPending();
+}
+
+static void simAppMemReport(void)
+{
+	MiMem_StatsPrint();
+}
+
+const SimImage_t SIM_IMAGE_NAME = {
+	.name = SIM_STR(SIM_IMAGE_SECTION),
+	.dataStart = SIM_DATA_START,
+	.dataEnd = SIM_DATA_STOP,
+	.bssStart = SIM_BSS_START,
+	.bssEnd = SIM_BSS_STOP,
+	.init = simAppInit,
+	.task = simAppTask,
+	.busy = simAppBusy,
+	.memReport = simAppMemReport,
+};
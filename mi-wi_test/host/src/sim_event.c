@@ -0,0 +1,182 @@
+/**
+* \file  sim_event.c
+*
+* \brief Discrete event scheduler of the host simulation
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+
+/************************ VARIABLES ********************************/
+/* Binary min-heap ordered by time, then insertion order */
+static SimEvent_t *simEvents;
+static size_t simEventCount;
+static size_t simEventCapacity;
+static uint64_t simEventSeq;
+
+/************************ FUNCTIONS ********************************/
+static bool simEventBefore(const SimEvent_t *a, const SimEvent_t *b)
+{
+	if (a->time != b->time)
+	{
+		return a->time < b->time;
+	}
+	return a->seq < b->seq;
+}
+
+/*********************************************************************
+* Function:         void SimEvent_Schedule(uint64_t time, SimEventType_t type,
+*                            SimNode_t *node, struct _SimTx_t *tx, uint32_t token)
+*
+* Overview:         Queues an event. Events in the past are moved to
+*                   the current time.
+********************************************************************/
+void SimEvent_Schedule(uint64_t time, SimEventType_t type, SimNode_t *node, struct _SimTx_t *tx, uint32_t token)
+{
+	size_t i;
+
+	if (simEventCount == simEventCapacity)
+	{
+		simEventCapacity = simEventCapacity ? (simEventCapacity * 2) : 256;
+		simEvents = realloc(simEvents, simEventCapacity * sizeof(SimEvent_t));
+		if (NULL == simEvents)
+		{
+			fprintf(stderr, "sim: out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	SimEvent_t event = {
+		.time = (time < simTimeUs) ? simTimeUs : time,
+		.seq = simEventSeq++,
+		.type = type,
+		.token = token,
+		.node = node,
+		.tx = tx,
+	};
+
+	/* Sift up */
+	i = simEventCount++;
+	while (i > 0)
+	{
+		size_t parent = (i - 1) / 2;
+
+		if (!simEventBefore(&event, &simEvents[parent]))
+		{
+			break;
+		}
+		simEvents[i] = simEvents[parent];
+		i = parent;
+	}
+	simEvents[i] = event;
+}
+
+static SimEvent_t simEventPop(void)
+{
+	SimEvent_t top = simEvents[0];
+	SimEvent_t last = simEvents[--simEventCount];
+	size_t i = 0;
+
+	/* Sift down */
+	for (;;)
+	{
+		size_t child = 2 * i + 1;
+
+		if (child >= simEventCount)
+		{
+			break;
+		}
+		if ((child + 1 < simEventCount) && simEventBefore(&simEvents[child + 1], &simEvents[child]))
+		{
+			child++;
+		}
+		if (!simEventBefore(&simEvents[child], &last))
+		{
+			break;
+		}
+		simEvents[i] = simEvents[child];
+		i = child;
+	}
+	if (simEventCount)
+	{
+		simEvents[i] = last;
+	}
+	return top;
+}
+
+/*********************************************************************
+* Function:         void SimEvent_RunUntil(uint64_t endUs)
+*
+* Overview:         Processes events in time order up to endUs and
+*                   leaves the simulated clock at endUs
+********************************************************************/
+void SimEvent_RunUntil(uint64_t endUs)
+{
+	while (simEventCount && (simEvents[0].time <= endUs))
+	{
+		SimEvent_t event = simEventPop();
+
+		simTimeUs = event.time;
+		if (SIM_EVENT_NODE_WAKE == event.type)
+		{
+			/* Only the latest wake-up request of a node is live */
+			if (event.node->wakeAt == event.time)
+			{
+				event.node->wakeAt = SIM_TIME_NEVER;
+				SimNode_Run(event.node);
+			}
+		}
+		else if (SIM_EVENT_ED_END == event.type)
+		{
+			SimTrx_EdEnd(event.node);
+		}
+		else
+		{
+			SimMedium_Event(&event);
+		}
+	}
+	if (simTimeUs < endUs)
+	{
+		simTimeUs = endUs;
+	}
+}
+
+void SimEvent_Reset(void)
+{
+	free(simEvents);
+	simEvents = NULL;
+	simEventCount = simEventCapacity = 0;
+	simEventSeq = 0;
+}
@@ -0,0 +1,189 @@
+/**
+* \file  sim_hw_timer.c
+*
+* \brief Common hardware timer on top of the simulated clock
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include "sim.h"
+#include "common_hw_timer.h"
+
+/************************ DEFINITIONS ******************************/
+#define SIM_HW_TIMER_PERIOD_US   (65536ULL)
+
+/************************ FUNCTIONS ********************************/
+void SimHwTimer_Reset(SimHwTimer_t *timer)
+{
+	timer->running = false;
+	timer->overflowEnabled = false;
+	timer->compareArmed = false;
+	timer->now = simTimeUs;
+	timer->epoch = simTimeUs;
+	timer->nextOverflow = 0;
+	timer->compareAt = 0;
+	timer->frozenCount = 0;
+	timer->overflowCb = NULL;
+	timer->expiryCb = NULL;
+}
+
+/*********************************************************************
+* Function:         void SimHwTimer_Sync(SimNode_t *node)
+*
+* Overview:         Fires, in order and at their own time stamps, the
+*                   overflow and compare interrupts of the node timer
+*                   that are due up to the local time of the node.
+*                   The node must be current.
+********************************************************************/
+void SimHwTimer_Sync(SimNode_t *node)
+{
+	SimHwTimer_t *timer = &node->timer;
+
+	while (timer->running)
+	{
+		uint64_t next = timer->nextOverflow;
+		bool compare = false;
+
+		if (timer->compareArmed && (timer->compareAt <= next))
+		{
+			next = timer->compareAt;
+			compare = true;
+		}
+		if (next > node->timeUs)
+		{
+			break;
+		}
+
+		timer->now = next;
+		if (compare)
+		{
+			timer->compareArmed = false;
+			if (timer->expiryCb)
+			{
+				timer->expiryCb();
+			}
+		}
+		else
+		{
+			timer->nextOverflow += SIM_HW_TIMER_PERIOD_US;
+			if (timer->overflowEnabled && timer->overflowCb)
+			{
+				timer->overflowCb();
+			}
+		}
+	}
+	timer->now = node->timeUs;
+}
+
+/*********************************************************************
+* Function:         uint64_t SimHwTimer_Next(const SimNode_t *node)
+*
+* Overview:         Time of the next timer interrupt of the node
+********************************************************************/
+uint64_t SimHwTimer_Next(const SimNode_t *node)
+{
+	const SimHwTimer_t *timer = &node->timer;
+	uint64_t next = SIM_TIME_NEVER;
+
+	if (!timer->running)
+	{
+		return next;
+	}
+	if (timer->overflowEnabled && timer->overflowCb)
+	{
+		next = timer->nextOverflow;
+	}
+	if (timer->compareArmed && (timer->compareAt < next))
+	{
+		next = timer->compareAt;
+	}
+	return next;
+}
+
+void common_tc_init(void)
+{
+	SimHwTimer_t *timer = &simCurrentNode->timer;
+
+	timer->running = true;
+	timer->overflowEnabled = true;
+	timer->compareArmed = false;
+	timer->epoch = timer->now;
+	timer->nextOverflow = timer->epoch + SIM_HW_TIMER_PERIOD_US;
+}
+
+uint16_t common_tc_read_count(void)
+{
+	SimHwTimer_t *timer = &simCurrentNode->timer;
+
+	if (!timer->running)
+	{
+		return timer->frozenCount;
+	}
+	return (uint16_t)(timer->now - timer->epoch);
+}
+
+void common_tc_delay(uint16_t value)
+{
+	SimHwTimer_t *timer = &simCurrentNode->timer;
+
+	timer->compareAt = timer->now + value;
+	timer->compareArmed = true;
+}
+
+void common_tc_compare_stop(void)
+{
+	simCurrentNode->timer.compareArmed = false;
+}
+
+void common_tc_overflow_stop(void)
+{
+	simCurrentNode->timer.overflowEnabled = false;
+}
+
+void common_tc_stop(void)
+{
+	SimHwTimer_t *timer = &simCurrentNode->timer;
+
+	timer->frozenCount = common_tc_read_count();
+	timer->running = false;
+	timer->compareArmed = false;
+}
+
+void set_common_tc_overflow_callback(tmr_callback_t callback)
+{
+	simCurrentNode->timer.overflowCb = callback;
+}
+
+void set_common_tc_expiry_callback(tmr_callback_t callback)
+{
+	simCurrentNode->timer.expiryCb = callback;
+}
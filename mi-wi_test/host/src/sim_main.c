@@ -0,0 +1,219 @@
+/**
+* \file  sim_main.c
+*
+* \brief Discrete event simulation of a MiWi star network
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include "sim.h"
+
+/************************ DEFINITIONS ******************************/
+#define SIM_DEFAULT_NODES           10
+#define SIM_DEFAULT_DURATION_S      60
+#define SIM_DEFAULT_INTERVAL_MS     1000
+#define SIM_DEFAULT_PAYLOAD         20
+#define SIM_DEFAULT_CHANNEL         1
+#define SIM_DEFAULT_JOIN_SPACING_MS 50
+
+/* Head start of the PAN coordinator before end devices power up */
+#define SIM_PAN_START_US            200000
+
+/* Angle between end devices placed one after the other (golden angle) */
+#define SIM_PLACE_ANGLE             2.39996323
+
+/************************ FUNCTIONS ********************************/
+static void simUsage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n nodes] [-s sleeping] [-t seconds] [-i interval_ms] [-l payload]\n"
+		"          [-j spacing_ms] [-b bulk] [-e period_s] [-x channel,duty,start_s]\n"
+		"          [-r radius_m] [-d | -p] [-a] [-q] [-v]\n"
+		"  -n  number of nodes including the PAN coordinator (default %d)\n"
+		"  -s  how many of the end devices sleep (default 0)\n"
+		"  -t  simulated time in seconds (default %d)\n"
+		"  -i  data period of every node in ms, 0 for none (default %d)\n"
+		"  -l  application payload in bytes (default %d)\n"
+		"  -j  delay between end device power-ups in ms (default %d)\n"
+		"  -b  end devices send this many bulk frames and an alarm per period\n"
+		"  -e  PAN coordinator scans the energy of all channels every period\n"
+		"  -x  another system sends on the channel for duty %% of the time\n"
+		"      from start_s on\n"
+		"  -r  end devices spread evenly over a disc of this radius around the\n"
+		"      PAN coordinator, with log-distance path loss (default same loss\n"
+		"      on every link)\n"
+		"  -d  PAN coordinator also sends to its end devices\n"
+		"  -p  end devices send to each other through the PAN coordinator\n"
+		"  -a  print the counters of every node\n"
+		"  -m  print the heap statistics of the PAN coordinator\n"
+		"  -q  one line summary\n"
+		"  -v  trace every frame in the air\n",
+		prog, SIM_DEFAULT_NODES, SIM_DEFAULT_DURATION_S, SIM_DEFAULT_INTERVAL_MS,
+		SIM_DEFAULT_PAYLOAD, SIM_DEFAULT_JOIN_SPACING_MS);
+}
+
+int main(int argc, char *argv[])
+{
+	SimNodeConfig_t cfg = {
+		.channel = SIM_DEFAULT_CHANNEL,
+		.dataIntervalMs = SIM_DEFAULT_INTERVAL_MS,
+		.dataLen = SIM_DEFAULT_PAYLOAD,
+	};
+	unsigned long nodes = SIM_DEFAULT_NODES;
+	unsigned long sleeping = 0;
+	unsigned long duration = SIM_DEFAULT_DURATION_S;
+	unsigned long spacingMs = SIM_DEFAULT_JOIN_SPACING_MS;
+	bool perNode = false, oneLine = false, memReport = false;
+	uint64_t endUs;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:t:i:l:j:b:e:x:r:dpamqvh")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n':
+				nodes = strtoul(optarg, NULL, 0);
+				break;
+			case 's':
+				sleeping = strtoul(optarg, NULL, 0);
+				break;
+			case 't':
+				duration = strtoul(optarg, NULL, 0);
+				break;
+			case 'i':
+				cfg.dataIntervalMs = (uint32_t)strtoul(optarg, NULL, 0);
+				break;
+			case 'l':
+				cfg.dataLen = (uint8_t)strtoul(optarg, NULL, 0);
+				break;
+			case 'j':
+				spacingMs = strtoul(optarg, NULL, 0);
+				break;
+			case 'b':
+				cfg.bulkFrames = (uint8_t)strtoul(optarg, NULL, 0);
+				break;
+			case 'e':
+				cfg.edScanPeriodMs = (uint32_t)strtoul(optarg, NULL, 0) * 1000;
+				break;
+			case 'x':
+			{
+				unsigned channel, duty, start;
+
+				if (3 != sscanf(optarg, "%u,%u,%u", &channel, &duty, &start))
+				{
+					simUsage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				simInterferer.enabled = true;
+				simInterferer.channel = (uint8_t)channel;
+				simInterferer.dutyPercent = (uint8_t)Min(duty, 100);
+				simInterferer.startUs = (uint64_t)start * 1000000ULL;
+				break;
+			}
+			case 'r':
+				simRadiusM = strtod(optarg, NULL);
+				break;
+			case 'd':
+				cfg.downlink = true;
+				break;
+			case 'p':
+				cfg.peer = true;
+				break;
+			case 'a':
+				perNode = true;
+				break;
+			case 'm':
+				memReport = true;
+				break;
+			case 'q':
+				oneLine = true;
+				break;
+			case 'v':
+				simTrace = true;
+				break;
+			default:
+				simUsage(argv[0]);
+				return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	/* A forwarded frame cannot be told from a downlink frame by its payload */
+	if ((nodes < 1) || (nodes > 0xFFFF) || (sleeping >= nodes) || (cfg.downlink && cfg.peer))
+	{
+		simUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	endUs = (uint64_t)duration * 1000000ULL;
+
+	/* A PAN coordinator with sleeping end devices keeps their frames
+	 * until they poll, which needs indirect messaging */
+	cfg.id = 0;
+	cfg.role = SIM_ROLE_PAN_COORDINATOR;
+	SimNode_Create(sleeping ? &simImageCoord : &simImageFfd, &cfg);
+	SimEvent_RunUntil(SIM_PAN_START_US);
+
+	cfg.role = SIM_ROLE_END_DEVICE;
+	cfg.downlink = false;
+	cfg.edScanPeriodMs = 0;
+	for (unsigned long i = 1; (i < nodes) && (simTimeUs < endUs); i++)
+	{
+		SimNode_t *node;
+		double radius = simRadiusM * sqrt((double)i / (nodes - 1));
+
+		cfg.id = (uint16_t)i;
+		node = SimNode_Create((i >= nodes - sleeping) ? &simImageRfd : &simImageFfd, &cfg);
+		node->x = radius * cos(i * SIM_PLACE_ANGLE);
+		node->y = radius * sin(i * SIM_PLACE_ANGLE);
+		SimEvent_RunUntil(Min(simTimeUs + spacingMs * 1000ULL, endUs));
+	}
+	SimEvent_RunUntil(endUs);
+
+	if (oneLine)
+	{
+		SimStats_ReportLine(endUs, true);
+	}
+	else
+	{
+		SimStats_Report(endUs, perNode);
+	}
+	if (memReport)
+	{
+		SimNode_Switch(simNodes[0]);
+		simNodes[0]->image->memReport();
+		printf("\n");
+	}
+	SimNode_DestroyAll();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,544 @@
+/**
+* \file  sim_medium.c
+*
+* \brief Shared radio channel: airtime, CSMA-CA, collisions and acknowledgements
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sim.h"
+#include "phy.h"
+#include "phy_at86rf212b.h"
+#include "sysTimer.h"
+#include "phyTiming.h"
+
+/************************ DEFINITIONS ******************************/
+/* The PPDU timing of phyTiming.h is the one of BPSK 20 kb/s, where a
+ * symbol carries one bit: the 8 bit PHR gives the symbol duration. */
+#define SIM_SYMBOL_US           (phyPHRDurationMicroSec / 8)
+#define SIM_UNIT_BACKOFF_US     (20 * SIM_SYMBOL_US)
+#define SIM_CCA_US              (8 * SIM_SYMBOL_US)
+#define SIM_TURNAROUND_US       (12 * SIM_SYMBOL_US)
+
+#define SIM_ACK_PSDU_LEN        5
+#define SIM_ACK_WAIT_US         (SIM_TURNAROUND_US + SimMedium_Airtime(SIM_ACK_PSDU_LEN) + SIM_UNIT_BACKOFF_US)
+
+/* Value of MAX_CSMA_RETRIES that skips CSMA-CA altogether */
+#define SIM_CSMA_DISABLED       7
+
+/* Bursts of the interferer */
+#define SIM_INTERFERER_BURST_US 5000
+
+#define SIM_FCF_ACK_REQUEST     0x20
+#define SIM_FRAME_TYPE_ACK      0x02
+
+/************************ TYPE DEFINITIONS ******************************/
+/* A frame in the air */
+typedef struct _SimTx_t
+{
+	struct _SimTx_t *next;
+	SimNode_t *sender;
+	uint32_t senderToken;
+	uint64_t start;
+	uint64_t end;
+	uint8_t channel;
+	int8_t powerDbm;
+	bool ack;
+	uint8_t len;
+	uint8_t psdu[MAX_PSDU];
+} SimTx_t;
+
+/************************ VARIABLES ********************************/
+SimMediumStats_t simMediumStats;
+SimInterferer_t simInterferer;
+double simRadiusM;
+
+static SimTx_t *simMediumOnAir;
+
+/************************ FUNCTIONS ********************************/
+/*********************************************************************
+* Function:         uint32_t SimMedium_Airtime(uint8_t psduLen)
+*
+* Overview:         Duration of a PPDU carrying psduLen bytes (FCS
+*                   included). phyPacketTxDuration() counts the
+*                   application payload on top of the P2P header and
+*                   FCS, so the PSDU length is mapped back onto it.
+*                   The macro does not parenthesise its argument.
+********************************************************************/
+uint32_t SimMedium_Airtime(uint8_t psduLen)
+{
+	int payloadLen = (int)psduLen - p2pMacHeader - 2;
+
+	return (uint32_t)phyPacketTxDuration(payloadLen);
+}
+
+/* Whether a burst of the interferer falls into [from, to) on the channel */
+static bool simMediumInterfered(uint8_t channel, uint64_t from, uint64_t to)
+{
+	uint64_t period, burst;
+
+	if (!simInterferer.enabled || (channel != simInterferer.channel) || !simInterferer.dutyPercent ||
+		(to <= simInterferer.startUs))
+	{
+		return false;
+	}
+	from = Max(from, simInterferer.startUs);
+	period = (uint64_t)SIM_INTERFERER_BURST_US * 100 / Min(simInterferer.dutyPercent, 100);
+	burst = from - (from - simInterferer.startUs) % period;
+	return (from < burst + SIM_INTERFERER_BURST_US) || (burst + period < to);
+}
+
+/* Output power of the transceiver from PHY_TX_PWR */
+static int8_t simMediumTxPower(const SimTrx_t *trx)
+{
+	return SIM_TRX_TX_POWER_MAX_DBM - (trx->regs[PHY_TX_PWR_REG] & 0x1F);
+}
+
+/* Power of a frame in the air at a node in dBm */
+static int16_t simMediumRxPower(const SimTx_t *tx, const SimNode_t *node)
+{
+	double distance;
+
+	if (simRadiusM <= 0)
+	{
+		return tx->powerDbm - SIM_DEFAULT_PATH_LOSS_DB;
+	}
+	distance = Max(hypot(tx->sender->x - node->x, tx->sender->y - node->y), 1.0);
+	return tx->powerDbm - SIM_PATH_LOSS_1M_DB - (int16_t)lround(10.0 * SIM_PATH_LOSS_EXPONENT * log10(distance));
+}
+
+/*********************************************************************
+* Function:         int8_t SimMedium_Energy(SimNode_t *node)
+*
+* Overview:         Channel energy seen by the node in dBm, the one of
+*                   the strongest frame in the air
+********************************************************************/
+int8_t SimMedium_Energy(SimNode_t *node)
+{
+	uint8_t channel = SimTrx_Channel(&node->trx);
+	int16_t energy = PHY_RSSI_BASE_VAL_OQPSK_RC_250;
+
+	if (simMediumInterfered(channel, simTimeUs, simTimeUs + 1))
+	{
+		energy = SIM_DEFAULT_RX_POWER_DBM;
+	}
+	for (SimTx_t *tx = simMediumOnAir; tx; tx = tx->next)
+	{
+		if ((tx->sender != node) && (tx->channel == channel))
+		{
+			energy = Max(energy, simMediumRxPower(tx, node));
+		}
+	}
+	return (int8_t)energy;
+}
+
+/* Energy detection CCA (mode 1) against CCA_ED_THRES */
+static int8_t simMediumCcaThreshold(const SimNode_t *node)
+{
+	return PHY_RSSI_BASE_VAL_OQPSK_RC_250 + 2 * (node->trx.regs[CCA_THRES_REG] & 0x0F);
+}
+
+static bool simMediumBusy(SimNode_t *node)
+{
+	return SimMedium_Energy(node) > simMediumCcaThreshold(node);
+}
+
+static bool simMediumListening(const SimTrx_t *trx)
+{
+	if (SIM_TX_ACK_WAIT == trx->txPhase)
+	{
+		return true;
+	}
+	return (SIM_TX_IDLE == trx->txPhase) && SimTrx_IsReceiving(trx);
+}
+
+/*********************************************************************
+* Function:         static void simMediumStart(SimNode_t *node,
+*                            const uint8_t *psdu, uint8_t len, bool ack)
+*
+* Overview:         Puts a frame on the air. Every listening node on
+*                   the channel that gets it above the sensitivity
+*                   synchronises to it, unless it is already
+*                   receiving: then both frames are lost at that node.
+********************************************************************/
+static void simMediumStart(SimNode_t *node, const uint8_t *psdu, uint8_t len, bool ack)
+{
+	SimTx_t *tx = calloc(1, sizeof(SimTx_t));
+
+	if (NULL == tx)
+	{
+		fprintf(stderr, "sim: out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	tx->sender = node;
+	tx->senderToken = node->trx.txToken;
+	tx->start = simTimeUs;
+	tx->end = simTimeUs + SimMedium_Airtime(len);
+	tx->channel = SimTrx_Channel(&node->trx);
+	tx->powerDbm = simMediumTxPower(&node->trx);
+	tx->ack = ack;
+	tx->len = len;
+	memcpy(tx->psdu, psdu, len);
+	tx->next = simMediumOnAir;
+	simMediumOnAir = tx;
+
+	node->stats.airtimeUs += tx->end - tx->start;
+	simMediumStats.airtimeUs += tx->end - tx->start;
+	/* Transmissions start in time order, so the union of their intervals
+	 * only grows at its end */
+	if (tx->end > simMediumStats.busyUntil)
+	{
+		simMediumStats.busyUs += tx->end - ((tx->start > simMediumStats.busyUntil) ? tx->start : simMediumStats.busyUntil);
+		simMediumStats.busyUntil = tx->end;
+	}
+	if (ack)
+	{
+		simMediumStats.acks++;
+	}
+	else
+	{
+		node->stats.frameTx++;
+		node->stats.frameTxPowerSumDbm += tx->powerDbm;
+		simMediumStats.transmissions++;
+	}
+
+	if (simTrace)
+	{
+		printf("%10llu us  node %-4u %s ch %-2u len %-3u",
+			(unsigned long long)simTimeUs, node->cfg.id, ack ? "ack" : "tx ",
+			tx->channel, len);
+		for (uint8_t i = 0; i < len - 2; i++)
+		{
+			printf(" %02x", psdu[i]);
+		}
+		printf("\n");
+	}
+
+	for (uint16_t i = 0; i < simNodeCount; i++)
+	{
+		SimNode_t *rx = simNodes[i];
+		SimTrx_t *trx = &rx->trx;
+		int16_t power;
+
+		if ((rx == node) || (SimTrx_Channel(trx) != tx->channel))
+		{
+			continue;
+		}
+		power = simMediumRxPower(tx, rx);
+		if ((SIM_TX_CCA == trx->txPhase) && (power > simMediumCcaThreshold(rx)))
+		{
+			trx->ccaBusy = true;
+		}
+		if ((power < SIM_TRX_SENSITIVITY_DBM) || !simMediumListening(trx))
+		{
+			continue;
+		}
+		if (NULL == trx->rxFrame)
+		{
+			trx->rxFrame = tx;
+			trx->rxCorrupted = false;
+		}
+		else if (!trx->rxCorrupted)
+		{
+			trx->rxCorrupted = true;
+			rx->stats.frameRxCollision++;
+			simMediumStats.collisions++;
+		}
+	}
+
+	SimEvent_Schedule(tx->end, SIM_EVENT_FRAME_END, node, tx, tx->senderToken);
+}
+
+static void simMediumBackoff(SimNode_t *node, uint64_t from)
+{
+	SimTrx_t *trx = &node->trx;
+	uint32_t slots = SimNode_Random(node) & ((1U << trx->csmaBe) - 1);
+
+	trx->txPhase = SIM_TX_BACKOFF;
+	SimEvent_Schedule(from + slots * SIM_UNIT_BACKOFF_US, SIM_EVENT_BACKOFF_END, node, NULL, trx->txToken);
+}
+
+/* Starts (or restarts, for a frame retry) the channel access */
+static void simMediumAccess(SimNode_t *node, uint64_t from)
+{
+	SimTrx_t *trx = &node->trx;
+	uint8_t maxCsma = (trx->regs[XAH_CTRL_0_REG] >> MAX_CSMA_RETRES) & 0x07;
+
+	if (!trx->txExtended || (SIM_CSMA_DISABLED == maxCsma))
+	{
+		trx->txPhase = SIM_TX_FRAME;
+		SimEvent_Schedule(from, SIM_EVENT_TX_START, node, NULL, trx->txToken);
+		return;
+	}
+	trx->csmaBackoffs = 0;
+	trx->csmaBe = (trx->regs[CSMA_BE_REG] >> MIN_BE) & 0x0F;
+	simMediumBackoff(node, from);
+}
+
+/*********************************************************************
+* Function:         void SimMedium_TxRequest(SimNode_t *node, bool extended)
+*
+* Overview:         Starts sending the frame buffer, with CSMA-CA and
+*                   automatic retransmissions in the extended mode
+*                   (TX_ARET), as it is at once in the basic mode.
+*                   The MCU takes no simulated time, so a request made
+*                   while the node still sends an acknowledgement
+*                   waits for it; otherwise every reply would cut the
+*                   acknowledgement short.
+********************************************************************/
+void SimMedium_TxRequest(SimNode_t *node, bool extended)
+{
+	SimTrx_t *trx = &node->trx;
+
+	if (SIM_TX_ACK_REPLY == trx->txPhase)
+	{
+		trx->txPending = true;
+		trx->txPendingExtended = extended;
+		return;
+	}
+	if (SIM_TX_IDLE != trx->txPhase)
+	{
+		return;
+	}
+	trx->txExtended = extended;
+	trx->frameRetries = 0;
+	trx->rxFrame = NULL;
+	simMediumAccess(node, node->timeUs);
+}
+
+/*********************************************************************
+* Function:         void SimMedium_TxAbort(SimNode_t *node)
+*
+* Overview:         Cancels the transmit procedure of the node. A
+*                   frame already in the air is not recalled.
+********************************************************************/
+void SimMedium_TxAbort(SimNode_t *node)
+{
+	SimTrx_t *trx = &node->trx;
+
+	if ((SIM_TX_IDLE == trx->txPhase) || (SIM_TX_ACK_REPLY == trx->txPhase))
+	{
+		return;
+	}
+	trx->txPhase = SIM_TX_IDLE;
+	trx->txToken++;
+}
+
+static void simMediumFrameEnd(SimTx_t *tx)
+{
+	SimNode_t *node = tx->sender;
+	SimTrx_t *trx = &node->trx;
+
+	/* Off the air */
+	for (SimTx_t **p = &simMediumOnAir; *p; p = &(*p)->next)
+	{
+		if (*p == tx)
+		{
+			*p = tx->next;
+			break;
+		}
+	}
+
+	for (uint16_t i = 0; i < simNodeCount; i++)
+	{
+		SimNode_t *rx = simNodes[i];
+		SimTrx_t *rxTrx = &rx->trx;
+
+		if (rxTrx->rxFrame != tx)
+		{
+			continue;
+		}
+		rxTrx->rxFrame = NULL;
+		if (rxTrx->rxCorrupted)
+		{
+			continue;
+		}
+		if (simMediumInterfered(tx->channel, tx->start, tx->end))
+		{
+			simMediumStats.interfered++;
+			continue;
+		}
+
+		if (tx->ack)
+		{
+			/* TX_ARET ends with the acknowledgement, not with the wait */
+			if ((SIM_TX_ACK_WAIT == rxTrx->txPhase) && (tx->psdu[2] == rxTrx->frameBuffer[3]))
+			{
+				SimTrx_TxDone(rx, TRAC_STATUS_SUCCESS);
+			}
+		}
+		else if (SIM_TX_IDLE == rxTrx->txPhase)
+		{
+			if (SimTrx_Deliver(rx, tx->psdu, tx->len, (int8_t)simMediumRxPower(tx, rx)))
+			{
+				rxTrx->txPhase = SIM_TX_ACK_REPLY;
+				rxTrx->ackSeq = tx->psdu[2];
+				SimEvent_Schedule(simTimeUs + SIM_TURNAROUND_US, SIM_EVENT_ACK_START, rx, NULL, rxTrx->txToken);
+			}
+			SimNode_Wake(rx, simTimeUs);
+		}
+	}
+
+	if (tx->senderToken == trx->txToken)
+	{
+		if (tx->ack)
+		{
+			trx->txPhase = SIM_TX_IDLE;
+			if (trx->txPending)
+			{
+				trx->txPending = false;
+				SimMedium_TxRequest(node, trx->txPendingExtended);
+			}
+		}
+		else if (SIM_TX_FRAME == trx->txPhase)
+		{
+			if (trx->txExtended && (tx->psdu[0] & SIM_FCF_ACK_REQUEST))
+			{
+				trx->txPhase = SIM_TX_ACK_WAIT;
+				SimEvent_Schedule(simTimeUs + SIM_ACK_WAIT_US, SIM_EVENT_ACK_WAIT_END, node, NULL, trx->txToken);
+			}
+			else
+			{
+				SimTrx_TxDone(node, TRAC_STATUS_SUCCESS);
+			}
+		}
+	}
+	free(tx);
+}
+
+/*********************************************************************
+* Function:         void SimMedium_Event(const SimEvent_t *event)
+*
+* Overview:         Advances the transmit procedure of a node or ends
+*                   a frame in the air
+********************************************************************/
+void SimMedium_Event(const SimEvent_t *event)
+{
+	SimNode_t *node = event->node;
+	SimTrx_t *trx = &node->trx;
+
+	if (SIM_EVENT_FRAME_END == event->type)
+	{
+		simMediumFrameEnd(event->tx);
+		return;
+	}
+	if (event->token != trx->txToken)
+	{
+		/* The procedure was aborted or has completed */
+		return;
+	}
+
+	switch (event->type)
+	{
+		case SIM_EVENT_BACKOFF_END:
+			trx->txPhase = SIM_TX_CCA;
+			trx->ccaBusy = simMediumBusy(node);
+			SimEvent_Schedule(simTimeUs + SIM_CCA_US, SIM_EVENT_CCA_END, node, NULL, trx->txToken);
+			break;
+
+		case SIM_EVENT_CCA_END:
+			if (trx->ccaBusy || simMediumBusy(node))
+			{
+				uint8_t maxCsma = (trx->regs[XAH_CTRL_0_REG] >> MAX_CSMA_RETRES) & 0x07;
+				uint8_t maxBe = (trx->regs[CSMA_BE_REG] >> MAX_BE) & 0x0F;
+
+				if (++trx->csmaBackoffs > maxCsma)
+				{
+					node->stats.frameTxChannelBusy++;
+					SimTrx_TxDone(node, TRAC_STATUS_CHANNEL_ACCESS_FAILURE);
+					break;
+				}
+				trx->csmaBe = Min(trx->csmaBe + 1, maxBe);
+				simMediumBackoff(node, simTimeUs);
+				break;
+			}
+			trx->txPhase = SIM_TX_FRAME;
+			simMediumStart(node, &trx->frameBuffer[1], trx->frameBuffer[0], false);
+			break;
+
+		case SIM_EVENT_TX_START:
+			if (SIM_TX_FRAME == trx->txPhase)
+			{
+				simMediumStart(node, &trx->frameBuffer[1], trx->frameBuffer[0], false);
+			}
+			break;
+
+		case SIM_EVENT_ACK_START:
+			if (SIM_TX_ACK_REPLY == trx->txPhase)
+			{
+				uint8_t ack[SIM_ACK_PSDU_LEN] = {SIM_FRAME_TYPE_ACK, 0x00, trx->ackSeq, 0x00, 0x00};
+
+				simMediumStart(node, ack, sizeof(ack), true);
+			}
+			break;
+
+		case SIM_EVENT_ACK_WAIT_END:
+			if (SIM_TX_ACK_WAIT != trx->txPhase)
+			{
+				break;
+			}
+			if (trx->frameRetries < ((trx->regs[XAH_CTRL_0_REG] >> MAX_FRAME_RETRES) & 0x0F))
+			{
+				trx->frameRetries++;
+				simMediumAccess(node, simTimeUs);
+			}
+			else
+			{
+				SimTrx_TxDone(node, TRAC_STATUS_NO_ACK);
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*********************************************************************
+* Function:         void SimMedium_Reset(void)
+*
+* Overview:         Drops the frames in the air and the counters
+********************************************************************/
+void SimMedium_Reset(void)
+{
+	while (simMediumOnAir)
+	{
+		SimTx_t *tx = simMediumOnAir;
+
+		simMediumOnAir = tx->next;
+		free(tx);
+	}
+	memset(&simMediumStats, 0, sizeof(simMediumStats));
+}
@@ -0,0 +1,383 @@
+/**
+* \file  sim_node.c
+*
+* \brief Simulated node management and firmware image context switching
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+/************************ DEFINITIONS ******************************/
+#define SIM_MAX_IMAGES  4
+
+/* Main loop passes run on every wake-up, enough for a frame to make its
+ * way from the application queue down to the transceiver */
+#define SIM_NODE_PASSES 4
+
+/* Main loop period of a busy node, it spins on real hardware */
+#define SIM_NODE_POLL_US 100
+
+/************************ TYPE DEFINITIONS ******************************/
+/* Bookkeeping for one firmware image shared by several nodes */
+typedef struct _SimImageState_t
+{
+	const SimImage_t *image;
+	size_t dataSize;
+	size_t bssSize;
+	/* Initialised .data as linked, used to boot every new node */
+	uint8_t *pristineData;
+	/* Node whose variables currently occupy the image sections */
+	SimNode_t *resident;
+} SimImageState_t;
+
+/************************ VARIABLES ********************************/
+uint64_t simTimeUs;
+SimNode_t *simCurrentNode;
+SimNode_t **simNodes;
+uint16_t simNodeCount;
+bool simTrace;
+
+static uint16_t simNodeCapacity;
+static SimImageState_t simImageStates[SIM_MAX_IMAGES];
+static uint8_t simImageStateCount;
+
+/************************ FUNCTIONS ********************************/
+static void *simAlloc(size_t size)
+{
+	void *ptr = calloc(1, size);
+
+	if (NULL == ptr)
+	{
+		fprintf(stderr, "sim: out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	return ptr;
+}
+
+/* Copies a whole image section. The sections hold many variables, so
+ * AddressSanitizer builds must not check the copy against the redzones
+ * it placed between them. */
+#if defined(__SANITIZE_ADDRESS__)
+__attribute__((no_sanitize_address))
+static void simSectionCopy(uint8_t *dst, const uint8_t *src, size_t size)
+{
+	volatile uint8_t *d = dst;
+	const volatile uint8_t *s = src;
+
+	while (size--)
+	{
+		*d++ = *s++;
+	}
+}
+
+__attribute__((no_sanitize_address))
+static void simSectionClear(uint8_t *dst, size_t size)
+{
+	volatile uint8_t *d = dst;
+
+	while (size--)
+	{
+		*d++ = 0;
+	}
+}
+#else
+#define simSectionCopy(dst, src, size)    memcpy((dst), (src), (size))
+#define simSectionClear(dst, size)        memset((dst), 0, (size))
+#endif
+
+static SimImageState_t *simImageStateGet(const SimImage_t *image)
+{
+	for (uint8_t i = 0; i < simImageStateCount; i++)
+	{
+		if (simImageStates[i].image == image)
+		{
+			return &simImageStates[i];
+		}
+	}
+
+	if (simImageStateCount >= SIM_MAX_IMAGES)
+	{
+		fprintf(stderr, "sim: too many firmware images\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* First use of the image: nothing has run in it yet, so its data
+	 * section still holds the initial values. */
+	SimImageState_t *state = &simImageStates[simImageStateCount++];
+	state->image = image;
+	state->dataSize = (size_t)(image->dataEnd - image->dataStart);
+	state->bssSize = (size_t)(image->bssEnd - image->bssStart);
+	state->pristineData = simAlloc(state->dataSize + 1);
+	simSectionCopy(state->pristineData, image->dataStart, state->dataSize);
+	state->resident = NULL;
+	return state;
+}
+
+static void simContextSave(SimNode_t *node)
+{
+	SimImageState_t *state = node->imageState;
+
+	simSectionCopy(node->context, node->image->dataStart, state->dataSize);
+	simSectionCopy(node->context + state->dataSize, node->image->bssStart, state->bssSize);
+}
+
+static void simContextLoad(SimNode_t *node)
+{
+	SimImageState_t *state = node->imageState;
+
+	simSectionCopy(node->image->dataStart, node->context, state->dataSize);
+	simSectionCopy(node->image->bssStart, node->context + state->dataSize, state->bssSize);
+}
+
+/*********************************************************************
+* Function:         SimNode_t *SimNode_Create(const SimImage_t *image,
+*                                             const SimNodeConfig_t *cfg)
+*
+* Overview:         Creates a node running the given firmware image,
+*                   powers up its transceiver and runs the image
+*                   start-up code in the new node context.
+********************************************************************/
+SimNode_t *SimNode_Create(const SimImage_t *image, const SimNodeConfig_t *cfg)
+{
+	SimNode_t *node = simAlloc(sizeof(SimNode_t));
+	SimImageState_t *state = simImageStateGet(image);
+
+	node->cfg = *cfg;
+	node->image = image;
+	node->imageState = state;
+	node->context = simAlloc(state->dataSize + state->bssSize + 1);
+	memcpy(node->context, state->pristineData, state->dataSize);
+	node->timeUs = simTimeUs;
+	node->wakeAt = SIM_TIME_NEVER;
+	node->rngState = ((uint32_t)cfg->id + 1U) * 2654435761U;
+	node->stats.memFreePercentMin = 100;
+	SimTrx_Reset(&node->trx);
+	SimHwTimer_Reset(&node->timer);
+
+	if (simNodeCount == simNodeCapacity)
+	{
+		simNodeCapacity = simNodeCapacity ? (uint16_t)(simNodeCapacity * 2) : 16;
+		simNodes = realloc(simNodes, simNodeCapacity * sizeof(SimNode_t *));
+		if (NULL == simNodes)
+		{
+			fprintf(stderr, "sim: out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	simNodes[simNodeCount++] = node;
+
+	SimNode_Run(node);
+	return node;
+}
+
+/*********************************************************************
+* Function:         void SimNode_Switch(SimNode_t *node)
+*
+* Overview:         Makes the node current. Its variables are copied
+*                   into the image sections (saving the previous
+*                   resident first) and the hardware timer interrupts
+*                   due up to the current simulated time are replayed.
+********************************************************************/
+void SimNode_Switch(SimNode_t *node)
+{
+	if (node->timeUs < simTimeUs)
+	{
+		node->timeUs = simTimeUs;
+	}
+
+	SimImageState_t *state = node->imageState;
+
+	if (state->resident != node)
+	{
+		if (state->resident)
+		{
+			simContextSave(state->resident);
+		}
+		simContextLoad(node);
+		state->resident = node;
+	}
+	simCurrentNode = node;
+	SimHwTimer_Sync(node);
+}
+
+/*********************************************************************
+* Function:         void SimNode_Run(SimNode_t *node)
+*
+* Overview:         Boots the node on its first run, then runs a few
+*                   passes of its main loop. The next wake-up is set
+*                   to the next timer interrupt, or to the end of the
+*                   MCU sleep; the medium wakes the node earlier on a
+*                   transceiver interrupt. A busy node is polled.
+********************************************************************/
+void SimNode_Run(SimNode_t *node)
+{
+	uint64_t next;
+
+	SimNode_Switch(node);
+	if (!node->booted)
+	{
+		node->booted = true;
+		node->image->init();
+	}
+	for (uint8_t pass = 0; (pass < SIM_NODE_PASSES) && (node->sleepUntil <= node->timeUs); pass++)
+	{
+		node->image->task();
+	}
+
+	next = (node->sleepUntil > node->timeUs) ? node->sleepUntil : SimHwTimer_Next(node);
+	if ((node->sleepUntil <= node->timeUs) && node->image->busy() && (node->timeUs + SIM_NODE_POLL_US < next))
+	{
+		next = node->timeUs + SIM_NODE_POLL_US;
+	}
+	if (SIM_TIME_NEVER != next)
+	{
+		SimNode_Wake(node, next);
+	}
+}
+
+/*********************************************************************
+* Function:         void SimNode_Wake(SimNode_t *node, uint64_t at)
+*
+* Overview:         Requests a main loop run of the node at the given
+*                   time. Only the earliest pending request is kept.
+********************************************************************/
+void SimNode_Wake(SimNode_t *node, uint64_t at)
+{
+	if (at < simTimeUs)
+	{
+		at = simTimeUs;
+	}
+	if (at < node->wakeAt)
+	{
+		node->wakeAt = at;
+		SimEvent_Schedule(at, SIM_EVENT_NODE_WAKE, node, NULL, 0);
+	}
+}
+
+/*********************************************************************
+* Function:         void SimNode_Sleep(uint32_t ms)
+*
+* Overview:         Puts the MCU of the current node in standby for
+*                   the given time. Its timer counter stops; the main
+*                   loop resumes when the time is up.
+********************************************************************/
+void SimNode_Sleep(uint32_t ms)
+{
+	SimNode_t *node = simCurrentNode;
+
+	node->sleepUntil = node->timeUs + (uint64_t)ms * 1000U;
+	node->stats.sleptUs += (uint64_t)ms * 1000U;
+	common_tc_stop();
+}
+
+/*********************************************************************
+* Function:         void SimNode_DestroyAll(void)
+*
+* Overview:         Releases every node
+********************************************************************/
+void SimNode_DestroyAll(void)
+{
+	for (uint16_t i = 0; i < simNodeCount; i++)
+	{
+		free(simNodes[i]->context);
+		free(simNodes[i]);
+	}
+	free(simNodes);
+	simNodes = NULL;
+	simNodeCount = simNodeCapacity = 0;
+	simCurrentNode = NULL;
+	SimEvent_Reset();
+	SimMedium_Reset();
+
+	for (uint8_t i = 0; i < simImageStateCount; i++)
+	{
+		/* Put the initial values back so a new run boots cleanly */
+		simSectionCopy(simImageStates[i].image->dataStart, simImageStates[i].pristineData,
+			simImageStates[i].dataSize);
+		simSectionClear(simImageStates[i].image->bssStart, simImageStates[i].bssSize);
+		free(simImageStates[i].pristineData);
+	}
+	simImageStateCount = 0;
+}
+
+/*********************************************************************
+* Function:         uint32_t SimNode_Random(SimNode_t *node)
+*
+* Overview:         Per node pseudo random generator (xorshift32), so
+*                   runs are reproducible
+********************************************************************/
+uint32_t SimNode_Random(SimNode_t *node)
+{
+	uint32_t x = node->rngState;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	node->rngState = x;
+	return x;
+}
+
+/*********************************************************************
+* Function:         uint64_t SimTime_Now(void)
+*
+* Overview:         Time as seen by the running node
+********************************************************************/
+uint64_t SimTime_Now(void)
+{
+	return simCurrentNode ? simCurrentNode->timeUs : simTimeUs;
+}
+
+/*********************************************************************
+* Function:         void SimTime_Block(uint32_t us)
+*
+* Overview:         Lets the current node busy-wait. Its local clock
+*                   moves ahead of the simulation and timer interrupts
+*                   falling into the wait are delivered to it; the
+*                   rest of the network catches up through events.
+********************************************************************/
+void SimTime_Block(uint32_t us)
+{
+	if (simCurrentNode)
+	{
+		simCurrentNode->timeUs += us;
+		SimHwTimer_Sync(simCurrentNode);
+	}
+}
+
+void sim_delay_us(uint32_t us)
+{
+	SimTime_Block(us);
+}
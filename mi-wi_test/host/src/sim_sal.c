@@ -0,0 +1,272 @@
+/**
+* \file  sim_sal.c
+*
+* \brief Security abstraction layer for the host build using software AES-128
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <string.h>
+#include "sal.h"
+
+/************************ DEFINITIONS ******************************/
+#define AES_ROUNDS          10
+#define AES_ROUND_KEYS_SIZE (AES_BLOCKSIZE * (AES_ROUNDS + 1))
+
+/************************ VARIABLES ********************************/
+static const uint8_t aesSbox[256] = {
+	0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+	0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+	0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+	0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+	0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+	0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+	0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+	0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+	0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+	0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+	0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+	0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+	0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+	0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+	0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+	0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static uint8_t aesInvSbox[256];
+static bool aesInvSboxReady;
+static uint8_t aesRoundKeys[AES_ROUND_KEYS_SIZE];
+static uint8_t aesState[AES_BLOCKSIZE];
+static uint8_t aesMode;
+static uint8_t aesDir;
+
+/************************ FUNCTIONS ********************************/
+static uint8_t aesXtime(uint8_t x)
+{
+	return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+static uint8_t aesMul(uint8_t a, uint8_t b)
+{
+	uint8_t r = 0;
+
+	while (b)
+	{
+		if (b & 1)
+		{
+			r ^= a;
+		}
+		a = aesXtime(a);
+		b >>= 1;
+	}
+	return r;
+}
+
+static void aesExpandKey(const uint8_t *key)
+{
+	uint8_t rcon = 0x01;
+
+	memcpy(aesRoundKeys, key, AES_KEYSIZE);
+	for (uint8_t i = AES_KEYSIZE; i < AES_ROUND_KEYS_SIZE; i += 4)
+	{
+		uint8_t t[4];
+
+		memcpy(t, &aesRoundKeys[i - 4], 4);
+		if (0 == (i % AES_KEYSIZE))
+		{
+			uint8_t tmp = t[0];
+
+			t[0] = aesSbox[t[1]] ^ rcon;
+			t[1] = aesSbox[t[2]];
+			t[2] = aesSbox[t[3]];
+			t[3] = aesSbox[tmp];
+			rcon = aesXtime(rcon);
+		}
+		for (uint8_t j = 0; j < 4; j++)
+		{
+			aesRoundKeys[i + j] = aesRoundKeys[i + j - AES_KEYSIZE] ^ t[j];
+		}
+	}
+}
+
+static void aesAddRoundKey(uint8_t *s, uint8_t round)
+{
+	for (uint8_t i = 0; i < AES_BLOCKSIZE; i++)
+	{
+		s[i] ^= aesRoundKeys[(round * AES_BLOCKSIZE) + i];
+	}
+}
+
+static void aesEncryptBlock(uint8_t *s)
+{
+	uint8_t t[AES_BLOCKSIZE];
+
+	aesAddRoundKey(s, 0);
+	for (uint8_t round = 1; round <= AES_ROUNDS; round++)
+	{
+		/* SubBytes and ShiftRows */
+		for (uint8_t c = 0; c < 4; c++)
+		{
+			for (uint8_t r = 0; r < 4; r++)
+			{
+				t[(c * 4) + r] = aesSbox[s[(((c + r) % 4) * 4) + r]];
+			}
+		}
+		/* MixColumns */
+		if (round != AES_ROUNDS)
+		{
+			for (uint8_t c = 0; c < 4; c++)
+			{
+				uint8_t *col = &t[c * 4];
+				uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+				uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+
+				col[0] ^= all ^ aesXtime(a0 ^ a1);
+				col[1] ^= all ^ aesXtime(a1 ^ a2);
+				col[2] ^= all ^ aesXtime(a2 ^ a3);
+				col[3] ^= all ^ aesXtime(a3 ^ a0);
+			}
+		}
+		memcpy(s, t, AES_BLOCKSIZE);
+		aesAddRoundKey(s, round);
+	}
+}
+
+static void aesDecryptBlock(uint8_t *s)
+{
+	uint8_t t[AES_BLOCKSIZE];
+
+	aesAddRoundKey(s, AES_ROUNDS);
+	for (uint8_t round = AES_ROUNDS; round > 0; round--)
+	{
+		/* InvShiftRows and InvSubBytes */
+		for (uint8_t c = 0; c < 4; c++)
+		{
+			for (uint8_t r = 0; r < 4; r++)
+			{
+				t[(((c + r) % 4) * 4) + r] = aesInvSbox[s[(c * 4) + r]];
+			}
+		}
+		memcpy(s, t, AES_BLOCKSIZE);
+		aesAddRoundKey(s, (uint8_t)(round - 1));
+		/* InvMixColumns */
+		if (round != 1)
+		{
+			for (uint8_t c = 0; c < 4; c++)
+			{
+				uint8_t *col = &s[c * 4];
+				uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+
+				col[0] = aesMul(a0, 14) ^ aesMul(a1, 11) ^ aesMul(a2, 13) ^ aesMul(a3, 9);
+				col[1] = aesMul(a0, 9) ^ aesMul(a1, 14) ^ aesMul(a2, 11) ^ aesMul(a3, 13);
+				col[2] = aesMul(a0, 13) ^ aesMul(a1, 9) ^ aesMul(a2, 14) ^ aesMul(a3, 11);
+				col[3] = aesMul(a0, 11) ^ aesMul(a1, 13) ^ aesMul(a2, 9) ^ aesMul(a3, 14);
+			}
+		}
+	}
+}
+
+void sal_init(void)
+{
+	for (uint16_t i = 0; i < 256; i++)
+	{
+		aesInvSbox[aesSbox[i]] = (uint8_t)i;
+	}
+	aesInvSboxReady = true;
+}
+
+bool sal_aes_setup(uint8_t *key, uint8_t enc_mode, uint8_t dir)
+{
+	if (!aesInvSboxReady)
+	{
+		sal_init();
+	}
+	/* Like the transceiver, a change of mode keeps the result of the last
+	 * operation, so CBC can follow an ECB block */
+	if (NULL != key)
+	{
+		aesExpandKey(key);
+		memset(aesState, 0, sizeof(aesState));
+	}
+	aesMode = enc_mode;
+	aesDir = dir;
+	return true;
+}
+
+/* Writes the next block and returns the result of the previous one, the
+ * way the transceiver pipelines its AES engine. */
+void sal_aes_wrrd(uint8_t *idata, uint8_t *odata)
+{
+	uint8_t block[AES_BLOCKSIZE];
+
+	memcpy(block, idata, AES_BLOCKSIZE);
+	if (NULL != odata)
+	{
+		memcpy(odata, aesState, AES_BLOCKSIZE);
+	}
+
+	if (AES_DIR_DECRYPT == aesDir)
+	{
+		aesDecryptBlock(block);
+	}
+	else
+	{
+		if (AES_MODE_CBC == aesMode)
+		{
+			for (uint8_t i = 0; i < AES_BLOCKSIZE; i++)
+			{
+				block[i] ^= aesState[i];
+			}
+		}
+		aesEncryptBlock(block);
+	}
+	memcpy(aesState, block, AES_BLOCKSIZE);
+}
+
+void sal_aes_exec(uint8_t *data)
+{
+	sal_aes_wrrd(data, NULL);
+}
+
+void sal_aes_read(uint8_t *data)
+{
+	memcpy(data, aesState, AES_BLOCKSIZE);
+}
+
+void sal_aes_restart(void)
+{
+}
+
+void _sal_aes_clean_up(void)
+{
+	memset(aesState, 0, sizeof(aesState));
+}
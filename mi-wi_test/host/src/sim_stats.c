@@ -0,0 +1,307 @@
+/**
+* \file  sim_stats.c
+*
+* \brief Statistics report of the host simulation
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+
+/************************ DEFINITIONS ******************************/
+/* Latency histogram: 1 ms bins, the last one collects the rest */
+#define SIM_STATS_LATENCY_BINS      10001
+#define SIM_STATS_LATENCY_BIN_US    1000
+
+/************************ TYPE DEFINITIONS ******************************/
+/* Application traffic in one direction */
+typedef struct _SimStatsFlow_t
+{
+	uint32_t sent;
+	uint32_t confirmed;
+	uint32_t failed;
+	uint32_t received;
+	uint64_t latencySumUs;
+	uint32_t latencyMaxUs;
+	uint32_t alarms;
+	uint64_t alarmLatencySumUs;
+	uint32_t alarmLatencyMaxUs;
+} SimStatsFlow_t;
+
+/************************ VARIABLES ********************************/
+static uint32_t simStatsLatency[2][SIM_STATS_LATENCY_BINS];
+
+/************************ FUNCTIONS ********************************/
+/*********************************************************************
+* Function:         void SimStats_Latency(bool uplink, uint64_t latencyUs)
+*
+* Overview:         Records the latency of an application frame, from
+*                   MiApp_SendData() to the data indication
+********************************************************************/
+void SimStats_Latency(bool uplink, uint64_t latencyUs)
+{
+	uint64_t bin = latencyUs / SIM_STATS_LATENCY_BIN_US;
+
+	if (bin >= SIM_STATS_LATENCY_BINS)
+	{
+		bin = SIM_STATS_LATENCY_BINS - 1;
+	}
+	simStatsLatency[uplink ? 1 : 0][bin]++;
+}
+
+/* Upper bound in ms of the bin holding the given percentile */
+static uint32_t simStatsPercentile(bool uplink, uint32_t count, uint8_t percent)
+{
+	const uint32_t *bins = simStatsLatency[uplink ? 1 : 0];
+	uint64_t target = ((uint64_t)count * percent + 99) / 100;
+	uint64_t seen = 0;
+
+	for (uint32_t i = 0; i < SIM_STATS_LATENCY_BINS; i++)
+	{
+		seen += bins[i];
+		if (seen >= target)
+		{
+			return i + 1;
+		}
+	}
+	return SIM_STATS_LATENCY_BINS;
+}
+
+static void simStatsFlows(SimStatsFlow_t *up, SimStatsFlow_t *down)
+{
+	memset(up, 0, sizeof(*up));
+	memset(down, 0, sizeof(*down));
+
+	for (uint16_t i = 0; i < simNodeCount; i++)
+	{
+		const SimNodeStats_t *s = &simNodes[i]->stats;
+		bool pan = (SIM_ROLE_PAN_COORDINATOR == simNodes[i]->cfg.role);
+		SimStatsFlow_t *tx = pan ? down : up;
+		/* Peer traffic is sent and received by end devices */
+		SimStatsFlow_t *rx = (pan || simNodes[i]->cfg.peer) ? up : down;
+
+		tx->sent += s->appTx;
+		tx->confirmed += s->appTxSuccess;
+		tx->failed += s->appTxFailure;
+		rx->received += s->appRx;
+		rx->latencySumUs += s->appRxLatencySumUs;
+		if (s->appRxLatencyMaxUs > rx->latencyMaxUs)
+		{
+			rx->latencyMaxUs = s->appRxLatencyMaxUs;
+		}
+		rx->alarms += s->appRxAlarm;
+		rx->alarmLatencySumUs += s->appRxAlarmLatencySumUs;
+		if (s->appRxAlarmLatencyMaxUs > rx->alarmLatencyMaxUs)
+		{
+			rx->alarmLatencyMaxUs = s->appRxAlarmLatencyMaxUs;
+		}
+	}
+}
+
+static void simStatsFlowPrint(const char *name, const SimStatsFlow_t *flow, bool uplink)
+{
+	printf("%-9s sent %u, confirmed %u, failed %u, received %u",
+		name, flow->sent, flow->confirmed, flow->failed, flow->received);
+	if (flow->sent)
+	{
+		printf(" (%.1f%%)", 100.0 * flow->received / flow->sent);
+	}
+	printf("\n");
+	if (flow->received)
+	{
+		printf("%-9s latency avg %.1f ms, p50 %u ms, p99 %u ms, max %.1f ms\n", "",
+			flow->latencySumUs / 1000.0 / flow->received,
+			simStatsPercentile(uplink, flow->received, 50),
+			simStatsPercentile(uplink, flow->received, 99),
+			flow->latencyMaxUs / 1000.0);
+	}
+	if (flow->alarms)
+	{
+		printf("%-9s %u alarms, latency avg %.1f ms, max %.1f ms\n", "",
+			flow->alarms, flow->alarmLatencySumUs / 1000.0 / flow->alarms,
+			flow->alarmLatencyMaxUs / 1000.0);
+	}
+}
+
+/*********************************************************************
+* Function:         void SimStats_Report(uint64_t durationUs, bool perNode)
+*
+* Overview:         Prints the network summary, optionally preceded by
+*                   the counters of every node
+********************************************************************/
+void SimStats_Report(uint64_t durationUs, bool perNode)
+{
+	SimStatsFlow_t up, down;
+	uint32_t joined = 0, sleeping = 0, linkFailures = 0;
+	uint32_t frames = 0, noAck = 0, channelBusy = 0, overrun = 0;
+	uint32_t edFrames = 0;
+	int64_t edPowerSumDbm = 0;
+	uint8_t memMin = 100, txQueueMax = 0, indirectMax = 0;
+
+	if (perNode)
+	{
+		printf("node role joined_ms frame_tx no_ack cca_fail frame_rx collide overrun"
+			" app_tx app_ok app_fail app_rx txq_max mem_min%% slept%%\n");
+	}
+	for (uint16_t i = 0; i < simNodeCount; i++)
+	{
+		const SimNode_t *node = simNodes[i];
+		const SimNodeStats_t *s = &node->stats;
+		bool pan = (SIM_ROLE_PAN_COORDINATOR == node->cfg.role);
+		uint64_t sleptUs = s->sleptUs;
+
+		/* Sleep is booked when it starts; drop what lies past the end */
+		if (node->sleepUntil > durationUs)
+		{
+			sleptUs -= Min(sleptUs, node->sleepUntil - durationUs);
+		}
+		if (perNode)
+		{
+			printf("%4u %4s %9llu %8u %6u %8u %8u %7u %7u %6u %6u %8u %6u %7u %8u %6u\n",
+				node->cfg.id, pan ? "PAN" : ((&simImageRfd == node->image) ? "RFD" : "ED"),
+				s->connected ? (unsigned long long)(s->connectedAtUs / 1000) : 0ULL,
+				s->frameTx, s->frameTxNoAck, s->frameTxChannelBusy, s->frameRx,
+				s->frameRxCollision, s->frameRxOverrun, s->appTx, s->appTxSuccess,
+				s->appTxFailure, s->appRx, s->txQueueMax, s->memFreePercentMin,
+				(unsigned)(durationUs ? (100 * sleptUs / durationUs) : 0));
+		}
+
+		if (!pan && s->connected)
+		{
+			joined++;
+		}
+		if (&simImageRfd == node->image)
+		{
+			sleeping++;
+		}
+		if (!pan)
+		{
+			edFrames += s->frameTx;
+			edPowerSumDbm += s->frameTxPowerSumDbm;
+		}
+		linkFailures += s->linkFailures;
+		frames += s->frameTx;
+		noAck += s->frameTxNoAck;
+		channelBusy += s->frameTxChannelBusy;
+		overrun += s->frameRxOverrun;
+		memMin = Min(memMin, s->memFreePercentMin);
+		txQueueMax = Max(txQueueMax, s->txQueueMax);
+		indirectMax = Max(indirectMax, s->indirectQueueMax);
+	}
+	if (perNode)
+	{
+		printf("\n");
+	}
+
+	simStatsFlows(&up, &down);
+	printf("nodes     %u (%u sleeping), %.1f s simulated\n",
+		simNodeCount, sleeping, durationUs / 1e6);
+	printf("joined    %u/%u end devices, %u link failures\n",
+		joined, simNodeCount ? simNodeCount - 1 : 0, linkFailures);
+	simStatsFlowPrint((simNodeCount && simNodes[0]->cfg.peer) ? "peer" : "uplink", &up, true);
+	if (down.sent || down.received)
+	{
+		simStatsFlowPrint("downlink", &down, false);
+	}
+	printf("medium    %u frames, %u acks, %u collisions, %.1f%% airtime, %.1f%% offered load\n",
+		simMediumStats.transmissions, simMediumStats.acks, simMediumStats.collisions,
+		durationUs ? (100.0 * simMediumStats.busyUs / durationUs) : 0.0,
+		durationUs ? (100.0 * simMediumStats.airtimeUs / durationUs) : 0.0);
+	if (simInterferer.enabled)
+	{
+		uint8_t panChannel = SimTrx_Channel(&simNodes[0]->trx);
+		uint16_t following = 0;
+
+		for (uint16_t i = 1; i < simNodeCount; i++)
+		{
+			following += (SimTrx_Channel(&simNodes[i]->trx) == panChannel);
+		}
+		printf("interfer  channel %u, %u%% from %.1f s, %u frames lost; PAN on channel %u with %u/%u end devices\n",
+			simInterferer.channel, simInterferer.dutyPercent, simInterferer.startUs / 1e6,
+			simMediumStats.interfered, panChannel, following, simNodeCount - 1);
+	}
+	printf("mac       %u no ack, %u channel access failures, %u rx overruns\n",
+		noAck, channelBusy, overrun);
+	if (simNodeCount)
+	{
+		const SimNodeStats_t *s = &simNodes[0]->stats;
+
+		printf("txpower   PAN coordinator %.1f dBm, end devices %.1f dBm per frame on average\n",
+			s->frameTx ? ((double)s->frameTxPowerSumDbm / s->frameTx) : 0.0,
+			edFrames ? ((double)edPowerSumDbm / edFrames) : 0.0);
+	}
+	printf("stack     tx queue max %u, indirect queue max %u, heap free min %u%%\n",
+		txQueueMax, indirectMax, memMin);
+	if (simNodeCount && simNodes[0]->stats.edScans)
+	{
+		SimNodeStats_t *s = &simNodes[0]->stats;
+
+		printf("edscan    %u scans, %u channels, %u samples, max %d dBm, optimal channel %u\n",
+			s->edScans, s->edScanChannels, s->edScanSamples, s->edScanEnergyMax,
+			s->edScanOptimalChannel);
+	}
+}
+
+/*********************************************************************
+* Function:         void SimStats_ReportLine(uint64_t durationUs, bool header)
+*
+* Overview:         One line summary, for comparing runs
+********************************************************************/
+void SimStats_ReportLine(uint64_t durationUs, bool header)
+{
+	SimStatsFlow_t up, down;
+	uint32_t joined = 0;
+
+	if (header)
+	{
+		printf("%6s %7s %8s %8s %7s %8s %8s %10s %9s\n", "nodes", "joined", "up_sent", "up_rx",
+			"deliv%", "avg_ms", "p99_ms", "collisions", "airtime%");
+	}
+
+	for (uint16_t i = 0; i < simNodeCount; i++)
+	{
+		if ((SIM_ROLE_PAN_COORDINATOR != simNodes[i]->cfg.role) && simNodes[i]->stats.connected)
+		{
+			joined++;
+		}
+	}
+	simStatsFlows(&up, &down);
+
+	printf("%6u %7u %8u %8u %7.1f %8.1f %8u %10u %9.1f\n", simNodeCount, joined,
+		up.sent, up.received, up.sent ? (100.0 * up.received / up.sent) : 0.0,
+		up.received ? (up.latencySumUs / 1000.0 / up.received) : 0.0,
+		up.received ? simStatsPercentile(true, up.received, 99) : 0,
+		simMediumStats.collisions,
+		durationUs ? (100.0 * simMediumStats.busyUs / durationUs) : 0.0);
+}
@@ -0,0 +1,586 @@
+/**
+* \file  sim_trx.c
+*
+* \brief Register level model of the AT86RF212B behind the trx_access API
+*
+* Copyright (c) 2019 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+/************************ HEADERS **********************************/
+#include <string.h>
+#include "sim.h"
+#include "trx_access.h"
+#include "phy.h"
+#include "phy_at86rf212b.h"
+
+/************************ DEFINITIONS ******************************/
+#define SIM_TRX_PART_NUM        0x07
+#define SIM_TRX_VERSION_NUM     0x03
+#define SIM_TRX_MAN_ID_0        0x1F
+
+/* Reset values that the PHY driver reads back and modifies */
+#define SIM_TRX_RST_TRX_CTRL_1  0x22
+#define SIM_TRX_RST_PHY_CC_CCA  0x2B
+#define SIM_TRX_RST_TRX_CTRL_2  0x24
+#define SIM_TRX_RST_XAH_CTRL_0  0x38
+#define SIM_TRX_RST_CSMA_SEED_1 0x42
+#define SIM_TRX_RST_CSMA_BE     0x53
+#define SIM_TRX_RST_PHY_TX_PWR  0x60
+#define SIM_TRX_RST_CCA_THRES   0x77
+
+/* Frame control field */
+#define SIM_FCF_ACK_REQUEST     0x20
+#define SIM_FCF_PANID_COMP      0x40
+#define SIM_FCF_DST_MODE(fcf1)  (((fcf1) >> 2) & 0x03)
+#define SIM_FCF_SRC_MODE(fcf1)  (((fcf1) >> 6) & 0x03)
+#define SIM_ADDR_MODE_NONE      0
+#define SIM_ADDR_MODE_SHORT     2
+#define SIM_ADDR_MODE_LONG      3
+
+#define SIM_FRAME_TYPE_ACK      2
+#define SIM_FRAME_TYPE_RESERVED 4
+
+/* ED register range of the AT86RF212B (1 dB steps) */
+#define SIM_TRX_ED_MAX          84
+
+/************************ FUNCTIONS ********************************/
+/* Runs the interrupt handler of the node for unmasked IRQ status bits */
+static void simTrxInterrupt(SimNode_t *node)
+{
+	SimTrx_t *trx = &node->trx;
+
+	if ((NULL != trx->irqHandler) && (trx->irqStatus & trx->regs[IRQ_MASK_REG]))
+	{
+		SimNode_Switch(node);
+		trx->irqHandler();
+	}
+}
+
+void SimTrx_Reset(SimTrx_t *trx)
+{
+	/* Events of a transmit procedure cut short must stay stale */
+	uint32_t txToken = trx->txToken + 1;
+
+	memset(trx, 0, sizeof(SimTrx_t));
+	trx->txToken = txToken;
+	trx->status = TRX_STATUS_TRX_OFF;
+	trx->tracStatus = TRAC_STATUS_INVALID;
+	trx->regs[TRX_CTRL_1_REG] = SIM_TRX_RST_TRX_CTRL_1;
+	trx->regs[PHY_TX_PWR_REG] = SIM_TRX_RST_PHY_TX_PWR;
+	trx->regs[PHY_CC_CCA_REG] = SIM_TRX_RST_PHY_CC_CCA;
+	trx->regs[TRX_CTRL_2_REG] = SIM_TRX_RST_TRX_CTRL_2;
+	trx->regs[PART_NUM_REG] = SIM_TRX_PART_NUM;
+	trx->regs[VERSION_NUM_REG] = SIM_TRX_VERSION_NUM;
+	trx->regs[MAN_ID_0_REG] = SIM_TRX_MAN_ID_0;
+	trx->regs[SHORT_ADDR_0_REG] = 0xFF;
+	trx->regs[SHORT_ADDR_1_REG] = 0xFF;
+	trx->regs[PAN_ID_0_REG] = 0xFF;
+	trx->regs[PAN_ID_1_REG] = 0xFF;
+	trx->regs[XAH_CTRL_0_REG] = SIM_TRX_RST_XAH_CTRL_0;
+	trx->regs[CSMA_SEED_1_REG] = SIM_TRX_RST_CSMA_SEED_1;
+	trx->regs[CSMA_BE_REG] = SIM_TRX_RST_CSMA_BE;
+	trx->regs[CCA_THRES_REG] = SIM_TRX_RST_CCA_THRES;
+}
+
+uint8_t SimTrx_Channel(const SimTrx_t *trx)
+{
+	return trx->regs[PHY_CC_CCA_REG] & 0x1F;
+}
+
+/* No frame is received with the preamble detector off (RX_PDT_DIS) */
+bool SimTrx_IsReceiving(const SimTrx_t *trx)
+{
+	return ((TRX_STATUS_RX_ON == trx->status) || (TRX_STATUS_RX_AACK_ON == trx->status)) &&
+		!(trx->regs[RX_SYN_REG] & (1 << RX_PDT_DIS));
+}
+
+/* ED register value, relative to the RSSI base value the driver takes
+ * for the modulation of the channel */
+static uint8_t simTrxEdLevel(SimNode_t *node)
+{
+	int8_t base = SimTrx_Channel(&node->trx) ? PHY_RSSI_BASE_VAL_OQPSK_RC_250 : PHY_RSSI_BASE_VAL_BPSK_20;
+	int16_t ed = SimMedium_Energy(node) - base;
+
+	return (uint8_t)((ed < 0) ? 0 : ((ed > SIM_TRX_ED_MAX) ? SIM_TRX_ED_MAX : ed));
+}
+
+static uint16_t simTrxReg16(const SimTrx_t *trx, uint8_t reg)
+{
+	return (uint16_t)(trx->regs[reg] | ((uint16_t)trx->regs[reg + 1] << 8));
+}
+
+static uint16_t simGet16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+/*********************************************************************
+* Function:         static bool simTrxAddressMatch(const SimTrx_t *trx,
+*                            const uint8_t *psdu, uint8_t len, bool *unicast)
+*
+* Overview:         Frame filter of the extended operating mode
+*                   (RX_AACK). Returns true if the frame is for this
+*                   node and reports whether it was unicast to it.
+********************************************************************/
+static bool simTrxAddressMatch(const SimTrx_t *trx, const uint8_t *psdu, uint8_t len, bool *unicast)
+{
+	uint8_t frameType = psdu[0] & FCF_FRAMETYPE_MASK;
+	uint8_t dstMode = SIM_FCF_DST_MODE(psdu[1]);
+	uint16_t panId = simTrxReg16(trx, PAN_ID_0_REG);
+	uint16_t dstPanId;
+
+	*unicast = false;
+
+	if (trx->regs[XAH_CTRL_1_REG] & (1 << AACK_PROM_MODE))
+	{
+		return true;
+	}
+	if ((SIM_FRAME_TYPE_ACK == frameType) || (frameType >= SIM_FRAME_TYPE_RESERVED))
+	{
+		return false;
+	}
+	if (SIM_ADDR_MODE_NONE == dstMode)
+	{
+		/* Only a PAN coordinator accepts frames without destination */
+		return (trx->regs[CSMA_SEED_1_REG] & (1 << AACK_I_AM_COORD)) != 0;
+	}
+	if (len < 5 + ((SIM_ADDR_MODE_LONG == dstMode) ? 8 : 2))
+	{
+		return false;
+	}
+
+	dstPanId = simGet16(&psdu[3]);
+	if ((0xFFFF != dstPanId) && (dstPanId != panId))
+	{
+		return false;
+	}
+
+	if (SIM_ADDR_MODE_SHORT == dstMode)
+	{
+		uint16_t dst = simGet16(&psdu[5]);
+
+		if (0xFFFF == dst)
+		{
+			return true;
+		}
+		*unicast = (dst == simTrxReg16(trx, SHORT_ADDR_0_REG));
+		return *unicast;
+	}
+	if (SIM_ADDR_MODE_LONG == dstMode)
+	{
+		*unicast = (0 == memcmp(&psdu[5], &trx->regs[IEEE_ADDR_0_REG], 8));
+		return *unicast;
+	}
+	return false;
+}
+
+/*********************************************************************
+* Function:         bool SimTrx_Deliver(SimNode_t *node, const uint8_t *psdu,
+*                                       uint8_t len, int8_t rxPowerDbm)
+*
+* Overview:         Hands a frame from the air to the node transceiver.
+*                   The frame lands in the frame buffer and raises
+*                   TRX_END when it passes the frame filter, running
+*                   the interrupt handler if TRX_END is unmasked.
+*                   Returns true if the transceiver acknowledges the
+*                   frame.
+********************************************************************/
+bool SimTrx_Deliver(SimNode_t *node, const uint8_t *psdu, uint8_t len, int8_t rxPowerDbm)
+{
+	SimTrx_t *trx = &node->trx;
+	bool unicast = false;
+	int16_t ed;
+
+	if (!SimTrx_IsReceiving(trx) || (len < 5) || (len > MAX_PSDU))
+	{
+		return false;
+	}
+
+	if (TRX_STATUS_RX_AACK_ON == trx->status)
+	{
+		if (!simTrxAddressMatch(trx, psdu, len, &unicast))
+		{
+			node->stats.frameRxFiltered++;
+			return false;
+		}
+	}
+
+	ed = rxPowerDbm - PHY_RSSI_BASE_VAL_OQPSK_RC_250;
+	if (ed < 0)
+	{
+		ed = 0;
+	}
+	else if (ed > SIM_TRX_ED_MAX)
+	{
+		ed = SIM_TRX_ED_MAX;
+	}
+
+	/* Frame buffer protection is off: a frame not read yet is overwritten */
+	if (trx->irqStatus & (1 << TRX_END))
+	{
+		node->stats.frameRxOverrun++;
+	}
+	trx->frameBuffer[0] = len;
+	memcpy(&trx->frameBuffer[1], psdu, len);
+	trx->frameBuffer[1 + len] = 0xFF;
+	trx->edLevel = (uint8_t)ed;
+	trx->crcValid = true;
+	trx->irqStatus |= (1 << RX_START) | (1 << TRX_END);
+	node->stats.frameRx++;
+	simTrxInterrupt(node);
+
+	return unicast && (psdu[0] & SIM_FCF_ACK_REQUEST) &&
+		!(trx->regs[CSMA_SEED_1_REG] & (1 << AACK_DIS_ACK));
+}
+
+static void simTrxTransmit(SimNode_t *node, bool extended)
+{
+	uint8_t len = node->trx.frameBuffer[0];
+
+	if ((len < 3) || (len > MAX_PSDU))
+	{
+		return;
+	}
+	SimMedium_TxRequest(node, extended);
+}
+
+/*********************************************************************
+* Function:         void SimTrx_TxDone(SimNode_t *node, uint8_t trac)
+*
+* Overview:         Ends the transmit procedure: TRAC status (extended
+*                   mode only) and TRX_END, taken by the interrupt
+*                   handler if unmasked; then the node is woken up to
+*                   poll it.
+********************************************************************/
+void SimTrx_TxDone(SimNode_t *node, uint8_t trac)
+{
+	SimTrx_t *trx = &node->trx;
+
+	if (TRAC_STATUS_NO_ACK == trac)
+	{
+		node->stats.frameTxNoAck++;
+	}
+	trx->tracStatus = trx->txExtended ? trac : TRAC_STATUS_INVALID;
+	trx->irqStatus |= (1 << TRX_END);
+	trx->txPhase = SIM_TX_IDLE;
+	trx->txToken++;
+	simTrxInterrupt(node);
+	SimNode_Wake(node, simTimeUs);
+}
+
+/*********************************************************************
+* Function:         void SimTrx_EdEnd(SimNode_t *node)
+*
+* Overview:         Ends an energy detection started with CCA_ED_DONE
+*                   unmasked: the interrupt handler takes the level,
+*                   then the node is woken up to hand it on.
+********************************************************************/
+void SimTrx_EdEnd(SimNode_t *node)
+{
+	SimTrx_t *trx = &node->trx;
+
+	if (!trx->edPending || (trx->edEndUs != simTimeUs))
+	{
+		/* The transceiver was reset meanwhile */
+		return;
+	}
+	trx->edPending = false;
+	trx->edLevel = simTrxEdLevel(node);
+	trx->irqStatus |= (1 << CCA_ED_DONE);
+	simTrxInterrupt(node);
+	SimNode_Wake(node, simTimeUs);
+}
+
+static void simTrxCommand(SimNode_t *node, uint8_t cmd)
+{
+	SimTrx_t *trx = &node->trx;
+
+	if (TRX_STATUS_SLEEP == trx->status)
+	{
+		/* SPI commands are ignored while the transceiver sleeps */
+		return;
+	}
+
+	/* Only the forced commands break into a transmit procedure */
+	if ((TRX_CMD_FORCE_TRX_OFF == cmd) || (TRX_CMD_FORCE_PLL_ON == cmd))
+	{
+		SimMedium_TxAbort(node);
+	}
+	else if ((SIM_TX_IDLE != trx->txPhase) && (SIM_TX_ACK_REPLY != trx->txPhase) &&
+		(TRX_CMD_TX_START != cmd))
+	{
+		return;
+	}
+	/* A frame being received is lost on any state change */
+	trx->rxFrame = NULL;
+
+	switch (cmd)
+	{
+		case TRX_CMD_FORCE_TRX_OFF:
+		case TRX_CMD_TRX_OFF:
+			trx->status = TRX_STATUS_TRX_OFF;
+			break;
+
+		case TRX_CMD_FORCE_PLL_ON:
+		case TRX_CMD_PLL_ON:
+			trx->status = TRX_STATUS_PLL_ON;
+			break;
+
+		case TRX_CMD_RX_ON:
+			trx->status = TRX_STATUS_RX_ON;
+			break;
+
+		case TRX_CMD_RX_AACK_ON:
+			trx->status = TRX_STATUS_RX_AACK_ON;
+			break;
+
+		case TRX_CMD_TX_ARET_ON:
+			trx->status = TRX_STATUS_TX_ARET_ON;
+			break;
+
+		case TRX_CMD_TX_START:
+			if (TRX_STATUS_PLL_ON == trx->status)
+			{
+				simTrxTransmit(node, false);
+			}
+			else if (TRX_STATUS_TX_ARET_ON == trx->status)
+			{
+				simTrxTransmit(node, true);
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+void sim_trx_slp_tr(bool level)
+{
+	SimNode_t *node = simCurrentNode;
+	SimTrx_t *trx = &node->trx;
+
+	if (level == trx->slpTr)
+	{
+		return;
+	}
+	trx->slpTr = level;
+
+	if (level)
+	{
+		if (TRX_STATUS_TRX_OFF == trx->status)
+		{
+			trx->status = TRX_STATUS_SLEEP;
+		}
+		else if (TRX_STATUS_TX_ARET_ON == trx->status)
+		{
+			simTrxTransmit(node, true);
+		}
+		else if (TRX_STATUS_PLL_ON == trx->status)
+		{
+			simTrxTransmit(node, false);
+		}
+	}
+	else if (TRX_STATUS_SLEEP == trx->status)
+	{
+		trx->status = TRX_STATUS_TRX_OFF;
+	}
+}
+
+void sim_trx_rst(bool level)
+{
+	if (!level)
+	{
+		SimTrx_Reset(&simCurrentNode->trx);
+	}
+}
+
+uint8_t trx_reg_read(uint8_t addr)
+{
+	SimNode_t *node = simCurrentNode;
+	SimTrx_t *trx = &node->trx;
+	uint8_t value;
+
+	addr &= (SIM_TRX_REGISTER_COUNT - 1);
+	switch (addr)
+	{
+		case TRX_STATUS_REG:
+			/* Busy while a frame is received or acknowledged */
+			if ((TRX_STATUS_RX_AACK_ON == trx->status) &&
+				((NULL != trx->rxFrame) || (SIM_TX_ACK_REPLY == trx->txPhase)))
+			{
+				return TRX_STATUS_BUSY_RX_AACK;
+			}
+			return trx->status;
+
+		case TRX_STATE_REG:
+			return (uint8_t)(trx->tracStatus << TRAC_STATUS);
+
+		case IRQ_STATUS_REG:
+			/* Cleared on read */
+			value = trx->irqStatus;
+			trx->irqStatus = 0;
+			return value;
+
+		case PHY_ED_LEVEL_REG:
+			return trx->edLevel;
+
+		case PHY_RSSI_REG:
+			value = (uint8_t)((SimNode_Random(node) & 0x03) << RND_VALUE);
+			if (trx->crcValid)
+			{
+				value |= (1 << RX_CRC_VALID);
+			}
+			return value;
+
+		default:
+			return trx->regs[addr];
+	}
+}
+
+void trx_reg_write(uint8_t addr, uint8_t data)
+{
+	SimNode_t *node = simCurrentNode;
+	SimTrx_t *trx = &node->trx;
+
+	addr &= (SIM_TRX_REGISTER_COUNT - 1);
+	switch (addr)
+	{
+		case TRX_STATUS_REG:
+		case IRQ_STATUS_REG:
+		case PART_NUM_REG:
+		case VERSION_NUM_REG:
+		case MAN_ID_0_REG:
+		case MAN_ID_1_REG:
+			/* Read only */
+			break;
+
+		case TRX_STATE_REG:
+			simTrxCommand(node, data & TRX_STATUS_MASK);
+			break;
+
+		case PHY_ED_LEVEL_REG:
+			/* Any write starts a manual energy detection. With CCA_ED_DONE
+			 * masked the driver polls for it, the node busy-waits. */
+			if (trx->regs[IRQ_MASK_REG] & (1 << CCA_ED_DONE))
+			{
+				trx->edPending = true;
+				trx->edEndUs = SimTime_Now() + SIM_TRX_ED_DURATION_US;
+				SimEvent_Schedule(trx->edEndUs, SIM_EVENT_ED_END, node, NULL, 0);
+				break;
+			}
+			SimTime_Block(SIM_TRX_ED_DURATION_US);
+			trx->edLevel = simTrxEdLevel(node);
+			trx->irqStatus |= (1 << CCA_ED_DONE);
+			break;
+
+
+		default:
+			trx->regs[addr] = data;
+			break;
+	}
+}
+
+uint8_t trx_bit_read(uint8_t addr, uint8_t mask, uint8_t pos)
+{
+	return (uint8_t)((trx_reg_read(addr) & mask) >> pos);
+}
+
+void trx_bit_write(uint8_t reg_addr, uint8_t mask, uint8_t pos, uint8_t new_value)
+{
+	uint8_t value = trx_reg_read(reg_addr) & (uint8_t)~mask;
+
+	trx_reg_write(reg_addr, value | ((uint8_t)(new_value << pos) & mask));
+}
+
+void trx_frame_read(uint8_t *data, uint8_t length)
+{
+	uint16_t n = Min(length, SIM_TRX_FRAME_BUFFER_SIZE);
+
+	memcpy(data, simCurrentNode->trx.frameBuffer, n);
+}
+
+void trx_frame_write(uint8_t *data, uint8_t length)
+{
+	uint16_t n = Min(length, SIM_TRX_FRAME_BUFFER_SIZE);
+
+	memcpy(simCurrentNode->trx.frameBuffer, data, n);
+}
+
+void trx_sram_read(uint8_t addr, uint8_t *data, uint8_t length)
+{
+	if (addr < SIM_TRX_FRAME_BUFFER_SIZE)
+	{
+		uint16_t n = Min(length, SIM_TRX_FRAME_BUFFER_SIZE - addr);
+
+		memcpy(data, &simCurrentNode->trx.frameBuffer[addr], n);
+	}
+}
+
+void trx_sram_write(uint8_t addr, uint8_t *data, uint8_t length)
+{
+	if (addr < SIM_TRX_FRAME_BUFFER_SIZE)
+	{
+		uint16_t n = Min(length, SIM_TRX_FRAME_BUFFER_SIZE - addr);
+
+		memcpy(&simCurrentNode->trx.frameBuffer[addr], data, n);
+	}
+}
+
+void trx_aes_wrrd(uint8_t addr, uint8_t *idata, uint8_t length)
+{
+	/* The AES engine is provided by the host SAL, not by the SPI model */
+	(void)addr;
+	(void)idata;
+	(void)length;
+}
+
+/* The handler runs when the medium raises an unmasked IRQ status bit */
+void trx_irq_init(FUNC_PTR trx_irq_cb)
+{
+	simCurrentNode->trx.irqHandler = trx_irq_cb;
+}
+
+void trx_spi_init(void)
+{
+}
+
+void PhyReset(void)
+{
+	SimTrx_Reset(&simCurrentNode->trx);
+}
+
+void trx_spi_disable(void)
+{
+}
+
+void trx_spi_enable(void)
+{
+}
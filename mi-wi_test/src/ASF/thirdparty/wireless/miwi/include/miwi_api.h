@@ -505,6 +505,8 @@ extern defaultParametersRamOnly_t defaultParamsRamOnly;
 *      miwi_status_t status of Initialization
 *      In Mesh, when Network Freezer is enabled, stack try to restores the network freezer
 *      data and tries to reconnect to the network, this is indicated with reconnection progress status
+*      MEMORY_UNAVAILABLE if the memory pools of the stack cannot be created,
+*      FAILURE if the MiMAC layer cannot be initialized
 *
 * Example:
 *      <code>
@@ -845,6 +847,61 @@ uint8_t msghandle, DataConf_callback_t ConfCallback);
 bool MiApp_SendData(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *msgpointer, uint8_t msghandle,
 bool ackReq, DataConf_callback_t ConfCallback);
 
+/* Transmit classes, in the order the stack sends queued frames */
+typedef enum miwi_tx_class {
+	TX_CLASS_CONTROL = 0,       // Stack commands: connection, link status, connection table
+	TX_CLASS_ALARM,             // Application alarms
+	TX_CLASS_NORMAL,            // Application data, MiApp_SendData
+	TX_CLASS_BULK,              // Application data that can wait, like telemetry
+	TX_CLASS_COUNT
+}miwi_tx_class_t;
+
+/************************************************************************************
+* Function:
+* bool MiApp_SendDataWithClass(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *msgpointer,
+uint8_t msghandle, bool ackReq, miwi_tx_class_t txClass, DataConf_callback_t ConfCallback);
+*
+* Summary:
+*      This function sends a message like MiApp_SendData in the given transmit class
+*
+* Description:
+*      Queued frames are sent class by class: stack commands first, then alarms,
+*      normal and bulk data. Within a class the frames keep their order. A
+*      waiting frame moves up one class per aging time of its class, up to the
+*      alarm class, so bulk data is not starved. A frame that waited for the
+*      deadline of its class is dropped and confirmed with TRANSACTION_EXPIRED.
+*
+* PreCondition:
+*      Protocol initialization has been done.
+*
+* Parameters:
+*      uint8_t addr_len - destionation address length
+*      uint8_t *addr  - destionation address
+*      uint8_t msglen - length of the message
+*      uint8_t *msgpointer - message/frame pointer
+*      uint8_t msghandle - message handle
+*      bool ackReq - set to receive network level ack (Note- Discarded for broadcast data)
+*      miwi_tx_class_t txClass - TX_CLASS_ALARM, TX_CLASS_NORMAL or TX_CLASS_BULK
+*      DataConf_callback_t ConfCallback - The callback routine which will be called upon
+*                                               the initiated data procedure is performed
+*
+* Returns:
+*      A boolean to indicates if the message was queued. Fails as well when
+*      the queue of the class is full.
+*
+* Example:
+*      <code>
+*      // Report a lock alarm ahead of queued telemetry
+*      MiApp_SendDataWithClass(LONG_ADDR_LEN, coordAddr, len, frameptr, 1, true, TX_CLASS_ALARM, callback);
+*      </code>
+*
+* Remarks:
+*      Frames forwarded by the PAN coordinator are sent in TX_CLASS_NORMAL.
+*
+*****************************************************************************************/
+bool MiApp_SendDataWithClass(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *msgpointer, uint8_t msghandle,
+bool ackReq, miwi_tx_class_t txClass, DataConf_callback_t ConfCallback);
+
 #define BROADCAST_TO_ALL            0x01
 #define MULTICAST_TO_COORDINATORS   0x02
 #define MULTICAST_TO_FFDS           0x03
@@ -877,6 +934,8 @@ uint8_t		*Payload;                   // pointer to the application payload
 uint8_t		PayloadSize;                // application payload length
 uint8_t		PacketRSSI;                 // RSSI value of the receive message
 uint8_t 	PacketLQI;                  // LQI value of the received message
+uint8_t		Handle;                     // receive buffer of the message, see MiApp_MessageHold
+uint32_t	TimeStamp;                  // MiWi_TickGet() when the message was received
 
 } RECEIVED_MESSAGE;
 
@@ -934,6 +993,76 @@ typedef void (*PacketIndCallback_t)(RECEIVED_MESH_MESSAGE *ind);
 *****************************************************************************************/
 bool  MiApp_SubscribeDataIndicationCallback(PacketIndCallback_t callback);
 
+#if defined(PROTOCOL_P2P) || defined (PROTOCOL_STAR)
+/************************************************************************************
+* Function:
+*      bool MiApp_MessageHold(RECEIVED_MESSAGE *msg)
+*
+* Summary:
+*      This function keeps a received message in its receive buffer
+*
+* Description:
+*      The message handed to the data indication callback points into the
+*      receive buffer of the stack, which is reused when the callback returns.
+*      After MiApp_MessageHold the buffer stays valid, so a copy of the
+*      RECEIVED_MESSAGE structure can be kept and processed later without
+*      copying the payload. Every hold takes one reference, which must be given
+*      back with MiApp_MessageRelease; the buffer is reused after the last
+*      release. Held messages occupy receive buffers (BANK_SIZE), keep their
+*      number below it.
+*
+* PreCondition:
+*      Called from the data indication callback, or for a message already held.
+*
+* Parameters:
+*      RECEIVED_MESSAGE *msg - The received message
+*
+* Returns:
+*      A boolean to indicate if the message is held.
+*
+* Example:
+*      <code>
+*      void ReceivedDataIndication(RECEIVED_MESSAGE *ind)
+*      {
+*          if (MiApp_MessageHold(ind))
+*          {
+*              heldMessage = *ind;
+*          }
+*      }
+*      </code>
+*
+* Remarks:
+*      None
+*
+*****************************************************************************************/
+bool MiApp_MessageHold(RECEIVED_MESSAGE *msg);
+
+/************************************************************************************
+* Function:
+*      void MiApp_MessageRelease(RECEIVED_MESSAGE *msg)
+*
+* Summary:
+*      This function gives back a message kept by MiApp_MessageHold
+*
+* Description:
+*      The pointers of the message must not be used after the release.
+*
+* PreCondition:
+*      The message is held by MiApp_MessageHold.
+*
+* Parameters:
+*      RECEIVED_MESSAGE *msg - The held message
+*
+* Returns:
+*      None
+*
+* Remarks:
+*      May be called from interrupt context.
+*
+*****************************************************************************************/
+void MiApp_MessageRelease(RECEIVED_MESSAGE *msg);
+#endif
+
 
 #define NOISE_DETECT_ENERGY 0x00
 #define NOISE_DETECT_CS     0x01
@@ -983,6 +1112,84 @@ bool  MiApp_SubscribeDataIndicationCallback(PacketIndCallback_t callback);
 *****************************************************************************************/
 uint8_t    MiApp_NoiseDetection(uint32_t ChannelMap, uint8_t ScanDuration, uint8_t DetectionMode, OUTPUT uint8_t *NoiseLevel);
 
+#if defined(ENABLE_BACKGROUND_ED_SCAN)
+/* Energy of a channel measured by MiApp_EdScanStart, in dBm. The energies
+   are valid when samples is not 0. busySamples counts the samples of
+   ED_SCAN_BUSY_LEVEL dBm or more, the time share the channel is in use. */
+typedef struct
+{
+    uint8_t channel;
+    uint8_t samples;
+    uint8_t busySamples;
+    int8_t minEnergy;
+    int8_t meanEnergy;
+    int8_t maxEnergy;
+} EdScanResult_t;
+
+typedef void (*EdScanInd_callback_t)(EdScanResult_t *result);
+typedef void (*EdScanConf_callback_t)(uint8_t optimalChannel);
+
+/************************************************************************************
+* Function:
+*      bool MiApp_EdScanStart(uint32_t ChannelMap, uint8_t ScanDuration,
+*                             EdScanInd_callback_t IndCallback, EdScanConf_callback_t ConfCallback)
+*
+* Summary:
+*      This function starts an energy detection scan in the background
+*
+* Description:
+*      This is the user interface function for the application layer to
+*      assess the channels without blocking the main loop as
+*      MiApp_NoiseDetection does. The channels are scanned one after the
+*      other. On each of them, the energy is measured every
+*      ED_SCAN_SAMPLE_INTERVAL milliseconds while the stack has no frame to
+*      send or to confirm. The device stays reachable on its operating
+*      channel between the measurements.
+*
+* PreCondition:
+*      Protocol initialization has been done.
+*
+* Parameters:
+*      uint32_t ChannelMap -  The bit map of channels to scan
+*      uint8_t ScanDuration - The time to scan a single channel, as for
+*                          MiApp_NoiseDetection
+*      EdScanInd_callback_t IndCallback - Gets the minimum, mean and maximum
+*                          energy of each channel once it has been scanned
+*      EdScanConf_callback_t ConfCallback - Gets the channel with the lowest
+*                          mean energy once all channels have been scanned,
+*                          0xFF if no energy could be measured. May be NULL.
+*
+* Returns:
+*      A boolean to indicate if the scan started. It does not while another
+*      scan is in progress or if no channel of the map is supported.
+*
+* Example:
+*      <code>
+*      MiApp_EdScanStart(0x000007FF, 5, edScanInd, edScanConf);
+*      </code>
+*
+* Remarks:
+*      The transceiver does not receive during a measurement, which takes
+*      8 symbols.
+*
+*****************************************************************************************/
+bool MiApp_EdScanStart(uint32_t ChannelMap, uint8_t ScanDuration,
+                       EdScanInd_callback_t IndCallback, EdScanConf_callback_t ConfCallback);
+
+/************************************************************************************
+* Function:
+*      void MiApp_EdScanStop(void)
+*
+* Summary:
+*      This function stops the background energy detection scan
+*
+* Description:
+*      The channels left are not scanned and no confirmation is given.
+*
+*****************************************************************************************/
+void MiApp_EdScanStop(void);
+#endif
+
 #define POWER_STATE_SLEEP       0x00
 #define POWER_STATE_WAKEUP      0x01
 #define POWER_STATE_WAKEUP_DR   0x02
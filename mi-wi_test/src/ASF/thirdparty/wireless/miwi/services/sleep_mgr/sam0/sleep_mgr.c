@@ -45,9 +45,16 @@
 #include "asf.h"
 #include "trx_access.h"
 #include "sysTimer.h"
+#include "miwi_config.h"
 
 /* Minimum sleep interval in milliseconds */
+#if defined(ENABLE_TICKLESS_IDLE)
+/* The stack asks for sleeps up to the next timer deadline, also when
+ * it is only a few system timer ticks away */
+#define MIN_SLEEP_INTERVAL     (2 * SYS_TIMER_INTERVAL)
+#else
 #define MIN_SLEEP_INTERVAL     (1000)
+#endif
 
 struct rtc_module rtc_instance;
 
@@ -46,6 +46,8 @@
 #include "sal.h"
 #include "phy.h"
 #include "mimac_at86rf.h"
+#include "mimac_header.h"
+#include "mimac_ccm.h"
 
 #if defined(ENABLE_NETWORK_FREEZER)
 #include "pdsDataServer.h"
@@ -55,8 +57,7 @@
 	const char mySecurityKey[16] = {SECURITY_KEY_00, SECURITY_KEY_01, SECURITY_KEY_02, SECURITY_KEY_03, SECURITY_KEY_04,
 		SECURITY_KEY_05, SECURITY_KEY_06, SECURITY_KEY_07, SECURITY_KEY_08, SECURITY_KEY_09, SECURITY_KEY_10, SECURITY_KEY_11,
 	SECURITY_KEY_12, SECURITY_KEY_13, SECURITY_KEY_14, SECURITY_KEY_15};
-	uint8_t final_mic_value[16] , CBC_mic[16] , CTR_mic[16];
-	uint8_t InitVect_in[16];
+	uint8_t final_mic_value[CCM_MIC_MAX_LENGTH];
 
 	const uint8_t myKeySequenceNumber = KEY_SEQUENCE_NUMBER; // The sequence number of security key. Used to identify the security key
 
@@ -73,13 +74,46 @@ MACINIT_PARAM MACInitParams;
 uint8_t BankIndex = 0xFF;
 // Mic Size is 4 bytes.
 uint8_t calculated_mic_values[AES_BLOCKSIZE/4];
-uint8_t received_mic_values[AES_BLOCKSIZE/4];
+uint8_t received_mic_values[CCM_MIC_MAX_LENGTH];
+
+/* Transmit pipeline. A frame is built (header, CCM*) into the slot of its
+ * sequence number while the previous one still waits for its
+ * acknowledgement, and goes to the transceiver on that confirmation.
+ * Confirmations are reported in sequence number order. */
+#if !MIMAC_TX_PIPELINE_DEPTH || (MIMAC_TX_PIPELINE_DEPTH & (MIMAC_TX_PIPELINE_DEPTH - 1))
+#error "MIMAC_TX_PIPELINE_DEPTH must be a power of two"
+#endif
+#define MAC_TX_SLOT(seq)        ((seq) & (MIMAC_TX_PIPELINE_DEPTH - 1))
+
+typedef enum
+{
+	MAC_TX_SLOT_FREE = 0,
+	MAC_TX_SLOT_PREPARED,
+	MAC_TX_SLOT_SUBMITTED,
+	MAC_TX_SLOT_CONFIRMED
+} MacTxSlotState_t;
 
-bool dataConfAvailable = 0;
-miwi_status_t dataStatus;
-uint8_t dataHandle = 0;
-uint8_t* dataPointer = NULL;
-DataConf_callback_t dataConfCallback = NULL;
+typedef struct
+{
+	uint8_t packet[128];
+	uint8_t *payload;
+	DataConf_callback_t confCallback;
+	uint8_t handle;
+	uint8_t state;
+	miwi_status_t status;
+	uint8_t txPowerReduction;
+	uint16_t txSpacing;
+	MIWI_TICK submitTick;   // earliest time the frame may go to the PHY
+} MacTxSlot_t;
+
+static MacTxSlot_t macTxSlots[MIMAC_TX_PIPELINE_DEPTH];
+/* Oldest frame not reported yet, oldest frame not confirmed by the PHY */
+static uint8_t macTxDoneSeq;
+static uint8_t macTxConfSeq;
+/* Spacing of the last frame on air */
+static uint32_t macTxSpacing;
+
+static void macTxSubmit(void);
 /************************************************************************************
  * Function:
  *      bool MiMAC_SetAltAddress(uint8_t *Address, uint8_t *PANID)
@@ -129,86 +163,46 @@ bool MiMAC_SetAltAddress( uint8_t *Address,  uint8_t *PanId)
 }
 
 #if defined (ENABLE_SECURITY)
-uint8_t addr[8] = {0xda , 0x98 , 0x22 , 0xfe , 0xff , 0xa3 , 0x04 , 0x00};
-void mic_generator (uint8_t *Payloadinfo, uint8_t len , uint8_t frame_control ,  API_UINT32_UNION FrameCounter ,  uint8_t *SourceIEEEAddress)
+/************************************************************************************
+ * Builds the CCM* nonce (source address, frame counter, security level) and
+ * the authenticated data (frame control, frame counter, source address) of a
+ * secured MiWi frame.
+ *****************************************************************************************/
+static void secureFrameParams(uint8_t *nonce, uint8_t *aData, uint8_t FrameControl,
+	API_UINT32_UNION FrameCounter, uint8_t *SourceIEEEAddress)
 {
-	uint8_t i , j , iterations  , copy_packet1[128] , cbc_header_with_padding[16];
-	// Calculating No of blocks in the packet (1 block = 16 bytes of data)
-	iterations = len/16;
-	if (len % 16 != 0) iterations++;
-	InitVect_in[0] = 0x49;//frame_control;
-	cbc_header_with_padding[0] = 0x00;  // l(a)
-	cbc_header_with_padding[1] = 0x0d;  // l(a)Header Length
-	cbc_header_with_padding[2] = frame_control;  //frame_control;  //byte 1
-	for (i=0;i<8;i++)
-	{
-		InitVect_in[i+1] =  SourceIEEEAddress[i];
-		cbc_header_with_padding[i+7] = SourceIEEEAddress[i];
-	}
-	for (i=0;i<4;i++)
-	{
-		InitVect_in[i+9] = FrameCounter.v[i];
-		cbc_header_with_padding[i+3] = FrameCounter.v[i];
-	}
-	//cbc_header_with_padding[14] = 0x00;  // Padding
-	cbc_header_with_padding[15] = 0x00;   // Padding
-	InitVect_in[13] = SECURITY_LEVEL; //Security Mode // 0x04 --> CCM-32
-	InitVect_in[14] = 0x00; // 15 th byte padded to zero
-	InitVect_in[15] = len; // For MIC calculation All preceding blocks will be incremented by 1
-	PHY_EncryptReq(&InitVect_in[0], (uint8_t *)mySecurityKey);
-	for (i=0;i<16;i++)
-	{
-		copy_packet1[i] = cbc_header_with_padding[i];
-	}
-	// Copy the Payload and Do the padding
-	for (i=16;i<len+16;i++)
-	{
-		copy_packet1[i]	= Payloadinfo[i-16];  // Copying the Payload
-	}
-	for (i=len+16;i<(iterations *16) + 16 ; i++ )
-	{
-		copy_packet1[i] = 0; // Padding
-	}
-	for (i=0;i<iterations+1;i++)
-	{
-		for (j=0;j<16;j++)
-		{
-			InitVect_in[j]	= InitVect_in[j] ^ copy_packet1[j+(i*16)];
-		}
-		PHY_EncryptReq(&InitVect_in[0], (uint8_t *)mySecurityKey);
-	}
-	for (i=0;i<16;i++)
-	{
-		CBC_mic[i] = InitVect_in[i];
-	}
+	memcpy(&nonce[0], SourceIEEEAddress, 8);
+	memcpy(&nonce[8], FrameCounter.v, 4);
+	nonce[12] = SECURITY_LEVEL;
 
+	aData[0] = FrameControl;
+	memcpy(&aData[1], FrameCounter.v, 4);
+	memcpy(&aData[5], SourceIEEEAddress, 8);
 }
 
 /************************************************************************************
  * Function:
- *      bool DataEncrypt( uint8_t *key, uint8_t *Payload, uint8_t *PayloadLen,
+ *      bool DataEncrypt( uint8_t *Payload, uint8_t *PayloadLen,
  *                        API_UINT32_UNION FrameCounter, uint8_t FrameControl )
  *
  * Summary:
- *      This function decrypt received secured frame
+ *      This function encrypts a frame to transmit
  *
  * Description:
- *      This is the function to encrypt the transmitting packet. All parameters are
- *      input information used in the encryption process. After encryption is
- *      performed successfully, the result will be put into the buffer that is
- *      pointed by input parameter "Payload" and the parameter "PayloadLen" will
- *      also be updated.
+ *      This is the function to encrypt the transmitting packet with CCM*. All
+ *      parameters are input information used in the encryption process. After
+ *      encryption is performed successfully, the result will be put into the
+ *      buffer that is pointed by input parameter "Payload" and the MIC into
+ *      final_mic_value.
  *
  * PreCondition:
  *      Transceiver initialization has been done.
  *
  * Parameters:
- *      uint8_t * Key          - Security Key used to decrypt packet
  *      uint8_t * Payload      - Pointer to the the input plain payload and output
  *                            encrypted payload
  *      uint8_t * PayloadLen   - Pointer to the length of input plain payload and
  *                            output encrypted payload
- *      uint8_t * DestIEEEAddress      - The IEEE address of the packet target
  *      API_UINT32_UNION FrameCounter      - Frame counter of the transmitting packet
  *      uint8_t FrameControl   - The frame control byte of the transmitting packet
  *
@@ -217,7 +211,7 @@ void mic_generator (uint8_t *Payloadinfo, uint8_t len , uint8_t frame_control ,
  *
  * Example:
  *      <code>
- *      DataEncrypt(key, payload, &payloadLen, FrameCounter, FrameControl);
+ *      DataEncrypt(payload, &payloadLen, FrameCounter, FrameControl);
  *      </code>
  *
  * Remarks:
@@ -228,77 +222,16 @@ void mic_generator (uint8_t *Payloadinfo, uint8_t len , uint8_t frame_control ,
 bool DataEncrypt(uint8_t *Payloadinfo, uint8_t *Payload_len, API_UINT32_UNION FrameCounter,
 uint8_t FrameControl)
 {
-	uint8_t i , iterations , block[16] , j , CTR_Nonce_and_Counter[16], CipheringData[CALC_SEC_PAYLOAD_SIZE(TX_BUFFER_SIZE)];
-	// Calculating No of blocks in the packet (1 block = 16 bytes of data)
-	iterations = *Payload_len/16;
-	if (*Payload_len % 16 != 0) iterations++;
-
-    // Copy payload for security processing 
-	memcpy(CipheringData, Payloadinfo, *Payload_len);
-
-	mic_generator(&Payloadinfo[0] , *Payload_len, FrameControl  , FrameCounter ,  MACInitParams.PAddress);
-
-	for (i=*Payload_len;i<iterations *16 ; i++ )
-	{
-		CipheringData[i] = 0; // Padding
-	}
-	CTR_Nonce_and_Counter[0] = 0x01;  // L
-	for (i=0;i<8;i++)
-	{
-		CTR_Nonce_and_Counter[i+1] = MACInitParams.PAddress[i];
-	}
-	for (i=0;i<4;i++)
-	{
-		CTR_Nonce_and_Counter[i+9] = FrameCounter.v[i];
-	}
-	CTR_Nonce_and_Counter[13] = SECURITY_LEVEL; //Security Mode // 0x04 --> CCM-32
-	CTR_Nonce_and_Counter[14] = 0x00; // 15 th byte padded to zero
-	CTR_Nonce_and_Counter[15] = 0x00; // For MIC calculation All preceding blocks will be incremented by 1
-
-	for (i=0;i<iterations+1;i++)
-	{
-		for (j=0;j<16;j++)
-		{
-			block[j] = CTR_Nonce_and_Counter[j];
-		}
-		PHY_EncryptReq(&block[0], (uint8_t *)mySecurityKey);
-		for (j=0;j<16;j++)
-		{
-			if (CTR_Nonce_and_Counter[15] == 0)
-			{
-				final_mic_value[j] = block[j] ^ CBC_mic[j]; // CTR_MIC XOR CBC_MIC gives final MIC values
-			}
-			else
-			{
-				CipheringData[j+(i-1)*16] = block[j] ^ CipheringData[j+(i-1)*16];
-			}
-		}
-		CTR_Nonce_and_Counter[15]++; // Increment Counter for next operation
-	}
-
-    // Copy back the decrypted payload after security processing 
-	memcpy(Payloadinfo, CipheringData, *Payload_len);
-
-	return true;
+	uint8_t nonce[CCM_NONCE_LENGTH], aData[13];
 
+	secureFrameParams(nonce, aData, FrameControl, FrameCounter, MACInitParams.PAddress);
+	return MiMAC_CcmEncrypt((uint8_t *)mySecurityKey, nonce, aData, sizeof(aData),
+		Payloadinfo, *Payload_len, final_mic_value, MIC_SIZE);
 }
-// Validates the Received mic with the mic computed from data packet decryption.
-bool validate_mic(void)
-{
-	if (final_mic_value[0] != received_mic_values[0] || final_mic_value[1] != received_mic_values[1])
-	{
-		return false;
-	}
-	else
-	{
-		return true;
-	}
-}
-
 
 /************************************************************************************
  * Function:
- *      bool DataDecrypt( uint8_t *key, uint8_t *Payload, uint8_t *PayloadLen,
+ *      bool DataDecrypt( uint8_t *Payload, uint8_t *PayloadLen,
  *                        uint8_t *SourceIEEEAddress, API_UINT32_UNION FrameCounter,
  *                        uint8_t FrameControl )
  *
@@ -306,21 +239,21 @@ bool validate_mic(void)
  *      This function decrypt received secured frame
  *
  * Description:
- *      This is the function to decrypt the secured packet. All parameters are
- *      input information used in the decryption process. After decryption is
- *      performed successfully, the result will be put into the buffer that is
- *      pointed by input parameter "Payload" and the parameter "PayloadLen" will
- *      also be updated.
+ *      This is the function to decrypt the secured packet with CCM*. All
+ *      parameters are input information used in the decryption process. After
+ *      decryption is performed successfully, the result will be put into the
+ *      buffer that is pointed by input parameter "Payload" and the parameter
+ *      "PayloadLen" will also be updated. The MIC is compared with
+ *      received_mic_values.
  *
  * PreCondition:
  *      Transceiver initialization has been done.
  *
  * Parameters:
- *      uint8_t * Key          - Security Key used to decrypt packet
  *      uint8_t * Payload      - Pointer to the the input secured payload and output
  *                            decrypted payload
- *      uint8_t * PayloadLen   - Pointer to the length of input secured payload and
- *                            output decrypted payload
+ *      uint8_t * PayloadLen   - Pointer to the length of input secured payload,
+ *                            including the MIC, and output decrypted payload
  *      uint8_t * SourceIEEEAddress    - The IEEE address of the package originator
  *      API_UINT32_UNION FrameCounter      - Frame counter of the received packet
  *      uint8_t FrameControl   - The frame control byte of the received packet
@@ -330,7 +263,7 @@ bool validate_mic(void)
  *
  * Example:
  *      <code>
- *      DataDecrypt(key, payload, &payloadLen, SourceIEEEAddr, FrameCounter, FrameControl);
+ *      DataDecrypt(payload, &payloadLen, SourceIEEEAddr, FrameCounter, FrameControl);
  *      </code>
  *
  * Remarks:
@@ -340,66 +273,16 @@ bool validate_mic(void)
 bool DataDecrypt(uint8_t *Payload, uint8_t *PayloadLen, uint8_t *SourceIEEEAddress,
 API_UINT32_UNION FrameCounter, uint8_t FrameControl)
 {
-	uint8_t i , iterations , block[16] , j , CTR_Nonce_and_Counter[16], CipheringData[CALC_SEC_PAYLOAD_SIZE(RX_BUFFER_SIZE)];
-	// Calculating No of blocks in the packet (1 block = 16 bytes of data)
-	iterations = *PayloadLen/16;
-	if (*PayloadLen % 16 != 0) iterations++;
-
-	// Copy payload for security processing 
-	memcpy(CipheringData, Payload, *PayloadLen);
-
-	//mic_generator(&Payloadinfo[0] , *Payload_len);
-
-	for (i=*PayloadLen;i<iterations *16 ; i++ )
-	{
-		CipheringData[i] = 0; // Padding
-	}
-	CTR_Nonce_and_Counter[0] = 0x01;  // L
-	for (i=0;i<8;i++)
-	{
-		CTR_Nonce_and_Counter[i+1] = SourceIEEEAddress[i];
-	}
-	for (i=0;i<4;i++)
-	{
-		CTR_Nonce_and_Counter[i+9] = FrameCounter.v[i];
-	}
-	CTR_Nonce_and_Counter[13] = SECURITY_LEVEL; //Security Mode
-	CTR_Nonce_and_Counter[14] = 0x00; // 15 th byte padded to zero
-	CTR_Nonce_and_Counter[15] = 0x00; // For MIC calculation All preceding blocks will be incremented by 1
-
+	uint8_t nonce[CCM_NONCE_LENGTH], aData[13];
 
-	for (i=0;i<iterations+1;i++)
-	{
-		for (j=0;j<16;j++)
-		{
-			block[j] = CTR_Nonce_and_Counter[j];
-		}
-		PHY_EncryptReq(&block[0], (uint8_t *)mySecurityKey);
-		for (j=0;j<16;j++)
-		{
-			if (CTR_Nonce_and_Counter[15] == 0)
-			{
-				CTR_mic[j] = block[j]; // CTR_MIC XOR CBC_MIC gives final MIC values
-			}
-			else
-			{
-				CipheringData[j+(i-1)*16] = block[j] ^ CipheringData[j+(i-1)*16];
-			}
-		}
-		CTR_Nonce_and_Counter[15]++; // Increment Counter for next opration
-	}
-	*PayloadLen = *PayloadLen-4;
-	mic_generator(&CipheringData[0] , *PayloadLen , FrameControl  , FrameCounter , SourceIEEEAddress);
-	for (i=0;i<16;i++)
+	if (*PayloadLen < MIC_SIZE)
 	{
-		final_mic_value[i] = CTR_mic[i] ^ CBC_mic[i];
+		return false;
 	}
-
-	// Copy back the decrypted payload after security processing 
-	memcpy(Payload, CipheringData, *PayloadLen);
-
-	return validate_mic();
-
+	*PayloadLen = *PayloadLen - MIC_SIZE;
+	secureFrameParams(nonce, aData, FrameControl, FrameCounter, SourceIEEEAddress);
+	return MiMAC_CcmDecrypt((uint8_t *)mySecurityKey, nonce, aData, sizeof(aData),
+		Payload, *PayloadLen, received_mic_values, MIC_SIZE);
 }
 #endif
 
@@ -561,12 +444,18 @@ bool MiMAC_Init(MACINIT_PARAM initValue)
 {
 	uint8_t i;
 
-	PHY_Init();
+	if (!PHY_Init())
+	{
+		return false;
+	}
 	MACInitParams = initValue;
 	uint16_t x =  PHY_RandomReq();
 	// Set RF mode
 	PHY_SetRxState(true);
 	IEEESeqNum =   x & 0xff;
+	macTxDoneSeq = IEEESeqNum;
+	macTxConfSeq = IEEESeqNum;
+	memset(macTxSlots, 0, sizeof(macTxSlots));
 
 	// Set Node Address
 	PHY_SetIEEEAddr(MACInitParams.PAddress);
@@ -574,6 +463,7 @@ bool MiMAC_Init(MACINIT_PARAM initValue)
 	for (i = 0; i < BANK_SIZE; i++)
 	{
 		RxBuffer[i].PayloadLen = 0;
+		RxBuffer[i].RefCount = 0;
 	}
 	#ifdef ENABLE_SECURITY
 		#if defined(ENABLE_NETWORK_FREEZER)
@@ -630,10 +520,11 @@ bool MiMAC_Init(MACINIT_PARAM initValue)
      *      </code>
      *
      * Remarks:
-     *      None
+     *      The frame is prepared right away, up to MIMAC_TX_PIPELINE_DEPTH
+     *      frames can wait for their confirmation. FALSE is returned if
+     *      none of them is free.
      *
      *****************************************************************************************/
-uint8_t packet[128];//temp buffer
 bool MiMAC_SendPacket( MAC_TRANS_PARAM transParam,
          uint8_t *MACPayload,
          uint8_t MACPayloadLen, uint8_t msghandle,
@@ -643,11 +534,17 @@ bool MiMAC_SendPacket( MAC_TRANS_PARAM transParam,
     uint8_t loc = 0;
     uint8_t i = 0;
 	uint8_t frameControl = 0;
-	PHY_DataReq_t phyDataRequest;
+	uint8_t dstMode, srcMode;
+	const MAC_HEADER_LAYOUT *layout;
+	MacTxSlot_t *slot;
+	uint8_t *packet;
 
-	#ifndef TARGET_SMALL
-		bool IntraPAN;
-	#endif
+    if ((uint8_t)(IEEESeqNum - macTxDoneSeq) >= MIMAC_TX_PIPELINE_DEPTH)
+    {
+        return false;
+    }
+    slot = &macTxSlots[MAC_TX_SLOT(IEEESeqNum)];
+    packet = slot->packet;
 
     if (transParam.flags.bits.broadcast)
     {
@@ -670,58 +567,39 @@ bool MiMAC_SendPacket( MAC_TRANS_PARAM transParam,
         frameControl = 0x01;
     }
 
-    // decide the header length for different addressing mode
+    // decide the addressing modes, the header layout follows from them
 #ifndef TARGET_SMALL
     if ((transParam.DestPANID.Val == MAC_PANID.Val) && (MAC_PANID.Val != 0xFFFF)) // this is intraPAN
 #endif
     {
-        headerLength = 5;
-        frameControl |= 0x40;
-#ifndef TARGET_SMALL
-        IntraPAN = true;
-#endif
+        frameControl |= MAC_FCF_PANID_COMP;
     }
-#ifndef TARGET_SMALL
-    else
-    {
-        headerLength = 7;
-        IntraPAN = false;
-    }
-#endif
+    dstMode = transParam.altDestAddr ? MAC_ADDR_MODE_SHORT : MAC_ADDR_MODE_LONG;
+    srcMode = transParam.altSrcAddr ? MAC_ADDR_MODE_SHORT : MAC_ADDR_MODE_LONG;
 
-    if (transParam.altDestAddr)
-    {
-        headerLength += 2;
-    } else
-    {
-        headerLength += 8;
-    }
-
-    if (transParam.altSrcAddr)
-    {
-        headerLength += 2;
-    } else
+    if (transParam.flags.bits.ackReq && transParam.flags.bits.broadcast == false)
     {
-        headerLength += 8;
+        frameControl |= 0x20;
     }
 
-    if (transParam.flags.bits.ackReq && transParam.flags.bits.broadcast == false)
+    if (transParam.framePending)
     {
-        frameControl |= 0x20;
+        frameControl |= MAC_FCF_FRAME_PENDING;
     }
 
     // use PACKET_TYPE_RESERVE to represent beacon. Fixed format for beacon packet
     if (transParam.flags.bits.packetType == PACKET_TYPE_RESERVE)
     {
         frameControl = 0x00;
-        headerLength = 7;
-#if !defined(TARGET_SMALL)
-        IntraPAN = false;
-#endif
+        dstMode = MAC_ADDR_MODE_NONE;
+        srcMode = MAC_ADDR_MODE_SHORT;
         transParam.altSrcAddr = true;
         transParam.flags.bits.ackReq = false;
     }
 
+    layout = &MACHeaderLayout[MAC_HEADER_INDEX(frameControl, (srcMode << 6) | (dstMode << 2))];
+    headerLength = layout->headerLength;
+
 #ifdef ENABLE_SECURITY
     if (transParam.flags.bits.secEn)
     {
@@ -742,81 +620,46 @@ bool MiMAC_SendPacket( MAC_TRANS_PARAM transParam,
 		packet[loc++] = MACPayloadLen+headerLength;
     }
 
-    // set frame control LSB
+    // set frame control
 	packet[loc++] = frameControl;
+	packet[loc++] = (srcMode << 6) | (dstMode << 2);
 
-    // set frame control MSB
-    if (transParam.flags.bits.packetType == PACKET_TYPE_RESERVE)
-    {
-		packet[loc++] = 0x80;
-        // sequence number
-		packet[loc++] = IEEESeqNum++;
-    } else
-    {
-        if (transParam.altDestAddr && transParam.altSrcAddr)
-        {
-			packet[loc++] = 0x88;
-
-        } else if (transParam.altDestAddr && transParam.altSrcAddr == 0)
-        {
-			packet[loc++] = 0xC8;
-        } else if (transParam.altDestAddr == 0 && transParam.altSrcAddr == 1)
-        {
-			packet[loc++] = 0x8C;
-        } else
-        {
-			packet[loc++] = 0xCC;
-        }
+    // sequence number
+	packet[loc++] = IEEESeqNum++;
 
-        // sequence number
-		packet[loc++] = IEEESeqNum++;
-
-        // destination PANID
-		packet[loc++] = transParam.DestPANID.v[0];
-		packet[loc++] = transParam.DestPANID.v[1];
-
-        // destination address
+    // destination PANID and address, the header starts after the length
+    if (layout->dstAddrOffset)
+    {
+		packet[1 + layout->dstPanIdOffset] = transParam.DestPANID.v[0];
+		packet[1 + layout->dstPanIdOffset + 1] = transParam.DestPANID.v[1];
         if (transParam.flags.bits.broadcast)
         {
-			packet[loc++] = 0xFF;
-			packet[loc++] = 0xFF;
+			packet[1 + layout->dstAddrOffset] = 0xFF;
+			packet[1 + layout->dstAddrOffset + 1] = 0xFF;
         } else
         {
-            if (transParam.altDestAddr)
-            {
-				packet[loc++] = transParam.DestAddress[0];
-				packet[loc++] = transParam.DestAddress[1];
-            } else
-            {
-                for (i = 0; i < 8; i++)
-                {
-					packet[loc++] = transParam.DestAddress[i];
-                }
-            }
+			memcpy(&packet[1 + layout->dstAddrOffset], transParam.DestAddress, MAC_ADDR_LEN(dstMode));
         }
     }
 
-#ifndef TARGET_SMALL
-    // source PANID if necessary
-    if (IntraPAN == false)
+    // source PANID if not compressed
+    if (layout->srcAddrOffset && (layout->srcPanIdOffset != layout->dstPanIdOffset))
     {
-		packet[loc++] = MAC_PANID.v[0];
-		packet[loc++] = MAC_PANID.v[1];
+		packet[1 + layout->srcPanIdOffset] = MAC_PANID.v[0];
+		packet[1 + layout->srcPanIdOffset + 1] = MAC_PANID.v[1];
     }
-#endif
 
     // source address
     if (transParam.altSrcAddr)
     {
-		packet[loc++] = myNetworkAddress.v[0];
-		packet[loc++] = myNetworkAddress.v[1];
+		packet[1 + layout->srcAddrOffset] = myNetworkAddress.v[0];
+		packet[1 + layout->srcAddrOffset + 1] = myNetworkAddress.v[1];
     } else
     {
-        for (i = 0; i < 8; i++)
-        {
-			packet[loc++] = MACInitParams.PAddress[i];
-        }
+		memcpy(&packet[1 + layout->srcAddrOffset], MACInitParams.PAddress, 8);
     }
+    loc = 1 + headerLength;
+
 #ifdef ENABLE_SECURITY
 if (transParam.flags.bits.secEn)
 {
@@ -867,19 +710,46 @@ if (transParam.flags.bits.secEn)
         i = 0x01;
     }
 
-    dataPointer = MACPayload;
-	dataConfCallback = ConfCallback;
-    dataHandle = msghandle;
+    slot->payload = MACPayload;
+    slot->confCallback = ConfCallback;
+    slot->handle = msghandle;
+    slot->txPowerReduction = transParam.txPowerReduction;
+    slot->txSpacing = transParam.txSpacing;
+    slot->state = MAC_TX_SLOT_PREPARED;
 
-    phyDataRequest.polledConfirmation = false;
-    phyDataRequest.confirmCallback = PHY_DataConf;
-    phyDataRequest.data = packet;
-
-    // Now Trigger the Transmission of packet
-    PHY_DataReq(&phyDataRequest);
+    // Trigger the transmission if the transceiver is not busy with a previous frame
+    macTxSubmit();
     return true;
 }
 
+/* Hands the oldest prepared frame to the PHY once the previous one is
+ * confirmed and its spacing has passed, so the PHY holds a single frame
+ * of the pipeline at a time. MiMAC_Task retries a frame held back. */
+static void macTxSubmit(void)
+{
+	MacTxSlot_t *slot = &macTxSlots[MAC_TX_SLOT(macTxConfSeq)];
+	PHY_DataReq_t phyDataRequest;
+	uint32_t remaining;
+
+	if ((macTxConfSeq == IEEESeqNum) || (MAC_TX_SLOT_PREPARED != slot->state))
+	{
+		return;
+	}
+	/* Modulo 2^32, a submit tick further ahead than a spacing has passed */
+	remaining = (uint32_t)(slot->submitTick.Val - MiWi_TickGet());
+	if ((0 != remaining) && (remaining <= macTxSpacing))
+	{
+		return;
+	}
+	slot->state = MAC_TX_SLOT_SUBMITTED;
+
+	phyDataRequest.polledConfirmation = false;
+	phyDataRequest.confirmCallback = PHY_DataConf;
+	phyDataRequest.data = slot->packet;
+	phyDataRequest.txPowerReduction = slot->txPowerReduction;
+	PHY_DataReq(&phyDataRequest);
+}
+
 /************************************************************************************
  * Function:
  *      void MiMAC_DiscardPacket(void)
@@ -918,12 +788,93 @@ if (transParam.flags.bits.secEn)
 void MiMAC_DiscardPacket(void)
 {
 	//re-enable buffer for next packets
-	if (BankIndex < BANK_SIZE)
+	if ((BankIndex < BANK_SIZE) && (0 == RxBuffer[BankIndex].RefCount))
 	{
 		RxBuffer[BankIndex].PayloadLen = 0;
 	}
 }
 
+/************************************************************************************
+ * Function:
+ *      bool MiMAC_RetainPacket(uint8_t handle)
+ *
+ * Summary:
+ *      This function adds a reference to a received packet
+ *
+ * Description:
+ *      The bank is skipped by MiMAC_ReceivedPacket, MiMAC_DiscardPacket and the
+ *      PHY until every reference is given back with MiMAC_ReleasePacket.
+ *
+ * PreCondition:
+ *      A packet has been received, MiMAC_ReceivedPacket returned true.
+ *
+ * Parameters:
+ *      uint8_t handle - MACRxPacket.Handle of the packet
+ *
+ * Returns:
+ *      false if the bank does not hold a packet anymore.
+ *
+ * Remarks:
+ *      None
+ *
+ *****************************************************************************************/
+bool MiMAC_RetainPacket(uint8_t handle)
+{
+	irqflags_t flags;
+	bool retained = false;
+
+	if (handle < BANK_SIZE)
+	{
+		flags = cpu_irq_save();
+		if ((RxBuffer[handle].PayloadLen > 0) && (RxBuffer[handle].RefCount < UINT8_MAX))
+		{
+			RxBuffer[handle].RefCount++;
+			retained = true;
+		}
+		cpu_irq_restore(flags);
+	}
+	return retained;
+}
+
+/************************************************************************************
+ * Function:
+ *      void MiMAC_ReleasePacket(uint8_t handle)
+ *
+ * Summary:
+ *      This function gives back a reference taken by MiMAC_RetainPacket
+ *
+ * Description:
+ *      The bank takes the next packet from the PHY once the last reference
+ *      is released.
+ *
+ * PreCondition:
+ *      MiMAC initialization has been done.
+ *
+ * Parameters:
+ *      uint8_t handle - MACRxPacket.Handle of the packet
+ *
+ * Returns:
+ *      None
+ *
+ * Remarks:
+ *      May be called from interrupt context.
+ *
+ *****************************************************************************************/
+void MiMAC_ReleasePacket(uint8_t handle)
+{
+	irqflags_t flags;
+
+	if (handle < BANK_SIZE)
+	{
+		flags = cpu_irq_save();
+		if ((RxBuffer[handle].RefCount > 0) && (0 == --RxBuffer[handle].RefCount))
+		{
+			RxBuffer[handle].PayloadLen = 0;
+		}
+		cpu_irq_restore(flags);
+	}
+}
+
 /************************************************************************************
  * Function:
  *      bool MiMAC_ReceivedPacket(void)
@@ -968,7 +919,7 @@ bool MiMAC_ReceivedPacket(void)
 	BankIndex = 0xFF;
 	for (i = 0; i < BANK_SIZE; i++)
 	{
-		if (RxBuffer[i].PayloadLen > 0)
+		if ((RxBuffer[i].PayloadLen > 0) && (0 == RxBuffer[i].RefCount))
 		{
 			BankIndex = i;
 			break;
@@ -978,172 +929,15 @@ bool MiMAC_ReceivedPacket(void)
 	if (BankIndex < BANK_SIZE)
 	{
 		uint8_t addrMode;
-		#ifndef TARGET_SMALL
-		bool bIntraPAN = true;
 
-		if ((RxBuffer[BankIndex].Payload[0] & 0x40) == 0)
-		{
-			bIntraPAN = false;
-		}
-		#endif
 		MACRxPacket.flags.Val = 0;
-		MACRxPacket.altSourceAddress = false;
-		MACRxPacket.SourcePANID.Val = 0xFFFF;
 
-		//Determine the start of the MAC payload
+		//Determine the addresses and the start of the MAC payload, without
+		//FCS, LQI and RSSI at the end of the buffer
 		addrMode = RxBuffer[BankIndex].Payload[1] & 0xCC;
-		switch (addrMode)
+		if ((RxBuffer[BankIndex].PayloadLen < 4) ||
+			!MiMAC_HeaderParse(RxBuffer[BankIndex].Payload, RxBuffer[BankIndex].PayloadLen - 4, &MACRxPacket))
 		{
-			case 0xC8: //short dest, long source
-			// for P2P only broadcast allows short destination address
-			if (RxBuffer[BankIndex].Payload[5] == 0xFF && RxBuffer[BankIndex].Payload[6] == 0xFF)
-			{
-				MACRxPacket.flags.bits.broadcast = 1;
-			}
-			MACRxPacket.flags.bits.sourcePrsnt = 1;
-
-			#ifndef TARGET_SMALL
-			if (bIntraPAN) // check if it is intraPAN
-			#endif
-			{
-				#ifndef TARGET_SMALL
-				MACRxPacket.SourcePANID.v[0] = RxBuffer[BankIndex].Payload[3];
-				MACRxPacket.SourcePANID.v[1] = RxBuffer[BankIndex].Payload[4];
-				#endif
-				MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[7]);
-
-				MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 19;
-				MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[15]);
-			}
-			#ifndef TARGET_SMALL
-			else
-			{
-				MACRxPacket.SourcePANID.v[0] = RxBuffer[BankIndex].Payload[7];
-				MACRxPacket.SourcePANID.v[1] = RxBuffer[BankIndex].Payload[8];
-				MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[9]);
-				MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 21;
-				MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[17]);
-			}
-			#endif
-
-			break;
-
-			case 0xCC: // long dest, long source
-			MACRxPacket.flags.bits.sourcePrsnt = 1;
-			#ifndef TARGET_SMALL
-			if (bIntraPAN) // check if it is intraPAN
-			#endif
-			{
-				//rxFrame.flags.bits.intraPAN = 1;
-				#ifndef TARGET_SMALL
-				MACRxPacket.SourcePANID.v[0] = RxBuffer[BankIndex].Payload[3];
-				MACRxPacket.SourcePANID.v[1] = RxBuffer[BankIndex].Payload[4];
-				#endif
-				MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[13]);
-				MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 25;
-				MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[21]);
-			}
-			#ifndef TARGET_SMALL
-			else
-			{
-				MACRxPacket.SourcePANID.v[0] = RxBuffer[BankIndex].Payload[13];
-				MACRxPacket.SourcePANID.v[1] = RxBuffer[BankIndex].Payload[14];
-				MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[15]);
-				MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 27;
-				MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[23]);
-			}
-			#endif
-			break;
-
-			case 0x80: // short source only. used in beacon
-			{
-				MACRxPacket.flags.bits.broadcast = 1;
-				MACRxPacket.flags.bits.sourcePrsnt = 1;
-				MACRxPacket.altSourceAddress = true;
-				MACRxPacket.SourcePANID.v[0] = RxBuffer[BankIndex].Payload[3];
-				MACRxPacket.SourcePANID.v[1] = RxBuffer[BankIndex].Payload[4];
-				MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[5]);
-				MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 11;
-				MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[7]);
-			}
-			break;
-
-			case 0x88: // short dest, short source
-			{
-				if (RxBuffer[BankIndex].Payload[5] == 0xFF && RxBuffer[BankIndex].Payload[6] == 0xFF)
-				{
-					MACRxPacket.flags.bits.broadcast = 1;
-				}
-				MACRxPacket.flags.bits.sourcePrsnt = 1;
-				MACRxPacket.altSourceAddress = true;
-				#ifndef TARGET_SMALL
-				if (bIntraPAN == false)
-				{
-					MACRxPacket.SourcePANID.v[0] = RxBuffer[BankIndex].Payload[7];
-					MACRxPacket.SourcePANID.v[1] = RxBuffer[BankIndex].Payload[8];
-					MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[9]);
-					MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 15;
-					MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[11]);
-				} else
-				#endif
-				{
-					MACRxPacket.SourcePANID.v[0] = RxBuffer[BankIndex].Payload[3];
-					MACRxPacket.SourcePANID.v[1] = RxBuffer[BankIndex].Payload[4];
-					MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[7]);
-					MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 13;
-					MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[9]);
-				}
-			}
-			break;
-
-			case 0x8C: // long dest, short source
-			{
-				MACRxPacket.flags.bits.sourcePrsnt = 1;
-				MACRxPacket.altSourceAddress = true;
-				#ifndef TARGET_SMALL
-				if (bIntraPAN) // check if it is intraPAN
-				#endif
-				{
-					#ifndef TARGET_SMALL
-					MACRxPacket.SourcePANID.v[0] = RxBuffer[BankIndex].Payload[3];
-					MACRxPacket.SourcePANID.v[1] = RxBuffer[BankIndex].Payload[4];
-					#endif
-					#if defined(PROTOCOL_MESH)
-					MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[13]);
-					#else
-					MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[12]);
-					#endif
-
-					MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 19;
-					MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[15]);
-				}
-				#ifndef TARGET_SMALL
-				else
-				{
-					MACRxPacket.SourcePANID.v[0] = RxBuffer[BankIndex].Payload[12];
-					MACRxPacket.SourcePANID.v[1] = RxBuffer[BankIndex].Payload[13];
-					MACRxPacket.SourceAddress = &(RxBuffer[BankIndex].Payload[14]);
-					MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 21;
-					MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[17]);
-				}
-				#endif
-			}
-			break;
-
-
-			case 0x08: //dest-short, source-none
-			{
-				if (RxBuffer[BankIndex].Payload[5] == 0xFF && RxBuffer[BankIndex].Payload[6] == 0xFF)
-				{
-					MACRxPacket.flags.bits.broadcast = 1;
-				}
-				MACRxPacket.PayloadLen = RxBuffer[BankIndex].PayloadLen - 10;
-				MACRxPacket.Payload = &(RxBuffer[BankIndex].Payload[7]);
-			}
-			break;
-
-			// all other addressing mode will not be supported in P2P
-			default:
 			// not valid addressing mode or no addressing info
 			MiMAC_DiscardPacket();
 			return false;
@@ -1165,15 +959,7 @@ bool MiMAC_ReceivedPacket(void)
 			FrameCounter.v[2] = MACRxPacket.Payload[2];
 			FrameCounter.v[3] = MACRxPacket.Payload[3];
 
-			for (i = 0; i < CONNECTION_SIZE; i++)
-			{
-				if ((defaultParamsRomOrRam.ConnectionTable[i].status.bits.isValid) &&
-				isSameAddress(defaultParamsRomOrRam.ConnectionTable[i].Address, MACRxPacket.SourceAddress))
-				{
-					break;
-				}
-			}
-
+			i = connectionHashFind(MACRxPacket.SourceAddress, LONG_ADDR_LEN);
 			if (i < CONNECTION_SIZE)
 			{
 				if (IncomingFrameCounter[i].Val > FrameCounter.Val)
@@ -1235,6 +1021,8 @@ bool MiMAC_ReceivedPacket(void)
 		MACRxPacket.LQIValue = RxBuffer[BankIndex].Payload[RxBuffer[BankIndex].PayloadLen - 2];
 		MACRxPacket.RSSIValue = RxBuffer[BankIndex].Payload[RxBuffer[BankIndex].PayloadLen - 1];
 		#endif
+		MACRxPacket.Handle = BankIndex;
+		MACRxPacket.TimeStamp = RxBuffer[BankIndex].TimeStamp;
 
 		return true;
 	}
@@ -1285,6 +1073,28 @@ uint8_t MiMAC_ChannelAssessment(uint8_t AssessmentMode)
 	return 0;
 }
 
+#if defined(ENABLE_PHY_RX_IRQ)
+/************************************************************************************
+* Function:
+*      bool MiMAC_ChannelAssessmentStart(uint8_t AssessmentMode, uint8_t Channel,
+*                                        MiMAC_ChannelAssessmentConf_t ConfCallback)
+*
+* Summary:
+*      This function starts the noise detection on a channel
+*
+* Returns:
+*      A boolean to indicate if the detection started
+*****************************************************************************************/
+bool MiMAC_ChannelAssessmentStart(uint8_t AssessmentMode, uint8_t Channel, MiMAC_ChannelAssessmentConf_t ConfCallback)
+{
+	if ((AssessmentMode != CHANNEL_ASSESSMENT_ENERGY_DETECT) || (Channel > 26))
+	{
+		return false;
+	}
+	return PHY_EdStart(Channel, ConfCallback);
+}
+#endif
+
 /************************************************************************************
 * Function:
 *      uint32_t MiMAC_SymbolToTicks(uint32_t symbols)
@@ -1307,6 +1117,21 @@ uint32_t MiMAC_SymbolToTicks(uint32_t symbols)
 	return SYMBOLS_TO_TICKS(symbols);
 }
 
+/************************************************************************************
+* Function:
+*      bool MiMAC_TxPending(void)
+*
+* Summary:
+*      This function tells whether a frame waits to go to the transceiver
+*
+* Returns:
+*      true if a prepared frame waits, false otherwise.
+*****************************************************************************************/
+bool MiMAC_TxPending(void)
+{
+	return (macTxConfSeq != IEEESeqNum) && (MAC_TX_SLOT_PREPARED == macTxSlots[MAC_TX_SLOT(macTxConfSeq)].state);
+}
+
 /************************************************************************************
 * Function:
 *      uint32_t MiMAC_GetPHYChannelInfo(uint32_t supportedChannelMap)
@@ -1352,16 +1177,34 @@ uint32_t MiMAC_GetPHYChannelInfo(void)
  *****************************************************************************************/
 void PHY_DataConf(uint8_t status)
 {
-	dataStatus = (miwi_status_t)status;
-	dataConfAvailable = true;
+	MacTxSlot_t *slot = &macTxSlots[MAC_TX_SLOT(macTxConfSeq)];
+
+	slot->status = (miwi_status_t)status;
+	slot->state = MAC_TX_SLOT_CONFIRMED;
+	macTxSpacing = SYMBOLS_TO_TICKS((uint32_t)slot->txSpacing);
+	macTxConfSeq++;
+	// The frame after this one waits for the spacing, prepared or not yet,
+	// MiMAC_Task hands it to the PHY once the spacing has passed
+	macTxSlots[MAC_TX_SLOT(macTxConfSeq)].submitTick.Val = MiWi_TickGet() + macTxSpacing;
 }
 
 void MiMAC_Task(void)
 {
+  MacTxSlot_t *slot;
+
   PHY_TaskHandler();
-  if(dataConfCallback && dataConfAvailable)
+  macTxSubmit();
+  while (macTxDoneSeq != macTxConfSeq)
   {
-	  dataConfCallback(dataHandle, dataStatus, dataPointer);
-	  dataConfAvailable = false;
+	  slot = &macTxSlots[MAC_TX_SLOT(macTxDoneSeq)];
+	  DataConf_callback_t callback = slot->confCallback;
+
+	  // The slot is free before the callback, which may send again
+	  slot->state = MAC_TX_SLOT_FREE;
+	  macTxDoneSeq++;
+	  if (callback)
+	  {
+		  callback(slot->handle, slot->status, slot->payload);
+	  }
   }
 }
@@ -154,6 +154,9 @@
         } flags;
 
         uint8_t        *DestAddress;           // destination address
+        bool           framePending;           // more frames wait here for the destination
+        uint8_t        txPowerReduction;       // transmit power below the configured one, in steps of about 1 dB
+        uint16_t       txSpacing;              // idle time after the frame before the next one, in symbols
         #if defined(IEEE_802_15_4)
             bool                        altDestAddr;        // use the alternative network address as destination in the packet
             bool                        altSrcAddr;         // use the alternative network address as source in the packet
@@ -194,6 +197,9 @@
         uint8_t        PayloadLen;                         // Payload size
         uint8_t        RSSIValue;                          // RSSI value for the received packet
         uint8_t        LQIValue;                           // LQI value for the received packet
+        uint8_t        Handle;                             // Receive bank holding the packet, see MiMAC_RetainPacket
+        uint32_t       TimeStamp;                          // MiWi_TickGet() when the packet was received
+        bool           framePending;                       // the sender holds more frames for this device
         #if defined(IEEE_802_15_4)
             bool                    altSourceAddress;               // Source address is the alternative network address
             API_UINT16_UNION     SourcePANID;                    // PAN ID of the sender
@@ -232,6 +238,11 @@
 
     typedef enum mac_set_params mac_set_params_t;
 
+    /* Energy of the channel in dBm, see MiMAC_ChannelAssessmentStart */
+    typedef void (*MiMAC_ChannelAssessmentConf_t)(int8_t energy);
+    /* Energy reported when a frame was received during the measurement */
+    #define CHANNEL_ASSESSMENT_ENERGY_INVALID   PHY_ED_LEVEL_INVALID
+
     /************************************************************************************
      * Function:
      *      bool MiMAC_Set(mac_set_params_t id, uint8_t *value);
@@ -413,6 +424,42 @@
      *****************************************************************************************/
     uint8_t MiMAC_ChannelAssessment(uint8_t AssessmentMode);
 
+#if defined(ENABLE_PHY_RX_IRQ)
+    /************************************************************************************
+     * Function:
+     *      bool MiMAC_ChannelAssessmentStart(uint8_t AssessmentMode, uint8_t Channel,
+     *                                        MiMAC_ChannelAssessmentConf_t ConfCallback)
+     *
+     * Summary:
+     *      This function starts the noise detection on a channel
+     *
+     * Description:
+     *      This is the MiMAC interface for the protocol layer to perform the
+     *      noise detection without waiting for it. The transceiver interrupt
+     *      ends the measurement and goes back to the operating channel, the
+     *      callback gets the energy from MiMAC_Task.
+     *
+     * PreCondition:
+     *      MiMAC initialization has been done.
+     *
+     * Parameters:
+     *      uint8_t AssessmentMode - Only CHANNEL_ASSESSMENT_ENERGY_DETECT is supported
+     *      uint8_t Channel - The channel to measure
+     *      MiMAC_ChannelAssessmentConf_t ConfCallback - Gets the energy in dBm
+     *
+     * Returns:
+     *      A boolean to indicate if the detection started. It does not while
+     *      the transceiver transmits, receives a frame or sleeps.
+     *
+     * Remarks:
+     *      The transceiver does not receive while it measures another channel
+     *      than the operating one. On the operating channel a frame received
+     *      during the measurement makes it CHANNEL_ASSESSMENT_ENERGY_INVALID.
+     *
+     *****************************************************************************************/
+    bool MiMAC_ChannelAssessmentStart(uint8_t AssessmentMode, uint8_t Channel, MiMAC_ChannelAssessmentConf_t ConfCallback);
+#endif
+
 	/************************************************************************************
 	* Function:
 	*      uint32_t MiMAC_SymbolToTicks(uint32_t symbols)
@@ -431,6 +478,23 @@
 	*      converted value in uint32.
 	*****************************************************************************************/
 	uint32_t MiMAC_SymbolToTicks(uint32_t symbols);
+
+	/************************************************************************************
+	* Function:
+	*      bool MiMAC_TxPending(void)
+	*
+	* Summary:
+	*      This function tells whether a frame waits to go to the transceiver
+	*
+	* Description:
+	*      A prepared frame waits for the confirmation of the previous one and
+	*      for the spacing after it. MiMAC_Task hands it to the transceiver, so
+	*      the main loop has to keep running MiMAC_Task meanwhile.
+	*
+	* Returns:
+	*      true if a prepared frame waits, false otherwise.
+	*****************************************************************************************/
+	bool MiMAC_TxPending(void);
 	
 	/************************************************************************************
 	* Function:
@@ -490,6 +554,66 @@
     void MiMAC_DiscardPacket(void);
 
 
+    /************************************************************************************
+     * Function:
+     *      bool MiMAC_RetainPacket(uint8_t handle)
+     *
+     * Summary:
+     *      This function adds a reference to a received packet
+     *
+     * Description:
+     *      The upper layers use this function to hand a packet over to the
+     *      application without copying it. MACRxPacket and the received message
+     *      of the protocol point into the receive bank, which stays valid after
+     *      MiMAC_DiscardPacket as long as it is referenced. Every reference is
+     *      given back with MiMAC_ReleasePacket. A referenced bank cannot take new
+     *      packets, so BANK_SIZE has to exceed the number of packets the
+     *      application may hold.
+     *
+     * PreCondition:
+     *      A packet has been received, MiMAC_ReceivedPacket returned true.
+     *
+     * Parameters:
+     *      uint8_t handle - MACRxPacket.Handle of the packet
+     *
+     * Returns:
+     *      A boolean to indicate if the reference was taken. It fails once the
+     *      packet has been discarded or released by all holders.
+     *
+     * Remarks:
+     *      None
+     *
+     *****************************************************************************************/
+    bool MiMAC_RetainPacket(uint8_t handle);
+
+
+    /************************************************************************************
+     * Function:
+     *      void MiMAC_ReleasePacket(uint8_t handle)
+     *
+     * Summary:
+     *      This function gives back a reference taken by MiMAC_RetainPacket
+     *
+     * Description:
+     *      The bank can receive packets again once the last holder is done with
+     *      the data it points to.
+     *
+     * PreCondition:
+     *      MiMAC initialization has been done.
+     *
+     * Parameters:
+     *      uint8_t handle - MACRxPacket.Handle of the packet
+     *
+     * Returns:
+     *      None
+     *
+     * Remarks:
+     *      May be called from interrupt context.
+     *
+     *****************************************************************************************/
+    void MiMAC_ReleasePacket(uint8_t handle);
+
+
     /************************************************************************************
      * Function:
      *      bool MiMAC_ReceivedPacket(void)
@@ -563,7 +687,9 @@
      *      </code>
      *
      * Remarks:
-     *      None
+     *      The frame is prepared right away, up to MIMAC_TX_PIPELINE_DEPTH
+     *      frames can wait for their confirmation. FALSE is returned if
+     *      none of them is free.
      *
      *****************************************************************************************/
     bool MiMAC_SendPacket(MAC_TRANS_PARAM transParam, uint8_t *MACPayload, uint8_t MACPayloadLen, uint8_t msghandle,
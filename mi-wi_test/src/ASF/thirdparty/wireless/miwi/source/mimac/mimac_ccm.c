@@ -0,0 +1,325 @@
+/**
+* \file  mimac_ccm.c
+*
+* \brief CCM* authenticated encryption on a pluggable AES backend
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries. 
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products. 
+* It is your responsibility to comply with third party license terms applicable 
+* to your use of third party software (including open source software) that 
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, 
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, 
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, 
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE 
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL 
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE 
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE 
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT 
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY 
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY, 
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+
+#include <string.h>
+#include <stdbool.h>
+#include "mimac_ccm.h"
+
+/* Flags of the first CBC-MAC block B0 and of the counter blocks A_i */
+#define CCM_FLAGS_ADATA             0x40
+#define CCM_FLAGS_MIC(micLen)       ((uint8_t)((((micLen) - 2) / 2) << 3))
+#define CCM_FLAGS_L                 (CCM_LENGTH_FIELD - 1)
+
+/************************ VARIABLES ********************************/
+#if defined(ENABLE_SOFTWARE_AES)
+static const MiMAC_CryptoBackend_t *ccmBackend = &MiMAC_CryptoSoftware;
+#else
+static const MiMAC_CryptoBackend_t *ccmBackend = &MiMAC_CryptoTransceiver;
+#endif
+
+/************************************************************************************
+ * Adds data to the partly filled CBC-MAC block and passes every full block
+ * to the AES backend. Returns the new fill level of the block.
+ *****************************************************************************************/
+static uint8_t ccmAbsorb(uint8_t *block, uint8_t fill, uint8_t *data, uint8_t len)
+{
+	while (len)
+	{
+		uint8_t n = CCM_BLOCK_LENGTH - fill;
+
+		if (n > len)
+		{
+			n = len;
+		}
+		memcpy(&block[fill], data, n);
+		fill += n;
+		data += n;
+		len -= n;
+		if (CCM_BLOCK_LENGTH == fill)
+		{
+			ccmBackend->blockWriteRead(block, NULL);
+			fill = 0;
+		}
+	}
+	return fill;
+}
+
+/* Pads the last CBC-MAC block of a field with zeros */
+static void ccmFlush(uint8_t *block, uint8_t fill)
+{
+	if (fill)
+	{
+		memset(&block[fill], 0, CCM_BLOCK_LENGTH - fill);
+		ccmBackend->blockWriteRead(block, NULL);
+	}
+}
+
+/************************************************************************************
+ * Function:
+ *      static void ccmCbcMac(uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+ *                            uint8_t *mData, uint8_t mLen, uint8_t micLen, uint8_t *tag)
+ *
+ * Summary:
+ *      This function computes the unencrypted authentication tag
+ *
+ * Description:
+ *      B0 goes through the backend in ECB mode, the length prefixed aData and
+ *      mData, each padded to full blocks, in its CBC mode, so the backend
+ *      chains the blocks itself and only the tag is read back.
+ *
+ *****************************************************************************************/
+static void ccmCbcMac(uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+	uint8_t *mData, uint8_t mLen, uint8_t micLen, uint8_t *tag)
+{
+	uint8_t block[CCM_BLOCK_LENGTH];
+	uint8_t fill;
+
+	block[0] = (aLen ? CCM_FLAGS_ADATA : 0) | CCM_FLAGS_MIC(micLen) | CCM_FLAGS_L;
+	memcpy(&block[1], nonce, CCM_NONCE_LENGTH);
+	block[14] = 0;
+	block[15] = mLen;
+	ccmBackend->blockWriteRead(block, NULL);
+
+	ccmBackend->chain(true);
+	if (aLen)
+	{
+		block[0] = 0;
+		block[1] = aLen;
+		fill = ccmAbsorb(block, 2, aData, aLen);
+		ccmFlush(block, fill);
+	}
+	fill = ccmAbsorb(block, 0, mData, mLen);
+	ccmFlush(block, fill);
+	ccmBackend->blockRead(tag);
+	ccmBackend->chain(false);
+}
+
+/************************************************************************************
+ * Function:
+ *      static void ccmCtr(uint8_t *nonce, uint8_t *mData, uint8_t mLen, uint8_t *s0)
+ *
+ * Summary:
+ *      This function en- or decrypts mData in place with the CTR key stream
+ *
+ * Description:
+ *      The counter blocks A_i are independent, so each transfer writes A_i+1
+ *      and reads S_i, and no result needs a transfer of its own but the last.
+ *      S_0 masks the MIC and is only computed if s0 is not NULL.
+ *
+ *****************************************************************************************/
+static void ccmCtr(uint8_t *nonce, uint8_t *mData, uint8_t mLen, uint8_t *s0)
+{
+	uint8_t counter[CCM_BLOCK_LENGTH];
+	uint8_t keyStream[CCM_BLOCK_LENGTH];
+	uint8_t blocks = (mLen + CCM_BLOCK_LENGTH - 1) / CCM_BLOCK_LENGTH;
+	uint8_t i = s0 ? 0 : 1;
+
+	if (i > blocks)
+	{
+		return;
+	}
+	counter[0] = CCM_FLAGS_L;
+	memcpy(&counter[1], nonce, CCM_NONCE_LENGTH);
+	counter[14] = 0;
+	counter[15] = i;
+	ccmBackend->blockWriteRead(counter, NULL);
+
+	for (; i <= blocks; i++)
+	{
+		uint8_t offset, n;
+
+		if (i < blocks)
+		{
+			counter[15] = i + 1;
+			ccmBackend->blockWriteRead(counter, keyStream);
+		}
+		else
+		{
+			ccmBackend->blockRead(keyStream);
+		}
+
+		if (0 == i)
+		{
+			memcpy(s0, keyStream, CCM_BLOCK_LENGTH);
+			continue;
+		}
+		offset = (i - 1) * CCM_BLOCK_LENGTH;
+		n = mLen - offset;
+		if (n > CCM_BLOCK_LENGTH)
+		{
+			n = CCM_BLOCK_LENGTH;
+		}
+		for (uint8_t j = 0; j < n; j++)
+		{
+			mData[offset + j] ^= keyStream[j];
+		}
+	}
+}
+
+/************************************************************************************
+ * Function:
+ *      void MiMAC_CcmSetBackend(const MiMAC_CryptoBackend_t *backend)
+ *
+ * Summary:
+ *      This function selects the AES backend of the following frames
+ *
+ * Description:
+ *      See mimac_ccm.h
+ *
+ * PreCondition:
+ *      No frame is being secured.
+ *
+ * Parameters:
+ *      const MiMAC_CryptoBackend_t * backend - The backend to use
+ *
+ * Returns:
+ *      None
+ *
+ * Remarks:
+ *      None
+ *
+ *****************************************************************************************/
+void MiMAC_CcmSetBackend(const MiMAC_CryptoBackend_t *backend)
+{
+	ccmBackend = backend;
+}
+
+static bool ccmMicLengthValid(uint8_t micLen)
+{
+	return (0 == micLen) || (4 == micLen) || (8 == micLen) || (16 == micLen);
+}
+
+/************************************************************************************
+ * Function:
+ *      bool MiMAC_CcmEncrypt(uint8_t *key, uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+ *                            uint8_t *mData, uint8_t mLen, uint8_t *mic, uint8_t micLen)
+ *
+ * Summary:
+ *      This function authenticates and encrypts a frame with CCM*
+ *
+ * Description:
+ *      The tag is computed over the plain text first, then the plain text
+ *      and the tag are encrypted.
+ *
+ * PreCondition:
+ *      With the transceiver backend, its initialization has been done and
+ *      it is not sleeping.
+ *
+ * Parameters:
+ *      See mimac_ccm.h
+ *
+ * Returns:
+ *      false if the MIC length is not supported
+ *
+ * Remarks:
+ *      None
+ *
+ *****************************************************************************************/
+bool MiMAC_CcmEncrypt(uint8_t *key, uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+	uint8_t *mData, uint8_t mLen, uint8_t *mic, uint8_t micLen)
+{
+	uint8_t tag[CCM_BLOCK_LENGTH];
+	uint8_t s0[CCM_BLOCK_LENGTH];
+
+	if (!ccmMicLengthValid(micLen))
+	{
+		return false;
+	}
+
+	ccmBackend->keySetup(key);
+	if (micLen)
+	{
+		ccmCbcMac(nonce, aData, aLen, mData, mLen, micLen, tag);
+	}
+	ccmCtr(nonce, mData, mLen, micLen ? s0 : NULL);
+	for (uint8_t i = 0; i < micLen; i++)
+	{
+		mic[i] = tag[i] ^ s0[i];
+	}
+	return true;
+}
+
+/************************************************************************************
+ * Function:
+ *      bool MiMAC_CcmDecrypt(uint8_t *key, uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+ *                            uint8_t *mData, uint8_t mLen, uint8_t *mic, uint8_t micLen)
+ *
+ * Summary:
+ *      This function decrypts a frame with CCM* and checks its MIC
+ *
+ * Description:
+ *      The cipher text is decrypted first, then the tag is computed over the
+ *      plain text. All MIC bytes are compared, without an early exit.
+ *
+ * PreCondition:
+ *      With the transceiver backend, its initialization has been done and
+ *      it is not sleeping.
+ *
+ * Parameters:
+ *      See mimac_ccm.h
+ *
+ * Returns:
+ *      true if all bytes of the MIC match
+ *
+ * Remarks:
+ *      None
+ *
+ *****************************************************************************************/
+bool MiMAC_CcmDecrypt(uint8_t *key, uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+	uint8_t *mData, uint8_t mLen, uint8_t *mic, uint8_t micLen)
+{
+	uint8_t tag[CCM_BLOCK_LENGTH];
+	uint8_t s0[CCM_BLOCK_LENGTH];
+	uint8_t diff = 0;
+
+	if (!ccmMicLengthValid(micLen))
+	{
+		return false;
+	}
+
+	ccmBackend->keySetup(key);
+	ccmCtr(nonce, mData, mLen, micLen ? s0 : NULL);
+	if (micLen)
+	{
+		ccmCbcMac(nonce, aData, aLen, mData, mLen, micLen, tag);
+	}
+	for (uint8_t i = 0; i < micLen; i++)
+	{
+		diff |= mic[i] ^ tag[i] ^ s0[i];
+	}
+	return 0 == diff;
+}
@@ -0,0 +1,157 @@
+/**
+* \file  mimac_ccm.h
+*
+* \brief CCM* authenticated encryption on a pluggable AES backend
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries. 
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products. 
+* It is your responsibility to comply with third party license terms applicable 
+* to your use of third party software (including open source software) that 
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, 
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, 
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, 
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE 
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL 
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE 
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE 
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT 
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY 
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY, 
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+
+#ifndef __MIMAC_CCM_H
+#define __MIMAC_CCM_H
+
+	#include <stdint.h>
+	#include <stdbool.h>
+	#include "mimac_crypto.h"
+
+	/*********************************************************************/
+	// CCM* as in IEEE 802.15.4: a 13 byte nonce and a two byte length
+	// field (L = 2). The MIC may be 0, 4, 8 or 16 bytes long.
+	/*********************************************************************/
+	#define CCM_NONCE_LENGTH            13
+	#define CCM_LENGTH_FIELD            2
+	#define CCM_MIC_MAX_LENGTH          16
+	#define CCM_BLOCK_LENGTH            16
+
+	/************************************************************************************
+	 * Function:
+	 *      void MiMAC_CcmSetBackend(const MiMAC_CryptoBackend_t *backend)
+	 *
+	 * Summary:
+	 *      This function selects the AES backend of the following frames
+	 *
+	 * Description:
+	 *      Frames are secured with MiMAC_CryptoSoftware if ENABLE_SOFTWARE_AES
+	 *      is defined, otherwise with MiMAC_CryptoTransceiver. With both built,
+	 *      the application may move the work to the MCU while the SPI bus or
+	 *      the transceiver is busy, and back.
+	 *
+	 * PreCondition:
+	 *      No frame is being secured.
+	 *
+	 * Parameters:
+	 *      const MiMAC_CryptoBackend_t * backend - The backend to use
+	 *
+	 * Returns:
+	 *      None
+	 *
+	 * Remarks:
+	 *      None
+	 *
+	 *****************************************************************************************/
+	void MiMAC_CcmSetBackend(const MiMAC_CryptoBackend_t *backend);
+
+	/************************************************************************************
+	 * Function:
+	 *      bool MiMAC_CcmEncrypt(uint8_t *key, uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+	 *                            uint8_t *mData, uint8_t mLen, uint8_t *mic, uint8_t micLen)
+	 *
+	 * Summary:
+	 *      This function authenticates and encrypts a frame with CCM*
+	 *
+	 * Description:
+	 *      The key is loaded into the AES backend once for the frame. The
+	 *      CBC-MAC blocks and then the CTR blocks pass back to back through
+	 *      it; on the transceiver every SPI transfer writes the next block
+	 *      while it reads the result of the previous one.
+	 *
+	 * PreCondition:
+	 *      With the transceiver backend, its initialization has been done and
+	 *      it is not sleeping.
+	 *
+	 * Parameters:
+	 *      uint8_t * key -     The 16 byte security key
+	 *      uint8_t * nonce -   The CCM_NONCE_LENGTH byte nonce
+	 *      uint8_t * aData -   Data authenticated only, like the MAC header
+	 *      uint8_t aLen -      The length of aData
+	 *      uint8_t * mData -   The plain text, encrypted in place
+	 *      uint8_t mLen -      The length of mData
+	 *      uint8_t * mic -     Receives the encrypted MIC
+	 *      uint8_t micLen -    The length of the MIC
+	 *
+	 * Returns:
+	 *      false if the MIC length is not supported
+	 *
+	 * Remarks:
+	 *      None
+	 *
+	 *****************************************************************************************/
+	bool MiMAC_CcmEncrypt(uint8_t *key, uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+		uint8_t *mData, uint8_t mLen, uint8_t *mic, uint8_t micLen);
+
+	/************************************************************************************
+	 * Function:
+	 *      bool MiMAC_CcmDecrypt(uint8_t *key, uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+	 *                            uint8_t *mData, uint8_t mLen, uint8_t *mic, uint8_t micLen)
+	 *
+	 * Summary:
+	 *      This function decrypts a frame with CCM* and checks its MIC
+	 *
+	 * Description:
+	 *      The counterpart of MiMAC_CcmEncrypt(), with the same single key load
+	 *      and streamed blocks. mData is decrypted in place also if the MIC does
+	 *      not match.
+	 *
+	 * PreCondition:
+	 *      With the transceiver backend, its initialization has been done and
+	 *      it is not sleeping.
+	 *
+	 * Parameters:
+	 *      uint8_t * key -     The 16 byte security key
+	 *      uint8_t * nonce -   The CCM_NONCE_LENGTH byte nonce
+	 *      uint8_t * aData -   Data authenticated only, like the MAC header
+	 *      uint8_t aLen -      The length of aData
+	 *      uint8_t * mData -   The cipher text, decrypted in place
+	 *      uint8_t mLen -      The length of mData
+	 *      uint8_t * mic -     The received, encrypted MIC
+	 *      uint8_t micLen -    The length of the MIC
+	 *
+	 * Returns:
+	 *      true if all bytes of the MIC match
+	 *
+	 * Remarks:
+	 *      None
+	 *
+	 *****************************************************************************************/
+	bool MiMAC_CcmDecrypt(uint8_t *key, uint8_t *nonce, uint8_t *aData, uint8_t aLen,
+		uint8_t *mData, uint8_t mLen, uint8_t *mic, uint8_t micLen);
+
+#endif
@@ -0,0 +1,69 @@
+/**
+* \file  mimac_crypto.h
+*
+* \brief AES backends of the CCM* engine
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries. 
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products. 
+* It is your responsibility to comply with third party license terms applicable 
+* to your use of third party software (including open source software) that 
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, 
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, 
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, 
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE 
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL 
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE 
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE 
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT 
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY 
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY, 
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+
+#ifndef __MIMAC_CRYPTO_H
+#define __MIMAC_CRYPTO_H
+
+	#include <stdint.h>
+	#include <stdbool.h>
+	#include "miwi_config.h"
+
+	/*********************************************************************/
+	// An AES-128 backend of the CCM* engine. Its calls follow the AES
+	// engine of the transceiver: after keySetup() the blocks are
+	// encrypted one by one (ECB), with chain(true) every block is first
+	// XORed with the previous result (CBC). blockWriteRead() starts the
+	// next block and returns the result of the previous one, so a backend
+	// may compute both at once; blockRead() returns the last result.
+	/*********************************************************************/
+	typedef struct _MiMAC_CryptoBackend_t
+	{
+		void (*keySetup)(uint8_t *key);
+		void (*chain)(bool enable);
+		void (*blockWriteRead)(uint8_t *input, uint8_t *output);
+		void (*blockRead)(uint8_t *output);
+	} MiMAC_CryptoBackend_t;
+
+	/* The AES engine of the AT86RF2xx, through the SAL */
+	extern const MiMAC_CryptoBackend_t MiMAC_CryptoTransceiver;
+
+#if defined(ENABLE_SOFTWARE_AES)
+	/* Table driven AES-128 on the MCU */
+	extern const MiMAC_CryptoBackend_t MiMAC_CryptoSoftware;
+#endif
+
+#endif
@@ -0,0 +1,314 @@
+/**
+* \file  mimac_crypto_sw.c
+*
+* \brief Table driven software AES-128 backend of the CCM* engine
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries. 
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products. 
+* It is your responsibility to comply with third party license terms applicable 
+* to your use of third party software (including open source software) that 
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, 
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, 
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, 
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE 
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL 
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE 
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE 
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT 
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY 
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY, 
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+
+#include <string.h>
+#include <stdbool.h>
+#include "mimac_crypto.h"
+
+#if defined(ENABLE_SOFTWARE_AES)
+
+/************************ DEFINITIONS ******************************/
+/* Cortex-M0+ keeps a single round table in flash and rotates its
+ * entries, which costs one cycle each; larger cores use four tables */
+#if defined(__ARM_ARCH_6M__) && !defined(SOFTWARE_AES_FOUR_TABLES)
+#define SOFTWARE_AES_ONE_TABLE
+#endif
+
+#define AES_ROUNDS                  10
+#define AES_ROUND_KEY_WORDS         (4 * (AES_ROUNDS + 1))
+#define AES_KEY_LENGTH              16
+#define AES_BLOCK_LENGTH            16
+
+#define AES_GET_U32(b, i)           ((uint32_t)(b)[(i)] | ((uint32_t)(b)[(i) + 1] << 8) | \
+                                     ((uint32_t)(b)[(i) + 2] << 16) | ((uint32_t)(b)[(i) + 3] << 24))
+#define AES_PUT_U32(n, b, i)        do { (b)[(i)] = (uint8_t)(n); (b)[(i) + 1] = (uint8_t)((n) >> 8); \
+                                         (b)[(i) + 2] = (uint8_t)((n) >> 16); (b)[(i) + 3] = (uint8_t)((n) >> 24); } while (0)
+#define AES_ROTL8(x)                (((x) << 8) | ((x) >> 24))
+
+/*********************************************************************/
+// Round table: SubBytes and MixColumns of one state byte as a column,
+// little endian. V() lists the bytes 3s, s, s, 2s of the column.
+/*********************************************************************/
+#define AES_FT \
+	V(A5,63,63,C6), V(84,7C,7C,F8), V(99,77,77,EE), V(8D,7B,7B,F6), \
+	V(0D,F2,F2,FF), V(BD,6B,6B,D6), V(B1,6F,6F,DE), V(54,C5,C5,91), \
+	V(50,30,30,60), V(03,01,01,02), V(A9,67,67,CE), V(7D,2B,2B,56), \
+	V(19,FE,FE,E7), V(62,D7,D7,B5), V(E6,AB,AB,4D), V(9A,76,76,EC), \
+	V(45,CA,CA,8F), V(9D,82,82,1F), V(40,C9,C9,89), V(87,7D,7D,FA), \
+	V(15,FA,FA,EF), V(EB,59,59,B2), V(C9,47,47,8E), V(0B,F0,F0,FB), \
+	V(EC,AD,AD,41), V(67,D4,D4,B3), V(FD,A2,A2,5F), V(EA,AF,AF,45), \
+	V(BF,9C,9C,23), V(F7,A4,A4,53), V(96,72,72,E4), V(5B,C0,C0,9B), \
+	V(C2,B7,B7,75), V(1C,FD,FD,E1), V(AE,93,93,3D), V(6A,26,26,4C), \
+	V(5A,36,36,6C), V(41,3F,3F,7E), V(02,F7,F7,F5), V(4F,CC,CC,83), \
+	V(5C,34,34,68), V(F4,A5,A5,51), V(34,E5,E5,D1), V(08,F1,F1,F9), \
+	V(93,71,71,E2), V(73,D8,D8,AB), V(53,31,31,62), V(3F,15,15,2A), \
+	V(0C,04,04,08), V(52,C7,C7,95), V(65,23,23,46), V(5E,C3,C3,9D), \
+	V(28,18,18,30), V(A1,96,96,37), V(0F,05,05,0A), V(B5,9A,9A,2F), \
+	V(09,07,07,0E), V(36,12,12,24), V(9B,80,80,1B), V(3D,E2,E2,DF), \
+	V(26,EB,EB,CD), V(69,27,27,4E), V(CD,B2,B2,7F), V(9F,75,75,EA), \
+	V(1B,09,09,12), V(9E,83,83,1D), V(74,2C,2C,58), V(2E,1A,1A,34), \
+	V(2D,1B,1B,36), V(B2,6E,6E,DC), V(EE,5A,5A,B4), V(FB,A0,A0,5B), \
+	V(F6,52,52,A4), V(4D,3B,3B,76), V(61,D6,D6,B7), V(CE,B3,B3,7D), \
+	V(7B,29,29,52), V(3E,E3,E3,DD), V(71,2F,2F,5E), V(97,84,84,13), \
+	V(F5,53,53,A6), V(68,D1,D1,B9), V(00,00,00,00), V(2C,ED,ED,C1), \
+	V(60,20,20,40), V(1F,FC,FC,E3), V(C8,B1,B1,79), V(ED,5B,5B,B6), \
+	V(BE,6A,6A,D4), V(46,CB,CB,8D), V(D9,BE,BE,67), V(4B,39,39,72), \
+	V(DE,4A,4A,94), V(D4,4C,4C,98), V(E8,58,58,B0), V(4A,CF,CF,85), \
+	V(6B,D0,D0,BB), V(2A,EF,EF,C5), V(E5,AA,AA,4F), V(16,FB,FB,ED), \
+	V(C5,43,43,86), V(D7,4D,4D,9A), V(55,33,33,66), V(94,85,85,11), \
+	V(CF,45,45,8A), V(10,F9,F9,E9), V(06,02,02,04), V(81,7F,7F,FE), \
+	V(F0,50,50,A0), V(44,3C,3C,78), V(BA,9F,9F,25), V(E3,A8,A8,4B), \
+	V(F3,51,51,A2), V(FE,A3,A3,5D), V(C0,40,40,80), V(8A,8F,8F,05), \
+	V(AD,92,92,3F), V(BC,9D,9D,21), V(48,38,38,70), V(04,F5,F5,F1), \
+	V(DF,BC,BC,63), V(C1,B6,B6,77), V(75,DA,DA,AF), V(63,21,21,42), \
+	V(30,10,10,20), V(1A,FF,FF,E5), V(0E,F3,F3,FD), V(6D,D2,D2,BF), \
+	V(4C,CD,CD,81), V(14,0C,0C,18), V(35,13,13,26), V(2F,EC,EC,C3), \
+	V(E1,5F,5F,BE), V(A2,97,97,35), V(CC,44,44,88), V(39,17,17,2E), \
+	V(57,C4,C4,93), V(F2,A7,A7,55), V(82,7E,7E,FC), V(47,3D,3D,7A), \
+	V(AC,64,64,C8), V(E7,5D,5D,BA), V(2B,19,19,32), V(95,73,73,E6), \
+	V(A0,60,60,C0), V(98,81,81,19), V(D1,4F,4F,9E), V(7F,DC,DC,A3), \
+	V(66,22,22,44), V(7E,2A,2A,54), V(AB,90,90,3B), V(83,88,88,0B), \
+	V(CA,46,46,8C), V(29,EE,EE,C7), V(D3,B8,B8,6B), V(3C,14,14,28), \
+	V(79,DE,DE,A7), V(E2,5E,5E,BC), V(1D,0B,0B,16), V(76,DB,DB,AD), \
+	V(3B,E0,E0,DB), V(56,32,32,64), V(4E,3A,3A,74), V(1E,0A,0A,14), \
+	V(DB,49,49,92), V(0A,06,06,0C), V(6C,24,24,48), V(E4,5C,5C,B8), \
+	V(5D,C2,C2,9F), V(6E,D3,D3,BD), V(EF,AC,AC,43), V(A6,62,62,C4), \
+	V(A8,91,91,39), V(A4,95,95,31), V(37,E4,E4,D3), V(8B,79,79,F2), \
+	V(32,E7,E7,D5), V(43,C8,C8,8B), V(59,37,37,6E), V(B7,6D,6D,DA), \
+	V(8C,8D,8D,01), V(64,D5,D5,B1), V(D2,4E,4E,9C), V(E0,A9,A9,49), \
+	V(B4,6C,6C,D8), V(FA,56,56,AC), V(07,F4,F4,F3), V(25,EA,EA,CF), \
+	V(AF,65,65,CA), V(8E,7A,7A,F4), V(E9,AE,AE,47), V(18,08,08,10), \
+	V(D5,BA,BA,6F), V(88,78,78,F0), V(6F,25,25,4A), V(72,2E,2E,5C), \
+	V(24,1C,1C,38), V(F1,A6,A6,57), V(C7,B4,B4,73), V(51,C6,C6,97), \
+	V(23,E8,E8,CB), V(7C,DD,DD,A1), V(9C,74,74,E8), V(21,1F,1F,3E), \
+	V(DD,4B,4B,96), V(DC,BD,BD,61), V(86,8B,8B,0D), V(85,8A,8A,0F), \
+	V(90,70,70,E0), V(42,3E,3E,7C), V(C4,B5,B5,71), V(AA,66,66,CC), \
+	V(D8,48,48,90), V(05,03,03,06), V(01,F6,F6,F7), V(12,0E,0E,1C), \
+	V(A3,61,61,C2), V(5F,35,35,6A), V(F9,57,57,AE), V(D0,B9,B9,69), \
+	V(91,86,86,17), V(58,C1,C1,99), V(27,1D,1D,3A), V(B9,9E,9E,27), \
+	V(38,E1,E1,D9), V(13,F8,F8,EB), V(B3,98,98,2B), V(33,11,11,22), \
+	V(BB,69,69,D2), V(70,D9,D9,A9), V(89,8E,8E,07), V(A7,94,94,33), \
+	V(B6,9B,9B,2D), V(22,1E,1E,3C), V(92,87,87,15), V(20,E9,E9,C9), \
+	V(49,CE,CE,87), V(FF,55,55,AA), V(78,28,28,50), V(7A,DF,DF,A5), \
+	V(8F,8C,8C,03), V(F8,A1,A1,59), V(80,89,89,09), V(17,0D,0D,1A), \
+	V(DA,BF,BF,65), V(31,E6,E6,D7), V(C6,42,42,84), V(B8,68,68,D0), \
+	V(C3,41,41,82), V(B0,99,99,29), V(77,2D,2D,5A), V(11,0F,0F,1E), \
+	V(CB,B0,B0,7B), V(FC,54,54,A8), V(D6,BB,BB,6D), V(3A,16,16,2C)
+
+#define V(a, b, c, d) 0x##a##b##c##d
+static const uint32_t aesFt0[256] = { AES_FT };
+#undef V
+
+#if defined(SOFTWARE_AES_ONE_TABLE)
+#define AES_FT1(x)                  AES_ROTL8(aesFt0[(x)])
+#define AES_FT2(x)                  AES_ROTL8(AES_ROTL8(aesFt0[(x)]))
+#define AES_FT3(x)                  AES_ROTL8(AES_ROTL8(AES_ROTL8(aesFt0[(x)])))
+/* The S-box is the second byte of every table entry */
+#define AES_SBOX(x)                 ((uint8_t)(aesFt0[(x)] >> 8))
+#else
+#define V(a, b, c, d) 0x##b##c##d##a
+static const uint32_t aesFt1[256] = { AES_FT };
+#undef V
+#define V(a, b, c, d) 0x##c##d##a##b
+static const uint32_t aesFt2[256] = { AES_FT };
+#undef V
+#define V(a, b, c, d) 0x##d##a##b##c
+static const uint32_t aesFt3[256] = { AES_FT };
+#undef V
+
+static const uint8_t aesSbox[256] =
+{
+	0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+	0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+	0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+	0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+	0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+	0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+	0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+	0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+	0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+	0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+	0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+	0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+	0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+	0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+	0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+	0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+#define AES_FT1(x)                  aesFt1[(x)]
+#define AES_FT2(x)                  aesFt2[(x)]
+#define AES_FT3(x)                  aesFt3[(x)]
+#define AES_SBOX(x)                 aesSbox[(x)]
+#endif
+
+#define AES_ROUND(rk, x0, x1, x2, x3, y0, y1, y2, y3) \
+	do { \
+		x0 = (rk)[0] ^ aesFt0[(y0) & 0xFF] ^ AES_FT1(((y1) >> 8) & 0xFF) ^ \
+		     AES_FT2(((y2) >> 16) & 0xFF) ^ AES_FT3((y3) >> 24); \
+		x1 = (rk)[1] ^ aesFt0[(y1) & 0xFF] ^ AES_FT1(((y2) >> 8) & 0xFF) ^ \
+		     AES_FT2(((y3) >> 16) & 0xFF) ^ AES_FT3((y0) >> 24); \
+		x2 = (rk)[2] ^ aesFt0[(y2) & 0xFF] ^ AES_FT1(((y3) >> 8) & 0xFF) ^ \
+		     AES_FT2(((y0) >> 16) & 0xFF) ^ AES_FT3((y1) >> 24); \
+		x3 = (rk)[3] ^ aesFt0[(y3) & 0xFF] ^ AES_FT1(((y0) >> 8) & 0xFF) ^ \
+		     AES_FT2(((y1) >> 16) & 0xFF) ^ AES_FT3((y2) >> 24); \
+	} while (0)
+
+/* The last round has no MixColumns */
+#define AES_FINAL(rk, y0, y1, y2, y3) \
+	((rk) ^ (uint32_t)AES_SBOX((y0) & 0xFF) ^ ((uint32_t)AES_SBOX(((y1) >> 8) & 0xFF) << 8) ^ \
+	 ((uint32_t)AES_SBOX(((y2) >> 16) & 0xFF) << 16) ^ ((uint32_t)AES_SBOX((y3) >> 24) << 24))
+
+/************************ VARIABLES ********************************/
+static uint32_t aesRoundKey[AES_ROUND_KEY_WORDS];
+static uint8_t aesKey[AES_KEY_LENGTH];
+static bool aesKeyValid;
+/* Result of the last block, the chaining value in CBC mode */
+static uint8_t aesResult[AES_BLOCK_LENGTH];
+static bool aesChain;
+
+/************************ FUNCTIONS ********************************/
+static void aesExpandKey(const uint8_t *key)
+{
+	static const uint8_t rcon[AES_ROUNDS] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36};
+	uint32_t *rk = aesRoundKey;
+
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		rk[i] = AES_GET_U32(key, 4 * i);
+	}
+	for (uint8_t i = 0; i < AES_ROUNDS; i++, rk += 4)
+	{
+		rk[4] = rk[0] ^ rcon[i] ^
+			((uint32_t)AES_SBOX((rk[3] >> 8) & 0xFF)) ^
+			((uint32_t)AES_SBOX((rk[3] >> 16) & 0xFF) << 8) ^
+			((uint32_t)AES_SBOX(rk[3] >> 24) << 16) ^
+			((uint32_t)AES_SBOX(rk[3] & 0xFF) << 24);
+		rk[5] = rk[1] ^ rk[4];
+		rk[6] = rk[2] ^ rk[5];
+		rk[7] = rk[3] ^ rk[6];
+	}
+}
+
+/*********************************************************************
+* Function:         static void aesEncrypt(const uint8_t *input, uint8_t *output)
+*
+* Overview:         Encrypts one block with the expanded key, two rounds
+*                   per loop so the state needs no copies.
+********************************************************************/
+static void aesEncrypt(const uint8_t *input, uint8_t *output)
+{
+	const uint32_t *rk = aesRoundKey;
+	uint32_t x0, x1, x2, x3, y0, y1, y2, y3;
+
+	x0 = AES_GET_U32(input, 0) ^ rk[0];
+	x1 = AES_GET_U32(input, 4) ^ rk[1];
+	x2 = AES_GET_U32(input, 8) ^ rk[2];
+	x3 = AES_GET_U32(input, 12) ^ rk[3];
+
+	for (uint8_t i = 0; i < (AES_ROUNDS / 2) - 1; i++)
+	{
+		rk += 4;
+		AES_ROUND(rk, y0, y1, y2, y3, x0, x1, x2, x3);
+		rk += 4;
+		AES_ROUND(rk, x0, x1, x2, x3, y0, y1, y2, y3);
+	}
+	rk += 4;
+	AES_ROUND(rk, y0, y1, y2, y3, x0, x1, x2, x3);
+	rk += 4;
+
+	x0 = AES_FINAL(rk[0], y0, y1, y2, y3);
+	x1 = AES_FINAL(rk[1], y1, y2, y3, y0);
+	x2 = AES_FINAL(rk[2], y2, y3, y0, y1);
+	x3 = AES_FINAL(rk[3], y3, y0, y1, y2);
+
+	AES_PUT_U32(x0, output, 0);
+	AES_PUT_U32(x1, output, 4);
+	AES_PUT_U32(x2, output, 8);
+	AES_PUT_U32(x3, output, 12);
+}
+
+/* The expanded key is kept as long as the same key is used */
+static void swKeySetup(uint8_t *key)
+{
+	if (!aesKeyValid || (0 != memcmp(aesKey, key, AES_KEY_LENGTH)))
+	{
+		memcpy(aesKey, key, AES_KEY_LENGTH);
+		aesExpandKey(aesKey);
+		aesKeyValid = true;
+	}
+	aesChain = false;
+}
+
+static void swChain(bool enable)
+{
+	aesChain = enable;
+}
+
+static void swBlockWriteRead(uint8_t *input, uint8_t *output)
+{
+	uint8_t block[AES_BLOCK_LENGTH];
+
+	memcpy(block, input, AES_BLOCK_LENGTH);
+	if (aesChain)
+	{
+		for (uint8_t i = 0; i < AES_BLOCK_LENGTH; i++)
+		{
+			block[i] ^= aesResult[i];
+		}
+	}
+	if (NULL != output)
+	{
+		memcpy(output, aesResult, AES_BLOCK_LENGTH);
+	}
+	aesEncrypt(block, aesResult);
+}
+
+static void swBlockRead(uint8_t *output)
+{
+	memcpy(output, aesResult, AES_BLOCK_LENGTH);
+}
+
+const MiMAC_CryptoBackend_t MiMAC_CryptoSoftware =
+{
+	swKeySetup,
+	swChain,
+	swBlockWriteRead,
+	swBlockRead
+};
+
+#endif
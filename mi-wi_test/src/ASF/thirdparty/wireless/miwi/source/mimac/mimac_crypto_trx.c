@@ -0,0 +1,70 @@
+/**
+* \file  mimac_crypto_trx.c
+*
+* \brief CCM* backend on the AES engine of the transceiver
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries. 
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products. 
+* It is your responsibility to comply with third party license terms applicable 
+* to your use of third party software (including open source software) that 
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, 
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, 
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, 
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE 
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL 
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE 
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE 
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT 
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY 
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY, 
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+
+#include <stdbool.h>
+#include "sal.h"
+#include "mimac_crypto.h"
+
+/* The key is written once, a mode change takes effect with the next
+ * block written to the engine */
+static void trxKeySetup(uint8_t *key)
+{
+	sal_aes_setup(key, AES_MODE_ECB, AES_DIR_ENCRYPT);
+}
+
+static void trxChain(bool enable)
+{
+	sal_aes_setup(NULL, enable ? AES_MODE_CBC : AES_MODE_ECB, AES_DIR_ENCRYPT);
+}
+
+static void trxBlockWriteRead(uint8_t *input, uint8_t *output)
+{
+	sal_aes_wrrd(input, output);
+}
+
+static void trxBlockRead(uint8_t *output)
+{
+	sal_aes_read(output);
+}
+
+const MiMAC_CryptoBackend_t MiMAC_CryptoTransceiver =
+{
+	trxKeySetup,
+	trxChain,
+	trxBlockWriteRead,
+	trxBlockRead
+};
@@ -0,0 +1,113 @@
+/**
+* \file  mimac_header.c
+*
+* \brief IEEE 802.15.4 MAC header layouts
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries. 
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products. 
+* It is your responsibility to comply with third party license terms applicable 
+* to your use of third party software (including open source software) that 
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, 
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, 
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, 
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE 
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL 
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE 
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE 
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT 
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY 
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY, 
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+#include <string.h>
+#include <stdbool.h>
+#include "miwi_config.h"
+#include "mimac_header.h"
+
+/* Indexed by MAC_HEADER_INDEX: PAN ID compression, source mode, destination mode */
+const MAC_HEADER_LAYOUT MACHeaderLayout[MAC_HEADER_LAYOUTS] =
+{
+	MAC_HEADER_ROW(0, 0), MAC_HEADER_ROW(0, 1), MAC_HEADER_ROW(0, 2), MAC_HEADER_ROW(0, 3),
+	MAC_HEADER_ROW(1, 0), MAC_HEADER_ROW(1, 1), MAC_HEADER_ROW(1, 2), MAC_HEADER_ROW(1, 3)
+};
+
+/************************************************************************************
+ * Function:
+ *      bool MiMAC_HeaderParse(uint8_t *frame, uint8_t frameLen, MAC_RECEIVED_PACKET *packet)
+ *
+ * Summary:
+ *      This function decodes the addressing fields of a received frame
+ *
+ * Description:
+ *      A frame without destination address is taken as broadcast, like a
+ *      short destination address of 0xFFFF.
+ *
+ * PreCondition:
+ *      None
+ *
+ * Parameters:
+ *      uint8_t * frame -               The frame starting with the frame control field
+ *      uint8_t frameLen -              The length of the frame without the FCS
+ *      MAC_RECEIVED_PACKET * packet -  The packet to fill
+ *
+ * Returns:
+ *      false if the addressing modes are not supported or the frame is shorter
+ *      than its header.
+ *
+ * Remarks:
+ *      None
+ *
+ *****************************************************************************************/
+bool MiMAC_HeaderParse(uint8_t *frame, uint8_t frameLen, MAC_RECEIVED_PACKET *packet)
+{
+	const MAC_HEADER_LAYOUT *layout;
+	uint8_t fcf0 = frame[0];
+
+#ifdef TARGET_SMALL
+	// small targets only talk within their PAN
+	fcf0 |= MAC_FCF_PANID_COMP;
+#endif
+	layout = &MACHeaderLayout[MAC_HEADER_INDEX(fcf0, frame[1])];
+	if ((0 == layout->headerLength) || (frameLen < layout->headerLength))
+	{
+		return false;
+	}
+
+	if ((0 == layout->dstAddrOffset) ||
+		((MAC_ADDR_MODE_SHORT == MAC_FCF_DST_MODE(frame[1])) &&
+		(frame[layout->dstAddrOffset] == 0xFF) && (frame[layout->dstAddrOffset + 1] == 0xFF)))
+	{
+		packet->flags.bits.broadcast = 1;
+	}
+
+	packet->framePending = (0 != (frame[0] & MAC_FCF_FRAME_PENDING));
+	packet->altSourceAddress = false;
+	packet->SourcePANID.Val = 0xFFFF;
+	if (layout->srcAddrOffset)
+	{
+		packet->flags.bits.sourcePrsnt = 1;
+		packet->altSourceAddress = (MAC_ADDR_MODE_SHORT == MAC_FCF_SRC_MODE(frame[1]));
+		packet->SourcePANID.v[0] = frame[layout->srcPanIdOffset];
+		packet->SourcePANID.v[1] = frame[layout->srcPanIdOffset + 1];
+		packet->SourceAddress = &frame[layout->srcAddrOffset];
+	}
+
+	packet->Payload = &frame[layout->headerLength];
+	packet->PayloadLen = frameLen - layout->headerLength;
+	return true;
+}
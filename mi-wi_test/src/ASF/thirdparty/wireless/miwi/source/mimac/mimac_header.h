@@ -0,0 +1,146 @@
+/**
+* \file  mimac_header.h
+*
+* \brief IEEE 802.15.4 MAC header layouts
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries. 
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products. 
+* It is your responsibility to comply with third party license terms applicable 
+* to your use of third party software (including open source software) that 
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, 
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, 
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, 
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE 
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL 
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE 
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE 
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT 
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY 
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY, 
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+#ifndef __MIMAC_HEADER_H
+#define __MIMAC_HEADER_H
+
+	#include "mimac_at86rf.h"
+
+	/*********************************************************************/
+	// Frame control field. The addressing modes of the second byte give
+	// the length of the address fields, PAN ID compression in the first
+	// byte drops the source PAN ID of frames with both addresses.
+	/*********************************************************************/
+	#define MAC_FCF_SECURITY            0x08
+	#define MAC_FCF_FRAME_PENDING       0x10
+	#define MAC_FCF_PANID_COMP          0x40
+
+	#define MAC_ADDR_MODE_NONE          0x00
+	#define MAC_ADDR_MODE_SHORT         0x02
+	#define MAC_ADDR_MODE_LONG          0x03
+
+	#define MAC_FCF_DST_MODE(fcf1)      (((fcf1) >> 2) & 0x03)
+	#define MAC_FCF_SRC_MODE(fcf1)      (((fcf1) >> 6) & 0x03)
+
+	/* Frame control, sequence number, then the destination PAN ID */
+	#define MAC_HEADER_PANID_OFFSET     3
+
+	/*********************************************************************/
+	// The layout table is generated by the preprocessor from these rules.
+	// Only the addressing modes of MiWi frames are supported: both
+	// addresses present, a short destination only (broadcast commands)
+	// or a short source only (beacons).
+	/*********************************************************************/
+	#define MAC_ADDR_LEN(mode)          (((mode) == MAC_ADDR_MODE_LONG) ? 8 : (((mode) == MAC_ADDR_MODE_SHORT) ? 2 : 0))
+
+	#define MAC_HEADER_SUPPORTED(dm, sm)                                         \
+		((((dm) >= MAC_ADDR_MODE_SHORT) && ((sm) >= MAC_ADDR_MODE_SHORT)) ||     \
+		(((dm) == MAC_ADDR_MODE_NONE) && ((sm) == MAC_ADDR_MODE_SHORT)) ||       \
+		(((dm) == MAC_ADDR_MODE_SHORT) && ((sm) == MAC_ADDR_MODE_NONE)))
+
+	#define MAC_HEADER_DST_END(dm)      (MAC_HEADER_PANID_OFFSET + ((dm) ? (2 + MAC_ADDR_LEN(dm)) : 0))
+	#define MAC_HEADER_SRC_PANID(c, dm, sm)    ((sm) && !((c) && (dm)))
+	#define MAC_HEADER_SRC_END(c, dm, sm)                                        \
+		(MAC_HEADER_DST_END(dm) + (MAC_HEADER_SRC_PANID(c, dm, sm) ? 2 : 0))
+
+	#define MAC_HEADER_ENTRY(c, dm, sm)                                          \
+		{                                                                        \
+			MAC_HEADER_SUPPORTED(dm, sm) ?                                       \
+				(MAC_HEADER_SRC_END(c, dm, sm) + MAC_ADDR_LEN(sm)) : 0,          \
+			(MAC_HEADER_SUPPORTED(dm, sm) && (dm)) ? MAC_HEADER_PANID_OFFSET : 0, \
+			(MAC_HEADER_SUPPORTED(dm, sm) && (dm)) ? (MAC_HEADER_PANID_OFFSET + 2) : 0, \
+			(MAC_HEADER_SUPPORTED(dm, sm) && (sm)) ?                             \
+				(MAC_HEADER_SRC_PANID(c, dm, sm) ? MAC_HEADER_DST_END(dm) : MAC_HEADER_PANID_OFFSET) : 0, \
+			(MAC_HEADER_SUPPORTED(dm, sm) && (sm)) ? MAC_HEADER_SRC_END(c, dm, sm) : 0 \
+		}
+
+	#define MAC_HEADER_ROW(c, sm)                                                \
+		MAC_HEADER_ENTRY(c, 0, sm), MAC_HEADER_ENTRY(c, 1, sm),                  \
+		MAC_HEADER_ENTRY(c, 2, sm), MAC_HEADER_ENTRY(c, 3, sm)
+
+	/* Table index from the two frame control bytes */
+	#define MAC_HEADER_INDEX(fcf0, fcf1)                                         \
+		(((((fcf0) & MAC_FCF_PANID_COMP) ? 1 : 0) << 4) | (MAC_FCF_SRC_MODE(fcf1) << 2) | MAC_FCF_DST_MODE(fcf1))
+
+	#define MAC_HEADER_LAYOUTS          32
+
+	/***************************************************************************
+	 * Offsets of the fields of a MAC header from the frame control field, 0 if
+	 * the field is not present
+	 **************************************************************************/
+	typedef struct
+	{
+		uint8_t headerLength;           // Header length, 0 if the addressing modes are not supported
+		uint8_t dstPanIdOffset;         // Destination PAN ID
+		uint8_t dstAddrOffset;          // Destination address
+		uint8_t srcPanIdOffset;         // PAN ID of the sender, the destination PAN ID if compressed
+		uint8_t srcAddrOffset;          // Source address
+	} MAC_HEADER_LAYOUT;
+
+	extern const MAC_HEADER_LAYOUT MACHeaderLayout[MAC_HEADER_LAYOUTS];
+
+	/************************************************************************************
+	 * Function:
+	 *      bool MiMAC_HeaderParse(uint8_t *frame, uint8_t frameLen, MAC_RECEIVED_PACKET *packet)
+	 *
+	 * Summary:
+	 *      This function decodes the addressing fields of a received frame
+	 *
+	 * Description:
+	 *      The broadcast and source present flags, the source PAN ID and address
+	 *      and the MAC payload of the packet are set from the header layout of
+	 *      the frame, the frame pending flag from its frame control. The
+	 *      pointers refer into the frame.
+	 *
+	 * PreCondition:
+	 *      None
+	 *
+	 * Parameters:
+	 *      uint8_t * frame -               The frame starting with the frame control field
+	 *      uint8_t frameLen -              The length of the frame without the FCS
+	 *      MAC_RECEIVED_PACKET * packet -  The packet to fill
+	 *
+	 * Returns:
+	 *      false if the addressing modes are not supported or the frame is shorter
+	 *      than its header.
+	 *
+	 * Remarks:
+	 *      None
+	 *
+	 *****************************************************************************************/
+	bool MiMAC_HeaderParse(uint8_t *frame, uint8_t frameLen, MAC_RECEIVED_PACKET *packet);
+
+#endif
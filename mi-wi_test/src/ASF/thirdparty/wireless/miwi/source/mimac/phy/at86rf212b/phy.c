@@ -49,51 +49,89 @@
 #include "phy_at86rf212b.h"
 #include "mimem.h"
 #include "miqueue.h"
+#include "miring.h"
+#include "sysTimer.h"
 #include "string.h"
 
 /*- Definitions ------------------------------------------------------------*/
 #define PHY_CRC_SIZE    2
 
+/* The interrupt driven driver serves OTAU and the receive ring */
+#if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE)) || defined(ENABLE_PHY_RX_IRQ)
+#define PHY_IRQ_MODE
+#endif
+
+#if defined(PHY_IRQ_MODE) && !defined(PHY_RX_RING_SIZE)
+#define PHY_RX_RING_SIZE    4
+#endif
+
 /*- Types ------------------------------------------------------------------*/
 typedef enum {
 	PHY_STATE_INITIAL,
 	PHY_STATE_IDLE,
 	PHY_STATE_SLEEP,
 	PHY_STATE_TX_WAIT_END,
-#if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE))
+#if defined(PHY_IRQ_MODE)
 	PHY_STATE_TX_CONFIRM,
-	PHY_STATE_RX_IND,
 	PHY_STATE_ED_WAIT,
 	PHY_STATE_ED_DONE,
 #endif
 } PhyState_t;
 
+#if defined(PHY_IRQ_MODE)
+/* Received frame, filled by the transceiver interrupt */
+typedef struct PhyRxFrame_t
+{
+	uint32_t timeStamp;		// MiWi_TickGet() at the end of the frame
+	uint8_t size;			// PSDU length including the FCS
+	uint8_t lqi;			// Link Quality Index
+	int8_t rssi;			// RSSI in dBm
+	uint8_t frame[1 + MAX_PSDU + 1];	// PHR, PSDU and LQI as in the frame buffer
+} PhyRxFrame_t;
+#endif
+
 /*- Prototypes -------------------------------------------------------------*/
 static void phyWriteRegister(uint8_t reg, uint8_t value);
 static uint8_t phyReadRegister(uint8_t reg);
-static void phyWaitState(uint8_t state);
 static void phyTrxSetState(uint8_t state);
 static void phySetChannel(void);
 static void phySetRxState(void);
 static int8_t phyRssiBaseVal(void);
+static void phyTxPowerApply(uint8_t reduction);
 
-#if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE))
+#if defined(PHY_IRQ_MODE)
 static void phyInterruptHandler(void);
+static bool phyRxFrameStore(PhyRxFrame_t *rxFrame);
+#else
+static void phyWaitState(uint8_t state);
 #endif
 
 /*- Variables --------------------------------------------------------------*/
 static PhyState_t phyState = PHY_STATE_INITIAL;
+#if !defined(PHY_IRQ_MODE)
 static uint8_t phyRxBuffer[128];
+#endif
 static bool phyRxState;
 static uint8_t phyBand;
 static uint8_t phyChannel;// TODO
 static uint8_t phyModulation;
+/* PHY_TX_PWR of PHY_SetTxPower and the value in the register now */
+static uint8_t phyTxPower;
+static uint8_t phyTxPowerReg;
 RxBuffer_t RxBuffer[BANK_SIZE];
 PHY_DataReq_t gPhyDataReq;
-#if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE))
-static PHY_DataInd_t ind;
+#if defined(PHY_IRQ_MODE)
+/* Written by the interrupt, read by PHY_TaskHandler */
+static PhyRxFrame_t phyRxFrames[PHY_RX_RING_SIZE];
+static MiRing_t phyRxRing;
 volatile uint8_t phyTxStatus;
-volatile int8_t phyRxRssi;
+/* Energy detection started by PHY_EdStart */
+static PHY_EdConfCb_t phyEdConfirmCallback;
+static uint8_t phyEdChannel;
+static uint8_t phyEdRxSyn;
+static volatile int8_t phyEdLevel;
+#endif
+#if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE))
 PHY_ReservedFrameIndCallback_t phyReserveFrameIndCallback = NULL;
 #endif
 MiQueue_t phyTxQueue;
@@ -106,7 +144,8 @@ void PHY_DataReq(PHY_DataReq_t* phyDataReq)
 {
     PhyTxFrame_t *phyDataRequestPtr = NULL;
 
-    phyDataRequestPtr = (PhyTxFrame_t *) MiMem_Alloc(sizeof(PhyTxFrame_t));
+    /* Every member is written below, no need to clear it */
+    phyDataRequestPtr = (PhyTxFrame_t *) MiMem_AllocNoClear(sizeof(PhyTxFrame_t));
 
     if (NULL == phyDataRequestPtr)
     {
@@ -133,6 +172,7 @@ void PHY_TxHandler(void)
 				return;
 			}
 			phyTrxSetState(TRX_CMD_TX_ARET_ON);
+			phyTxPowerApply(phyTxPtr->phyDataReq.txPowerReduction);
 
 			phyReadRegister(IRQ_STATUS_REG);
 
@@ -153,7 +193,7 @@ void PHY_TxHandler(void)
 			gPhyDataReq.polledConfirmation = phyTxPtr->phyDataReq.polledConfirmation;
 			gPhyDataReq.confirmCallback = phyTxPtr->phyDataReq.confirmCallback;
 
-#if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE))
+#if defined(PHY_IRQ_MODE)
 			if(gPhyDataReq.polledConfirmation)
 			{
 				uint8_t status;
@@ -186,6 +226,7 @@ void PHY_TxHandler(void)
 				/* Post the confirmation */
 				gPhyDataReq.confirmCallback(status);
 				gPhyDataReq.confirmCallback=  NULL;
+				phyTxPowerApply(0);
 				/* Set back the transceiver to RX ON state */
 				phySetRxState();
 				phyState = PHY_STATE_IDLE;
@@ -202,7 +243,7 @@ void PHY_TxHandler(void)
 
 /*************************************************************************//**
 *****************************************************************************/
-void PHY_Init(void)
+bool PHY_Init(void)
 {
 	trx_spi_init();
 	PhyReset();
@@ -211,7 +252,16 @@ void PHY_Init(void)
 	phyModulation = phyReadRegister(TRX_CTRL_2_REG) & 0x3f;
 	phyState = PHY_STATE_IDLE;
 
-#if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE))
+#if defined(ENABLE_MIMEM_SLAB)
+	/* One request entry is allocated for every frame */
+	if (!MiMem_SlabCreate(sizeof(PhyTxFrame_t), MIMEM_SLAB_PHY_FRAMES))
+	{
+		return false;
+	}
+#endif
+
+#if defined(PHY_IRQ_MODE)
+	miRingInit(&phyRxRing, phyRxFrames, sizeof(PhyRxFrame_t), PHY_RX_RING_SIZE);
 	phyWriteRegister(IRQ_MASK_REG , (1<<TRX_END) );
 #endif
 
@@ -248,15 +298,18 @@ void PHY_Init(void)
 	phyWriteRegister(TRX_CTRL_2_REG, (1 << RX_SAFE_MODE) | (1 << ALT_SPECTRUM) |
 	(1 << BPSK_OQPSK) | (1 << SUB_MODE) | (2 << OQPSK_DATA_RATE));
 	phyWriteRegister(RF_CTRL_0_REG, 2);
-	phyWriteRegister(PHY_TX_PWR_REG, 0xc1);
+	phyTxPower = 0xc1;
+	phyTxPowerReg = phyTxPower;
+	phyWriteRegister(PHY_TX_PWR_REG, phyTxPower);
 	
 	phyModulation = phyReadRegister(TRX_CTRL_2_REG) & 0x3f;
 
-#if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE))
+#if defined(PHY_IRQ_MODE)
 	/* Interrupt Handler Initialization */
 	trx_irq_init((FUNC_PTR)phyInterruptHandler);
 	ENABLE_TRX_IRQ();
 #endif
+	return true;
 }
 
 
@@ -324,9 +377,27 @@ void PHY_SetShortAddr(uint16_t addr)
 
 void PHY_SetTxPower(uint8_t txPower)
 {
+	phyTxPower = (phyTxPower & ~0x1f) | txPower;
+	phyTxPowerApply(0);
+}
+
+/* Lowers the transmit power by reduction steps of TX_PWR, the register
+ * is only written when the value changes */
+static void phyTxPowerApply(uint8_t reduction)
+{
+	uint8_t level = (phyTxPower & 0x1f) + reduction;
 	uint8_t reg;
-	reg = phyReadRegister(PHY_TX_PWR_REG) & ~0x1f;
-	phyWriteRegister(PHY_TX_PWR_REG, reg | txPower);
+
+	if (level > 0x1f)
+	{
+		level = 0x1f;
+	}
+	reg = (phyTxPower & ~0x1f) | level;
+	if (reg != phyTxPowerReg)
+	{
+		phyTxPowerReg = reg;
+		phyWriteRegister(PHY_TX_PWR_REG, reg);
+	}
 }
 
 /*************************************************************************//**
@@ -426,7 +497,10 @@ uint8_t PHY_EdReq(void) //TODO datatype int8 or uint8
 	uint8_t ed;
 	uint8_t prev_rx_pdt_dis;
 
-
+#if defined(PHY_IRQ_MODE)
+	/* The interrupt would clear CCA_ED_DONE polled below */
+	DISABLE_TRX_IRQ();
+#endif
 	phyTrxSetState(TRX_CMD_PLL_ON);
 	phyReadRegister(IRQ_STATUS_REG);
 	/*Ensure that register bit RX_PDT_DIS is set to 0*/
@@ -447,6 +521,9 @@ uint8_t PHY_EdReq(void) //TODO datatype int8 or uint8
 	phySetRxState();
 
 	phyWriteRegister(RX_SYN_REG, prev_rx_pdt_dis);
+#if defined(PHY_IRQ_MODE)
+	ENABLE_TRX_IRQ();
+#endif
 
 /*	*Adding the base value gets the real value for ED which will be negative.
 		*Since the RSSI values will be used within the Same radio for comparisons
@@ -457,6 +534,53 @@ uint8_t PHY_EdReq(void) //TODO datatype int8 or uint8
 }
 
 
+#if defined(PHY_IRQ_MODE)
+/*************************************************************************//**
+*****************************************************************************/
+/* Starts an energy detection on the channel without waiting for it. The
+ * interrupt takes the result at CCA_ED_DONE and returns to the operating
+ * channel, PHY_TaskHandler hands the result to the callback. On the
+ * operating channel the transceiver keeps receiving meanwhile. A
+ * transmission, a frame being received or a sleeping transceiver keep it
+ * from starting, false is returned then and nothing is called back. */
+bool PHY_EdStart(uint8_t channel, PHY_EdConfCb_t confirmCallback)
+{
+	uint8_t status;
+
+	if ((PHY_STATE_IDLE != phyState) || phyTxQueue.size)
+	{
+		return false;
+	}
+	status = phyReadRegister(TRX_STATUS_REG) & TRX_STATUS_MASK;
+	if ((TRX_STATUS_BUSY_RX_AACK == status) || (TRX_STATUS_BUSY_RX == status))
+	{
+		return false;
+	}
+
+	phyEdConfirmCallback = confirmCallback;
+	phyEdChannel = channel;
+	if (channel != phyChannel)
+	{
+		uint8_t operatingChannel = phyChannel;
+
+		/* No frame is received while away from the operating channel */
+		phyEdRxSyn = phyReadRegister(RX_SYN_REG);
+		phyWriteRegister(RX_SYN_REG, phyEdRxSyn | (1 << RX_PDT_DIS));
+		phyTrxSetState(TRX_CMD_TRX_OFF);
+		phyChannel = channel;
+		phySetChannel();
+		phyChannel = operatingChannel;
+		phyTrxSetState(TRX_CMD_RX_ON);
+	}
+	phyReadRegister(IRQ_STATUS_REG);
+	phyWriteRegister(IRQ_MASK_REG, (1 << TRX_END) | (1 << CCA_ED_DONE));
+	/* The interrupt may come with the write below */
+	phyState = PHY_STATE_ED_WAIT;
+	phyWriteRegister(PHY_ED_LEVEL_REG, 0xFF);
+	return true;
+}
+#endif
+
 /*************************************************************************//**
 *****************************************************************************/
 static void phyWriteRegister(uint8_t reg, uint8_t value)
@@ -475,6 +599,7 @@ static uint8_t phyReadRegister(uint8_t reg)
 	return value;
 }
 
+#if !defined(PHY_IRQ_MODE)
 /*************************************************************************//**
 *****************************************************************************/
 static void phyWaitState(uint8_t state)
@@ -482,6 +607,7 @@ static void phyWaitState(uint8_t state)
 	while (state != (phyReadRegister(TRX_STATUS_REG) & TRX_STATUS_MASK)) {
 	}
 }
+#endif
 
 /*************************************************************************//**
 *****************************************************************************/
@@ -604,12 +730,22 @@ bool PHY_SubscribeReservedFrameIndicationCallback(PHY_ReservedFrameIndCallback_t
 }
 
 
+#endif /* OTAU_ENABLED && OTAU_PHY_MODE */
+
+#if defined(PHY_IRQ_MODE)
 /*************************************************************************//**
 *****************************************************************************/
-
-void PHY_DataInd(PHY_DataInd_t *dataInd)
+/* Moves a received frame into a free MiMAC bank, false if there is none */
+static bool phyRxFrameStore(PhyRxFrame_t *rxFrame)
 {
-	uint8_t i,RxBank=0xFF;
+	uint8_t i, RxBank = 0xFF;
+
+	/* Too long for a bank, drop it */
+	if ((rxFrame->size + 2) >= RX_PACKET_SIZE)
+	{
+		return true;
+	}
+
 	for (i = 0; i < BANK_SIZE; i++)
 	{
 		if (RxBuffer[i].PayloadLen == 0)
@@ -618,27 +754,24 @@ void PHY_DataInd(PHY_DataInd_t *dataInd)
 			break;
 		}
 	}
-	
-	if (RxBank < BANK_SIZE)
+	if (RxBank >= BANK_SIZE)
 	{
-		if(dataInd->size <= MAX_PSDU)
-		{
-			RxBuffer[RxBank].PayloadLen = dataInd->size + 2;
-			if (RxBuffer[RxBank].PayloadLen < RX_PACKET_SIZE)
-			{
-				//copy all of the data from the FIFO into the RxBuffer, plus RSSI and LQI
-				for (i = 0; i <= dataInd->size; i++)
-				{
-					RxBuffer[RxBank].Payload[i] = dataInd->data[i];
-				}
-				RxBuffer[RxBank].Payload[RxBuffer[RxBank].PayloadLen - 2] = dataInd->lqi + phyRssiBaseVal();
-				RxBuffer[RxBank].Payload[RxBuffer[RxBank].PayloadLen - 1] = dataInd->rssi + phyRssiBaseVal();
-		   }
-		}
+		return false;
 	}
+
+	/* PSDU and LQI, then RSSI in the last byte */
+	memcpy(RxBuffer[RxBank].Payload, &rxFrame->frame[1], rxFrame->size + 1);
+	RxBuffer[RxBank].Payload[rxFrame->size + 1] = (uint8_t)rxFrame->rssi;
+	RxBuffer[RxBank].TimeStamp = rxFrame->timeStamp;
+	/* The length hands the bank to MiMAC, so it is written last */
+	RxBuffer[RxBank].PayloadLen = rxFrame->size + 2;
+	return true;
 }
+
 void PHY_TaskHandler(void)
 {
+	PhyRxFrame_t *rxFrame;
+
 	PHY_TxHandler();
 
 	if (PHY_STATE_SLEEP == phyState)
@@ -648,7 +781,8 @@ void PHY_TaskHandler(void)
 
 	if (PHY_STATE_TX_CONFIRM == phyState)
 	{		
-		uint8_t status = (phyReadRegister(TRX_STATE_REG) >> TRAC_STATUS) & 7;
+		/* TRAC_STATUS is reused by RX_AACK, the interrupt kept a copy */
+		uint8_t status = phyTxStatus;
 
 		if (TRAC_STATUS_SUCCESS == status)
 		{
@@ -669,30 +803,54 @@ void PHY_TaskHandler(void)
 
 		gPhyDataReq.confirmCallback(status);
 		gPhyDataReq.confirmCallback = NULL;
-		phySetRxState();
+		/* The interrupt went back to RX_AACK_ON already */
+		if (!phyRxState)
+		{
+			phySetRxState();
+		}
 		phyState = PHY_STATE_IDLE;
+		/* A frame queued by the confirmation is written right away */
+		PHY_TxHandler();
 	}
-	else if (PHY_STATE_RX_IND == phyState)
+
+	if (PHY_STATE_ED_DONE == phyState)
+	{
+		phyState = PHY_STATE_IDLE;
+		phyEdConfirmCallback(phyEdLevel);
+		PHY_TxHandler();
+	}
+
+	/* Move every frame received since the last call; frames without a
+	 * free bank wait in the ring until MiMAC has handled one */
+	while (NULL != (rxFrame = (PhyRxFrame_t *)miRingPeek(&phyRxRing)))
 	{
 #ifdef OTAU_SERVER
-		uint16_t fcf = convert_byte_array_to_16_bit(ind.data);
+		uint16_t fcf = convert_byte_array_to_16_bit(&rxFrame->frame[1]);
 		if(FCF_GET_FRAMETYPE(fcf) == 0x07)
 		{
-			//delay_us(500);
+			PHY_DataInd_t ind;
+
+			ind.data = &rxFrame->frame[1];
+			ind.size = rxFrame->size;
+			ind.lqi  = rxFrame->lqi;
+			ind.rssi = rxFrame->rssi;
 			phyReserveFrameIndCallback(&ind);
 		}
 		else
 #endif
+		if (!phyRxFrameStore(rxFrame))
 		{
-			PHY_DataInd(&ind);
+			break;
 		}
-
-		while (TRX_CMD_PLL_ON != (phyReadRegister(TRX_STATUS_REG) & TRX_STATUS_TRX_STATUS_MASK));
-		phyState = PHY_STATE_IDLE;
-		phySetRxState();
+		miRingRelease(&phyRxRing);
 	}
 }
-		
+
+/*************************************************************************//**
+*****************************************************************************/
+/* Reads a received frame straight into the ring. The transceiver stays in
+ * RX_AACK_ON, the frame buffer protection (RX_SAFE_MODE) ends with the read,
+ * so the next frame can be received while the main loop is busy. */
 static void phyInterruptHandler(void)
 {
 	uint8_t irq;
@@ -702,42 +860,92 @@ static void phyInterruptHandler(void)
 	/* Keep compiler happy */
 	irq = irq;
 	
-	if (PHY_STATE_TX_WAIT_END == phyState)
+	if (PHY_STATE_ED_WAIT == phyState)
+	{
+		if (irq & (1 << CCA_ED_DONE))
+		{
+			uint8_t status = phyReadRegister(TRX_STATUS_REG) & TRX_STATUS_MASK;
+
+			/* The base value is the one of the channel measured */
+			phyEdLevel = (int8_t)(phyReadRegister(PHY_ED_LEVEL_REG) + phyRssiBaseVal());
+			phyWriteRegister(IRQ_MASK_REG, (1 << TRX_END));
+			if ((TRX_STATUS_BUSY_RX_AACK == status) || (TRX_STATUS_BUSY_RX == status))
+			{
+				/* A frame began meanwhile, that is not noise */
+				phyEdLevel = PHY_ED_LEVEL_INVALID;
+			}
+			if (phyEdChannel != phyChannel)
+			{
+				phyWriteRegister(RX_SYN_REG, phyEdRxSyn);
+				phyTrxSetState(TRX_CMD_TRX_OFF);
+				phySetChannel();
+				phySetRxState();
+			}
+			phyState = PHY_STATE_ED_DONE;
+		}
+	}
+	else if (PHY_STATE_TX_WAIT_END == phyState)
 	{
 		phyTxStatus = (phyReadRegister(TRX_STATE_REG) >> 5) & 0x07;
-		phyWriteRegister(TRX_STATE_REG, TRX_CMD_PLL_ON);
+		/* Acknowledgements go out at the power of PHY_SetTxPower */
+		phyTxPowerApply(0);
+		/* Receive again right away: the answer to a data request can
+		 * follow the acknowledgement before the main loop runs */
+		phyWriteRegister(TRX_STATE_REG, phyRxState ? TRX_CMD_RX_AACK_ON : TRX_CMD_PLL_ON);
 		phyState = PHY_STATE_TX_CONFIRM;
 	}
-	else if (PHY_STATE_IDLE == phyState)
+	else if ((PHY_STATE_IDLE == phyState) || (PHY_STATE_TX_CONFIRM == phyState) || (PHY_STATE_ED_DONE == phyState))
 	{
+		PhyRxFrame_t *rxFrame;
 		uint8_t size;
-		phyWriteRegister(TRX_STATE_REG, TRX_CMD_PLL_ON);
-		phyRxRssi = (int8_t)phyReadRegister(PHY_ED_LEVEL_REG);
+		int8_t rssi;
 
+		rssi = (int8_t)phyReadRegister(PHY_ED_LEVEL_REG);
 		trx_frame_read(&size,1);
 
 		if(size <= MAX_PSDU)
 		{
-			trx_frame_read(phyRxBuffer,size+2);
-			 
-			ind.data = phyRxBuffer+1;
-			ind.size = size;
-			ind.lqi  = phyRxBuffer[size+1];
-			ind.rssi = phyRxRssi + phyRssiBaseVal();
-
-#ifndef OTAU_SERVER
+			/* A full ring counts an overrun and the frame is dropped */
+			rxFrame = (PhyRxFrame_t *)miRingReserve(&phyRxRing);
+			if (NULL == rxFrame)
+			{
+				/* A pending transmit confirmation stays pending */
+				PhyState_t state = phyState;
+
+				phySetRxState();
+				phyState = state;
+				return;
+			}
+			trx_frame_read(rxFrame->frame, size + 2);
+
+			rxFrame->timeStamp = MiWi_TickGet();
+			rxFrame->size = size;
+			rxFrame->lqi  = rxFrame->frame[size + 1];
+			rxFrame->rssi = rssi + phyRssiBaseVal();
+
+#if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE)) && !defined(OTAU_SERVER)
 			uint16_t fcf;
-			fcf = convert_byte_array_to_16_bit(ind.data);
+			fcf = convert_byte_array_to_16_bit(&rxFrame->frame[1]);
 			if(FCF_GET_FRAMETYPE(fcf) == 0x07)
 			{
+				PHY_DataInd_t ind;
+
+				ind.data = &rxFrame->frame[1];
+				ind.size = rxFrame->size;
+				ind.lqi  = rxFrame->lqi;
+				ind.rssi = rxFrame->rssi;
 				delay_us(500);
+				/* Handled here, the reserved element is reused */
 				phyReserveFrameIndCallback(&ind);
-				phySetRxState();
+				if (PHY_STATE_IDLE == phyState)
+				{
+					phySetRxState();
+				}
 			}
 			else
 #endif
 			{
-				phyState = PHY_STATE_RX_IND;
+				miRingCommit(&phyRxRing);
 			}
 		}
 	}
@@ -786,6 +994,7 @@ void PHY_TaskHandler(void)
 							RxBuffer[RxBank].Payload[i-1] = phyRxBuffer[i];
 						}
 						RxBuffer[RxBank].Payload[RxBuffer[RxBank].PayloadLen - 1] = rssi + phyRssiBaseVal();
+						RxBuffer[RxBank].TimeStamp = MiWi_TickGet();
 					}
 				}
 				phyWaitState(TRX_STATUS_RX_AACK_ON);
@@ -812,8 +1021,11 @@ void PHY_TaskHandler(void)
 			}
 		    gPhyDataReq.confirmCallback(status);
 		    gPhyDataReq.confirmCallback = NULL;
+			phyTxPowerApply(0);
 			phySetRxState();
 			phyState = PHY_STATE_IDLE;
+			/* A frame queued by the confirmation is written right away */
+			PHY_TxHandler();
 		}
 	}
 }
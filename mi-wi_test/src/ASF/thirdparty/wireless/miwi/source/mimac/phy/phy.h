@@ -54,9 +54,12 @@
 
 /*********************************************************************/
 // BANK_SIZE defines the number of packet can be received and stored
-// to wait for handling in MiMAC layer.
+// to wait for handling in MiMAC layer. Applications that hold on to
+// received packets (MiMAC_RetainPacket) can raise it in miwi_config.h.
 /*********************************************************************/
+#if !defined(BANK_SIZE)
 #define BANK_SIZE         4
+#endif
 
 #define MAX_PSDU          127
 
@@ -241,12 +244,19 @@
 
 /*- Type definitions--------------------------------------------------------*/
 typedef void (*PHY_DataConfCb_t)(uint8_t status);
+/* Energy measured by PHY_EdStart in dBm, PHY_ED_LEVEL_INVALID when a
+ * frame was received meanwhile */
+typedef void (*PHY_EdConfCb_t)(int8_t ed);
+#define PHY_ED_LEVEL_INVALID    (-128)
 
 typedef struct PHY_DataReq_t
 {
 	bool polledConfirmation;
 	uint8_t *data;
 	PHY_DataConfCb_t confirmCallback;
+	/* Steps of TX_PWR, about 1 dB each, below the power set with
+	 * PHY_SetTxPower; acknowledgements are sent at that power */
+	uint8_t txPowerReduction;
 }PHY_DataReq_t;
 
 typedef struct _PhyTxFrame_t
@@ -280,7 +290,7 @@ typedef union
 } RADIO_STATUS;
 
 /*- Prototypes -------------------------------------------------------------*/
-void PHY_Init(void);
+bool PHY_Init(void);
 void PHY_SetRxState(bool rx);
 void PHY_SetChannel(uint8_t channel);
 void PHY_SetBand(uint8_t band);
@@ -299,6 +309,7 @@ void PHY_TaskHandler(void);
 void PHY_SetIEEEAddr(uint8_t *ieee_addr);
 uint16_t PHY_RandomReq(void);
 uint8_t PHY_EdReq(void);
+bool PHY_EdStart(uint8_t channel, PHY_EdConfCb_t confirmCallback);
 void PHY_EncryptReq(uint8_t *text, uint8_t *key);
 void PHY_EncryptReqCBC(uint8_t *text, uint8_t *key);
 void PHY_DecryptReq(uint8_t *text, uint8_t *key);
@@ -306,8 +317,6 @@ bool DataEncrypt(uint8_t *, uint8_t *, API_UINT32_UNION,
 uint8_t );
 bool DataDecrypt(uint8_t *Payload, uint8_t *PayloadLen, uint8_t *SourceIEEEAddress,
 API_UINT32_UNION FrameCounter, uint8_t FrameControl);
-void mic_generator (uint8_t *Payloadinfo, uint8_t  , uint8_t frame_control ,  API_UINT32_UNION FrameCounter , uint8_t * Address);
-bool validate_mic(void);
 
 #if (defined(OTAU_ENABLED) && defined(OTAU_PHY_MODE))
 void PHY_EnableReservedFrameRx(void);
@@ -366,6 +375,10 @@ bool PHY_SubscribeReservedFrameIndicationCallback(PHY_ReservedFrameIndCallback_t
 typedef struct
 {
 	uint8_t PayloadLen;
+	/* Holders of the packet, see MiMAC_RetainPacket */
+	uint8_t RefCount;
+	/* MiWi_TickGet() when the packet was read from the transceiver */
+	uint32_t TimeStamp;
 	uint8_t Payload[RX_PACKET_SIZE];
 } RxBuffer_t;
 
@@ -57,9 +57,12 @@
 #include "string.h"
 
 /********************************* Macro Definitions *************************************/
-#define PROTOCOL_TIMER_INTERVAL   1000
+/* The protocol timeouts are configured in seconds */
+#define PROTOCOL_TIMER_SECOND     1000
 #if defined(PROTOCOL_STAR)
 #define DATA_TIMER_INTERVAL       100
+/* Requests for the whole connection table within it share one snapshot */
+#define CONNECTION_TABLE_SNAPSHOT_WAIT  1000
 #endif
 #if defined(ENABLE_SLEEP_FEATURE)
 #define RECEIVE_ON_WHEN_IDLE     0x00
@@ -104,6 +107,54 @@ typedef struct _gSearchConnection
     SearchConnectionConf_callback_t gSearchConfCallback;
 } gSearchConnection_t;
 
+#if defined(ENABLE_BACKGROUND_ED_SCAN)
+typedef struct _edScan
+{
+    uint32_t channelMap;
+    uint8_t scanDuration;
+    bool inProgress;
+    /* Measurement started and not confirmed yet, on sampleChannel */
+    bool sampling;
+    uint8_t sampleChannel;
+    int16_t energySum;
+    uint8_t optimalChannel;
+    int8_t optimalEnergy;
+    EdScanResult_t result;
+    EdScanInd_callback_t indCallback;
+    EdScanConf_callback_t confCallback;
+} edScan_t;
+#endif
+
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR)
+typedef struct _channelMonitor
+{
+    /* Acknowledged frames sent in the period and the failed ones */
+    uint16_t txFrames;
+    uint16_t txFailures;
+    /* Last scan of each channel: mean energy in dBm and share of busy
+       samples, known for the channels set in scanned */
+    int8_t noise[32];
+    uint8_t busyPercent[32];
+    uint32_t scanned;
+    uint8_t degradedPeriods;
+    uint8_t holdoffPeriods;
+    /* All channels are scanned for one to hop to */
+    bool candidateScan;
+} channelMonitor_t;
+#endif
+
+#if defined(ENABLE_TX_POWER_CONTROL)
+/* Transmit power of a connection */
+typedef struct _txPowerLink
+{
+    /* RSSI of the frames of the peer in dBm, scaled by
+       1 << TX_POWER_CONTROL_RSSI_SHIFT, valid once known is set */
+    int16_t rssiAverage;
+    bool known;
+    uint8_t reduction;
+} txPowerLink_t;
+#endif
+
 /* Frame Transmit Structures */
 typedef struct _TxFrameEntry_t
 {
@@ -113,6 +164,8 @@ typedef struct _TxFrameEntry_t
     MAC_TRANS_PARAM frameParam;
     uint8_t frameLength;
     uint8_t frameHandle;
+    uint8_t txClass;
+    uint32_t queuedTick;
 } TxFrameEntry_t;
 
 typedef struct _TxFrame_t
@@ -155,19 +208,33 @@ MAC_RECEIVED_PACKET MACRxPacket;
 /* Long Address of the Device */
 uint8_t myLongAddress[MY_ADDRESS_LENGTH] = {EUI_0,EUI_1,EUI_2,EUI_3, EUI_4, EUI_5,EUI_6,EUI_7};
 
-/* Tx Frame Queue Parameters */
-MiQueue_t frameTxQueue;
-bool txCallbackReceived = true;
-TxFrame_t *sentFrame;
+/* Tx Frame Queue Parameters, one queue per transmit class */
+MiQueue_t frameTxQueue[TX_CLASS_COUNT];
+uint8_t frameTxQueued;
+static const uint8_t frameTxDepth[TX_CLASS_COUNT] =
+{
+    TX_CLASS_CONTROL_DEPTH, TX_CLASS_ALARM_DEPTH, TX_CLASS_NORMAL_DEPTH, TX_CLASS_BULK_DEPTH
+};
+/* Aging and deadline in ticks, 0 if not used */
+static const uint32_t frameTxAging[TX_CLASS_COUNT] =
+{
+    0, 0, TX_CLASS_NORMAL_AGING * ONE_MILI_SECOND, TX_CLASS_BULK_AGING * ONE_MILI_SECOND
+};
+static const uint32_t frameTxDeadline[TX_CLASS_COUNT] =
+{
+    TX_CLASS_CONTROL_DEADLINE * ONE_MILI_SECOND, TX_CLASS_ALARM_DEADLINE * ONE_MILI_SECOND,
+    TX_CLASS_NORMAL_DEADLINE * ONE_MILI_SECOND, TX_CLASS_BULK_DEADLINE * ONE_MILI_SECOND
+};
+/* Frames handed to MiMAC, confirmed in the order they were sent */
+static MiQueue_t sentFrameQueue;
 static MIWI_TICK lastTxFrameTick;
 static uint32_t transaction_duration_us = 0;
 #ifdef ENABLE_ED_SCAN
 static bool noiseDetectionInProgress = false;
 #endif
-static SYS_Timer_t protocolTimer;
 uint8_t backupChannel = 0xFF;
-/* Time interval parameter for active scan */
-uint16_t connectionTimeInterval = 0;
+/* Runs out with the wait for the connection response */
+static SYS_Timer_t connectionTimer;
 
 defaultParametersRomOrRam_t *miwiDefaultRomOrRamParams;
 defaultParametersRamOnly_t *miwiDefaultRamOnlyParams;
@@ -184,13 +251,17 @@ uint8_t end_nodes = 0;
 END_DEVICES_Unique_Short_Address  END_DEVICES_Short_Address[CONNECTION_SIZE];
 LinkFailureCallback_t linkFailureCallback;
 #if defined(ENABLE_PERIODIC_CONNECTIONTABLE_SHARE)
-/* Time interval parameter for broadcasting dev info */
-uint16_t sharePeerDevInfoTimeInterval = 0;
+/* Periodic timer for broadcasting dev info */
+static SYS_Timer_t sharePeerDevInfoTimer;
 #endif
 #if defined(ENABLE_LINK_STATUS)
-uint16_t inActiveDeviceCheckTimeInterval = 0;
-uint16_t linkStatusTimeInterval = 0;
+static SYS_Timer_t inActiveDeviceCheckTimer;
+static SYS_Timer_t linkStatusTimer;
 uint8_t linkStatusFailureCount = 0;
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+/* Seconds between link status of the END_DEVICES, PAN CO shares it */
+uint8_t linkStatusKeepAlive = LINK_STATUS_TIMEOUT;
+#endif
 #endif
 #endif
 #ifdef ENABLE_SLEEP_FEATURE
@@ -205,40 +276,96 @@ RECEIVED_MESSAGE  rxMessage;
 uint8_t conn_size = 0;
 
 #if defined(PROTOCOL_STAR)
-/* Queue to store frame requiring application level ack from destination */
-MiQueue_t appAckWaitDataQueue;
+/* Forwarded frames waiting for the SW ACK, in the slot of their sequence number */
+static AppAckWait_t appAckWaitTable[APP_ACK_WAIT_SIZE];
+/* Sequence number of the last forwarded frame waiting for the SW ACK */
+static uint8_t appAckSeq;
+/* Generation of the connection table shared with the end devices, moves
+   on with every change */
+static uint8_t connTableGeneration;
+/* Slot changed to reach each of the last generations, at the generation
+   modulo the log size */
+static uint8_t connTableDeltaLog[CONNECTION_TABLE_DELTA_LOG_SIZE];
+/* Number of the last generations the log holds the change of */
+static uint8_t connTableDeltaCount;
+/* Generation the end devices were last told about */
+static uint8_t connTableSharedGeneration;
+/* Set when the whole table is to be shared once the snapshot timer runs out */
+static bool connTableSnapshotPending;
+static SYS_Timer_t connTableSnapshotTimer;
+/* Generation of END_DEVICES_Short_Address on END_DEVICES, up to date
+   once a whole table has been received */
+static uint8_t peerTableGeneration;
+static bool peerTableSynced;
+/* Slot the next frame of the table being received starts at */
+static uint8_t peerTableNextSlot;
 #endif
 #if defined(ENABLE_ED_SCAN)
-/* Time interval parameter for active scan */
-uint16_t edScanDurationTimeInterval = 0;
+/* Runs out with the energy detection of a channel */
+static SYS_Timer_t edScanDurationTimer;
+#endif
+#if defined(ENABLE_BACKGROUND_ED_SCAN)
+/* Background energy detection scan, sampled by edScanSampleTimer, moves
+   to the next channel with edScanChannelTimer */
+static edScan_t edScanInfo;
+static SYS_Timer_t edScanSampleTimer;
+static SYS_Timer_t edScanChannelTimer;
 #endif
 #if defined(ENABLE_ACTIVE_SCAN)
-/* Time interval parameter for active scan */
-uint16_t activeScanDurationTimeInterval = 0;
+/* Runs out with the active scan of a channel */
+static SYS_Timer_t activeScanDurationTimer;
 #endif
 /* Queue to store frame with MAC level ack from destination */
 MiQueue_t macAckOnlyFrameQueue;
 
-/* Queue to store frame destined for sleeping devices */
-MiQueue_t indirectFrameQueue;
+#if defined(ENABLE_INDIRECT_MESSAGE)
+/* Frames held for the sleeping devices, one queue per connection index */
+MiQueue_t indirectFrameQueue[CONNECTION_SIZE];
+uint8_t indirectFrameCount;
+/* Held frames being sent, in the order of their confirmations */
+static MiQueue_t indirectTxQueue;
+/* Runs out with the oldest held frame */
+static SYS_Timer_t indirectExpiryTimer;
+#endif
 #ifdef ENABLE_SLEEP_FEATURE
-uint16_t dataRequestInterval = 0;
+/* Runs out when the next data request is due */
+static SYS_Timer_t dataRequestTimer;
 #endif
 #ifdef ENABLE_FREQUENCY_AGILITY
 /* Optimial Channel Choosen for Channel Hopping */
 uint8_t optimalChannel = 0xFF;
-uint16_t freqAgilityBroadcastInterval = 0;
+static SYS_Timer_t freqAgilityBroadcastTimer;
 uint8_t freqAgilityRetries = 0;
 bool channelChangeInProgress = false;
 #endif
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR)
+/* Looks at the operating channel every CHANNEL_MONITOR_PERIOD seconds */
+static SYS_Timer_t channelMonitorTimer;
+static channelMonitor_t channelMonitor;
+#endif
 PacketIndCallback_t pktRxcallback = NULL;
 #if defined(ENABLE_SECURITY)
 API_UINT32_UNION IncomingFrameCounter[CONNECTION_SIZE];  // If authentication is used, IncomingFrameCounter can prevent replay attack
 #endif
+/* Open addressing index of the connection table. The key is the short
+ * address, the first bytes of the long address, so both kinds of lookup
+ * use it. A bucket holds a connection index. */
+#define CONNECTION_HASH_EMPTY   0xFF
+static uint8_t connectionHash[CONNECTION_HASH_SIZE];
+#if defined(ENABLE_TX_POWER_CONTROL)
+/* Same index as the connection table */
+static txPowerLink_t txPowerLinks[CONNECTION_SIZE];
+#endif
 /************************************** Function Prototypes****************************************************/
 bool frameTransmit(INPUT bool Broadcast,API_UINT16_UNION DestinationPANID,INPUT uint8_t *DestinationAddress,INPUT bool isCommand,INPUT bool SecurityEnabled,
-                   INPUT uint8_t msgLen, INPUT uint8_t* msgPtr, INPUT uint8_t msghandle, INPUT bool ackReq, INPUT DataConf_callback_t ConfCallback);
+                   INPUT uint8_t msgLen, INPUT uint8_t* msgPtr, INPUT uint8_t msghandle, INPUT bool ackReq, INPUT bool framePending, INPUT uint8_t txClass,
+                   INPUT DataConf_callback_t ConfCallback);
+static TxFrame_t *frameTxSchedule(MIWI_TICK currentTick);
 static void CommandConfCallback(uint8_t msgConfHandle, miwi_status_t status, uint8_t* msgPointer);
+static bool commandFrameAlloc(CommandFrame_t *frame, uint8_t commandId, uint8_t size);
+static void commandFramePut(CommandFrame_t *frame, uint8_t value);
+static bool commandFrameTransmit(CommandFrame_t *frame, bool broadcast, API_UINT16_UNION panId, uint8_t *address,
+                                 bool secEn, DataConf_callback_t callback);
 static void frameTxCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPointer);
 static void frameParse(MAC_RECEIVED_PACKET *macRxPacket);
 #ifndef ENABLE_SLEEP_FEATURE
@@ -248,7 +375,8 @@ static void connReqConfCallback(uint8_t msgConfHandle, miwi_status_t status, uin
 uint8_t AddConnection(uint8_t capacityInfo);
 static miwi_status_t sendConnectionRequest(void);
 static void protocolTimerInit(void);
-static void protocolTimerHandler(SYS_Timer_t *timer);
+static void protocolTimerRestart(SYS_Timer_t *timer, uint32_t interval);
+static void connectionTimerHandler(SYS_Timer_t *timer);
 #ifdef ENABLE_ACTIVE_SCAN
 static uint8_t ScanChannel(void);
 #endif
@@ -256,16 +384,48 @@ static uint8_t ScanChannel(void);
 static inline  uint32_t miwi_scan_duration_ticks(uint8_t scan_duration);
 #endif
 static void removeConnection(uint8_t index);
+static uint16_t connectionHashHome(uint8_t *address);
+static void connectionHashInsert(uint8_t connIndex);
+static void connectionHashRemove(uint8_t connIndex);
+static void connectionHashRebuild(void);
+#if defined(ENABLE_TX_POWER_CONTROL)
+static void txPowerControlRssi(uint8_t *address, int8_t rssi);
+static uint8_t txPowerControlReduction(TxFrameEntry_t *txFrameEntry);
+static void txPowerControlReset(uint8_t connIndex);
+#endif
 
 #if defined(PROTOCOL_STAR)
-static SYS_Timer_t dataTimer;
-static void dataTimerHandler(SYS_Timer_t *timer);
-static void store_connection_tb(uint8_t *payload);
-static uint8_t Find_Index (uint8_t *DestAddr);
+static AppAckWait_t *appAckWaitAlloc(void);
+static AppAckWait_t *appAckWaitFind(uint8_t seq);
+static void appAckWaitRelease(AppAckWait_t *entry, miwi_status_t status);
+static void appAckWaitTimerHandler(SYS_Timer_t *timer);
+static void connTableChanged(uint8_t connIndex);
+static void connTableSendSnapshot(void);
+static void connTableSnapshotRequest(void);
+static void connTableSnapshotTimerHandler(SYS_Timer_t *timer);
+static void connTableSendDelta(void);
+static void connTableEntryWrite(CommandFrame_t *frame, uint8_t connIndex);
+static void storeConnectionTableSnapshot(uint8_t *payload, uint8_t payloadSize);
+static void storeConnectionTableDelta(uint8_t *payload, uint8_t payloadSize);
+static void storeConnectionTableEntry(uint8_t *entry);
+static void requestConnectionTable(void);
 static void startCompleteProcedure(bool timeronly);
 static void startLinkStatusTimer(void);
 static void sendLinkStatus(void);
 void findInActiveDevices(void);
+#if defined(ENABLE_LINK_STATUS)
+static void linkStatusTimerHandler(SYS_Timer_t *timer);
+static void inActiveDeviceCheckTimerHandler(SYS_Timer_t *timer);
+#endif
+#if defined(ENABLE_PERIODIC_CONNECTIONTABLE_SHARE)
+static void sharePeerDevInfoTimerHandler(SYS_Timer_t *timer);
+#endif
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+static void linkStatusMark(uint8_t *address);
+static void linkStatusFrameAcked(uint8_t *address);
+static void linkStatusKeepAliveAdapt(void);
+static void linkStatusKeepAliveSet(uint8_t keepAlive);
+#endif
 static void handleLostConnection(void);
 void appAckWaitDataCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPointer);
 static void MiApp_BroadcastConnectionTable(void);
@@ -274,11 +434,42 @@ static void MiApp_BroadcastConnectionTable(void);
 static void sendDataRequest(void);
 static void dataRequestConfCallback(uint8_t msgConfHandle, miwi_status_t status, uint8_t* msgPointer);
 static void rfdDataWaitTimerExpired(struct SYS_Timer_t *timer);
+static void dataRequestTimerHandler(SYS_Timer_t *timer);
+static void rfdDataReceived(bool framePending);
+#endif
+#if defined(ENABLE_INDIRECT_MESSAGE)
+static bool indirectFrameStore(uint8_t connIndex, P2PStarDataFrame_t *dataFramePtr);
+static void indirectFrameSend(uint8_t connIndex);
+static void indirectFrameDrop(IndirectFrame_t *entry);
+static void indirectFrameFlush(uint8_t connIndex);
+static void indirectFrameRelease(P2PStarDataFrame_t *dataFramePtr);
+static void indirectFrameConfCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPointer);
+static void indirectExpiryTimerStart(void);
+static void indirectExpiryTimerHandler(SYS_Timer_t *timer);
 #endif
+static void dataFrameConfirm(P2PStarDataFrame_t *dataFramePtr, uint8_t handle, miwi_status_t status, uint8_t* msgPointer);
 void macAckOnlyDataCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPointer);
 #ifdef ENABLE_FREQUENCY_AGILITY
 static void StartChannelHopping(void);
 static void channelHopCmdCallback(uint8_t msgConfHandle, miwi_status_t status, uint8_t* msgPointer);
+static void freqAgilityBroadcastTimerHandler(SYS_Timer_t *timer);
+#endif
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR)
+static void channelMonitorTimerHandler(SYS_Timer_t *timer);
+static void channelMonitorScanInd(EdScanResult_t *result);
+static void channelMonitorScanConf(uint8_t quietestChannel);
+#endif
+#ifdef ENABLE_ACTIVE_SCAN
+static void scanDurationExpired(SYS_Timer_t *timer);
+#endif
+#ifdef ENABLE_ED_SCAN
+static void edScanDurationExpired(SYS_Timer_t *timer);
+#endif
+#if defined(ENABLE_BACKGROUND_ED_SCAN)
+static void edScanChannelStart(void);
+static void edScanSampleTimerHandler(SYS_Timer_t *timer);
+static void edScanSampleConfirm(int8_t energy);
+static void edScanChannelTimerHandler(SYS_Timer_t *timer);
 #endif
 /********************* Function Definitions *******************************************/
 miwi_status_t MiApp_ProtocolInit(defaultParametersRomOrRam_t *defaultRomOrRamParams,
@@ -343,6 +534,15 @@ miwi_status_t MiApp_ProtocolInit(defaultParametersRomOrRam_t *defaultRomOrRamPar
     }
 #endif
     }
+    /* The connection table may have been restored */
+    connectionHashRebuild();
+#if defined(PROTOCOL_STAR)
+    /* End devices may hold any generation of a restored table */
+    connTableSnapshotPending = (0 != connTableDeltaCount);
+    connTableDeltaCount = 0;
+    connTableSharedGeneration = connTableGeneration;
+    peerTableSynced = false;
+#endif
     initValue.PAddress = myLongAddress;
     initValue.actionFlags.bits.CCAEnable = 1;
     initValue.actionFlags.bits.PAddrLength = MY_ADDRESS_LENGTH;
@@ -353,7 +553,28 @@ miwi_status_t MiApp_ProtocolInit(defaultParametersRomOrRam_t *defaultRomOrRamPar
 #endif
     initValue.actionFlags.bits.RepeaterMode = 0;
 
-    MiMAC_Init(initValue);
+#if defined(ENABLE_MIMEM_SLAB)
+    /* Size classes of the allocations made for every frame, a failure
+     * means MIMEM_SLAB_CLASSES or the heap is too small */
+    if (!MiMem_SlabCreate(sizeof(P2PStarDataFrame_t), MIMEM_SLAB_DATA_FRAMES) ||
+        !MiMem_SlabCreate(sizeof(TxFrame_t), MIMEM_SLAB_TX_FRAMES) ||
+        !MiMem_SlabCreate(TX_BUFFER_SIZE, MIMEM_SLAB_CMD_FRAMES) ||
+        !MiMem_SlabCreate(PACKETLEN_SMALL_COMMAND, MIMEM_SLAB_SMALL_CMD_FRAMES))
+    {
+        return MEMORY_UNAVAILABLE;
+    }
+#if defined(ENABLE_INDIRECT_MESSAGE)
+    if (!MiMem_SlabCreate(sizeof(IndirectFrame_t), MIMEM_SLAB_INDIRECT_FRAMES))
+    {
+        return MEMORY_UNAVAILABLE;
+    }
+#endif
+#endif
+
+    if (!MiMAC_Init(initValue))
+    {
+        return FAILURE;
+    }
 
     if (currentChannel != 0xFF)
         MiApp_Set(CHANNEL, &currentChannel);
@@ -366,10 +587,31 @@ miwi_status_t MiApp_ProtocolInit(defaultParametersRomOrRam_t *defaultRomOrRamPar
     protocolTimerInit();
 	
 #if defined(PROTOCOL_STAR)
-	miQueueInit(&appAckWaitDataQueue);
+	for (uint8_t slot = 0; slot < APP_ACK_WAIT_SIZE; slot++)
+	{
+		appAckWaitTable[slot].dataFramePtr = NULL;
+		appAckWaitTable[slot].timer.interval = (SW_ACK_TIMEOUT + 1) * DATA_TIMER_INTERVAL;
+		appAckWaitTable[slot].timer.mode = SYS_TIMER_INTERVAL_MODE;
+		appAckWaitTable[slot].timer.handler = appAckWaitTimerHandler;
+	}
 #endif
 	miQueueInit(&macAckOnlyFrameQueue);
-	miQueueInit(&indirectFrameQueue);
+#if defined(ENABLE_INDIRECT_MESSAGE)
+	for (uint8_t connIndex = 0; connIndex < CONNECTION_SIZE; connIndex++)
+	{
+		miQueueInit(&indirectFrameQueue[connIndex]);
+	}
+	miQueueInit(&indirectTxQueue);
+	indirectFrameCount = 0;
+	indirectExpiryTimer.mode = SYS_TIMER_INTERVAL_MODE;
+	indirectExpiryTimer.handler = indirectExpiryTimerHandler;
+#endif
+	for (uint8_t txClass = TX_CLASS_CONTROL; txClass < TX_CLASS_COUNT; txClass++)
+	{
+		miQueueInit(&frameTxQueue[txClass]);
+	}
+	frameTxQueued = 0;
+	miQueueInit(&sentFrameQueue);
 
     if (IN_NETWORK_STATE == p2pStarCurrentState)
     {
@@ -385,13 +627,13 @@ miwi_status_t MiApp_ProtocolInit(defaultParametersRomOrRam_t *defaultRomOrRamPar
             startLinkStatusTimer();
 #ifdef ENABLE_SLEEP_FEATURE
             /* Start data request timer upon network freezer restore */
-            dataRequestInterval = RFD_WAKEUP_INTERVAL;
+            protocolTimerRestart(&dataRequestTimer, RFD_WAKEUP_INTERVAL * PROTOCOL_TIMER_SECOND);
 #endif
         }
 #else
 #ifdef ENABLE_SLEEP_FEATURE
         /* Start data request timer upon network freezer restore */
-        dataRequestInterval = RFD_WAKEUP_INTERVAL;
+        protocolTimerRestart(&dataRequestTimer, RFD_WAKEUP_INTERVAL * PROTOCOL_TIMER_SECOND);
 #endif
 #endif
     }
@@ -539,14 +781,14 @@ static void sendScanConfirm(void)
 }
 /************************************************************************************
 * Function:
-*      static void scanDurationExpired(void)
+*      static void scanDurationExpired(SYS_Timer_t *timer)
 *
 * Summary:
 *      This callback function is called when scan timer is expired, so
 *      it tries to scan the next channel if available
 *
 *****************************************************************************************/
-static void scanDurationExpired(void)
+static void scanDurationExpired(SYS_Timer_t *timer)
 {
     uint8_t status;
 
@@ -578,7 +820,7 @@ static void ActiveScanReqConfcb(uint8_t handle, miwi_status_t confstatus, uint8_
     if (SUCCESS == confstatus)
     {
         /* Start the timer for scan Duration time */
-        activeScanDurationTimeInterval =  (miwi_scan_duration_ticks(gSearchConnectionInfo.scanDuration)/1000000) + 1;
+        protocolTimerRestart(&activeScanDurationTimer, miwi_scan_duration_ticks(gSearchConnectionInfo.scanDuration) / ONE_MILI_SECOND);
     }
     else
     {
@@ -607,32 +849,30 @@ static void ActiveScanReqConfcb(uint8_t handle, miwi_status_t confstatus, uint8_
 *****************************************************************************************/
 static uint8_t initiateActiveScanReq(void)
 {
-    uint8_t dataLen = 0;
-    uint8_t *dataPtr = NULL;
+    CommandFrame_t frame;
     API_UINT16_UNION broadcastPANID;
 
-    dataPtr = MiMem_Alloc(PACKETLEN_P2P_ACTIVE_SCAN_REQUEST);
-    if (NULL == dataPtr)
+    if ((SEARCHING_NETWORK != p2pStarCurrentState) && (RESYNC_IN_PROGRESS != p2pStarCurrentState))
+    {
+        return FAILURE;
+    }
+
+    if (!commandFrameAlloc(&frame, CMD_P2P_ACTIVE_SCAN_REQUEST, PACKETLEN_P2P_ACTIVE_SCAN_REQUEST))
         return MEMORY_UNAVAILABLE;
 
     /* Construct the P2P Active Scan Request */
-    dataPtr[dataLen++] = CMD_P2P_ACTIVE_SCAN_REQUEST;
-    dataPtr[dataLen++] = currentChannel;
+    commandFramePut(&frame, currentChannel);
     broadcastPANID.Val = 0xFFFF;
 
     /* Initiate the frame transmission */
     if (SEARCHING_NETWORK == p2pStarCurrentState)
     {
-        frameTransmit(true, broadcastPANID, NULL, true, false, dataLen, dataPtr,0, true, ActiveScanReqConfcb);
-    }
-    else if (RESYNC_IN_PROGRESS == p2pStarCurrentState)
-    {
-        frameTransmit(false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[resyncInfo.connectionIndex].Address, 
-                                      true, false, dataLen, dataPtr,0, true, ActiveScanReqConfcb);
+        commandFrameTransmit(&frame, true, broadcastPANID, NULL, false, ActiveScanReqConfcb);
     }
     else
     {
-        return FAILURE;
+        commandFrameTransmit(&frame, false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[resyncInfo.connectionIndex].Address,
+                             false, ActiveScanReqConfcb);
     }
 
     return SUCCESS;
@@ -793,14 +1033,14 @@ static inline  uint32_t miwi_scan_duration_ticks(uint8_t scan_duration)
 #ifdef ENABLE_ED_SCAN
 /************************************************************************************
 * Function:
-*      static void edScanDurationExpired(void)
+*      static void edScanDurationExpired(SYS_Timer_t *timer)
 *
 * Summary:
 *      This callback function is called when scan timer is expired, so
 *      it tries to scan the next channel if available
 *
 *****************************************************************************************/
-static void edScanDurationExpired(void)
+static void edScanDurationExpired(SYS_Timer_t *timer)
 {
     noiseDetectionInProgress = false;
 }
@@ -817,6 +1057,12 @@ uint8_t MiApp_NoiseDetection(uint32_t ChannelMap, uint8_t ScanDuration, uint8_t
     {
         return 0xFF;
     }
+#if defined(ENABLE_BACKGROUND_ED_SCAN)
+    if (edScanInfo.inProgress)
+    {
+        return 0xFF;
+    }
+#endif
     i = 0;
     while( i < 32 )
     {
@@ -829,7 +1075,7 @@ uint8_t MiApp_NoiseDetection(uint32_t ChannelMap, uint8_t ScanDuration, uint8_t
             MiApp_Set(CHANNEL, &i);
 
             /* Start the timer for scan Duration time */
-            edScanDurationTimeInterval = (miwi_scan_duration_ticks(ScanDuration)/1000000) + 1;
+            protocolTimerRestart(&edScanDurationTimer, miwi_scan_duration_ticks(ScanDuration) / ONE_MILI_SECOND);
 
 		    noiseDetectionInProgress = true;
 
@@ -864,6 +1110,134 @@ uint8_t MiApp_NoiseDetection(uint32_t ChannelMap, uint8_t ScanDuration, uint8_t
 
     return OptimalChannel;
 }
+
+#if defined(ENABLE_BACKGROUND_ED_SCAN)
+bool MiApp_EdScanStart(uint32_t ChannelMap, uint8_t ScanDuration,
+                       EdScanInd_callback_t IndCallback, EdScanConf_callback_t ConfCallback)
+{
+    ChannelMap &= MiMAC_GetPHYChannelInfo();
+    if (edScanInfo.inProgress || noiseDetectionInProgress || (0 == ChannelMap) || (NULL == IndCallback))
+    {
+        return false;
+    }
+    edScanInfo.channelMap = ChannelMap;
+    edScanInfo.scanDuration = ScanDuration;
+    edScanInfo.indCallback = IndCallback;
+    edScanInfo.confCallback = ConfCallback;
+    edScanInfo.optimalChannel = 0xFF;
+    edScanInfo.inProgress = true;
+    edScanChannelStart();
+    protocolTimerRestart(&edScanSampleTimer, ED_SCAN_SAMPLE_INTERVAL);
+    return true;
+}
+
+void MiApp_EdScanStop(void)
+{
+    SYS_TimerStop(&edScanSampleTimer);
+    SYS_TimerStop(&edScanChannelTimer);
+    edScanInfo.inProgress = false;
+}
+
+/* Scans the lowest channel of the map left */
+static void edScanChannelStart(void)
+{
+    EdScanResult_t *result = &edScanInfo.result;
+
+    for (result->channel = 0; 0 == (edScanInfo.channelMap & (1UL << result->channel)); result->channel++);
+    result->samples = 0;
+    result->busySamples = 0;
+    result->minEnergy = INT8_MAX;
+    result->maxEnergy = INT8_MIN;
+    edScanInfo.energySum = 0;
+    protocolTimerRestart(&edScanChannelTimer, miwi_scan_duration_ticks(edScanInfo.scanDuration) / ONE_MILI_SECOND);
+}
+
+/* Measures in the slots the stack is idle in, the device would otherwise
+   miss the answer to its frames */
+static void edScanSampleTimerHandler(SYS_Timer_t *timer)
+{
+    if (edScanInfo.sampling || frameTxQueued || sentFrameQueue.size)
+    {
+        return;
+    }
+#ifdef ENABLE_SLEEP_FEATURE
+    if (P2PStatus.bits.DataRequesting)
+    {
+        return;
+    }
+#endif
+    if (MiMAC_ChannelAssessmentStart(CHANNEL_ASSESSMENT_ENERGY_DETECT, edScanInfo.result.channel, edScanSampleConfirm))
+    {
+        edScanInfo.sampling = true;
+        edScanInfo.sampleChannel = edScanInfo.result.channel;
+    }
+}
+
+static void edScanSampleConfirm(int8_t energy)
+{
+    EdScanResult_t *result = &edScanInfo.result;
+
+    edScanInfo.sampling = false;
+    /* The scan of the channel may have ended meanwhile */
+    if (!edScanInfo.inProgress || (edScanInfo.sampleChannel != result->channel) || (0xFF == result->samples) ||
+        (CHANNEL_ASSESSMENT_ENERGY_INVALID == energy))
+    {
+        return;
+    }
+    result->samples++;
+    if (energy >= ED_SCAN_BUSY_LEVEL)
+    {
+        result->busySamples++;
+    }
+    edScanInfo.energySum += energy;
+    if (energy < result->minEnergy)
+    {
+        result->minEnergy = energy;
+    }
+    if (energy > result->maxEnergy)
+    {
+        result->maxEnergy = energy;
+    }
+}
+
+static void edScanChannelTimerHandler(SYS_Timer_t *timer)
+{
+    EdScanResult_t *result = &edScanInfo.result;
+
+    if (result->samples)
+    {
+        result->meanEnergy = (int8_t)(edScanInfo.energySum / result->samples);
+        if ((0xFF == edScanInfo.optimalChannel) || (result->meanEnergy < edScanInfo.optimalEnergy))
+        {
+            edScanInfo.optimalChannel = result->channel;
+            edScanInfo.optimalEnergy = result->meanEnergy;
+        }
+    }
+    else
+    {
+        result->minEnergy = 0;
+        result->meanEnergy = 0;
+        result->maxEnergy = 0;
+    }
+    edScanInfo.channelMap &= ~(1UL << result->channel);
+    edScanInfo.indCallback(result);
+    if (!edScanInfo.inProgress)
+    {
+        /* Stopped by the callback */
+        return;
+    }
+    if (edScanInfo.channelMap)
+    {
+        edScanChannelStart();
+        return;
+    }
+    MiApp_EdScanStop();
+    if (NULL != edScanInfo.confCallback)
+    {
+        edScanInfo.confCallback(edScanInfo.optimalChannel);
+    }
+}
+#endif
 #endif
 
 static void startCompleteProcedure(bool timeronly)
@@ -888,15 +1262,20 @@ static void startCompleteProcedure(bool timeronly)
 #if defined(ENABLE_LINK_STATUS)
     /* Start the timer for Finding in active devices and initiating remove connection
     if found any */
-    inActiveDeviceCheckTimeInterval = FIND_INACTIVE_DEVICE_TIMEOUT;
+    protocolTimerRestart(&inActiveDeviceCheckTimer, FIND_INACTIVE_DEVICE_TIMEOUT * PROTOCOL_TIMER_SECOND);
 #endif
 
 #if defined(ENABLE_PERIODIC_CONNECTIONTABLE_SHARE)
     /* Start the timer for sharing the connection table periodically */
-    sharePeerDevInfoTimeInterval = SHARE_PEER_DEVICE_INFO_TIMEOUT;
+    protocolTimerRestart(&sharePeerDevInfoTimer, SHARE_PEER_DEVICE_INFO_TIMEOUT * PROTOCOL_TIMER_SECOND);
 #endif
 #endif
 
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR)
+    /* The device that started the network decides on channel hops */
+    memset(&channelMonitor, 0, sizeof(channelMonitor));
+    protocolTimerRestart(&channelMonitorTimer, CHANNEL_MONITOR_PERIOD * PROTOCOL_TIMER_SECOND);
+#endif
 }
 /************************************************************************************************
     * Function:
@@ -1074,10 +1453,9 @@ static void connReqConfCallback(uint8_t msgConfHandle, miwi_status_t status, uin
     if (SUCCESS == status)
     {
         /* Start the timer to wait for connection response */
-        connectionTimeInterval = CONNECTION_INTERVAL;
+        protocolTimerRestart(&connectionTimer, CONNECTION_INTERVAL * PROTOCOL_TIMER_SECOND);
 #ifdef ENABLE_SLEEP_FEATURE
         rfdDataWaitTimer.handler = rfdDataWaitTimerExpired;
-        rfdDataWaitTimer.timeout = RFD_DATA_WAIT / 1000;
         rfdDataWaitTimer.interval = RFD_DATA_WAIT / 1000;
         rfdDataWaitTimer.mode = SYS_TIMER_INTERVAL_MODE;
 #endif
@@ -1102,27 +1480,23 @@ static miwi_status_t sendConnectionRequest(void)
 {
     if ((gEstConnectionInfo.connectionRetries > 0) &&  (ESTABLISHING_NETWORK ==  p2pStarCurrentState))
     {
-        uint8_t* dataPtr = NULL;
-        uint8_t dataLen = 0;
+        CommandFrame_t frame;
 
-        dataPtr = MiMem_Alloc(PACKETLEN_P2P_CONNECTION_REQUEST);
-
-        if (NULL == dataPtr)
+        if (!commandFrameAlloc(&frame, CMD_P2P_CONNECTION_REQUEST, PACKETLEN_P2P_CONNECTION_REQUEST))
           return MEMORY_UNAVAILABLE;
 
         /* Construct the full frame with command id and payload */
-        dataPtr[dataLen++] = CMD_P2P_CONNECTION_REQUEST;
-        dataPtr[dataLen++] = currentChannel;
-        dataPtr[dataLen++] = P2PCapacityInfo;
+        commandFramePut(&frame, currentChannel);
+        commandFramePut(&frame, P2PCapacityInfo);
 
 #if defined(PROTOCOL_STAR) && defined(MAKE_ENDDEVICE_PERMANENT)
-        dataPtr[dataLen++] = 0xAA;
+        commandFramePut(&frame, 0xAA);
 #endif
 
 #if ADDITIONAL_NODE_ID_SIZE > 0
         for(uint8_t i = 0; i < ADDITIONAL_NODE_ID_SIZE; i++)
         {
-            dataPtr[dataLen++] = miwiDefaultRomOrRamParams->AdditionalNodeID[i];
+            commandFramePut(&frame, miwiDefaultRomOrRamParams->AdditionalNodeID[i]);
         }
 #endif
 
@@ -1130,7 +1504,7 @@ static miwi_status_t sendConnectionRequest(void)
         uint16_t DestinationAddress16 = ((gEstConnectionInfo.address[1] << 8) + gEstConnectionInfo.address[0]);
         if( DestinationAddress16 == 0xFFFF )
         {
-            if(frameTransmit(true, myPANID, NULL, true, false, dataLen, dataPtr,0, true, connReqConfCallback))
+            if(commandFrameTransmit(&frame, true, myPANID, NULL, false, connReqConfCallback))
                 return SUCCESS;
             else
                 return MEMORY_UNAVAILABLE;
@@ -1157,8 +1531,8 @@ static miwi_status_t sendConnectionRequest(void)
             }
             if (deviceFound)
             {
-                if (frameTransmit(false, miwiDefaultRomOrRamParams->ActiveScanResults[i].PANID, miwiDefaultRomOrRamParams->ActiveScanResults[i].Address, true, false,
-                dataLen, dataPtr,0, true, connReqConfCallback))
+                if (commandFrameTransmit(&frame, false, miwiDefaultRomOrRamParams->ActiveScanResults[i].PANID, miwiDefaultRomOrRamParams->ActiveScanResults[i].Address,
+                false, connReqConfCallback))
                     return SUCCESS;
                 else
                     return MEMORY_UNAVAILABLE;
@@ -1166,7 +1540,7 @@ static miwi_status_t sendConnectionRequest(void)
             else
             {
                 /* Free the allocated memory */
-                MiMem_Free(dataPtr);
+                MiMem_Free(frame.data);
 
                 /* Change back state  */
                 p2pStarCurrentState = gEstConnectionInfo.backupState;
@@ -1178,7 +1552,7 @@ static miwi_status_t sendConnectionRequest(void)
             }
         }
 #else
-        if(frameTransmit(true, myPANID, NULL, true, false, dataLen, dataPtr,0, true, connReqConfCallback))
+        if(commandFrameTransmit(&frame, true, myPANID, NULL, false, connReqConfCallback))
             return SUCCESS;
         else
             return MEMORY_UNAVAILABLE;
@@ -1235,17 +1609,12 @@ uint8_t MiApp_EstablishConnection(uint8_t Channel, uint8_t addr_len, uint8_t *ad
 #if !defined(TARGET_SMALL)
 static void removeConnection(uint8_t index)
 {
-    uint8_t* dataPtr = NULL;
-    uint8_t dataLen = 0;
-
-    dataPtr = MiMem_Alloc(PACKETLEN_P2P_CONNECTION_REMOVAL_REQUEST);
+    CommandFrame_t frame;
 
-    if (NULL == dataPtr)
+    if (!commandFrameAlloc(&frame, CMD_P2P_CONNECTION_REMOVAL_REQUEST, PACKETLEN_P2P_CONNECTION_REMOVAL_REQUEST))
         return;
 
-    dataPtr[dataLen++] = CMD_P2P_CONNECTION_REMOVAL_REQUEST;
-
-    frameTransmit(false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[index].Address, true, false, dataLen, dataPtr,0, true, CommandConfCallback);
+    commandFrameTransmit(&frame, false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[index].Address, false, CommandConfCallback);
 }
 /*********************************************************************
 * Function:
@@ -1294,6 +1663,7 @@ void MiApp_RemoveConnection(INPUT uint8_t ConnectionIndex)
                 removeConnection(i);
             }
             miwiDefaultRomOrRamParams->ConnectionTable[i].status.Val = 0;
+            connectionHashRemove(i);
 #if defined(ENABLE_NETWORK_FREEZER)
             PDS_Store(PDS_CONNECTION_TABLE_ID);
 #endif
@@ -1304,6 +1674,7 @@ void MiApp_RemoveConnection(INPUT uint8_t ConnectionIndex)
         removeConnection(ConnectionIndex);
 
         miwiDefaultRomOrRamParams->ConnectionTable[ConnectionIndex].status.Val = 0;
+        connectionHashRemove(ConnectionIndex);
 
 #if defined(ENABLE_NETWORK_FREEZER)
        PDS_Store(PDS_CONNECTION_TABLE_ID);
@@ -1323,6 +1694,16 @@ bool MiApp_SubscribeDataIndicationCallback(PacketIndCallback_t callback)
     return false;
 }
 
+bool MiApp_MessageHold(RECEIVED_MESSAGE *msg)
+{
+    return MiMAC_RetainPacket(msg->Handle);
+}
+
+void MiApp_MessageRelease(RECEIVED_MESSAGE *msg)
+{
+    MiMAC_ReleasePacket(msg->Handle);
+}
+
 #ifdef ENABLE_ACTIVE_SCAN
 bool MiApp_ResyncConnection(INPUT uint8_t ConnectionIndex, INPUT uint32_t ChannelMap, resyncConnection_callback_t callback)
 {
@@ -1355,8 +1736,19 @@ bool MiApp_ResyncConnection(INPUT uint8_t ConnectionIndex, INPUT uint32_t Channe
 
 bool MiApp_SendData(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *msgpointer, uint8_t msghandle,
                                                               bool ackReq, DataConf_callback_t ConfCallback)
+{
+	return MiApp_SendDataWithClass(addr_len, addr, msglen, msgpointer, msghandle, ackReq, TX_CLASS_NORMAL, ConfCallback);
+}
+
+bool MiApp_SendDataWithClass(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *msgpointer, uint8_t msghandle,
+                                                              bool ackReq, miwi_tx_class_t txClass, DataConf_callback_t ConfCallback)
 {
 	P2PStarDataFrame_t *dataFramePtr = NULL;
+	if ((TX_CLASS_CONTROL == txClass) || (txClass >= TX_CLASS_COUNT))
+	{
+		/* Stack commands only */
+		return false;
+	}
 	if (IN_NETWORK_STATE == p2pStarCurrentState &&  MAX_PAYLOAD >= msglen)
 	{
 	    bool broadcast = false;
@@ -1367,27 +1759,41 @@ bool MiApp_SendData(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *ms
 		    broadcast = true;
 #ifdef ENABLE_INDIRECT_MESSAGE
 		    uint8_t i;
-		    /* Add individual indirect entry for each sleeping device in connection table */
+		    /* One copy of the broadcast, shared by an indirect entry for each sleeping device in connection table */
+		    dataFramePtr = NULL;
 		    for(i = 0; i < CONNECTION_SIZE; i++)
 		    {
 			    if(miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.isValid && miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.RXOnWhenIdle == 0 
 					&& 50 < MiMem_PercentageOfFreeBuffers())
 			    {
-					dataFramePtr = (P2PStarDataFrame_t *)MiMem_Alloc(sizeof(P2PStarDataFrame_t));
 					if (NULL == dataFramePtr)
 					{
-						return false;
+						dataFramePtr = (P2PStarDataFrame_t *)MiMem_Alloc(sizeof(P2PStarDataFrame_t));
+						if (NULL == dataFramePtr)
+						{
+							return false;
+						}
+						dataFramePtr->dataFrame.confCallback = ConfCallback;
+						dataFramePtr->dataFrame.txClass = txClass;
+						dataFramePtr->dataFrame.msghandle = msghandle;
+						dataFramePtr->dataFrame.msgLength = msglen;
+						memcpy(&(dataFramePtr->dataFrame.msg), msgpointer, msglen);
+						dataFramePtr->dataFrame.ackReq = 0;
+						dataFramePtr->dataFrame.broadcast = 1;
 					}
-					dataFramePtr->dataFrame.confCallback = ConfCallback;
-					memcpy(&(dataFramePtr->dataFrame.destAddress), miwiDefaultRomOrRamParams->ConnectionTable[i].Address, MY_ADDRESS_LENGTH);
-					dataFramePtr->dataFrame.msghandle = msghandle;
-					dataFramePtr->dataFrame.msgLength = msglen;
-					memcpy(&(dataFramePtr->dataFrame.msg), msgpointer, msglen);
-					dataFramePtr->dataFrame.timeout = INDIRECT_MESSAGE_TIMEOUT;
-					dataFramePtr->dataFrame.ackReq = 0;
-					dataFramePtr->dataFrame.broadcast = 1;
-					miQueueAppend(&indirectFrameQueue, (miQueueBuffer_t*)dataFramePtr);
+					indirectFrameStore(i, dataFramePtr);
+			    }
+#if defined(ENABLE_MIMEM_STATS)
+			    else if (miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.isValid && miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.RXOnWhenIdle == 0)
+			    {
+					/* Sleeping device skipped, free memory is below half */
+					MiMem_StatsFailure(__FILE__, __LINE__);
 			    }
+#endif
+		    }
+		    if ((NULL != dataFramePtr) && (0 == dataFramePtr->dataFrame.refCount))
+		    {
+				MiMem_Free(dataFramePtr);
 		    }
 #endif
 			/* Also send the broadcast for all the Non-sleeping end devices */
@@ -1397,41 +1803,45 @@ bool MiApp_SendData(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *ms
 				return false;
 			}
 			dataFramePtr->dataFrame.confCallback = ConfCallback;
+			dataFramePtr->dataFrame.txClass = txClass;
 			dataFramePtr->dataFrame.msghandle = msghandle;
 			dataFramePtr->dataFrame.msgLength = msglen;
-			dataFramePtr->dataFrame.timeout = 0;
 			memcpy(&(dataFramePtr->dataFrame.msg), msgpointer, msglen);
-			frameTransmit(broadcast, myPANID, addr, false, false, msglen, dataFramePtr->dataFrame.msg, msghandle, 0, macAckOnlyDataCallback);
+			if (!frameTransmit(broadcast, myPANID, addr, false, false, msglen, dataFramePtr->dataFrame.msg, msghandle, 0, false, txClass, macAckOnlyDataCallback))
+			{
+				MiMem_Free(dataFramePtr);
+				return false;
+			}
 			miQueueAppend(&macAckOnlyFrameQueue, (miQueueBuffer_t*)dataFramePtr);
 			return true;
 	    }
 	    else
 	    {
 #ifdef ENABLE_INDIRECT_MESSAGE
-		    uint8_t i;
-		    
-		    for(i = 0; i < CONNECTION_SIZE; i++)
+		    uint8_t i = connectionHashFind(addr, LONG_ADDR_LEN);
+
+		    // check if RX on when idle
+		    if ((0xFF != i) && (miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.RXOnWhenIdle == 0))
 		    {
-			    // check if RX on when idle
-			    if(miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.isValid && (miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.RXOnWhenIdle == 0) &&
-			    isSameAddress(addr, miwiDefaultRomOrRamParams->ConnectionTable[i].Address) )
+			    dataFramePtr = (P2PStarDataFrame_t *)MiMem_Alloc(sizeof(P2PStarDataFrame_t));
+			    if (NULL == dataFramePtr)
 			    {
-					dataFramePtr = (P2PStarDataFrame_t *)MiMem_Alloc(sizeof(P2PStarDataFrame_t));
-					if (NULL == dataFramePtr)
-					{
-						return false;
-					}
-					dataFramePtr->dataFrame.confCallback = ConfCallback;
-					memcpy(&(dataFramePtr->dataFrame.destAddress), addr, MY_ADDRESS_LENGTH);
-					dataFramePtr->dataFrame.msghandle = msghandle;
-					dataFramePtr->dataFrame.msgLength = msglen;
-					memcpy(&(dataFramePtr->dataFrame.msg), msgpointer, msglen);
-					dataFramePtr->dataFrame.timeout = INDIRECT_MESSAGE_TIMEOUT;
-					dataFramePtr->dataFrame.ackReq = ackReq;
-					
-					miQueueAppend(&indirectFrameQueue, (miQueueBuffer_t*)dataFramePtr);
-					return true;
+				    return false;
+			    }
+			    dataFramePtr->dataFrame.confCallback = ConfCallback;
+			    dataFramePtr->dataFrame.txClass = txClass;
+			    memcpy(&(dataFramePtr->dataFrame.destAddress), addr, MY_ADDRESS_LENGTH);
+			    dataFramePtr->dataFrame.msghandle = msghandle;
+			    dataFramePtr->dataFrame.msgLength = msglen;
+			    memcpy(&(dataFramePtr->dataFrame.msg), msgpointer, msglen);
+			    dataFramePtr->dataFrame.ackReq = ackReq;
+
+			    if (!indirectFrameStore(i, dataFramePtr))
+			    {
+				    MiMem_Free(dataFramePtr);
+				    return false;
 			    }
+			    return true;
 		    }
 #endif
 	    }
@@ -1450,10 +1860,10 @@ bool MiApp_SendData(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *ms
 			return false;
 		}
 		dataFramePtr->dataFrame.confCallback = ConfCallback;
+		dataFramePtr->dataFrame.txClass = txClass;
 		memcpy(&(dataFramePtr->dataFrame.destAddress), addr, MY_ADDRESS_LENGTH);
 		dataFramePtr->dataFrame.msghandle = msghandle;
 		dataFramePtr->dataFrame.msgLength = msglen;
-		dataFramePtr->dataFrame.timeout = 0;
 		dataFramePtr->dataFrame.ackReq = ackReq;
 #if defined(PROTOCOL_STAR)
 		if (END_DEVICE == role)
@@ -1461,7 +1871,11 @@ bool MiApp_SendData(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *ms
 			if (MY_ADDRESS_LENGTH == addr_len && isSameAddress(addr, miwiDefaultRomOrRamParams->ConnectionTable[0].Address))
 			{
 				memcpy(&(dataFramePtr->dataFrame.msg), msgpointer, msglen);
-				frameTransmit(broadcast, myPANID, addr, false, false, msglen, dataFramePtr->dataFrame.msg, msghandle, ackReq, macAckOnlyDataCallback);
+				if (!frameTransmit(broadcast, myPANID, addr, false, false, msglen, dataFramePtr->dataFrame.msg, msghandle, ackReq, false, txClass, macAckOnlyDataCallback))
+				{
+					MiMem_Free(dataFramePtr);
+					return false;
+				}
 				miQueueAppend(&macAckOnlyFrameQueue, (miQueueBuffer_t*)dataFramePtr);
 			}
 			else
@@ -1471,19 +1885,35 @@ bool MiApp_SendData(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *ms
 				dataFramePtr->dataFrame.msg[1] = addr[0];
 				dataFramePtr->dataFrame.msg[2] = addr[1];
 				dataFramePtr->dataFrame.msg[3] = addr[2];
+				dataFramePtr->dataFrame.msg[4] = 0;
 
-				memcpy(&(dataFramePtr->dataFrame.msg[4]), msgpointer, msglen);
-				dataFramePtr->dataFrame.msgLength = msglen + 4;
+				memcpy(&(dataFramePtr->dataFrame.msg[FORWARD_PACKET_HEADER_SIZE]), msgpointer, msglen);
+				dataFramePtr->dataFrame.msgLength = msglen + FORWARD_PACKET_HEADER_SIZE;
 				if (ackReq)
 				{
-					dataFramePtr->dataFrame.timeout = SW_ACK_TIMEOUT + 1;
-					frameTransmit(broadcast, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[0].Address, true, false, dataFramePtr->dataFrame.msgLength, dataFramePtr->dataFrame.msg, msghandle, ackReq, appAckWaitDataCallback);
-					miQueueAppend(&appAckWaitDataQueue, (miQueueBuffer_t*)dataFramePtr);
-					SYS_TimerStart(&dataTimer);
+					AppAckWait_t *entry = appAckWaitAlloc();
+
+					if (NULL == entry)
+					{
+						/* Too many forwarded frames waiting for the SW ACK */
+						MiMem_Free(dataFramePtr);
+						return false;
+					}
+					dataFramePtr->dataFrame.msg[4] = entry->seq;
+					if (!frameTransmit(broadcast, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[0].Address, true, false, dataFramePtr->dataFrame.msgLength, dataFramePtr->dataFrame.msg, msghandle, ackReq, false, txClass, appAckWaitDataCallback))
+					{
+						MiMem_Free(dataFramePtr);
+						return false;
+					}
+					entry->dataFramePtr = dataFramePtr;
 				}
 				else
 				{
-					frameTransmit(broadcast, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[0].Address, true, false, dataFramePtr->dataFrame.msgLength, dataFramePtr->dataFrame.msg, msghandle, ackReq, macAckOnlyDataCallback);
+					if (!frameTransmit(broadcast, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[0].Address, true, false, dataFramePtr->dataFrame.msgLength, dataFramePtr->dataFrame.msg, msghandle, ackReq, false, txClass, macAckOnlyDataCallback))
+					{
+						MiMem_Free(dataFramePtr);
+						return false;
+					}
 					miQueueAppend(&macAckOnlyFrameQueue, (miQueueBuffer_t*)dataFramePtr);
 				}
 			}
@@ -1491,12 +1921,20 @@ bool MiApp_SendData(uint8_t addr_len, uint8_t *addr, uint8_t msglen, uint8_t *ms
 		else
 		{
 			memcpy(&(dataFramePtr->dataFrame.msg), msgpointer, msglen);
-			frameTransmit(broadcast, myPANID, addr, false, false, msglen, dataFramePtr->dataFrame.msg, msghandle, ackReq, macAckOnlyDataCallback);
+			if (!frameTransmit(broadcast, myPANID, addr, false, false, msglen, dataFramePtr->dataFrame.msg, msghandle, ackReq, false, txClass, macAckOnlyDataCallback))
+			{
+				MiMem_Free(dataFramePtr);
+				return false;
+			}
 			miQueueAppend(&macAckOnlyFrameQueue, (miQueueBuffer_t*)dataFramePtr);
 		}
 #else
 		memcpy(&(dataFramePtr->dataFrame.msg), msgpointer, msglen);
-		frameTransmit(broadcast, myPANID, addr, false, false, msglen, dataFramePtr->dataFrame.msg, msghandle, ackReq, macAckOnlyDataCallback);
+		if (!frameTransmit(broadcast, myPANID, addr, false, false, msglen, dataFramePtr->dataFrame.msg, msghandle, ackReq, false, txClass, macAckOnlyDataCallback))
+		{
+			MiMem_Free(dataFramePtr);
+			return false;
+		}
 		miQueueAppend(&macAckOnlyFrameQueue, (miQueueBuffer_t*)dataFramePtr);
 #endif
 	}
@@ -1508,10 +1946,99 @@ void CommandConfCallback(uint8_t msgConfHandle, miwi_status_t status, uint8_t* m
     MiMem_Free(msgPointer);
 }
 
+/*********************************************************************
+ * bool commandFrameAlloc(CommandFrame_t *frame, uint8_t commandId,
+ *                        uint8_t size)
+ *
+ * Overview:        Allocates the buffer of a command frame and writes
+ *                  the command identifier. The size is the PACKETLEN_*
+ *                  of the command: commands of up to
+ *                  PACKETLEN_SMALL_COMMAND bytes are served by the pool
+ *                  of small buffers and leave the larger ones to the
+ *                  data frames.
+ *
+ * Output:          false if no memory is available
+ ********************************************************************/
+static bool commandFrameAlloc(CommandFrame_t *frame, uint8_t commandId, uint8_t size)
+{
+    frame->data = MiMem_AllocNoClear(size);
+    frame->size = size;
+    frame->length = 0;
+    if (NULL == frame->data)
+    {
+        return false;
+    }
+    frame->data[frame->length++] = commandId;
+    return true;
+}
+
+/* Appends a byte to a command frame. Bytes past its size are only counted */
+static void commandFramePut(CommandFrame_t *frame, uint8_t value)
+{
+    if (frame->length < frame->size)
+    {
+        frame->data[frame->length] = value;
+    }
+    if (frame->length < 0xFF)
+    {
+        frame->length++;
+    }
+}
+
+/*********************************************************************
+ * bool commandFrameTransmit(CommandFrame_t *frame, bool broadcast,
+ *                           API_UINT16_UNION panId, uint8_t *address,
+ *                           bool secEn, DataConf_callback_t callback)
+ *
+ * Overview:        Sends a command frame with the MAC ACK requested
+ *                  (unless broadcast), in the control transmit class.
+ *                  The callback releases the buffer once the frame is
+ *                  sent. When it is not queued, or more bytes were put
+ *                  than the PACKETLEN_* of the command allows, the
+ *                  buffer is released here.
+ *
+ * Output:          true if the frame is queued
+ ********************************************************************/
+static bool commandFrameTransmit(CommandFrame_t *frame, bool broadcast, API_UINT16_UNION panId, uint8_t *address,
+                                 bool secEn, DataConf_callback_t callback)
+{
+    if ((frame->length <= frame->size) &&
+        frameTransmit(broadcast, panId, address, true, secEn, frame->length, frame->data, 0, true, false, TX_CLASS_CONTROL, callback))
+    {
+        return true;
+    }
+    MiMem_Free(frame->data);
+    return false;
+}
+
 static void frameTxCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPointer)
 {
-    txCallbackReceived = true;
+    TxFrame_t *sentFrame = (TxFrame_t *)miQueueRemove(&sentFrameQueue, NULL);
     DataConf_callback_t callback = sentFrame->txFrameEntry.frameConfCallback;
+#if defined(PROTOCOL_STAR) && defined(ENABLE_LINK_STATUS_AGGREGATION)
+    if ((SUCCESS == status) && sentFrame->txFrameEntry.frameParam.flags.bits.ackReq &&
+        !sentFrame->txFrameEntry.frameParam.flags.bits.broadcast)
+    {
+        linkStatusFrameAcked(sentFrame->txFrameEntry.frameDstAddr.v);
+    }
+#endif
+#if defined(ENABLE_TX_POWER_CONTROL)
+    if ((NO_ACK == status) && !sentFrame->txFrameEntry.frameParam.flags.bits.broadcast)
+    {
+        /* The peer may have faded away, back to full power */
+        txPowerControlReset(connectionHashFind(sentFrame->txFrameEntry.frameDstAddr.v, LONG_ADDR_LEN));
+    }
+#endif
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR)
+    if (sentFrame->txFrameEntry.frameParam.flags.bits.ackReq && !sentFrame->txFrameEntry.frameParam.flags.bits.broadcast)
+    {
+        channelMonitor.txFrames++;
+        if ((NO_ACK == status) || (CHANNEL_ACCESS_FAILURE == status))
+        {
+            channelMonitor.txFailures++;
+        }
+    }
+#endif
     if (NULL != callback)
     {
         callback(handle, status, msgPointer);
@@ -1580,25 +2107,23 @@ uint8_t AddConnection(uint8_t capacityInfo)
         }
 #endif
 
-    /* loop through all entry and locate an proper slot */
-    for(i = 0; i < CONNECTION_SIZE; i++)
+    /* check if the source address of current received packet is connected */
+    connectionSlot = connectionHashFind(rxMessage.SourceAddress, LONG_ADDR_LEN);
+    if( connectionSlot != 0xFF )
     {
-        /* check if the entry is valid */
-        if( miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.isValid )
+        status = STATUS_EXISTS;
+    }
+    else
+    {
+        /* locate the first empty slot */
+        for(i = 0; i < CONNECTION_SIZE; i++)
         {
-            // check if the entry address matches source address of current received packet
-            if( isSameAddress(rxMessage.SourceAddress, miwiDefaultRomOrRamParams->ConnectionTable[i].Address) )
+            if( !miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.isValid )
             {
                 connectionSlot = i;
-                status = STATUS_EXISTS;
                 break;
             }
         }
-        else if( connectionSlot == 0xFF )
-        {
-            /* store the first empty slot */
-            connectionSlot = i;
-        }
     }
 
     if( connectionSlot == 0xFF )
@@ -1612,6 +2137,15 @@ uint8_t AddConnection(uint8_t capacityInfo)
             return status;
         }
         MyindexinPC = connectionSlot;
+        if (STATUS_SUCCESS == status)
+        {
+#if defined(ENABLE_INDIRECT_MESSAGE)
+            /* Frames still held for the former device of the slot */
+            indirectFrameFlush(connectionSlot);
+#endif
+            /* The former device of the slot may still be indexed */
+            connectionHashRemove(connectionSlot);
+        }
         /* store the source address */
         for(i = 0; i < 8; i++)
         {
@@ -1621,6 +2155,7 @@ uint8_t AddConnection(uint8_t capacityInfo)
         /* store the capacity info and validate the entry */
         miwiDefaultRomOrRamParams->ConnectionTable[connectionSlot].status.bits.isValid = 1;
         miwiDefaultRomOrRamParams->ConnectionTable[connectionSlot].status.bits.RXOnWhenIdle = (capacityInfo & 0x01);
+        connectionHashInsert(connectionSlot);
 
         /* store possible additional connection payload */
 #if ADDITIONAL_NODE_ID_SIZE > 0
@@ -1676,20 +2211,206 @@ bool isSameAddress(INPUT uint8_t *Address1, INPUT uint8_t *Address2)
     return true;
 }
 
-#ifndef ENABLE_SLEEP_FEATURE
-static void connectionRespConfCallback(uint8_t msgConfHandle, miwi_status_t status, uint8_t* msgPointer)
+/*********************************************************************
+ * uint8_t connectionHashFind(uint8_t *Address, uint8_t AddressLength)
+ *
+ * Overview:        This function looks up a valid connection from the
+ *                  long address of a device, or from its short address
+ *                  (the first END_DEVICE_SHORT_ADDR_LEN bytes)
+ *
+ * PreCondition:    Protocol initialization has been done
+ *
+ * Input:
+ *          Address         - Pointer to the address to look up
+ *          AddressLength   - LONG_ADDR_LEN or END_DEVICE_SHORT_ADDR_LEN
+ *
+ * Output:
+ *          The connection table index, 0xFF if the device is not connected
+ *
+ * Side Effects:
+ *
+ ********************************************************************/
+uint8_t connectionHashFind(INPUT uint8_t *Address, INPUT uint8_t AddressLength)
 {
-    /* Free the Frame Memory */
-    MiMem_Free(msgPointer);
+    uint16_t bucket = connectionHashHome(Address);
+    uint8_t connIndex;
 
-#if defined(PROTOCOL_STAR)
-    /* Broadcast connection table upon a device join */
-    MiApp_BroadcastConnectionTable();
-#endif
-}
-#endif
+    /* The index is at most half full, there is always an empty bucket */
+    while (CONNECTION_HASH_EMPTY != (connIndex = connectionHash[bucket]))
+    {
+        CONNECTION_ENTRY *entry = &miwiDefaultRomOrRamParams->ConnectionTable[connIndex];
 
-#if defined(PROTOCOL_STAR)
+        if (entry->status.bits.isValid && (0 == memcmp(entry->Address, Address, AddressLength)))
+        {
+            return connIndex;
+        }
+        bucket = (bucket + 1) & (CONNECTION_HASH_SIZE - 1);
+    }
+    return 0xFF;
+}
+
+/* First bucket to probe for an address, from its short address */
+static uint16_t connectionHashHome(uint8_t *address)
+{
+    uint32_t key = address[0] | ((uint32_t)address[1] << 8) | ((uint32_t)address[2] << 16);
+
+    return (uint16_t)((key * 2654435761UL) >> 16) & (CONNECTION_HASH_SIZE - 1);
+}
+
+/* Indexes a connection once its address is stored */
+static void connectionHashInsert(uint8_t connIndex)
+{
+    uint16_t bucket = connectionHashHome(miwiDefaultRomOrRamParams->ConnectionTable[connIndex].Address);
+
+    while (CONNECTION_HASH_EMPTY != connectionHash[bucket])
+    {
+        if (connIndex == connectionHash[bucket])
+        {
+            return;
+        }
+        bucket = (bucket + 1) & (CONNECTION_HASH_SIZE - 1);
+    }
+    connectionHash[bucket] = connIndex;
+#if defined(PROTOCOL_STAR)
+    connTableChanged(connIndex);
+#endif
+}
+
+/* Drops a connection from the index. The entries behind it in the probe
+ * sequence move back, so that lookups never stop at the freed bucket. */
+static void connectionHashRemove(uint8_t connIndex)
+{
+    uint16_t hole, bucket, home;
+
+#if defined(ENABLE_TX_POWER_CONTROL)
+    /* The next device of the slot starts at full power */
+    txPowerControlReset(connIndex);
+#endif
+    for (hole = 0; hole < CONNECTION_HASH_SIZE; hole++)
+    {
+        if (connIndex == connectionHash[hole])
+        {
+            break;
+        }
+    }
+    if (CONNECTION_HASH_SIZE == hole)
+    {
+        return;
+    }
+
+    bucket = hole;
+    while (1)
+    {
+        bucket = (bucket + 1) & (CONNECTION_HASH_SIZE - 1);
+        if (CONNECTION_HASH_EMPTY == connectionHash[bucket])
+        {
+            break;
+        }
+        home = connectionHashHome(miwiDefaultRomOrRamParams->ConnectionTable[connectionHash[bucket]].Address);
+        /* The entry stays if its home lies cyclically in (hole, bucket] */
+        if ((hole < bucket) ? ((hole < home) && (home <= bucket)) : ((hole < home) || (home <= bucket)))
+        {
+            continue;
+        }
+        connectionHash[hole] = connectionHash[bucket];
+        hole = bucket;
+    }
+    connectionHash[hole] = CONNECTION_HASH_EMPTY;
+#if defined(PROTOCOL_STAR)
+    connTableChanged(connIndex);
+#endif
+}
+
+/* Indexes every valid connection of the table */
+static void connectionHashRebuild(void)
+{
+    uint8_t i;
+
+    memset(connectionHash, CONNECTION_HASH_EMPTY, sizeof(connectionHash));
+    for (i = 0; i < CONNECTION_SIZE; i++)
+    {
+        if (miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.isValid)
+        {
+            connectionHashInsert(i);
+        }
+    }
+}
+
+#if defined(ENABLE_TX_POWER_CONTROL)
+/* Sets the transmit power of the connection from the RSSI of a frame of
+   the peer: lowered by what the average RSSI exceeds the target by */
+static void txPowerControlRssi(uint8_t *address, int8_t rssi)
+{
+    uint8_t p = connectionHashFind(address, LONG_ADDR_LEN);
+    txPowerLink_t *link;
+    int16_t margin;
+
+    if (0xFF == p)
+    {
+        return;
+    }
+    link = &txPowerLinks[p];
+    if (!link->known)
+    {
+        link->rssiAverage = rssi * (1 << TX_POWER_CONTROL_RSSI_SHIFT);
+        link->known = true;
+    }
+    else
+    {
+        link->rssiAverage += rssi - link->rssiAverage / (1 << TX_POWER_CONTROL_RSSI_SHIFT);
+    }
+
+    margin = link->rssiAverage / (1 << TX_POWER_CONTROL_RSSI_SHIFT) - TX_POWER_CONTROL_TARGET_RSSI;
+    if (margin <= 0)
+    {
+        link->reduction = 0;
+    }
+    else
+    {
+        link->reduction = (margin > TX_POWER_CONTROL_MAX_REDUCTION) ? TX_POWER_CONTROL_MAX_REDUCTION : (uint8_t)margin;
+    }
+}
+
+/* Power reduction of a frame about to be sent, none for a broadcast or
+   a device not connected */
+static uint8_t txPowerControlReduction(TxFrameEntry_t *txFrameEntry)
+{
+    uint8_t p;
+
+    if (txFrameEntry->frameParam.flags.bits.broadcast)
+    {
+        return 0;
+    }
+    p = connectionHashFind(txFrameEntry->frameDstAddr.v, LONG_ADDR_LEN);
+    return (0xFF == p) ? 0 : txPowerLinks[p].reduction;
+}
+
+/* Full power again until a frame of the peer is heard */
+static void txPowerControlReset(uint8_t connIndex)
+{
+    if (connIndex < CONNECTION_SIZE)
+    {
+        txPowerLinks[connIndex].known = false;
+        txPowerLinks[connIndex].reduction = 0;
+    }
+}
+#endif
+
+#ifndef ENABLE_SLEEP_FEATURE
+static void connectionRespConfCallback(uint8_t msgConfHandle, miwi_status_t status, uint8_t* msgPointer)
+{
+    /* Free the Frame Memory */
+    MiMem_Free(msgPointer);
+
+#if defined(PROTOCOL_STAR)
+    /* Broadcast connection table upon a device join, the new device
+       needs all of it */
+    connTableSendSnapshot();
+#endif
+}
+#endif
+
+#if defined(PROTOCOL_STAR)
 #if defined(ENABLE_LINK_STATUS)
 static void linkStatusConfCallback(uint8_t msgConfHandle, miwi_status_t status, uint8_t* msgPointer)
 {
@@ -1700,9 +2421,9 @@ static void linkStatusConfCallback(uint8_t msgConfHandle, miwi_status_t status,
         if (linkStatusFailureCount >= MAX_LINK_STATUS_FAILURES)
         {
             /* Stop Timers */
-            linkStatusTimeInterval = 0;
+            SYS_TimerStop(&linkStatusTimer);
 #ifdef ENABLE_SLEEP_FEATURE
-            dataRequestInterval = 0;
+            SYS_TimerStop(&dataRequestTimer);
 #endif
             if ((NULL != linkFailureCallback) && (p2pStarCurrentState != DISCONNECTED))
             {
@@ -1720,18 +2441,15 @@ static void linkStatusConfCallback(uint8_t msgConfHandle, miwi_status_t status,
 
 static void sendLinkStatus(void)
 {
-    uint8_t* dataPtr = NULL;
-    uint8_t dataLen = 0;
+    CommandFrame_t frame;
 
     /* Allocate memory for link status command */
-    dataPtr = MiMem_Alloc(PACKETLEN_CMD_IAM_ALIVE);
-    if (NULL == dataPtr)
+    if (!commandFrameAlloc(&frame, CMD_IAM_ALIVE, PACKETLEN_CMD_IAM_ALIVE))
         return;
 
-    dataPtr[dataLen++] = CMD_IAM_ALIVE;
     /* Pan Co is @ index 0 of connection table of END_Device in a Star Network */
-    frameTransmit(false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[0].Address, true, false,
-    dataLen, dataPtr,0, true, linkStatusConfCallback);
+    commandFrameTransmit(&frame, false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[0].Address, false,
+    linkStatusConfCallback);
 }
 
 void findInActiveDevices(void)
@@ -1757,17 +2475,103 @@ void findInActiveDevices(void)
 static void startLinkStatusTimer(void)
 {
     /* Start the timer for sending link status periodically  */
-    linkStatusTimeInterval = LINK_STATUS_TIMEOUT;
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+    protocolTimerRestart(&linkStatusTimer, linkStatusKeepAlive * PROTOCOL_TIMER_SECOND);
+#else
+    protocolTimerRestart(&linkStatusTimer, LINK_STATUS_TIMEOUT * PROTOCOL_TIMER_SECOND);
+#endif
+}
+
+static void linkStatusTimerHandler(SYS_Timer_t *timer)
+{
+    /* Reload time interval since it is periodic timer */
+    startLinkStatusTimer();
+    sendLinkStatus();
+}
+
+static void inActiveDeviceCheckTimerHandler(SYS_Timer_t *timer)
+{
+    /* Reload time interval since it is periodic timer */
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+    protocolTimerRestart(timer, (uint32_t)FIND_INACTIVE_DEVICE_TIMEOUT * linkStatusKeepAlive * PROTOCOL_TIMER_SECOND / LINK_STATUS_TIMEOUT);
+#else
+    protocolTimerRestart(timer, FIND_INACTIVE_DEVICE_TIMEOUT * PROTOCOL_TIMER_SECOND);
+#endif
+    findInActiveDevices();
+}
+
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+/* PAN CO: counts a frame exchanged with an END_DEVICE as its link status */
+static void linkStatusMark(uint8_t *address)
+{
+    uint8_t p = connectionHashFind(address, END_DEVICE_SHORT_ADDR_LEN);
+
+    /* Saturate, the count must not wrap to zero within a check interval */
+    if ((0xFF != p) && (0xFF != miwiDefaultRomOrRamParams->ConnectionTable[p].link_status))
+    {
+        miwiDefaultRomOrRamParams->ConnectionTable[p].link_status++;
+    }
+}
+
+/* A unicast frame was acknowledged, PAN CO took it as link status of the
+   END_DEVICE on either side of it */
+static void linkStatusFrameAcked(uint8_t *address)
+{
+    if (PAN_COORD == role)
+    {
+        linkStatusMark(address);
+    }
+    else if (SYS_TimerStarted(&linkStatusTimer))
+    {
+        /* No need for link status until a whole keepalive interval is quiet */
+        startLinkStatusTimer();
+        linkStatusFailureCount = 0;
+    }
+}
+
+/* PAN CO: moves the keepalive interval one step towards the one of the
+   network size, one step at a time so that END_DEVICES which missed a
+   share are still heard within the inactive device check */
+static void linkStatusKeepAliveAdapt(void)
+{
+    uint16_t target = LINK_STATUS_TIMEOUT * (1 + conn_size / LINK_STATUS_AGGREGATION_DEVICES);
+
+    if (target > LINK_STATUS_AGGREGATION_MAX_TIMEOUT)
+    {
+        target = LINK_STATUS_AGGREGATION_MAX_TIMEOUT;
+    }
+    if (linkStatusKeepAlive + LINK_STATUS_TIMEOUT <= target)
+    {
+        linkStatusKeepAlive += LINK_STATUS_TIMEOUT;
+    }
+    else if (linkStatusKeepAlive >= target + LINK_STATUS_TIMEOUT)
+    {
+        linkStatusKeepAlive -= LINK_STATUS_TIMEOUT;
+    }
+}
+
+/* END_DEVICE: takes the keepalive interval shared by PAN CO */
+static void linkStatusKeepAliveSet(uint8_t keepAlive)
+{
+    if (keepAlive < LINK_STATUS_TIMEOUT)
+    {
+        return;
+    }
+    linkStatusKeepAlive = keepAlive;
+    if (SYS_TimerRemainingTimeout(&linkStatusTimer) > (uint32_t)keepAlive * PROTOCOL_TIMER_SECOND)
+    {
+        startLinkStatusTimer();
+    }
 }
 #endif
 #endif
+#endif
 
 #ifdef ENABLE_SLEEP_FEATURE
 static void dataRequestConfCallback(uint8_t msgConfHandle, miwi_status_t status, uint8_t* msgPointer)
 {
     MiMem_Free(msgPointer);
     rfdDataWaitTimer.handler = rfdDataWaitTimerExpired;
-    rfdDataWaitTimer.timeout = RFD_DATA_WAIT / 1000;
     rfdDataWaitTimer.interval = RFD_DATA_WAIT / 1000;
     rfdDataWaitTimer.mode = SYS_TIMER_INTERVAL_MODE;
     SYS_TimerStart(&rfdDataWaitTimer);
@@ -1775,21 +2579,53 @@ static void dataRequestConfCallback(uint8_t msgConfHandle, miwi_status_t status,
 
 static void sendDataRequest(void)
 {
-	uint8_t* dataPtr = NULL;
-	uint8_t dataLen = 0;
+	CommandFrame_t frame;
 
-	/* Allocate memory for link status command */
-	dataPtr = MiMem_Alloc(PACKETLEN_MAC_DATA_REQUEST);
-	if (NULL == dataPtr)
-	return;
+	/* Allocate memory for data request command */
+	if (!commandFrameAlloc(&frame, CMD_MAC_DATA_REQUEST, PACKETLEN_MAC_DATA_REQUEST))
+	{
+		/* Try again on the next wake up */
+		rfdDataWaitTimerExpired(&rfdDataWaitTimer);
+		return;
+	}
 
-	dataPtr[dataLen++] = CMD_MAC_DATA_REQUEST;
 	/* Pan Co is @ index 0 of connection table of END_Device in a Star Network */
-	frameTransmit(false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[0].Address, true, false,
-	dataLen, dataPtr,0, true, dataRequestConfCallback);
+	if (!commandFrameTransmit(&frame, false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[0].Address, false,
+	dataRequestConfCallback))
+	{
+		rfdDataWaitTimerExpired(&rfdDataWaitTimer);
+		return;
+	}
 	
 	P2PStatus.bits.DataRequesting = 1;
 }
+
+/*********************************************************************
+ * static void rfdDataReceived(bool framePending)
+ *
+ * Overview:        Handles a frame of the PAN coordinator which answers
+ *                  the data request
+ *
+ * Input:
+ *          bool    framePending    The coordinator holds more frames
+ *
+ * Note:            Each frame with the frame pending bit keeps the
+ *                  receiver on for RFD_PENDING_DATA_WAIT, the last one
+ *                  ends the wait so that the device sleeps right away.
+ ********************************************************************/
+static void rfdDataReceived(bool framePending)
+{
+    SYS_TimerStop(&rfdDataWaitTimer);
+    if (framePending)
+    {
+        rfdDataWaitTimer.interval = RFD_PENDING_DATA_WAIT / 1000;
+        SYS_TimerStart(&rfdDataWaitTimer);
+    }
+    else
+    {
+        rfdDataWaitTimerExpired(&rfdDataWaitTimer);
+    }
+}
 #endif
 
 /******************************************************************************
@@ -1835,6 +2671,30 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
 
     rxMessage.PacketLQI = MACRxPacket.LQIValue;
     rxMessage.PacketRSSI = MACRxPacket.RSSIValue;
+    rxMessage.Handle = MACRxPacket.Handle;
+    rxMessage.TimeStamp = MACRxPacket.TimeStamp;
+
+#if defined(ENABLE_TX_POWER_CONTROL)
+    if (rxMessage.flags.bits.srcPrsnt && !MACRxPacket.altSourceAddress)
+    {
+        txPowerControlRssi(rxMessage.SourceAddress, (int8_t)rxMessage.PacketRSSI);
+    }
+#endif
+#if defined(PROTOCOL_STAR) && defined(ENABLE_LINK_STATUS_AGGREGATION)
+    if ((PAN_COORD == role) && rxMessage.flags.bits.srcPrsnt)
+    {
+        /* Any frame of an END_DEVICE tells it is alive */
+        linkStatusMark(rxMessage.SourceAddress);
+    }
+#endif
+
+#ifdef ENABLE_SLEEP_FEATURE
+    if (P2PStatus.bits.DataRequesting && !P2PStatus.bits.DataRequestPending && rxMessage.flags.bits.srcPrsnt &&
+        isSameAddress(rxMessage.SourceAddress, miwiDefaultRomOrRamParams->ConnectionTable[0].Address))
+    {
+        rfdDataReceived(MACRxPacket.framePending);
+    }
+#endif
 
     /* Command Frames Handling */
     if( rxMessage.flags.bits.command )
@@ -1844,8 +2704,7 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
             case CMD_P2P_CONNECTION_REQUEST:
             {
 #ifndef ENABLE_SLEEP_FEATURE
-                uint8_t* dataPtr = NULL;
-                uint8_t dataLen = 0;
+                CommandFrame_t frame;
 #endif
 #if defined(PROTOCOL_STAR)
                 if(PAN_COORD != role)
@@ -1888,12 +2747,10 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
 #if defined(PROTOCOL_STAR) && defined(ENABLE_LINK_STATUS)
                 if (rxMessage.Payload[3] == 0xAA)
                 {
-                    for (uint8_t p = 0 ;p <CONNECTION_SIZE;p++)
+                    uint8_t p = connectionHashFind(rxMessage.SourceAddress, LONG_ADDR_LEN);
+                    if (0xFF != p)
                     {
-                        if (isSameAddress(rxMessage.SourceAddress, miwiDefaultRomOrRamParams->ConnectionTable[p].Address) )
-                        {
-                             miwiDefaultRomOrRamParams->ConnectionTable[p].permanent_connections = 0xFF;
-                        }
+                        miwiDefaultRomOrRamParams->ConnectionTable[p].permanent_connections = 0xFF;
                     }
                 }
 #endif
@@ -1905,39 +2762,37 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
                 if( (status == STATUS_SUCCESS || status == STATUS_EXISTS ) && MiApp_CB_AllowConnection(LatestConnection) == false )
                 {
                     miwiDefaultRomOrRamParams->ConnectionTable[LatestConnection].status.Val = 0;
+                    connectionHashRemove(LatestConnection);
                     status = STATUS_NOT_PERMITTED;
                 }
 
                 /* Prepare the P2P_CONNECTION_RESPONSE command */
-                dataPtr = MiMem_Alloc(TX_BUFFER_SIZE);
-
-                if (NULL == dataPtr)
+                if (!commandFrameAlloc(&frame, CMD_P2P_CONNECTION_RESPONSE, PACKETLEN_P2P_CONNECTION_RESPONSE))
                     return;
 
                 /* Fill Connection Response Structure */
-                dataPtr[dataLen++] = CMD_P2P_CONNECTION_RESPONSE;
-                dataPtr[dataLen++] = status;
+                commandFramePut(&frame, status);
 #if defined(PROTOCOL_STAR)
-                dataPtr[dataLen++] = MyindexinPC;
+                commandFramePut(&frame, MyindexinPC);
 #endif
                 if( status == STATUS_SUCCESS || status == STATUS_EXISTS )
                 {
-                    dataPtr[dataLen++] = P2PCapacityInfo;
+                    commandFramePut(&frame, P2PCapacityInfo);
 #if ADDITIONAL_NODE_ID_SIZE > 0
                     for(i = 0; i < ADDITIONAL_NODE_ID_SIZE; i++)
                     {
-                        dataPtr[dataLen++] = miwiDefaultRomOrRamParams->AdditionalNodeID[i];
+                        commandFramePut(&frame, miwiDefaultRomOrRamParams->AdditionalNodeID[i]);
                     }
 #endif
                 }
 
                 /* Unicast the P2P_CONNECTION_RESPONSE to the requesting device */
 #ifdef TARGET_SMALL
-                frameTransmit(false, myPANID, rxMessage.SourceAddress, true, rxMessage.flags.bits.secEn,
-                        dataLen, dataPtr, 0, true, connectionRespConfCallback);
+                commandFrameTransmit(&frame, false, myPANID, rxMessage.SourceAddress, rxMessage.flags.bits.secEn,
+                        connectionRespConfCallback);
 #else
-                frameTransmit(false, rxMessage.SourcePANID, rxMessage.SourceAddress, true, rxMessage.flags.bits.secEn,
-                        dataLen, dataPtr, 0, true, connectionRespConfCallback);
+                commandFrameTransmit(&frame, false, rxMessage.SourcePANID, rxMessage.SourceAddress, rxMessage.flags.bits.secEn,
+                        connectionRespConfCallback);
 #endif
 #if defined(ENABLE_NETWORK_FREEZER)
                 if( status == STATUS_SUCCESS )
@@ -2000,7 +2855,7 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
                         startLinkStatusTimer();
 #endif
 #ifdef ENABLE_SLEEP_FEATURE
-                        dataRequestInterval = RFD_WAKEUP_INTERVAL;
+                        protocolTimerRestart(&dataRequestTimer, RFD_WAKEUP_INTERVAL * PROTOCOL_TIMER_SECOND);
 #endif
                     }
 #if defined(PROTOCOL_STAR)
@@ -2023,8 +2878,7 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
 
             case CMD_P2P_ACTIVE_SCAN_REQUEST:
             {
-                uint8_t* dataPtr = NULL;
-                uint8_t dataLen = 0;
+                CommandFrame_t frame;
                 if(ConnMode > ENABLE_ACTIVE_SCAN_RSP)
                 {
                     return;
@@ -2035,28 +2889,25 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
                 }
 
                 /* Prepare Active Scan Response */
-                dataPtr = MiMem_Alloc(PACKETLEN_P2P_ACTIVE_SCAN_RESPONSE);
-
-                if (NULL == dataPtr)
+                if (!commandFrameAlloc(&frame, CMD_P2P_ACTIVE_SCAN_RESPONSE, PACKETLEN_P2P_ACTIVE_SCAN_RESPONSE))
                     return;
 
-                dataPtr[dataLen++] = CMD_P2P_ACTIVE_SCAN_RESPONSE;
-                dataPtr[dataLen++] = P2PCapacityInfo;
+                commandFramePut(&frame, P2PCapacityInfo);
 
 #if ADDITIONAL_NODE_ID_SIZE > 0
                 for(i = 0; i < ADDITIONAL_NODE_ID_SIZE; i++)
                 {
-                    dataPtr[dataLen++] = (miwiDefaultRomOrRamParams->AdditionalNodeID[i]);
+                    commandFramePut(&frame, miwiDefaultRomOrRamParams->AdditionalNodeID[i]);
                 }
 #endif
 
                 /* unicast the response to the requesting device */
 #ifdef TARGET_SMALL
-                frameTransmit(false, myPANID, rxMessage.SourceAddress, true, rxMessage.flags.bits.secEn,
-                dataLen, dataPtr, 0, true, CommandConfCallback);
+                commandFrameTransmit(&frame, false, myPANID, rxMessage.SourceAddress, rxMessage.flags.bits.secEn,
+                CommandConfCallback);
 #else
-                frameTransmit(false, rxMessage.SourcePANID, rxMessage.SourceAddress, true, rxMessage.flags.bits.secEn,
-                dataLen, dataPtr, 0, true, CommandConfCallback);
+                commandFrameTransmit(&frame, false, rxMessage.SourcePANID, rxMessage.SourceAddress, rxMessage.flags.bits.secEn,
+                CommandConfCallback);
 #endif
             }
             break;
@@ -2067,7 +2918,7 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
                 {
                     resyncInfo.resyncTimes = 0;
 #ifdef ENABLE_ACTIVE_SCAN
-                    activeScanDurationTimeInterval = 0;
+                    SYS_TimerStop(&activeScanDurationTimer);
 #endif
                     p2pStarCurrentState = IN_NETWORK_STATE;
                     resyncInfo.confCallback(currentChannel, SUCCESS);
@@ -2117,38 +2968,53 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
 #if defined (PROTOCOL_STAR)
             case CMD_SHARE_CONNECTION_TABLE:
             {
-                if (END_DEVICE == role)
+                if ((END_DEVICE == role) && (CONNECTION_TABLE_SNAPSHOT_HEADER_SIZE <= rxMessage.PayloadSize))
                 {
                     /* END_devices FFD|| RFD process this Packet */
-                    end_nodes = rxMessage.Payload[1];
-                    store_connection_tb(rxMessage.Payload);
+                    storeConnectionTableSnapshot(rxMessage.Payload, rxMessage.PayloadSize);
+                }
+            }
+            break;
+            case CMD_CONNECTION_TABLE_DELTA:
+            {
+                if ((END_DEVICE == role) && (CONNECTION_TABLE_DELTA_HEADER_SIZE <= rxMessage.PayloadSize))
+                {
+                    storeConnectionTableDelta(rxMessage.Payload, rxMessage.PayloadSize);
+                }
+            }
+            break;
+            case CMD_CONNECTION_TABLE_REQUEST:
+            {
+                if (PAN_COORD == role)
+                {
+                    /* Requests of several END_devices share the snapshot */
+                    connTableSnapshotRequest();
                 }
             }
             break;
             case CMD_DATA_TO_ENDDEV_SUCCESS:
             {
-				P2PStarDataFrame_t *dataFramePtr = NULL;
-				dataFramePtr = (P2PStarDataFrame_t *) miQueueRemove(&appAckWaitDataQueue, NULL);
-
-				if (NULL == dataFramePtr)
-				{
-					return;
-				}
-				DataConf_callback_t callback = dataFramePtr->dataFrame.confCallback;
-				if (NULL != callback)
+				if (PACKETLEN_CMD_DATA_TO_ENDDEV_SUCCESS <= rxMessage.PayloadSize)
 				{
-					callback(dataFramePtr->dataFrame.msghandle, SUCCESS, dataFramePtr->dataFrame.msg);
+					AppAckWait_t *entry = appAckWaitFind(rxMessage.Payload[1]);
+
+					/* The deadline runs once the MAC has confirmed the frame,
+					   before that it is still in use by the transmission */
+					if ((NULL != entry) && SYS_TimerStarted(&entry->timer))
+					{
+						SYS_TimerStop(&entry->timer);
+						appAckWaitRelease(entry, SUCCESS);
+					}
 				}
-				MiMem_Free((uint8_t *)dataFramePtr);
             }
             break;
             case CMD_FORWRD_PACKET:
             {
 				/* If the role is PANC, the data has to be forwarded to corresponding enddevice */
-	            if (PAN_COORD == role)
+	            if ((PAN_COORD == role) && (FORWARD_PACKET_HEADER_SIZE <= rxMessage.PayloadSize))
 	            {
 					/* Based on the end device short address, the index in connection table is retrieved */
-					uint8_t ed_index = Find_Index(&(rxMessage.Payload[1]));
+					uint8_t ed_index = connectionHashFind(&(rxMessage.Payload[1]), END_DEVICE_SHORT_ADDR_LEN);
 					if (0xFF != ed_index)
 					{
 						/* Allocate buffer for data forward and update */
@@ -2164,27 +3030,40 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
 						dataPtr->dataFrame.msg[dataLen++] = rxMessage.SourceAddress[0];    // Unique address of EDy (DEST ED)
 						dataPtr->dataFrame.msg[dataLen++] = rxMessage.SourceAddress[1];    // Unique address of EDy (DEST ED)
 						dataPtr->dataFrame.msg[dataLen++] = rxMessage.SourceAddress[2];    // Unique address of EDy (DEST ED)
-						for(i = 4; i < rxMessage.PayloadSize; i++)
+						for(i = FORWARD_PACKET_HEADER_SIZE; i < rxMessage.PayloadSize; i++)
 						{
 							dataPtr->dataFrame.msg[dataLen++] = rxMessage.Payload[i];
 						}
 						dataPtr->dataFrame.msgLength = dataLen;
 						dataPtr->dataFrame.fromEDToED = 1;
+						dataPtr->dataFrame.seq = rxMessage.Payload[4];
+						dataPtr->dataFrame.txClass = TX_CLASS_NORMAL;
 						/* If the destination end device is sleeping device, place the data in indirect queue or transmit directly */
 						if(miwiDefaultRomOrRamParams->ConnectionTable[ed_index].status.bits.isValid && miwiDefaultRomOrRamParams->ConnectionTable[ed_index].status.bits.RXOnWhenIdle == 0)
 						{
-							if (50 < MiMem_PercentageOfFreeBuffers())
+							dataPtr->dataFrame.confCallback = NULL;
+							dataPtr->dataFrame.ackReq = true;
+#if defined(ENABLE_INDIRECT_MESSAGE)
+							if (!(50 < MiMem_PercentageOfFreeBuffers()) || !indirectFrameStore(ed_index, dataPtr))
+#endif
 							{
-								dataPtr->dataFrame.confCallback = NULL;
-								dataPtr->dataFrame.timeout = INDIRECT_MESSAGE_TIMEOUT;
-								dataPtr->dataFrame.ackReq = true;
-								miQueueAppend(&indirectFrameQueue, (miQueueBuffer_t*)dataPtr);
+								/* Not enough memory left to hold it for the sleeping device */
+								MiMem_Free(dataPtr);
+#if defined(ENABLE_MIMEM_STATS)
+								MiMem_StatsFailure(__FILE__, __LINE__);
+#endif
 							}
 						}
 						else
 						{
-							frameTransmit(false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[ed_index].Address, false, false, dataLen, dataPtr->dataFrame.msg, 1, true, appAckWaitDataCallback);
-							miQueueAppend(&appAckWaitDataQueue, (miQueueBuffer_t*)dataPtr);
+							if (frameTransmit(false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[ed_index].Address, false, false, dataLen, dataPtr->dataFrame.msg, 1, true, false, dataPtr->dataFrame.txClass, macAckOnlyDataCallback))
+							{
+								miQueueAppend(&macAckOnlyFrameQueue, (miQueueBuffer_t*)dataPtr);
+							}
+							else
+							{
+								MiMem_Free(dataPtr);
+							}
 						}
 					}
 	            }
@@ -2193,20 +3072,18 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
 #if defined(ENABLE_LINK_STATUS)
             case CMD_IAM_ALIVE:
             {
+#if !defined(ENABLE_LINK_STATUS_AGGREGATION)
                 if (PAN_COORD == role)
                 {
                     // PAN CP processes this packet to qualify it as alive , increments the link stat
-                    uint8_t p;
-                    for (p=0  ; p < CONNECTION_SIZE ; p++)
+                    uint8_t p = connectionHashFind(rxMessage.SourceAddress, END_DEVICE_SHORT_ADDR_LEN);
+                    if (0xFF != p)
                     {
-                        if (miwiDefaultRomOrRamParams->ConnectionTable[p].Address[0] == rxMessage.SourceAddress[0] && miwiDefaultRomOrRamParams->ConnectionTable[p].Address[1] == rxMessage.SourceAddress[1]
-                        && miwiDefaultRomOrRamParams->ConnectionTable[p].Address[2] == rxMessage.SourceAddress[2])
-                        {
-                            miwiDefaultRomOrRamParams->ConnectionTable[p].link_status++;
-                            break;
-                        }
+                        miwiDefaultRomOrRamParams->ConnectionTable[p].link_status++;
                     }
                 }
+#endif
+                /* With aggregation it is taken as link status like any other frame */
             }
             break;
 #endif
@@ -2228,26 +3105,13 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
 #if defined(ENABLE_INDIRECT_MESSAGE)
             case CMD_MAC_DATA_REQUEST:
             {
-				if (indirectFrameQueue.size)
+				if (indirectFrameCount)
 				{
-					uint8_t loopIndex;
-					for (loopIndex =0; loopIndex < indirectFrameQueue.size; loopIndex++)
+					uint8_t connIndex = connectionHashFind(rxMessage.SourceAddress, LONG_ADDR_LEN);
+
+					if (0xFF != connIndex)
 					{
-						P2PStarDataFrame_t *dataFramePtr = (P2PStarDataFrame_t *)miQueueRemove(&indirectFrameQueue, NULL);
-						if (NULL != dataFramePtr)
-						{
-							if (isSameAddress(rxMessage.SourceAddress, dataFramePtr->dataFrame.destAddress))
-							{
-								frameTransmit(dataFramePtr->dataFrame.broadcast, myPANID, dataFramePtr->dataFrame.destAddress, false, false, dataFramePtr->dataFrame.msgLength, dataFramePtr->dataFrame.msg, 
-									dataFramePtr->dataFrame.msghandle, dataFramePtr->dataFrame.ackReq, macAckOnlyDataCallback);
-								miQueueAppend(&macAckOnlyFrameQueue, (miQueueBuffer_t *)dataFramePtr);
-								break;
-							}
-							else
-							{
-								miQueueAppend(&indirectFrameQueue, (miQueueBuffer_t *)dataFramePtr);
-							}
-						}
+						indirectFrameSend(connIndex);
 					}
 				}
             }
@@ -2256,47 +3120,34 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
 #ifndef TARGET_SMALL
             case CMD_P2P_CONNECTION_REMOVAL_REQUEST:
             {
-                uint8_t* dataPtr = NULL;
-                uint8_t dataLen = 0;
+                CommandFrame_t frame;
 
-                dataPtr = MiMem_Alloc(PACKETLEN_P2P_CONNECTION_REMOVAL_RESPONSE);
-
-                if (NULL == dataPtr)
+                if (!commandFrameAlloc(&frame, CMD_P2P_CONNECTION_REMOVAL_RESPONSE, PACKETLEN_P2P_CONNECTION_REMOVAL_RESPONSE))
                     return;
 
-                dataPtr[dataLen++] = CMD_P2P_CONNECTION_REMOVAL_RESPONSE;
-
-                for(i = 0; i < CONNECTION_SIZE; i++)
+                /* look for the record of the requesting device */
+                i = connectionHashFind(rxMessage.SourceAddress, LONG_ADDR_LEN);
+                if( i != 0xFF )
                 {
-                    /* if the record is valid */
-                    if( miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.isValid )
-                    {
-                        /* if the record is the same as the requesting device */
-                        if( isSameAddress(rxMessage.SourceAddress, miwiDefaultRomOrRamParams->ConnectionTable[i].Address) )
-                        {
-                            /* Find the record. disable the record and set status to be SUCCESS */
-                            miwiDefaultRomOrRamParams->ConnectionTable[i].status.Val = 0;
+                    /* Find the record. disable the record and set status to be SUCCESS */
+                    miwiDefaultRomOrRamParams->ConnectionTable[i].status.Val = 0;
+                    connectionHashRemove(i);
 #if defined(ENABLE_NETWORK_FREEZER)
-                            PDS_Store(PDS_CONNECTION_TABLE_ID);
+                    PDS_Store(PDS_CONNECTION_TABLE_ID);
 #endif
-                            dataPtr[dataLen++] = STATUS_SUCCESS;
-
-                            break;
-                        }
-                    }
+                    commandFramePut(&frame, STATUS_SUCCESS);
                 }
-
-                if( i == CONNECTION_SIZE )
+                else
                 {
                     /* not found, the requesting device is not my peer */
-                    dataPtr[dataLen++] = STATUS_ENTRY_NOT_EXIST;
+                    commandFramePut(&frame, STATUS_ENTRY_NOT_EXIST);
                 }
 #ifdef TARGET_SMALL
-                frameTransmit(false, myPANID, rxMessage.SourceAddress, true, rxMessage.flags.bits.secEn,
-                dataLen, dataPtr,0, true, CommandConfCallback);
+                commandFrameTransmit(&frame, false, myPANID, rxMessage.SourceAddress, rxMessage.flags.bits.secEn,
+                CommandConfCallback);
 #else
-                frameTransmit(false, rxMessage.SourcePANID, rxMessage.SourceAddress, true, rxMessage.flags.bits.secEn,
-                dataLen, dataPtr,0, true, CommandConfCallback);
+                commandFrameTransmit(&frame, false, rxMessage.SourcePANID, rxMessage.SourceAddress, rxMessage.flags.bits.secEn,
+                CommandConfCallback);
 #endif
             }
             break;
@@ -2305,22 +3156,16 @@ void frameParse(MAC_RECEIVED_PACKET *macRxPacket)
             {
                 if( rxMessage.Payload[1] == STATUS_SUCCESS )
                 {
-                    for(i = 0; i < CONNECTION_SIZE; i++)
+                    // the record of the requesting device
+                    i = connectionHashFind(rxMessage.SourceAddress, LONG_ADDR_LEN);
+                    if( i != 0xFF )
                     {
-                        // if the record is valid
-                        if( miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.isValid )
-                        {
-                            // if the record address is the same as the requesting device
-                            if( isSameAddress(rxMessage.SourceAddress, miwiDefaultRomOrRamParams->ConnectionTable[i].Address) )
-                            {
-                                // invalidate the record
-                                miwiDefaultRomOrRamParams->ConnectionTable[i].status.Val = 0;
+                        // invalidate the record
+                        miwiDefaultRomOrRamParams->ConnectionTable[i].status.Val = 0;
+                        connectionHashRemove(i);
 #if defined(ENABLE_NETWORK_FREEZER)
-                                PDS_Store(PDS_CONNECTION_TABLE_ID);
+                        PDS_Store(PDS_CONNECTION_TABLE_ID);
 #endif
-                                break;
-                            }
-                        }
                     }
                 }
             }
@@ -2345,15 +3190,24 @@ void P2PTasks(void)
 
     currentTick.Val = MiWi_TickGet();
 
-    /* Transmission Queue Handling */
-    if (frameTxQueue.size && txCallbackReceived && (MiWi_TickGetDiff(currentTick, lastTxFrameTick) > (transaction_duration_us)))
+#ifdef ENABLE_SLEEP_FEATURE
+    if (P2PStatus.bits.DataRequestPending && (0 == frameTxQueued) && (0 == sentFrameQueue.size))
+    {
+        P2PStatus.bits.DataRequestPending = 0;
+        sendDataRequest();
+    }
+#endif
+
+    /* Transmission Queue Handling, a frame behind one in flight is held by
+     * MiMAC until the spacing after the previous frame has passed */
+    if (frameTxQueued && (sentFrameQueue.size < MIMAC_TX_PIPELINE_DEPTH) &&
+        (sentFrameQueue.size || (MiWi_TickGetDiff(currentTick, lastTxFrameTick) > (transaction_duration_us))))
     {
         TxFrame_t *txFramePtr = NULL;
-        txFramePtr =  (TxFrame_t *)miQueueRemove(&frameTxQueue, NULL);
+        txFramePtr = frameTxSchedule(currentTick);
         if (NULL != txFramePtr)
         {
             uint16_t transaction_duration_sym = 0;
-            sentFrame = txFramePtr;
 
             /* Calculate Transaction Duration Time which is based on Frame Size either minLIFSPeriod or minSIFSPeriod*/
             if ( (txFramePtr->txFrameEntry.frameLength + MAC_OVERHEAD + PHY_OVERHEAD) > aMaxSIFSFrameSize)
@@ -2366,15 +3220,25 @@ void P2PTasks(void)
             }
             /* Turn around time and unit back off period added for MAC acknowledgment reception */
             transaction_duration_sym += aTurnaroundTime + aUnitBackoffPeriod;
-            transaction_duration_us = MiMAC_SymbolToTicks(transaction_duration_sym);
+            txFramePtr->txFrameEntry.frameParam.txSpacing = transaction_duration_sym;
 
-            /* Store current transmitted frame tick information */
-            lastTxFrameTick = currentTick;
+#if defined(ENABLE_TX_POWER_CONTROL)
+            txFramePtr->txFrameEntry.frameParam.txPowerReduction = txPowerControlReduction(&txFramePtr->txFrameEntry);
+#endif
+            /* MiMAC prepares the frame now and sends it behind the one in flight,
+             * the frame stays in its class queue if MiMAC has no room for it */
+            if (MiMAC_SendPacket(txFramePtr->txFrameEntry.frameParam, txFramePtr->txFrameEntry.frame,
+                txFramePtr->txFrameEntry.frameLength, txFramePtr->txFrameEntry.frameHandle,
+                frameTxCallback))
+            {
+                miQueueRemove(&frameTxQueue[txFramePtr->txFrameEntry.txClass], NULL);
+                frameTxQueued--;
+                miQueueAppend(&sentFrameQueue, (miQueueBuffer_t *)txFramePtr);
 
-            MiMAC_SendPacket(txFramePtr->txFrameEntry.frameParam, txFramePtr->txFrameEntry.frame,
-            txFramePtr->txFrameEntry.frameLength, txFramePtr->txFrameEntry.frameHandle,
-            frameTxCallback);
-            txCallbackReceived = false;
+                /* Store current transmitted frame tick information */
+                transaction_duration_us = MiMAC_SymbolToTicks(transaction_duration_sym);
+                lastTxFrameTick = currentTick;
+            }
         }
     }
     /* Check for New frame Reception, Parse and handle the frame if received  */
@@ -2398,7 +3262,7 @@ void P2PTasks(void)
     /* System Software Timer Handler */
     SYS_TimerTaskHandler();
 #ifdef ENABLE_SLEEP_FEATURE
-    if(!(P2PStatus.bits.DataRequesting || P2PStatus.bits.RxHasUserData || (frameTxQueue.size) || (!txCallbackReceived)) && (p2pStarCurrentState == IN_NETWORK_STATE))
+    if(!(P2PStatus.bits.DataRequesting || P2PStatus.bits.RxHasUserData || (frameTxQueued) || (sentFrameQueue.size)) && (p2pStarCurrentState == IN_NETWORK_STATE))
     {
         MiMAC_PowerState(POWER_STATE_DEEP_SLEEP);
     }
@@ -2423,9 +3287,12 @@ void P2PTasks(void)
  *          uint8_t *      DestinationAddress  Pointer to destination long address
  *          BOOL        isCommand           If packet to send is a command packet
  *          BOOL        SecurityEnabled     If packet to send needs encryption
+ *          BOOL        framePending        More frames are held for the destination
+ *          uint8_t     txClass             Transmit class, miwi_tx_class_t
  *
  * Output:
- *          BOOL                            If operation successful
+ *          BOOL                            If operation successful, false as well
+ *                                          if the queue of the class is full
  *
  * Side Effects:    Transceiver is triggered to transmit a packet
  *
@@ -2439,12 +3306,19 @@ bool frameTransmit(INPUT bool Broadcast,
                 INPUT uint8_t* msgPtr,
                 INPUT uint8_t msghandle,
                 INPUT bool ackReq,
+                INPUT bool framePending,
+                INPUT uint8_t txClass,
                 INPUT DataConf_callback_t ConfCallback)
 {
     MAC_TRANS_PARAM *tParam;
 
     TxFrame_t *txFramePtr = NULL;
 
+    if (frameTxQueue[txClass].size >= frameTxDepth[txClass])
+    {
+        return false;
+    }
+
     txFramePtr = (TxFrame_t *) MiMem_Alloc(sizeof(TxFrame_t));
 
     if (NULL == txFramePtr)
@@ -2457,6 +3331,7 @@ bool frameTransmit(INPUT bool Broadcast,
     tParam->flags.bits.ackReq = (Broadcast) ? 0 : ackReq;
     tParam->flags.bits.broadcast = Broadcast;
     tParam->flags.bits.secEn = SecurityEnabled;
+    tParam->framePending = framePending;
     #if defined(IEEE_802_15_4)
         tParam->altSrcAddr = 0;
         tParam->altDestAddr = (Broadcast) ? true : false;
@@ -2505,140 +3380,168 @@ bool frameTransmit(INPUT bool Broadcast,
     txFramePtr->txFrameEntry.frameConfCallback = ConfCallback;
     txFramePtr->txFrameEntry.frameHandle = msghandle;
     txFramePtr->txFrameEntry.frameLength = msgLen;
+    txFramePtr->txFrameEntry.txClass = txClass;
+    txFramePtr->txFrameEntry.queuedTick = MiWi_TickGet();
 
-    miQueueAppend(&frameTxQueue, (miQueueBuffer_t *)txFramePtr);
+    miQueueAppend(&frameTxQueue[txClass], (miQueueBuffer_t *)txFramePtr);
+    frameTxQueued++;
 
     return true;
 }
 
-static void protocolTimerInit(void)
+/*********************************************************************
+ * static TxFrame_t *frameTxSchedule(MIWI_TICK currentTick)
+ *
+ * Overview:        This function drops the queued frames past the deadline
+ *                  of their class and picks the next frame to send
+ *
+ * PreCondition:    None
+ *
+ * Input:
+ *          MIWI_TICK   currentTick         Current time
+ *
+ * Output:
+ *          TxFrame_t *                     The frame to send, NULL if none. It
+ *                                          stays at the head of its class queue
+ *
+ * Side Effects:    Dropped frames are confirmed with TRANSACTION_EXPIRED
+ *
+ * Note:            Each class is FIFO, so only the heads are looked at. A
+ *                  head moves up one class per aging time it waited, up to
+ *                  the alarm class. The head of highest precedence is sent,
+ *                  the one that waited longer if two are equal.
+ ********************************************************************/
+static TxFrame_t *frameTxSchedule(MIWI_TICK currentTick)
 {
-    protocolTimer.interval = PROTOCOL_TIMER_INTERVAL;
-    protocolTimer.mode = SYS_TIMER_PERIODIC_MODE;
-    protocolTimer.handler = protocolTimerHandler;
-    SYS_TimerStart(&protocolTimer);
-
-#if defined(PROTOCOL_STAR)
-    dataTimer.interval = DATA_TIMER_INTERVAL;
-    dataTimer.mode = SYS_TIMER_PERIODIC_MODE;
-    dataTimer.handler = dataTimerHandler;
-#endif
-}
+    uint8_t txClass;
+    uint8_t nextClass = TX_CLASS_COUNT;
+    uint8_t nextPrecedence = TX_CLASS_COUNT;
+    uint32_t nextWait = 0;
 
-static void protocolTimerHandler(SYS_Timer_t *timer)
-{
-#ifdef ENABLE_SLEEP_FEATURE
-    if((0 != dataRequestInterval) && ((--dataRequestInterval) == 0))
+    for (txClass = TX_CLASS_CONTROL; txClass < TX_CLASS_COUNT; txClass++)
     {
-        sendDataRequest();
-    }
-#endif
-#ifdef ENABLE_ACTIVE_SCAN
-    if((0 != activeScanDurationTimeInterval) && ((--activeScanDurationTimeInterval) == 0))
+        TxFrame_t *txFramePtr;
+
+        while (NULL != (txFramePtr = (TxFrame_t *)miQueueRead(&frameTxQueue[txClass], NULL)))
+        {
+            /* Modulo 2^32, MiWi_TickGetDiff() does not take equal ticks */
+            uint32_t wait = currentTick.Val - txFramePtr->txFrameEntry.queuedTick;
+            uint8_t precedence = txClass;
+
+            if (frameTxDeadline[txClass] && (wait >= frameTxDeadline[txClass]))
+            {
+                DataConf_callback_t callback = txFramePtr->txFrameEntry.frameConfCallback;
+
+                miQueueRemove(&frameTxQueue[txClass], NULL);
+                frameTxQueued--;
+                if (NULL != callback)
+                {
+                    callback(txFramePtr->txFrameEntry.frameHandle, TRANSACTION_EXPIRED, txFramePtr->txFrameEntry.frame);
+                }
+                else
+                {
+                    MiMem_Free(txFramePtr->txFrameEntry.frame);
+                }
+                MiMem_Free((uint8_t *)txFramePtr);
+                continue;
+            }
+
+            if (frameTxAging[txClass])
+            {
+                uint32_t steps = wait / frameTxAging[txClass];
+
+                precedence = (steps >= (uint32_t)(txClass - TX_CLASS_ALARM)) ? TX_CLASS_ALARM : (uint8_t)(txClass - steps);
+            }
+            if ((precedence < nextPrecedence) || ((precedence == nextPrecedence) && (wait > nextWait)))
+            {
+                nextClass = txClass;
+                nextPrecedence = precedence;
+                nextWait = wait;
+            }
+            break;
+        }
+    }
+
+    if (TX_CLASS_COUNT == nextClass)
     {
-        scanDurationExpired();
+        return NULL;
     }
+    return (TxFrame_t *)miQueueRead(&frameTxQueue[nextClass], NULL);
+}
+
+/*********************************************************************
+* Function:         static void protocolTimerInit(void)
+*
+* Overview:         Sets up the timers of the protocol timeouts. Each of
+*                   them is started only for the time its timeout runs,
+*                   so the system timer runs the protocol work when it
+*                   is due and not on a periodic tick.
+********************************************************************/
+static void protocolTimerInit(void)
+{
+    connectionTimer.mode = SYS_TIMER_INTERVAL_MODE;
+    connectionTimer.handler = connectionTimerHandler;
+#ifdef ENABLE_SLEEP_FEATURE
+    dataRequestTimer.mode = SYS_TIMER_INTERVAL_MODE;
+    dataRequestTimer.handler = dataRequestTimerHandler;
+#endif
+#ifdef ENABLE_ACTIVE_SCAN
+    activeScanDurationTimer.mode = SYS_TIMER_INTERVAL_MODE;
+    activeScanDurationTimer.handler = scanDurationExpired;
 #endif
 #ifdef ENABLE_ED_SCAN
-    if((0 != edScanDurationTimeInterval) && ((--edScanDurationTimeInterval) == 0))
-    {
-        edScanDurationExpired();
-    }
+    edScanDurationTimer.mode = SYS_TIMER_INTERVAL_MODE;
+    edScanDurationTimer.handler = edScanDurationExpired;
+#endif
+#if defined(ENABLE_BACKGROUND_ED_SCAN)
+    edScanSampleTimer.mode = SYS_TIMER_PERIODIC_MODE;
+    edScanSampleTimer.handler = edScanSampleTimerHandler;
+    edScanChannelTimer.mode = SYS_TIMER_INTERVAL_MODE;
+    edScanChannelTimer.handler = edScanChannelTimerHandler;
 #endif
-    if((0 != connectionTimeInterval) && ((--connectionTimeInterval) == 0))
-    {
-        sendConnectionRequest();
-    }
 #ifdef ENABLE_FREQUENCY_AGILITY
-    if((0 != freqAgilityBroadcastInterval) && ((--freqAgilityBroadcastInterval) == 0))
-    {
-        StartChannelHopping();
-    }
+    freqAgilityBroadcastTimer.mode = SYS_TIMER_INTERVAL_MODE;
+    freqAgilityBroadcastTimer.handler = freqAgilityBroadcastTimerHandler;
+#endif
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR)
+    channelMonitorTimer.mode = SYS_TIMER_PERIODIC_MODE;
+    channelMonitorTimer.handler = channelMonitorTimerHandler;
 #endif
+#if defined(PROTOCOL_STAR)
 #ifdef ENABLE_PERIODIC_CONNECTIONTABLE_SHARE
-    if((0 != sharePeerDevInfoTimeInterval) && ((--sharePeerDevInfoTimeInterval) == 0))
-    {
-        /* Reload time interval since it is periodic timer */
-        sharePeerDevInfoTimeInterval = SHARE_PEER_DEVICE_INFO_TIMEOUT;
-        MiApp_BroadcastConnectionTable();
-    }
+    sharePeerDevInfoTimer.mode = SYS_TIMER_PERIODIC_MODE;
+    sharePeerDevInfoTimer.handler = sharePeerDevInfoTimerHandler;
 #endif
 #ifdef ENABLE_LINK_STATUS
-    if((0 != inActiveDeviceCheckTimeInterval) && ((--inActiveDeviceCheckTimeInterval) == 0))
-    {
-        /* Reload time interval since it is periodic timer */
-        inActiveDeviceCheckTimeInterval = FIND_INACTIVE_DEVICE_TIMEOUT;
-        findInActiveDevices();
-    }
-    if((0 != linkStatusTimeInterval) && ((--linkStatusTimeInterval) == 0))
+    inActiveDeviceCheckTimer.mode = SYS_TIMER_INTERVAL_MODE;
+    inActiveDeviceCheckTimer.handler = inActiveDeviceCheckTimerHandler;
+    linkStatusTimer.mode = SYS_TIMER_INTERVAL_MODE;
+    linkStatusTimer.handler = linkStatusTimerHandler;
+#endif
+    connTableSnapshotTimer.interval = CONNECTION_TABLE_SNAPSHOT_WAIT;
+    connTableSnapshotTimer.mode = SYS_TIMER_INTERVAL_MODE;
+    connTableSnapshotTimer.handler = connTableSnapshotTimerHandler;
+    if (connTableSnapshotPending)
     {
-        /* Reload time interval since it is periodic timer */
-        linkStatusTimeInterval = LINK_STATUS_TIMEOUT;
-        sendLinkStatus();
+        SYS_TimerStart(&connTableSnapshotTimer);
     }
 #endif
-#ifdef ENABLE_INDIRECT_MESSAGE
-	if (indirectFrameQueue.size)
-	{
-		uint8_t loopIndex;
-		for (loopIndex =0; loopIndex < indirectFrameQueue.size; loopIndex++)
-		{
-			P2PStarDataFrame_t *dataFramePtr = (P2PStarDataFrame_t *)miQueueRemove(&indirectFrameQueue, NULL);
-			if (NULL != dataFramePtr)
-			{
-				if ((0 != dataFramePtr->dataFrame.timeout) && ((--dataFramePtr->dataFrame.timeout) == 0))
-				{
-					DataConf_callback_t callback = dataFramePtr->dataFrame.confCallback;
-					if (NULL != callback && 1 != dataFramePtr->dataFrame.broadcast)
-					{
-						callback(dataFramePtr->dataFrame.msghandle, TRANSACTION_EXPIRED, dataFramePtr->dataFrame.msg);
-					}
-					MiMem_Free((uint8_t *)dataFramePtr);
-				}
-				else
-				{
-					miQueueAppend(&indirectFrameQueue, (miQueueBuffer_t *)dataFramePtr);
-				}
-			}
-		}
-	}
-#endif
 }
 
-#if defined(PROTOCOL_STAR)
-static void dataTimerHandler(SYS_Timer_t *timer)
+/* Starts the timer over to run out after the interval in milliseconds */
+static void protocolTimerRestart(SYS_Timer_t *timer, uint32_t interval)
 {
-	uint8_t loopIndex;
-	P2PStarDataFrame_t *dataFramePtr = NULL;
-	for (loopIndex = 0; loopIndex < appAckWaitDataQueue.size; loopIndex++)
-	{
-		dataFramePtr = (P2PStarDataFrame_t *) miQueueRemove(&appAckWaitDataQueue, NULL);
+    SYS_TimerStop(timer);
+    timer->interval = Max(interval, SYS_TIMER_INTERVAL);
+    SYS_TimerStart(timer);
+}
 
-		if (NULL == dataFramePtr)
-		{
-			return;
-		}
-		
-		if((0 != dataFramePtr->dataFrame.timeout) && (--dataFramePtr->dataFrame.timeout) == 0)
-		{
-			DataConf_callback_t callback = dataFramePtr->dataFrame.confCallback;
-			if (NULL != callback)
-			{
-				callback(dataFramePtr->dataFrame.msghandle, NO_ACK, (uint8_t*)&(dataFramePtr->dataFrame.msg));
-			}
-			MiMem_Free((uint8_t *)dataFramePtr);
-		}
-		else
-		{
-			miQueueAppend(&appAckWaitDataQueue, (miQueueBuffer_t *)dataFramePtr);
-		}
-	}
-	if (0 == appAckWaitDataQueue.size)
-	{
-		SYS_TimerStop(&dataTimer);
-	}
+static void connectionTimerHandler(SYS_Timer_t *timer)
+{
+    sendConnectionRequest();
 }
 
+#if defined(PROTOCOL_STAR)
 /************************************************************************************
 * Function:
 *      void MiApp_BroadcastConnectionTable(void)
@@ -2649,7 +3552,9 @@ static void dataTimerHandler(SYS_Timer_t *timer)
 * Description:
 *      This function is used by only PAN CO in a Star network and is a cmd
 *      type packet. PAN CO in Star Network , holds the responsibility to Share
-*      peer end devices connection table.
+*      peer end devices connection table. The changes made since the last
+*      share are broadcast, the whole table only when the end devices could
+*      not catch up from them.
 *
 * PreCondition:
 *      Protocol initialization has been done.
@@ -2658,100 +3563,150 @@ static void dataTimerHandler(SYS_Timer_t *timer)
 *      None.
 *
 * Remarks:
-*      None
+*      Without any change the broadcast only carries the generation, which
+*      lets the end devices detect that they missed an update.
 *
 *****************************************************************************************/
 static void MiApp_BroadcastConnectionTable(void)
 {
-    uint8_t i,j , k , count;
-    // Based on Connection Size in Network broadcast the connection details Multiple Times
-    // so that all the END_DEVICES in Star Network Receive the packet
-    uint8_t broadcast_count = 0;
-    uint8_t* dataPtr = NULL;
-    uint8_t dataLen = 0;
-
-    if ((conn_size  * 4 ) + 4 < TX_BUFFER_SIZE)
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+    linkStatusKeepAliveAdapt();
+#endif
+    /* Also when the log no longer holds all the changes since the last share */
+    if (connTableSnapshotPending || ((uint8_t)(connTableGeneration - connTableSharedGeneration) > connTableDeltaCount))
     {
-        broadcast_count = 1;
+        connTableSendSnapshot();
     }
     else
     {
-        broadcast_count = ((conn_size * 4) + 4 )/ TX_BUFFER_SIZE;
-        if ((conn_size *4) + 4 % TX_BUFFER_SIZE != 0)
-        {
-            broadcast_count = broadcast_count + ((conn_size *4) + 4 )% TX_BUFFER_SIZE;
-        }
+        connTableSendDelta();
+    }
+}
 
+/* PAN Co: records a change of a connection table slot for the end devices */
+static void connTableChanged(uint8_t connIndex)
+{
+    connTableGeneration++;
+    connTableDeltaLog[connTableGeneration & (CONNECTION_TABLE_DELTA_LOG_SIZE - 1)] = connIndex;
+    if (connTableDeltaCount < CONNECTION_TABLE_DELTA_LOG_SIZE)
+    {
+        connTableDeltaCount++;
     }
+}
+
+/* Appends the short address and the slot of a connection table entry,
+   the address is all 0xFF once the slot is free */
+static void connTableEntryWrite(CommandFrame_t *frame, uint8_t connIndex)
+{
+    CONNECTION_ENTRY *entry = &miwiDefaultRomOrRamParams->ConnectionTable[connIndex];
+    uint8_t i;
 
-    for (i = 0 ; i < broadcast_count ; i++)
+    for (i = 0; i < END_DEVICE_SHORT_ADDR_LEN; i++)
     {
-        dataPtr = MiMem_Alloc(TX_BUFFER_SIZE);
-        if (NULL == dataPtr)
+        commandFramePut(frame, entry->status.bits.isValid ? entry->Address[i] : 0xFF);
+    }
+    commandFramePut(frame, connIndex);
+}
+
+/* Broadcasts the whole connection table, each frame holding the valid
+   entries of a range of slots */
+static void connTableSendSnapshot(void)
+{
+    CommandFrame_t frame;
+    uint8_t slot = 0;
+    uint8_t endSlotOffset;
+
+    connTableSnapshotPending = false;
+    do
+    {
+        if (!commandFrameAlloc(&frame, CMD_SHARE_CONNECTION_TABLE, TX_BUFFER_SIZE))
+        {
+            /* Start over once the snapshot timer runs out */
+            connTableSnapshotRequest();
             return;
-        dataPtr[dataLen++] = CMD_SHARE_CONNECTION_TABLE;
-        dataPtr[dataLen++] = conn_size; // No of end devices in network
-        dataPtr[dataLen++] = (((TX_BUFFER_SIZE-4)/4)*i);
-        dataPtr[dataLen++] = (((TX_BUFFER_SIZE-4)/4)*(i+1));
-        count = 4;
-        for (j= ((TX_BUFFER_SIZE-4)/4)*i ;j<((TX_BUFFER_SIZE-4)/4)*(i+1);j++)
+        }
+        commandFramePut(&frame, conn_size); // No of end devices in network
+        commandFramePut(&frame, connTableGeneration);
+        commandFramePut(&frame, slot);
+        endSlotOffset = frame.length;
+        commandFramePut(&frame, 0);
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+        commandFramePut(&frame, linkStatusKeepAlive);
+#endif
+        for (; (slot < CONNECTION_SIZE) && (frame.length + CONNECTION_TABLE_ENTRY_SIZE <= frame.size); slot++)
         {
-            if (j < conn_size)
+            if (miwiDefaultRomOrRamParams->ConnectionTable[slot].status.bits.isValid)
             {
-                if (miwiDefaultRomOrRamParams->ConnectionTable[j].status.bits.isValid)
-                {
-                    dataPtr[dataLen++] = (miwiDefaultRomOrRamParams->ConnectionTable[j].Address[0]);
-                    dataPtr[dataLen++] = (miwiDefaultRomOrRamParams->ConnectionTable[j].Address[1]);
-                    dataPtr[dataLen++] = (miwiDefaultRomOrRamParams->ConnectionTable[j].Address[2]);
-                    dataPtr[dataLen++] = j;
-                }
-                else
-                {
-                    dataPtr[dataLen++] = 0xff;
-                    dataPtr[dataLen++] = 0xff;
-                    dataPtr[dataLen++] = 0xff;
-                    dataPtr[dataLen++] = j;
-                }
-                count = count + 4;
+                connTableEntryWrite(&frame, slot);
             }
         }
-        // Fill the remaining buffer with garbage value
-        for (k=count;k<TX_BUFFER_SIZE;k++)
+        /* End of the range, the last frame ends at CONNECTION_SIZE */
+        frame.data[endSlotOffset] = slot;
+        if (!commandFrameTransmit(&frame, true, myPANID, NULL, false, CommandConfCallback))
         {
-            dataPtr[dataLen++] = 0xFF;   // Garbage Value
+            connTableSnapshotRequest();
+            return;
         }
-        frameTransmit(true, myPANID, NULL, true, false, dataLen, dataPtr,0, true, CommandConfCallback);
+    } while (slot < CONNECTION_SIZE);
+    connTableSharedGeneration = connTableGeneration;
+}
+
+/* Shares the whole table once the snapshot timer runs out, the requests
+   made until then are answered by the same snapshot */
+static void connTableSnapshotRequest(void)
+{
+    connTableSnapshotPending = true;
+    SYS_TimerStart(&connTableSnapshotTimer);
+}
+
+static void connTableSnapshotTimerHandler(SYS_Timer_t *timer)
+{
+    if (connTableSnapshotPending && (PAN_COORD == role))
+    {
+        connTableSendSnapshot();
     }
 }
+
+#if defined(ENABLE_PERIODIC_CONNECTIONTABLE_SHARE)
+static void sharePeerDevInfoTimerHandler(SYS_Timer_t *timer)
+{
+    MiApp_BroadcastConnectionTable();
+}
 #endif
 
-#if defined(PROTOCOL_STAR)
-/* All connections (FFD || RFD)are stored in Connection Table of PAN Coordinator
-    Each Connection is identified by its index no. In case of Data TX , EDx --> PAN CO --> EDy
-    PAN Coordinator will forward the data to EDy , In order to know */
-static uint8_t Find_Index (uint8_t *DestAddr)
+/* Broadcasts the changes logged since the last share, with the changes
+   before them still in the log for the end devices which missed it */
+static void connTableSendDelta(void)
 {
-    uint8_t i;
-    uint8_t return_val;
-    for (i = 0;i < conn_size; i++)
-    {
-        if (miwiDefaultRomOrRamParams->ConnectionTable[i].status.bits.isValid)
-        {
-            if (DestAddr[0] == miwiDefaultRomOrRamParams->ConnectionTable[i].Address[0] && DestAddr[1] == miwiDefaultRomOrRamParams->ConnectionTable[i].Address[1] && DestAddr[2] == miwiDefaultRomOrRamParams->ConnectionTable[i].Address[2] )
-            {
-                return_val = i;
-                break;
-            }
+    CommandFrame_t frame;
+    uint8_t count = (connTableGeneration != connTableSharedGeneration) ? connTableDeltaCount : 0;
+    uint8_t generation = connTableGeneration - count;
 
-        }
+    if (!commandFrameAlloc(&frame, CMD_CONNECTION_TABLE_DELTA, CONNECTION_TABLE_DELTA_HEADER_SIZE + count * CONNECTION_TABLE_ENTRY_SIZE))
+        return;
+
+    commandFramePut(&frame, conn_size); // No of end devices in network
+    commandFramePut(&frame, connTableGeneration);
+    commandFramePut(&frame, count);
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+    commandFramePut(&frame, linkStatusKeepAlive);
+#endif
+    /* Oldest change first */
+    while (generation != connTableGeneration)
+    {
+        generation++;
+        connTableEntryWrite(&frame, connTableDeltaLog[generation & (CONNECTION_TABLE_DELTA_LOG_SIZE - 1)]);
     }
-    if (i == conn_size)
+    if (!commandFrameTransmit(&frame, true, myPANID, NULL, false, CommandConfCallback))
     {
-        return_val = 0xff;
+        /* The changes go with the next share */
+        return;
     }
-    return return_val;
+    connTableSharedGeneration = connTableGeneration;
 }
+#endif
 
+#if defined(PROTOCOL_STAR)
 bool MiApp_SubscribeLinkFailureCallback(LinkFailureCallback_t callback)
 {
     if (NULL != callback)
@@ -2778,9 +3733,9 @@ static void handleLostConnection(void)
         if (!stat)
         {
             /* Stop Timers */
-            linkStatusTimeInterval = 0;
+            SYS_TimerStop(&linkStatusTimer);
 #ifdef ENABLE_SLEEP_FEATURE
-            dataRequestInterval = 0;
+            SYS_TimerStop(&dataRequestTimer);
 #endif
             if ((NULL != linkFailureCallback) && (p2pStarCurrentState != DISCONNECTED))
             {
@@ -2791,23 +3746,114 @@ static void handleLostConnection(void)
     }
 }
 
-/* Function to store the Connection Table Information which is Broadcasted by PAN Coordinator
+/* Stores a frame of the Connection Table which is Broadcasted by PAN Coordinator
    Used by END_DEVICES (FFD || RFD) only */
-static void store_connection_tb(uint8_t *payload)
+static void storeConnectionTableSnapshot(uint8_t *payload, uint8_t payloadSize)
 {
-    uint8_t i , j ;
-    for (i = 4; i < RX_BUFFER_SIZE; i+=4)
+    uint8_t generation = payload[2];
+    uint8_t slot = payload[3];
+    uint8_t endSlot = payload[4];
+    uint8_t i;
+
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+    linkStatusKeepAliveSet(payload[CONNECTION_TABLE_SNAPSHOT_HEADER_SIZE - 1]);
+#endif
+
+    if (0 == slot)
     {
-        j = payload[i+3];
-        if (0xFF != j)
+        if (peerTableSynced && (generation == peerTableGeneration))
         {
-            END_DEVICES_Short_Address[j].connection_slot = j;
-            END_DEVICES_Short_Address[j].Address[0] = payload[i];
-            END_DEVICES_Short_Address[j].Address[1] = payload[i+1];
-            END_DEVICES_Short_Address[j].Address[2] = payload[i+2];
+            /* Sent for another END_DEVICE */
+            return;
         }
+        peerTableSynced = false;
+        peerTableGeneration = generation;
+    }
+    else if ((slot != peerTableNextSlot) || (generation != peerTableGeneration) || peerTableSynced)
+    {
+        /* The frames before it were missed */
+        return;
+    }
+
+    end_nodes = payload[1];
+    if (endSlot > CONNECTION_SIZE)
+    {
+        endSlot = CONNECTION_SIZE;
+    }
+    /* The slots of the range without an entry are free */
+    for (i = slot; i < endSlot; i++)
+    {
+        END_DEVICES_Short_Address[i].connection_slot = i;
+        memset(END_DEVICES_Short_Address[i].Address, 0xFF, END_DEVICE_SHORT_ADDR_LEN);
+    }
+    for (i = CONNECTION_TABLE_SNAPSHOT_HEADER_SIZE; i + CONNECTION_TABLE_ENTRY_SIZE <= payloadSize; i += CONNECTION_TABLE_ENTRY_SIZE)
+    {
+        storeConnectionTableEntry(&payload[i]);
+    }
+
+    peerTableNextSlot = endSlot;
+    if (CONNECTION_SIZE == endSlot)
+    {
+        peerTableSynced = true;
+        handleLostConnection();
     }
-    handleLostConnection();
+}
+
+/* Applies the changes of the Connection Table the device has not seen yet,
+   or asks for the whole table when some of them are no longer sent */
+static void storeConnectionTableDelta(uint8_t *payload, uint8_t payloadSize)
+{
+    uint8_t generation = payload[2];
+    uint8_t count = payload[3];
+    uint8_t behind = generation - peerTableGeneration;
+    uint8_t i;
+
+    if (CONNECTION_TABLE_DELTA_HEADER_SIZE + count * CONNECTION_TABLE_ENTRY_SIZE > payloadSize)
+    {
+        return;
+    }
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+    linkStatusKeepAliveSet(payload[CONNECTION_TABLE_DELTA_HEADER_SIZE - 1]);
+#endif
+
+    end_nodes = payload[1];
+    if (peerTableSynced && (behind <= count))
+    {
+        /* Skip the changes applied already */
+        for (i = count - behind; i < count; i++)
+        {
+            storeConnectionTableEntry(&payload[CONNECTION_TABLE_DELTA_HEADER_SIZE + i * CONNECTION_TABLE_ENTRY_SIZE]);
+        }
+        peerTableGeneration = generation;
+        handleLostConnection();
+    }
+    else
+    {
+        requestConnectionTable();
+    }
+}
+
+static void storeConnectionTableEntry(uint8_t *entry)
+{
+    uint8_t slot = entry[END_DEVICE_SHORT_ADDR_LEN];
+
+    if (slot < CONNECTION_SIZE)
+    {
+        END_DEVICES_Short_Address[slot].connection_slot = slot;
+        memcpy(END_DEVICES_Short_Address[slot].Address, entry, END_DEVICE_SHORT_ADDR_LEN);
+    }
+}
+
+static void requestConnectionTable(void)
+{
+    CommandFrame_t frame;
+
+    if (!commandFrameAlloc(&frame, CMD_CONNECTION_TABLE_REQUEST, PACKETLEN_CMD_CONNECTION_TABLE_REQUEST))
+        return;
+
+    /* Pan Co is @ index 0 of connection table of END_Device in a Star Network */
+    commandFrameTransmit(&frame, false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[0].Address, false,
+        CommandConfCallback);
 }
 #endif
 
@@ -2823,104 +3869,366 @@ bool MiApp_SubscribeReConnectionCallback(ReconnectionCallback_t callback)
 }
 #endif
 
+/*********************************************************************
+ * static void dataFrameConfirm(P2PStarDataFrame_t *dataFramePtr, uint8_t handle,
+ *                              miwi_status_t status, uint8_t* msgPointer)
+ *
+ * Overview:        Reports the MAC confirmation of a data frame to the
+ *                  application, or to the end device a forwarded frame
+ *                  came from
+ ********************************************************************/
+static void dataFrameConfirm(P2PStarDataFrame_t *dataFramePtr, uint8_t handle, miwi_status_t status, uint8_t* msgPointer)
+{
+	DataConf_callback_t callback = dataFramePtr->dataFrame.confCallback;
+	if (NULL != callback && 1 != dataFramePtr->dataFrame.broadcast)
+	{
+		callback(handle, status, msgPointer);
+	}
+#if defined(PROTOCOL_STAR)
+	/* SW ACK to the end device the frame came from, if it waits for one */
+	if (dataFramePtr->dataFrame.fromEDToED && (0 != dataFramePtr->dataFrame.seq) && (SUCCESS == status))
+	{
+		uint8_t ed_index = connectionHashFind(dataFramePtr->dataFrame.msg, END_DEVICE_SHORT_ADDR_LEN);
+		if (0xFF != ed_index)
+		{
+			CommandFrame_t frame;
+			if (!commandFrameAlloc(&frame, CMD_DATA_TO_ENDDEV_SUCCESS, PACKETLEN_CMD_DATA_TO_ENDDEV_SUCCESS))
+			return;
+			commandFramePut(&frame, dataFramePtr->dataFrame.seq);
+			commandFrameTransmit(&frame, false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[ed_index].Address, true, CommandConfCallback);
+		}
+	}
+#endif
+}
+
 void macAckOnlyDataCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPointer)
 {
 	P2PStarDataFrame_t *dataFramePtr = NULL;
-	dataFramePtr = (P2PStarDataFrame_t *) miQueueRemove(&macAckOnlyFrameQueue, NULL);
+	uint8_t loopIndex, queueSize = macAckOnlyFrameQueue.size;
 
-	if (NULL != dataFramePtr)
+	/* Frames of different transmit classes complete out of order, so look
+	   for the confirmed one and keep the others in their order */
+	for (loopIndex = 0; loopIndex < queueSize; loopIndex++)
 	{
-		DataConf_callback_t callback = dataFramePtr->dataFrame.confCallback;
-		if (NULL != callback && 1 != dataFramePtr->dataFrame.broadcast)
+		P2PStarDataFrame_t *framePtr = (P2PStarDataFrame_t *) miQueueRemove(&macAckOnlyFrameQueue, NULL);
+
+		if ((NULL == dataFramePtr) && (msgPointer == (uint8_t*)&(framePtr->dataFrame.msg)))
 		{
-			callback(handle, status, msgPointer);
+			dataFramePtr = framePtr;
 		}
-#if defined(PROTOCOL_STAR)
-		if (dataFramePtr->dataFrame.fromEDToED)
+		else
 		{
-			uint8_t ed_index = Find_Index(dataFramePtr->dataFrame.msg);
-			if (0xFF != ed_index)
-			{
-				uint8_t* dataPtr;
-				dataPtr = MiMem_Alloc(PACKETLEN_CMD_DATA_TO_ENDDEV_SUCCESS);
-				if (NULL == dataPtr)
-				return;
-				dataPtr[0] = CMD_DATA_TO_ENDDEV_SUCCESS;
-				frameTransmit(false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[ed_index].Address, true, true, 1, dataPtr, 0, true, CommandConfCallback);
-			}
+			miQueueAppend(&macAckOnlyFrameQueue, (miQueueBuffer_t *)framePtr);
 		}
-#endif
+	}
+
+	if (NULL != dataFramePtr)
+	{
+		dataFrameConfirm(dataFramePtr, handle, status, msgPointer);
 		MiMem_Free((uint8_t *)dataFramePtr);
 	}
 }
 
-#if defined(PROTOCOL_STAR)
-void appAckWaitDataCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPointer)
+#if defined(ENABLE_INDIRECT_MESSAGE)
+/*********************************************************************
+ * static bool indirectFrameStore(uint8_t connIndex, P2PStarDataFrame_t *dataFramePtr)
+ *
+ * Overview:        Holds a frame for a sleeping device until it polls
+ *                  with a data request
+ *
+ * Input:
+ *          uint8_t                 connIndex       Connection index of the device
+ *          P2PStarDataFrame_t *    dataFramePtr    The frame, which may
+ *                                                  already be held for
+ *                                                  other devices
+ *
+ * Output:          false if no entry could be allocated
+ ********************************************************************/
+static bool indirectFrameStore(uint8_t connIndex, P2PStarDataFrame_t *dataFramePtr)
 {
-	if (PAN_COORD == role)
+	IndirectFrame_t *entry = (IndirectFrame_t *)MiMem_Alloc(sizeof(IndirectFrame_t));
+
+	if (NULL == entry)
+	{
+		return false;
+	}
+	entry->dataFramePtr = dataFramePtr;
+	entry->queuedTick = MiWi_TickGet();
+	entry->connIndex = connIndex;
+	dataFramePtr->dataFrame.refCount++;
+	miQueueAppend(&indirectFrameQueue[connIndex], (miQueueBuffer_t *)entry);
+	if (0 == indirectFrameCount++)
 	{
-		uint8_t loopIndex;
-		P2PStarDataFrame_t *dataFramePtr = NULL;
-		for (loopIndex = 0; loopIndex < appAckWaitDataQueue.size; loopIndex++)
+		indirectExpiryTimerStart();
+	}
+	return true;
+}
+
+/*********************************************************************
+ * static void indirectFrameSend(uint8_t connIndex)
+ *
+ * Overview:        Sends the oldest frame held for a sleeping device
+ *
+ * Input:
+ *          uint8_t     connIndex       Connection index of the device
+ *
+ * Note:            If more frames are held for the device, the frame
+ *                  goes out with the frame pending bit and the next one
+ *                  follows on its confirmation, so that a single data
+ *                  request drains all of them.
+ ********************************************************************/
+static void indirectFrameSend(uint8_t connIndex)
+{
+	IndirectFrame_t *entry = (IndirectFrame_t *)miQueueRead(&indirectFrameQueue[connIndex], NULL);
+	P2PStarDataFrame_t *dataFramePtr;
+
+	if (NULL == entry)
+	{
+		return;
+	}
+	dataFramePtr = entry->dataFramePtr;
+	entry->framePending = (1 < indirectFrameQueue[connIndex].size);
+	if (!frameTransmit(dataFramePtr->dataFrame.broadcast, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[connIndex].Address, false, false, dataFramePtr->dataFrame.msgLength, dataFramePtr->dataFrame.msg,
+		dataFramePtr->dataFrame.msghandle, dataFramePtr->dataFrame.ackReq, entry->framePending, dataFramePtr->dataFrame.txClass, indirectFrameConfCallback))
+	{
+		/* Still held for the next data request */
+		return;
+	}
+	miQueueRemove(&indirectFrameQueue[connIndex], NULL);
+	indirectFrameCount--;
+
+	miQueueAppend(&indirectTxQueue, (miQueueBuffer_t *)entry);
+}
+
+/*********************************************************************
+ * static void indirectFrameRelease(P2PStarDataFrame_t *dataFramePtr)
+ *
+ * Overview:        Frees a held frame once no entry refers to it
+ ********************************************************************/
+static void indirectFrameRelease(P2PStarDataFrame_t *dataFramePtr)
+{
+	if (0 == --dataFramePtr->dataFrame.refCount)
+	{
+		MiMem_Free((uint8_t *)dataFramePtr);
+	}
+}
+
+/*********************************************************************
+ * static void indirectFrameDrop(IndirectFrame_t *entry)
+ *
+ * Overview:        Gives up a held frame which is no longer in the
+ *                  store; its sender learns it has expired
+ ********************************************************************/
+static void indirectFrameDrop(IndirectFrame_t *entry)
+{
+	P2PStarDataFrame_t *dataFramePtr = entry->dataFramePtr;
+	DataConf_callback_t callback = dataFramePtr->dataFrame.confCallback;
+
+	if (NULL != callback && 1 != dataFramePtr->dataFrame.broadcast)
+	{
+		callback(dataFramePtr->dataFrame.msghandle, TRANSACTION_EXPIRED, dataFramePtr->dataFrame.msg);
+	}
+	indirectFrameRelease(dataFramePtr);
+	MiMem_Free((uint8_t *)entry);
+}
+
+/*********************************************************************
+ * static void indirectFrameFlush(uint8_t connIndex)
+ *
+ * Overview:        Drops all the frames held for a connection index
+ ********************************************************************/
+static void indirectFrameFlush(uint8_t connIndex)
+{
+	IndirectFrame_t *entry;
+
+	while (NULL != (entry = (IndirectFrame_t *)miQueueRemove(&indirectFrameQueue[connIndex], NULL)))
+	{
+		indirectFrameCount--;
+		indirectFrameDrop(entry);
+	}
+}
+
+static void indirectFrameConfCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPointer)
+{
+	IndirectFrame_t *entry = NULL;
+	uint8_t loopIndex, queueSize = indirectTxQueue.size;
+
+	/* A shared broadcast can be in flight to several devices; as they
+	   are sent in one transmit class, the first one is confirmed first */
+	for (loopIndex = 0; loopIndex < queueSize; loopIndex++)
+	{
+		IndirectFrame_t *entryPtr = (IndirectFrame_t *)miQueueRemove(&indirectTxQueue, NULL);
+
+		if ((NULL == entry) && (msgPointer == (uint8_t*)&(entryPtr->dataFramePtr->dataFrame.msg)))
+		{
+			entry = entryPtr;
+		}
+		else
 		{
-			dataFramePtr = (P2PStarDataFrame_t *) miQueueRemove(&appAckWaitDataQueue, NULL);
+			miQueueAppend(&indirectTxQueue, (miQueueBuffer_t *)entryPtr);
+		}
+	}
 
-			if (NULL == dataFramePtr)
-			{
-				return;
-			}
-			
-			if(msgPointer == (uint8_t*)&(dataFramePtr->dataFrame.msg))
-			{
-				if (SUCCESS == status)
-				{
-					uint8_t* dataPtr = NULL;
-					uint8_t ed_index = Find_Index(dataFramePtr->dataFrame.msg);
-					if (0xFF != ed_index)
-					{
-						dataPtr = MiMem_Alloc(PACKETLEN_CMD_DATA_TO_ENDDEV_SUCCESS);
-						if (NULL == dataPtr)
-							return;
-						dataPtr[0] = CMD_DATA_TO_ENDDEV_SUCCESS;
-						frameTransmit(false, myPANID, miwiDefaultRomOrRamParams->ConnectionTable[ed_index].Address, true, true, 1, dataPtr, 0, true, CommandConfCallback);
-					}
-				}
-				MiMem_Free(dataFramePtr);
-			}
-			else
-			{
-				miQueueAppend(&appAckWaitDataQueue, (miQueueBuffer_t *)dataFramePtr);
-			}
+	if (NULL != entry)
+	{
+		dataFrameConfirm(entry->dataFramePtr, handle, status, msgPointer);
+		/* The sleeping device still listens for the next held frame */
+		if (entry->framePending && (SUCCESS == status))
+		{
+			indirectFrameSend(entry->connIndex);
 		}
+		indirectFrameRelease(entry->dataFramePtr);
+		MiMem_Free((uint8_t *)entry);
 	}
-	else if (SUCCESS != status)
+}
+
+/*********************************************************************
+ * static void indirectExpiryTimerStart(void)
+ *
+ * Overview:        Arms the expiry timer for the oldest held frame
+ *
+ * Note:            Frames are held in the order they are stored, so the
+ *                  oldest one is at the head of one of the queues.
+ ********************************************************************/
+static void indirectExpiryTimerStart(void)
+{
+	uint32_t now = MiWi_TickGet();
+	uint32_t oldest = 0;
+	uint32_t remaining;
+	uint8_t connIndex;
+
+	for (connIndex = 0; connIndex < CONNECTION_SIZE; connIndex++)
 	{
-		uint8_t loopIndex;
-		P2PStarDataFrame_t *dataFramePtr = NULL;
-		for (loopIndex = 0; loopIndex < appAckWaitDataQueue.size; loopIndex++)
+		IndirectFrame_t *entry = (IndirectFrame_t *)indirectFrameQueue[connIndex].head;
+
+		if (NULL != entry)
 		{
-			dataFramePtr = (P2PStarDataFrame_t *) miQueueRemove(&appAckWaitDataQueue, NULL);
+			/* Modulo 2^32, like the transmit queue ages */
+			oldest = Max(oldest, now - entry->queuedTick);
+		}
+	}
 
-			if (NULL == dataFramePtr)
-			{
-				return;
-			}
-		
-			if(handle == dataFramePtr->dataFrame.msghandle && msgPointer == (uint8_t*)&(dataFramePtr->dataFrame.msg))
-			{
-				DataConf_callback_t callback = dataFramePtr->dataFrame.confCallback;
-				if (NULL != callback)
-				{
-					callback(handle, status, msgPointer);
-				}
-				MiMem_Free((uint8_t *)dataFramePtr);
-			}
-			else
-			{
-				miQueueAppend(&appAckWaitDataQueue, (miQueueBuffer_t *)dataFramePtr);
-			}
+	remaining = (INDIRECT_MESSAGE_TIMEOUT * ONE_SECOND > oldest) ? (INDIRECT_MESSAGE_TIMEOUT * ONE_SECOND - oldest) : 0;
+	SYS_TimerStop(&indirectExpiryTimer);
+	indirectExpiryTimer.interval = Max(remaining / ONE_MILI_SECOND, SYS_TIMER_INTERVAL);
+	SYS_TimerStart(&indirectExpiryTimer);
+}
+
+static void indirectExpiryTimerHandler(SYS_Timer_t *timer)
+{
+	uint32_t now = MiWi_TickGet();
+	uint8_t connIndex;
+
+	for (connIndex = 0; connIndex < CONNECTION_SIZE; connIndex++)
+	{
+		IndirectFrame_t *entry;
+
+		while ((NULL != (entry = (IndirectFrame_t *)indirectFrameQueue[connIndex].head)) &&
+			((now - entry->queuedTick) >= INDIRECT_MESSAGE_TIMEOUT * ONE_SECOND))
+		{
+			miQueueRemove(&indirectFrameQueue[connIndex], NULL);
+			indirectFrameCount--;
+			indirectFrameDrop(entry);
 		}
 	}
+	if (indirectFrameCount)
+	{
+		indirectExpiryTimerStart();
+	}
+}
+#endif
+
+#if defined(PROTOCOL_STAR)
+/*********************************************************************
+ * static AppAckWait_t *appAckWaitAlloc(void)
+ *
+ * Overview:        Takes the next sequence number whose slot is free for
+ *                  a forwarded frame waiting for the SW ACK, NULL if all
+ *                  the slots are in use. Sequence number 0 is not used,
+ *                  it marks a forwarded frame without SW ACK.
+ ********************************************************************/
+static AppAckWait_t *appAckWaitAlloc(void)
+{
+	uint8_t probe;
+
+	for (probe = 0; probe < APP_ACK_WAIT_SIZE; probe++)
+	{
+		AppAckWait_t *entry;
+
+		if (0 == ++appAckSeq)
+		{
+			appAckSeq = 1;
+		}
+		entry = &appAckWaitTable[appAckSeq % APP_ACK_WAIT_SIZE];
+		if (NULL == entry->dataFramePtr)
+		{
+			entry->seq = appAckSeq;
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/*********************************************************************
+ * static AppAckWait_t *appAckWaitFind(uint8_t seq)
+ *
+ * Overview:        Returns the forwarded frame waiting for the SW ACK
+ *                  with the given sequence number, NULL if none
+ ********************************************************************/
+static AppAckWait_t *appAckWaitFind(uint8_t seq)
+{
+	AppAckWait_t *entry = &appAckWaitTable[seq % APP_ACK_WAIT_SIZE];
+
+	if ((NULL == entry->dataFramePtr) || (seq != entry->seq))
+	{
+		return NULL;
+	}
+	return entry;
+}
+
+/*********************************************************************
+ * static void appAckWaitRelease(AppAckWait_t *entry, miwi_status_t status)
+ *
+ * Overview:        Confirms a forwarded frame to the application and
+ *                  frees its slot
+ ********************************************************************/
+static void appAckWaitRelease(AppAckWait_t *entry, miwi_status_t status)
+{
+	P2PStarDataFrame_t *dataFramePtr = entry->dataFramePtr;
+	DataConf_callback_t callback = dataFramePtr->dataFrame.confCallback;
+
+	entry->dataFramePtr = NULL;
+	if (NULL != callback)
+	{
+		callback(dataFramePtr->dataFrame.msghandle, status, (uint8_t*)&(dataFramePtr->dataFrame.msg));
+	}
+	MiMem_Free((uint8_t *)dataFramePtr);
+}
+
+static void appAckWaitTimerHandler(SYS_Timer_t *timer)
+{
+	/* The timer is the first member of its slot */
+	appAckWaitRelease((AppAckWait_t *)timer, NO_ACK);
+}
+
+void appAckWaitDataCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPointer)
+{
+	/* The sequence number follows the short destination address */
+	AppAckWait_t *entry = appAckWaitFind(msgPointer[4]);
+
+	if ((NULL == entry) || (msgPointer != (uint8_t*)&(entry->dataFramePtr->dataFrame.msg)))
+	{
+		return;
+	}
+	if (SUCCESS == status)
+	{
+		/* The PAN coordinator has the frame, wait for the destination */
+		SYS_TimerStart(&entry->timer);
+	}
+	else
+	{
+		appAckWaitRelease(entry, status);
+	}
 }
 #endif
 
@@ -2928,7 +4236,32 @@ void appAckWaitDataCallback(uint8_t handle, miwi_status_t status, uint8_t* msgPo
 static void rfdDataWaitTimerExpired(struct SYS_Timer_t *timer)
 {
     P2PStatus.bits.DataRequesting = 0;
-    dataRequestInterval = RFD_WAKEUP_INTERVAL;
+    protocolTimerRestart(&dataRequestTimer, RFD_WAKEUP_INTERVAL * PROTOCOL_TIMER_SECOND);
+}
+
+static void dataRequestTimerHandler(SYS_Timer_t *timer)
+{
+    /* Poll once the own frames are out, the answer would otherwise
+       collide with them */
+    P2PStatus.bits.DataRequestPending = 1;
+    P2PStatus.bits.DataRequesting = 1;
+}
+
+/************************************************************************************
+* Function:
+*      uint16_t MiApp_CurrentDataRequestIntervalSec(void)
+*
+* Summary:
+*      This function returns the time until the next data request
+*
+* Returns:
+*      The seconds until the next data request, rounded up. 0 if no data
+*      request is scheduled.
+*
+*****************************************************************************************/
+uint16_t MiApp_CurrentDataRequestIntervalSec(void)
+{
+    return (SYS_TimerRemainingTimeout(&dataRequestTimer) + PROTOCOL_TIMER_SECOND - 1) / PROTOCOL_TIMER_SECOND;
 }
 #endif
 
@@ -2948,7 +4281,12 @@ static void channelHopCmdCallback(uint8_t msgConfHandle, miwi_status_t status, u
     }
 
     /* Start the timer for broadcast retries */
-    freqAgilityBroadcastInterval = (miwi_scan_duration_ticks(9)/1000000)+1;
+    protocolTimerRestart(&freqAgilityBroadcastTimer, miwi_scan_duration_ticks(9) / ONE_MILI_SECOND);
+}
+
+static void freqAgilityBroadcastTimerHandler(SYS_Timer_t *timer)
+{
+    StartChannelHopping();
 }
 
 /*********************************************************************
@@ -2971,21 +4309,18 @@ static void channelHopCmdCallback(uint8_t msgConfHandle, miwi_status_t status, u
 ********************************************************************/
 static void StartChannelHopping(void)
 {
-    uint8_t* dataPtr = NULL;
-    uint8_t dataLen = 0;
+    CommandFrame_t frame;
 
     /* Prepare the Channel Hopping Message */
-    dataPtr = MiMem_Alloc(PACKETLEN_CMD_CHANNEL_HOPPING);
-    if (NULL == dataPtr)
+    if (!commandFrameAlloc(&frame, CMD_CHANNEL_HOPPING, PACKETLEN_CMD_CHANNEL_HOPPING))
        return;
 
     /* Prepare channel hop command */
-    dataPtr[dataLen++] = CMD_CHANNEL_HOPPING;
-    dataPtr[dataLen++] = currentChannel;
-    dataPtr[dataLen++] = optimalChannel;
+    commandFramePut(&frame, currentChannel);
+    commandFramePut(&frame, optimalChannel);
 
     /* Initiate the transmission */
-    frameTransmit(true, myPANID, NULL, true, false, dataLen, dataPtr,0, true, channelHopCmdCallback);
+    commandFrameTransmit(&frame, true, myPANID, NULL, false, channelHopCmdCallback);
 }
 
 /*******************************************************************************************
@@ -3054,6 +4389,136 @@ bool MiApp_InitChannelHopping( INPUT uint32_t ChannelMap)
 
     return true;
 }
+
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR)
+/*********************************************************************
+* static void channelMonitorTimerHandler(SYS_Timer_t *timer)
+*
+* Overview:        Ends a monitoring period. A period is degraded when
+*                  too many acknowledged frames failed or the channel
+*                  is noisy. After CHANNEL_MONITOR_DEGRADED_PERIODS of
+*                  them in a row all channels are scanned for one to
+*                  hop to, otherwise only the operating channel is.
+*
+********************************************************************/
+static void channelMonitorTimerHandler(SYS_Timer_t *timer)
+{
+    uint32_t scanMap = 1UL << currentChannel;
+    bool degraded;
+
+    if ((IN_NETWORK_STATE != p2pStarCurrentState) || channelChangeInProgress
+#if defined(PROTOCOL_STAR)
+        || (PAN_COORD != role)
+#endif
+        )
+    {
+        channelMonitor.txFrames = 0;
+        channelMonitor.txFailures = 0;
+        return;
+    }
+
+    degraded = (channelMonitor.txFrames >= CHANNEL_MONITOR_MIN_FRAMES) &&
+        ((uint32_t)channelMonitor.txFailures * 100 >= (uint32_t)channelMonitor.txFrames * CHANNEL_MONITOR_FAILURE_PERCENT);
+    if ((channelMonitor.scanned & scanMap) && (channelMonitor.busyPercent[currentChannel] >= CHANNEL_MONITOR_BUSY_PERCENT))
+    {
+        degraded = true;
+    }
+    channelMonitor.txFrames = 0;
+    channelMonitor.txFailures = 0;
+
+    if (!degraded)
+    {
+        channelMonitor.degradedPeriods = 0;
+    }
+    else if (channelMonitor.degradedPeriods < 0xFF)
+    {
+        channelMonitor.degradedPeriods++;
+    }
+    if (channelMonitor.holdoffPeriods)
+    {
+        channelMonitor.holdoffPeriods--;
+    }
+
+    channelMonitor.candidateScan = (channelMonitor.degradedPeriods >= CHANNEL_MONITOR_DEGRADED_PERIODS) &&
+        (0 == channelMonitor.holdoffPeriods);
+    if (channelMonitor.candidateScan)
+    {
+        scanMap |= CHANNEL_MONITOR_CHANNEL_MAP;
+    }
+    /* A scan of the application takes the place of this one */
+    if (!MiApp_EdScanStart(scanMap, CHANNEL_MONITOR_SCAN_DURATION, channelMonitorScanInd, channelMonitorScanConf))
+    {
+        channelMonitor.candidateScan = false;
+    }
+}
+
+static void channelMonitorScanInd(EdScanResult_t *result)
+{
+    uint8_t channel = result->channel;
+
+    if (result->samples)
+    {
+        channelMonitor.noise[channel] = result->meanEnergy;
+        channelMonitor.busyPercent[channel] = (uint8_t)((uint16_t)result->busySamples * 100 / result->samples);
+        channelMonitor.scanned |= 1UL << channel;
+    }
+    else
+    {
+        channelMonitor.scanned &= ~(1UL << channel);
+    }
+}
+
+/* Hops to the least busy channel, the quietest of them, when it is
+   clearly better than the operating one */
+static void channelMonitorScanConf(uint8_t quietestChannel)
+{
+    uint8_t best = 0xFF;
+    uint8_t channel;
+
+    if (!channelMonitor.candidateScan)
+    {
+        return;
+    }
+    channelMonitor.candidateScan = false;
+    channelMonitor.degradedPeriods = 0;
+    channelMonitor.holdoffPeriods = CHANNEL_MONITOR_HOLDOFF_PERIODS;
+
+    if (channelChangeInProgress || (IN_NETWORK_STATE != p2pStarCurrentState))
+    {
+        return;
+    }
+    for (channel = 0; channel < 32; channel++)
+    {
+        if ((channel == currentChannel) || !(channelMonitor.scanned & (1UL << channel)) ||
+            !(CHANNEL_MONITOR_CHANNEL_MAP & (1UL << channel)))
+        {
+            continue;
+        }
+        if ((0xFF == best) || (channelMonitor.busyPercent[channel] < channelMonitor.busyPercent[best]) ||
+            ((channelMonitor.busyPercent[channel] == channelMonitor.busyPercent[best]) &&
+             (channelMonitor.noise[channel] < channelMonitor.noise[best])))
+        {
+            best = channel;
+        }
+    }
+    if ((0xFF == best) || (2 * channelMonitor.busyPercent[best] > CHANNEL_MONITOR_BUSY_PERCENT))
+    {
+        return;
+    }
+    /* A channel busy all the time has no sample, it is left anyway */
+    if ((channelMonitor.scanned & (1UL << currentChannel)) &&
+        (channelMonitor.busyPercent[best] >= channelMonitor.busyPercent[currentChannel]) &&
+        (channelMonitor.noise[best] + CHANNEL_MONITOR_NOISE_MARGIN > channelMonitor.noise[currentChannel]))
+    {
+        return;
+    }
+
+    optimalChannel = best;
+    freqAgilityRetries = 0;
+    channelChangeInProgress = true;
+    StartChannelHopping();
+}
+#endif
 #endif
 
 #ifdef ENABLE_SLEEP_FEATURE
@@ -3079,13 +4544,32 @@ bool MiApp_InitChannelHopping( INPUT uint32_t ChannelMap)
 *****************************************************************************************/
 bool MiApp_ReadyToSleep(uint32_t* sleepTime)
 {
-    if((p2pStarCurrentState == IN_NETWORK_STATE) && !(P2PStatus.bits.DataRequesting || P2PStatus.bits.RxHasUserData || (frameTxQueue.size) || (!txCallbackReceived)))
+#if defined(ENABLE_BACKGROUND_ED_SCAN)
+    if (edScanInfo.inProgress || edScanInfo.sampling)
+    {
+        return false;
+    }
+#endif
+    if((p2pStarCurrentState == IN_NETWORK_STATE) && !(P2PStatus.bits.DataRequesting || P2PStatus.bits.RxHasUserData || (frameTxQueued) || (sentFrameQueue.size)))
     {
-        *sleepTime = dataRequestInterval * 1000;
+#if defined(ENABLE_TICKLESS_IDLE)
+        *sleepTime = SYS_TimerNextExpiry(NULL);
+        if (SYS_TIMER_NO_EXPIRY == *sleepTime)
+        {
+            /* No timer armed, the device still wakes up once per data request period */
+            *sleepTime = RFD_WAKEUP_INTERVAL * PROTOCOL_TIMER_SECOND;
+        }
+        /* Up to the end of the system timer tick the deadline is in, so
+           the slept ticks make it expire on wake up */
+        *sleepTime = ((*sleepTime + SYS_TIMER_INTERVAL - 1) / SYS_TIMER_INTERVAL) * SYS_TIMER_INTERVAL;
+#else
+        *sleepTime = SYS_TimerRemainingTimeout(&dataRequestTimer);
+#endif
         return true;
     }
     return false;
 }
+
 #endif
 
 #if defined(ENABLE_NETWORK_FREEZER)
@@ -81,29 +81,58 @@
 
 #define PACKETLEN_P2P_ACTIVE_SCAN_RESPONSE             (2 + ADDITIONAL_NODE_ID_SIZE)
 #define PACKETLEN_P2P_CONNECTION_REMOVAL_RESPONSE       2
-#define PACKETLEN_TIME_SYNC_DATA_PACKET                 TX_BUFFER_SIZE
-#define PACKETLEN_MAC_DATA_REQUEST                      TX_BUFFER_SIZE
+#define PACKETLEN_MAC_DATA_REQUEST                      1
 #define PACKETLEN_P2P_CONNECTION_REMOVAL_REQUEST        1
 #define PACKETLEN_CMD_IAM_ALIVE                         1
-#define PACKETLEN_CMD_DATA_TO_ENDDEV_SUCCESS            1
+#define PACKETLEN_CMD_DATA_TO_ENDDEV_SUCCESS            2
 #define PACKETLEN_P2P_CONNECTION_REQUEST               (4 + ADDITIONAL_NODE_ID_SIZE)
+#define PACKETLEN_P2P_CONNECTION_RESPONSE              (4 + ADDITIONAL_NODE_ID_SIZE)
 #define PACKETLEN_P2P_ACTIVE_SCAN_REQUEST               2
 #define PACKETLEN_CMD_CHANNEL_HOPPING                   3
+// command, destination short address and SW ACK sequence number
+#define FORWARD_PACKET_HEADER_SIZE                      5
+// end devices are also known by the first bytes of their long address
+#define END_DEVICE_SHORT_ADDR_LEN                       3
+#if defined(ENABLE_LINK_STATUS_AGGREGATION)
+// keepalive interval of the end devices, last byte of the share headers
+#define CONNECTION_TABLE_KEEPALIVE_SIZE                 1
+#else
+#define CONNECTION_TABLE_KEEPALIVE_SIZE                 0
+#endif
+// command, number of end devices, generation, first and end slot
+#define CONNECTION_TABLE_SNAPSHOT_HEADER_SIZE           (5 + CONNECTION_TABLE_KEEPALIVE_SIZE)
+// command, number of end devices, generation, number of changes
+#define CONNECTION_TABLE_DELTA_HEADER_SIZE              (4 + CONNECTION_TABLE_KEEPALIVE_SIZE)
+// short address and slot of an end device
+#define CONNECTION_TABLE_ENTRY_SIZE                     4
+#define PACKETLEN_CMD_CONNECTION_TABLE_REQUEST          1
+// buffer size of the pool of small command frames, all commands but the
+// connection table share fit in it
+#define PACKETLEN_SMALL_COMMAND                         8
 
 #if defined (PROTOCOL_STAR)
 // END_device uses this command to denote PAN COR
 // that the data enclosed in packet is to be forwarded
-// to another END_Device in network
+// to another END_Device in network. The short address of the
+// destination and the sequence number of the SW ACK, 0 for none,
+// precede the data
 #define CMD_FORWRD_PACKET 0xCC
 // PAN COR will send this command to denote Packet Forward Success ,
-// SW generated ACK
+// SW generated ACK carrying the sequence number of the forwarded packet
 # define CMD_DATA_TO_ENDDEV_SUCCESS 0xDA
 // Used by END Devices to Send Link Status
 #define CMD_IAM_ALIVE  0x7A
 // Used by END Devices  to qualify them as permanent forever in Network Table
 #define CMD_MAKE_CONNECTION_ENTRY_PERMENANT  0x3A
-// Used by PAN COR to Share Connection Table Information with Peer END Devices
+// Used by PAN COR to Share Connection Table Information with Peer END Devices,
+// the whole table at a generation, split over several frames
 #define CMD_SHARE_CONNECTION_TABLE              0x77
+// Used by PAN COR to share the last changes of its Connection Table,
+// each one moving the table to the next generation
+#define CMD_CONNECTION_TABLE_DELTA              0x78
+// Used by END Devices which cannot apply the changes to ask PAN COR
+// for the whole Connection Table
+#define CMD_CONNECTION_TABLE_REQUEST            0x79
 #endif
 
 #if defined(ENABLE_ED_SCAN) && defined(ENABLE_FREQUENCY_AGILITY)
@@ -134,6 +163,8 @@ typedef union
         uint8_t Resync                 :1;     // indicate if the stack is currently in the process of
                                             // resynchronizing connection with the peer device
         uint8_t Enhanced_DR_SecEn      :1;
+        uint8_t DataRequestPending     :1;     // indicate that the data request waits until the frames
+                                            // queued by the device itself are sent
     }bits;                                  // bit map of the P2P status
 } P2P_STATUS;                               
 
@@ -165,6 +196,8 @@ typedef union
 #define SHARE_PEER_DEVICE_INFO_TIMEOUT      15
 #define LINK_STATUS_TIMEOUT                 15
 #define SW_ACK_TIMEOUT                      2
+// number of forwarded packets an END_device can have waiting for their SW ACK
+#define APP_ACK_WAIT_SIZE                   8
 // every 1 minute / 60 seconds the stack will evaluate the inactive end nodes
 #define FIND_INACTIVE_DEVICE_TIMEOUT        60
 #define END_DEVICES_DISPLAY_TIMEOUT         1000*15
@@ -204,13 +237,15 @@ typedef struct _DataFrame_t
 {
 	DataConf_callback_t confCallback;
 	uint8_t destAddress[MY_ADDRESS_LENGTH];
-	uint8_t timeout;
+	uint8_t seq;              // sequence number of the SW ACK of a forwarded frame
 	uint8_t ackReq;
 	uint8_t broadcast;
 	uint8_t fromEDToED;
+	uint8_t refCount;         // indirect store entries holding the frame
 	uint8_t msghandle;
+	uint8_t txClass;
 	uint8_t msgLength;
-	uint8_t msg[MAX_PAYLOAD + 4]; // +4 to support packet forward header
+	uint8_t msg[MAX_PAYLOAD + FORWARD_PACKET_HEADER_SIZE]; // to support packet forward header
 } DataFrame_t;
 
 typedef struct _P2PStarDataFrame_t
@@ -219,7 +254,37 @@ typedef struct _P2PStarDataFrame_t
 	DataFrame_t dataFrame;
 } P2PStarDataFrame_t;
 
+/* Frame held for a sleeping device. A broadcast is held once and shared
+ * by the entries of all sleeping devices. */
+typedef struct _IndirectFrame_t
+{
+	struct _IndirectFrame_t *nextFrame;
+	P2PStarDataFrame_t *dataFramePtr;
+	uint32_t queuedTick;      // MiWi_TickGet() when it was stored
+	uint8_t connIndex;        // connection table index of the sleeping device
+	uint8_t framePending;     // sent with more frames held for the device
+} IndirectFrame_t;
+
+/* Forwarded frame waiting for the SW ACK of the PAN coordinator, kept in
+ * the slot its sequence number selects */
+typedef struct _AppAckWait_t
+{
+	SYS_Timer_t timer;        // deadline of the SW ACK, runs from the MAC confirmation
+	P2PStarDataFrame_t *dataFramePtr;
+	uint8_t seq;
+} AppAckWait_t;
+
+/* Command frame being built. The bytes put are counted against the size
+ * allocated, a frame which does not fit is not sent. */
+typedef struct _CommandFrame_t
+{
+	uint8_t *data;
+	uint8_t size;             // bytes allocated, PACKETLEN_* of the command
+	uint8_t length;           // bytes put, command identifier included
+} CommandFrame_t;
+
 /************************ FUNCTION PROTOTYPES **********************/
 bool    isSameAddress(INPUT uint8_t *Address1, INPUT uint8_t *Address2);
+uint8_t connectionHashFind(INPUT uint8_t *Address, INPUT uint8_t AddressLength);
 
 #endif //__MIWI_P2P_STAR_H_
\ No newline at end of file
@@ -32,9 +32,17 @@
 */
 
 /************************ HEADERS **********************************/
+/* Keeps mimem.h from redirecting the allocation functions */
+#define MIMEM_IMPLEMENTATION
+
 #include <string.h>
 #include "compiler.h"
+#include "miwi_config.h"
 #include "mimem.h"
+#if defined(ENABLE_MIMEM_STATS)
+#include <stdio.h>
+#include "sysTimer.h"
+#endif
 
 /************************ MACRO DEFINITIONS ******************************/
 #define BYTE_ALIGNMENT   4U
@@ -46,6 +54,15 @@
 
 #define HEAP_MINIMUM_BLOCK_SIZE	 (( size_t )( blockMetaDataSize + 4U)) //4 is min bytes being allocated with alignment
 
+#define SLAB_MAX_CLASSES MIMEM_SLAB_CLASSES
+
+#if defined(ENABLE_MIMEM_STATS)
+/* Allocation time stored in front of every buffer */
+#define STATS_HEADER_SIZE   (sizeof(StatsHeader_t))
+#else
+#define STATS_HEADER_SIZE   0U
+#endif
+
 /************************ TYPE DEFINITIONS ******************************/
 typedef struct _Block_t
 {
@@ -55,14 +72,55 @@ typedef struct _Block_t
 	bool free;
 } Block_t;
 
+#if defined(ENABLE_MIMEM_SLAB)
+/* Free block of a slab, linked through its first word */
+typedef struct _SlabBlock_t
+{
+	struct _SlabBlock_t* next;
+} SlabBlock_t;
+
+/* Pool of equal blocks carved out of the heap in one piece */
+typedef struct _Slab_t
+{
+	uint8_t* start;
+	uint8_t* end;
+	SlabBlock_t* freeList;
+	size_t blockSize;
+} Slab_t;
+#endif
+
+#if defined(ENABLE_MIMEM_STATS)
+typedef union _StatsHeader_t
+{
+	uint32_t allocTick;
+	void* alignment;
+} StatsHeader_t;
+#endif
+
 /************************ FUNCTION PROTOTYPES **********************/
 static void splitBlock (Block_t* blockTobeSplitted, size_t size);
+static void* heapAlloc(size_t requestedSize);
+static void heapFree(Block_t* freeBlockPtr);
+static void* memAlloc(size_t size);
+static void memFree(void* ptr);
 
 /************************ VARIABLES ********************************/
 static uint8_t heapMem[HEAP_SIZE];
 static Block_t* base = NULL;
 static size_t totalFreeBytesRemaining;
 static const size_t blockMetaDataSize = ALIGN(sizeof(Block_t));
+#if defined(ENABLE_MIMEM_SLAB)
+/* Size classes, in increasing block size */
+static Slab_t slabs[SLAB_MAX_CLASSES];
+static uint8_t slabCount;
+#endif
+#if defined(ENABLE_MIMEM_STATS)
+static uint32_t statsAllocations;
+static uint32_t statsFailures;
+static size_t statsFreeBytesMin;
+static uint32_t statsLifetime[MIMEM_STATS_LIFETIME_BINS];
+static MiMemFailSite_t statsFailSites[MIMEM_STATS_FAIL_SITES];
+#endif
 
 /************************ FUNCTIONS ********************************/
 
@@ -87,7 +145,82 @@ void MiMem_Init(void)
 	base->free = true;
 	base->next = NULL;
 	base->prev = NULL;
+#if defined(ENABLE_MIMEM_SLAB)
+	slabCount = 0;
+#endif
+#if defined(ENABLE_MIMEM_STATS)
+	MiMem_StatsReset();
+#endif
+}
+
+#if defined(ENABLE_MIMEM_SLAB)
+/*********************************************************************
+* Function:         bool MiMem_SlabCreate(uint8_t size, uint8_t count)
+*
+* PreCondition:     none
+*
+* Input:		    size  - Block size of the class in bytes
+*                   count - Number of blocks
+*
+* Output:		    bool - true if the pool was created
+*
+* Side Effects:	    Takes count blocks of memory from the heap
+*
+* Overview:		    This function adds a size class: allocations of up to
+*  size bytes are then served from a free list of equal blocks in constant
+*  time. A pool of an existing block size is added next to the first one,
+*  the allocations of that size then use the blocks of both.
+*
+* Note:			    Only SLAB_MAX_CLASSES pools can be created, MiMem_Init
+*                   discards them
+********************************************************************/
+bool MiMem_SlabCreate(uint8_t size, uint8_t count)
+{
+	size_t blockSize;
+	uint8_t* region;
+	Slab_t* slab;
+	uint8_t i;
+
+	if (!base)
+	{
+		MiMem_Init();
+	}
+	if ((0U == size) || (0U == count))
+	{
+		return false;
+	}
+	blockSize = ALIGN((size_t)size + STATS_HEADER_SIZE);
+	for (i = 0; (i < slabCount) && (slabs[i].blockSize < blockSize); i++);
+	if (slabCount >= SLAB_MAX_CLASSES)
+	{
+		return false;
+	}
+	region = (uint8_t*)heapAlloc(ALIGN(blockSize * count + blockMetaDataSize));
+	if (NULL == region)
+	{
+		return false;
+	}
+
+	/* Keep the classes sorted so the first fit is the tightest */
+	memmove(&slabs[i + 1], &slabs[i], (slabCount - i) * sizeof(Slab_t));
+	slabCount++;
+	slab = &slabs[i];
+	slab->start = region;
+	slab->end = region + blockSize * count;
+	slab->blockSize = blockSize;
+	slab->freeList = NULL;
+	for (i = count; i > 0; i--)
+	{
+		SlabBlock_t* block = (SlabBlock_t*)(slab->start + (i - 1U) * blockSize);
+
+		block->next = slab->freeList;
+		slab->freeList = block;
+	}
+	/* The blocks count as free memory until they are handed out */
+	totalFreeBytesRemaining += blockSize * count;
+	return true;
 }
+#endif
 
 /*********************************************************************
 * Function:         void* MiMem_Alloc(uint8_t size)
@@ -100,58 +233,82 @@ void MiMem_Init(void)
 *
 * Side Effects:	    none
 *
-* Overview:		    This function returns valid pointer if memory is allocated
-*  or returns NULL if no memory available
+* Overview:		    This function returns valid pointer to zeroed memory if
+*  memory is allocated or returns NULL if no memory available
 *
 * Note:			    none
 ********************************************************************/
 void* MiMem_Alloc(uint8_t size)
 {
-	size_t requestedSize = 0U;
-	void* requestedMemPtr = NULL;
+	void* requestedMemPtr = MiMem_AllocNoClear(size);
 
+	if (NULL != requestedMemPtr)
+	{
+		memset(requestedMemPtr, 0, size);
+	}
+	return requestedMemPtr;
+}
+
+/*********************************************************************
+* Function:         void* MiMem_AllocNoClear(uint8_t size)
+*
+* PreCondition:     none
+*
+* Input:		    size  - Required number of bytes
+*
+* Output:		    uint8_t*_t - Pointer to the allocated memory or NULL
+*
+* Side Effects:	    none
+*
+* Overview:		    Same as MiMem_Alloc, for callers that initialize the
+*  whole buffer themselves. The smallest size class with a free block is
+*  used, the heap only when no class fits.
+*
+* Note:			    Contents of the memory are undefined
+********************************************************************/
+void* MiMem_AllocNoClear(uint8_t size)
+{
+#if defined(ENABLE_MIMEM_STATS)
+	return MiMem_AllocAt(size, false, NULL, 0);
+#else
 	/* Initialize the Heap */
 	if (!base)
 	{
 		MiMem_Init();
 	}
-	/* if requested size is of non zero */
-	if (size)
+	/* Nothing to allocate for a zero size */
+	if (!size)
 	{
-		requestedSize =  size + blockMetaDataSize;
-		requestedSize = ALIGN(requestedSize);
-		if (requestedSize <= totalFreeBytesRemaining)
-		{
-			size_t receivedSize = (size_t)~0U;
-			Block_t *requestedBlock = NULL;
-			Block_t *blockPtr = base;
+		return NULL;
+	}
+	return memAlloc(size);
+#endif
+}
 
-			/* Find best fit free Block */
-			while (blockPtr)
-			{
-				if ((blockPtr->free) && (blockPtr->size >= requestedSize) && (blockPtr->size < receivedSize))
-				{
-					receivedSize = blockPtr->size;
-					requestedBlock = blockPtr;
-				}
-				blockPtr = blockPtr->next;
-			}
+/******************************************************************************
+  \brief Allocation from the tightest size class with a free block, else
+    from the heap
+  \param[in] size - number of bytes
+  \return Pointer to the memory, NULL if none is available.
+ ******************************************************************************/
+static void* memAlloc(size_t size)
+{
+#if defined(ENABLE_MIMEM_SLAB)
+	for (uint8_t i = 0; i < slabCount; i++)
+	{
+		Slab_t* slab = &slabs[i];
 
-			if (requestedBlock)
-			{
-				if ((requestedBlock->size - requestedSize) > HEAP_MINIMUM_BLOCK_SIZE)
-				splitBlock (requestedBlock, requestedSize);
-				requestedBlock->free = false;
-				totalFreeBytesRemaining -= requestedBlock->size;
-				requestedMemPtr = ( void* )(((uint8_t*)requestedBlock) + blockMetaDataSize);
-			}
+		if ((size <= slab->blockSize) && slab->freeList)
+		{
+			SlabBlock_t* block = slab->freeList;
+
+			slab->freeList = block->next;
+			totalFreeBytesRemaining -= slab->blockSize;
+			return block;
 		}
 	}
-	if (NULL != requestedMemPtr)
-	{
-		memset(requestedMemPtr, 0, size);
-	}
-	return requestedMemPtr;
+#endif
+	return heapAlloc(ALIGN(size + blockMetaDataSize));
 }
 
 /*********************************************************************
@@ -171,9 +328,100 @@ void* MiMem_Alloc(uint8_t size)
 * Note:			    none
 ********************************************************************/
 void MiMem_Free(void *ptr)
+{
+#if defined(ENABLE_MIMEM_STATS)
+	StatsHeader_t* header;
+	uint32_t lifetimeMs;
+	uint8_t bin = 0;
+
+	if (NULL == ptr)
+	{
+		return;
+	}
+	header = (StatsHeader_t*)((uint8_t*)ptr - STATS_HEADER_SIZE);
+	lifetimeMs = (MiWi_TickGet() - header->allocTick) / ONE_MILI_SECOND;
+	while ((lifetimeMs > 0U) && (bin < (MIMEM_STATS_LIFETIME_BINS - 1)))
+	{
+		lifetimeMs >>= 1;
+		bin++;
+	}
+	statsLifetime[bin]++;
+	memFree(header);
+#else
+	memFree(ptr);
+#endif
+}
+
+/******************************************************************************
+  \brief Return memory to its size class or to the heap
+  \param[in] ptr - memory from memAlloc
+  \return None.
+ ******************************************************************************/
+static void memFree(void* ptr)
+{
+#if defined(ENABLE_MIMEM_SLAB)
+	for (uint8_t i = 0; i < slabCount; i++)
+	{
+		Slab_t* slab = &slabs[i];
+
+		if (((uint8_t*)ptr >= slab->start) && ((uint8_t*)ptr < slab->end))
+		{
+			((SlabBlock_t*)ptr)->next = slab->freeList;
+			slab->freeList = (SlabBlock_t*)ptr;
+			totalFreeBytesRemaining += slab->blockSize;
+			return;
+		}
+	}
+#endif
+	heapFree((Block_t*)((uint8_t*)ptr - (uint8_t*)blockMetaDataSize));
+}
+
+/******************************************************************************
+  \brief Best fit allocation from the block list of the heap
+  \param[in] requestedSize - aligned size including the block meta data
+  \return Pointer to the memory after the meta data, NULL if none fits.
+ ******************************************************************************/
+static void* heapAlloc(size_t requestedSize)
+{
+	void* requestedMemPtr = NULL;
+
+	if (requestedSize <= totalFreeBytesRemaining)
+	{
+		size_t receivedSize = (size_t)~0U;
+		Block_t *requestedBlock = NULL;
+		Block_t *blockPtr = base;
+
+		/* Find best fit free Block */
+		while (blockPtr)
+		{
+			if ((blockPtr->free) && (blockPtr->size >= requestedSize) && (blockPtr->size < receivedSize))
+			{
+				receivedSize = blockPtr->size;
+				requestedBlock = blockPtr;
+			}
+			blockPtr = blockPtr->next;
+		}
+
+		if (requestedBlock)
+		{
+			if ((requestedBlock->size - requestedSize) > HEAP_MINIMUM_BLOCK_SIZE)
+			splitBlock (requestedBlock, requestedSize);
+			requestedBlock->free = false;
+			totalFreeBytesRemaining -= requestedBlock->size;
+			requestedMemPtr = ( void* )(((uint8_t*)requestedBlock) + blockMetaDataSize);
+		}
+	}
+	return requestedMemPtr;
+}
+
+/******************************************************************************
+  \brief Return a block to the heap and merge it with free neighbours
+  \param[in] freeBlockPtr - meta data of the block to be freed
+  \return None.
+ ******************************************************************************/
+static void heapFree(Block_t* freeBlockPtr)
 {
 	Block_t* blockPtr = base;
-	Block_t* freeBlockPtr = (Block_t*)((uint8_t*)ptr - (uint8_t*)blockMetaDataSize);
 
 	for(; ((blockPtr != NULL) && (blockPtr != freeBlockPtr)); blockPtr = blockPtr->next);
 
@@ -231,3 +479,230 @@ uint8_t MiMem_PercentageOfFreeBuffers(void)
 {
 	return (totalFreeBytesRemaining * 100) / HEAP_SIZE;;
 }
+
+#if defined(ENABLE_MIMEM_STATS)
+/*********************************************************************
+* Function:         void* MiMem_AllocAt(uint8_t size, bool clear,
+*                                       const char* file, uint16_t line)
+*
+* PreCondition:     none
+*
+* Input:		    size  - Required number of bytes
+*                   clear - true to zero the memory
+*                   file, line - call site, for the failure statistics
+*
+* Output:		    uint8_t*_t - Pointer to the allocated memory or NULL
+*
+* Side Effects:	    none
+*
+* Overview:		    MiMem_Alloc and MiMem_AllocNoClear resolve to this
+*  function when the statistics are enabled
+*
+* Note:			    none
+********************************************************************/
+void* MiMem_AllocAt(uint8_t size, bool clear, const char* file, uint16_t line)
+{
+	StatsHeader_t* header;
+	uint8_t* requestedMemPtr;
+
+	if (!base)
+	{
+		MiMem_Init();
+	}
+	if (!size)
+	{
+		return NULL;
+	}
+	header = (StatsHeader_t*)memAlloc((size_t)size + STATS_HEADER_SIZE);
+	if (NULL == header)
+	{
+		MiMem_StatsFailure(file, line);
+		return NULL;
+	}
+	statsAllocations++;
+	if (totalFreeBytesRemaining < statsFreeBytesMin)
+	{
+		statsFreeBytesMin = totalFreeBytesRemaining;
+	}
+	header->allocTick = MiWi_TickGet();
+	requestedMemPtr = (uint8_t*)header + STATS_HEADER_SIZE;
+	if (clear)
+	{
+		memset(requestedMemPtr, 0, size);
+	}
+	return requestedMemPtr;
+}
+
+/*********************************************************************
+* Function:         void MiMem_StatsFailure(const char* file, uint16_t line)
+*
+* PreCondition:     none
+*
+* Input:		    file, line - call site
+*
+* Output:		    none
+*
+* Side Effects:	    none
+*
+* Overview:		    Counts a failed allocation. The stack also reports
+*  frames it drops because the free memory is below its threshold.
+*
+* Note:			    Failures beyond MIMEM_STATS_FAIL_SITES distinct call
+*  sites only show up in the total
+********************************************************************/
+void MiMem_StatsFailure(const char* file, uint16_t line)
+{
+	uint8_t i;
+
+	statsFailures++;
+	for (i = 0; i < MIMEM_STATS_FAIL_SITES; i++)
+	{
+		MiMemFailSite_t* site = &statsFailSites[i];
+
+		if ((0U == site->failures) || ((site->file == file) && (site->line == line)))
+		{
+			site->file = file;
+			site->line = line;
+			site->failures++;
+			break;
+		}
+	}
+}
+
+/*********************************************************************
+* Function:         void MiMem_GetStats(MiMemStats_t* stats)
+*
+* PreCondition:     none
+*
+* Input:		    stats - filled with the current statistics
+*
+* Output:		    none
+*
+* Side Effects:	    none
+*
+* Overview:		    Walks the heap and the size classes for the block
+*  counts and the largest free block, and copies the counters
+*
+* Note:			    none
+********************************************************************/
+void MiMem_GetStats(MiMemStats_t* stats)
+{
+	Block_t* blockPtr;
+
+	if (!base)
+	{
+		MiMem_Init();
+	}
+	memset(stats, 0, sizeof(MiMemStats_t));
+	stats->heapSize = HEAP_SIZE;
+	stats->freeBytes = (uint16_t)totalFreeBytesRemaining;
+	stats->freeBytesMin = (uint16_t)statsFreeBytesMin;
+
+	for (blockPtr = base; blockPtr != NULL; blockPtr = blockPtr->next)
+	{
+		stats->blocks++;
+		if (blockPtr->free)
+		{
+			size_t usable = blockPtr->size - blockMetaDataSize - STATS_HEADER_SIZE;
+
+			stats->freeBlocks++;
+			stats->largestFreeBlock = Max(stats->largestFreeBlock, (uint16_t)usable);
+		}
+	}
+#if defined(ENABLE_MIMEM_SLAB)
+	for (uint8_t i = 0; i < slabCount; i++)
+	{
+		SlabBlock_t* block;
+
+		stats->blocks += (uint16_t)((slabs[i].end - slabs[i].start) / slabs[i].blockSize);
+		for (block = slabs[i].freeList; block != NULL; block = block->next)
+		{
+			stats->freeBlocks++;
+			stats->largestFreeBlock = Max(stats->largestFreeBlock, (uint16_t)(slabs[i].blockSize - STATS_HEADER_SIZE));
+		}
+	}
+#endif
+	stats->allocations = statsAllocations;
+	stats->failures = statsFailures;
+	memcpy(stats->lifetime, statsLifetime, sizeof(statsLifetime));
+	memcpy(stats->failSites, statsFailSites, sizeof(statsFailSites));
+}
+
+/*********************************************************************
+* Function:         void MiMem_StatsReset(void)
+*
+* PreCondition:     none
+*
+* Input:		    none
+*
+* Output:		    none
+*
+* Side Effects:	    none
+*
+* Overview:		    Clears the counters and restarts the free memory
+*  minimum from the current level
+*
+* Note:			    none
+********************************************************************/
+void MiMem_StatsReset(void)
+{
+	statsAllocations = 0;
+	statsFailures = 0;
+	statsFreeBytesMin = totalFreeBytesRemaining;
+	memset(statsLifetime, 0, sizeof(statsLifetime));
+	memset(statsFailSites, 0, sizeof(statsFailSites));
+}
+
+/*********************************************************************
+* Function:         void MiMem_StatsPrint(void)
+*
+* PreCondition:     none
+*
+* Input:		    none
+*
+* Output:		    none
+*
+* Side Effects:	    none
+*
+* Overview:		    Prints the statistics on the console
+*
+* Note:			    none
+********************************************************************/
+void MiMem_StatsPrint(void)
+{
+	MiMemStats_t stats;
+	uint8_t i;
+
+	MiMem_GetStats(&stats);
+	printf("\r\nMiMem: %u of %u bytes free, minimum %u, largest block %u",
+		stats.freeBytes, stats.heapSize, stats.freeBytesMin, stats.largestFreeBlock);
+	printf("\r\n  %u blocks, %u free", stats.blocks, stats.freeBlocks);
+#if defined(ENABLE_MIMEM_SLAB)
+	for (i = 0; i < slabCount; i++)
+	{
+		printf("\r\n  class of %u bytes: %u blocks",
+			(unsigned)(slabs[i].blockSize - STATS_HEADER_SIZE),
+			(unsigned)((slabs[i].end - slabs[i].start) / slabs[i].blockSize));
+	}
+#endif
+	printf("\r\n  %lu allocations, %lu failed", (unsigned long)stats.allocations, (unsigned long)stats.failures);
+	for (i = 0; (i < MIMEM_STATS_FAIL_SITES) && stats.failSites[i].failures; i++)
+	{
+		printf("\r\n    %s:%u %u", stats.failSites[i].file ? stats.failSites[i].file : "?",
+			stats.failSites[i].line, stats.failSites[i].failures);
+	}
+	printf("\r\n  lifetime ms:");
+	for (i = 0; i < MIMEM_STATS_LIFETIME_BINS; i++)
+	{
+		if (stats.lifetime[i] && (i < (MIMEM_STATS_LIFETIME_BINS - 1)))
+		{
+			printf(" <%lu:%lu", 1UL << i, (unsigned long)stats.lifetime[i]);
+		}
+		else if (stats.lifetime[i])
+		{
+			printf(" >=%lu:%lu", 1UL << (i - 1), (unsigned long)stats.lifetime[i]);
+		}
+	}
+	printf("\r\n");
+}
+#endif
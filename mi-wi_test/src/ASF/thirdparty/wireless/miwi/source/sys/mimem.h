@@ -35,7 +35,7 @@
 #define __MIMEM_H_
 
 /************************ HEADERS **********************************/
-
+#include "miwi_config.h"
 
 /************************ DEFINITIONS ******************************/
 #if defined(PROTOCOL_MESH)
@@ -49,12 +49,59 @@
 #else
 #define NUMBER_OF_MIMEM_BUFFERS  10
 #endif
+
+#if defined(ENABLE_MIMEM_STATS)
+/* Call sites whose failed allocations are counted separately */
+#define MIMEM_STATS_FAIL_SITES        8
+/* Lifetime histogram: bin 0 is below 1 ms, bin n from 2^(n-1) ms */
+#define MIMEM_STATS_LIFETIME_BINS     16
+#endif
 /************************ DATA TYPES *******************************/
+#if defined(ENABLE_MIMEM_STATS)
+typedef struct _MiMemFailSite_t
+{
+	const char* file;
+	uint16_t line;
+	uint16_t failures;
+} MiMemFailSite_t;
+
+typedef struct _MiMemStats_t
+{
+	uint16_t heapSize;
+	uint16_t freeBytes;
+	/* Least free memory seen since start or the last reset */
+	uint16_t freeBytesMin;
+	/* Largest single allocation that would currently succeed */
+	uint16_t largestFreeBlock;
+	uint16_t blocks;
+	uint16_t freeBlocks;
+	uint32_t allocations;
+	uint32_t failures;
+	uint32_t lifetime[MIMEM_STATS_LIFETIME_BINS];
+	MiMemFailSite_t failSites[MIMEM_STATS_FAIL_SITES];
+} MiMemStats_t;
+#endif
 
 /************************ Prototypes ********************************/
 void MiMem_Init(void);
 void* MiMem_Alloc(uint8_t size);
+void* MiMem_AllocNoClear(uint8_t size);
+bool MiMem_SlabCreate(uint8_t size, uint8_t count);
 void MiMem_Free(void* buffPtr);
 uint8_t MiMem_PercentageOfFreeBuffers(void);
+
+#if defined(ENABLE_MIMEM_STATS)
+void* MiMem_AllocAt(uint8_t size, bool clear, const char* file, uint16_t line);
+void MiMem_StatsFailure(const char* file, uint16_t line);
+void MiMem_GetStats(MiMemStats_t* stats);
+void MiMem_StatsReset(void);
+void MiMem_StatsPrint(void);
+
+/* Record the call site of every allocation of the stack */
+#if !defined(MIMEM_IMPLEMENTATION)
+#define MiMem_Alloc(size)           MiMem_AllocAt((size), true, __FILE__, __LINE__)
+#define MiMem_AllocNoClear(size)    MiMem_AllocAt((size), false, __FILE__, __LINE__)
+#endif
+#endif
 #endif
 
@@ -0,0 +1,129 @@
+/**
+* \file  miring.c
+*
+* \brief Single producer, single consumer ring for MiWi Protocol implementation
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries. 
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products. 
+* It is your responsibility to comply with third party license terms applicable 
+* to your use of third party software (including open source software) that 
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, 
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, 
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, 
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE 
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL 
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE 
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE 
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT 
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY 
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY, 
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+
+/* === Includes ============================================================ */
+#include "miring.h"
+
+/* === Implementation ====================================================== */
+
+/**
+ * @brief Initializes the ring.
+ *
+ * @param ring The ring which should be initialized.
+ *
+ * @param elements Storage for capacity elements of elementSize bytes.
+ *
+ * @param elementSize Size of one element in bytes.
+ *
+ * @param capacity Number of elements, a power of two up to 128.
+ */
+void miRingInit(MiRing_t *ring, void *elements, uint8_t elementSize, uint8_t capacity)
+{
+	Assert((capacity != 0) && (capacity <= 128) && ((capacity & (capacity - 1)) == 0));
+
+	ring->elements = (uint8_t *)elements;
+	ring->elementSize = elementSize;
+	ring->capacity = capacity;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->overruns = 0;
+}
+
+/**
+ * @brief Reserves the next free element for the producer.
+ *
+ * @param ring Ring to produce into
+ *
+ * @return Pointer to the element to fill, NULL if the ring is full.
+ */
+void *miRingReserve(MiRing_t *ring)
+{
+	uint8_t head = ring->head;
+
+	if ((uint8_t)(head - ring->tail) >= ring->capacity)
+	{
+		ring->overruns++;
+		return NULL;
+	}
+	/* The consumer released the element before moving tail */
+	MI_RING_BARRIER();
+	return &ring->elements[(head & (ring->capacity - 1)) * ring->elementSize];
+}
+
+/**
+ * @brief Hands the element reserved last over to the consumer.
+ *
+ * @param ring Ring to produce into
+ */
+void miRingCommit(MiRing_t *ring)
+{
+	/* The element is complete before the consumer can see it */
+	MI_RING_BARRIER();
+	ring->head = ring->head + 1;
+}
+
+/**
+ * @brief Reads the oldest element without removing it.
+ *
+ * @param ring Ring to consume from
+ *
+ * @return Pointer to the element, NULL if the ring is empty.
+ */
+void *miRingPeek(MiRing_t *ring)
+{
+	uint8_t tail = ring->tail;
+
+	if (tail == ring->head)
+	{
+		return NULL;
+	}
+	MI_RING_BARRIER();
+	return &ring->elements[(tail & (ring->capacity - 1)) * ring->elementSize];
+}
+
+/**
+ * @brief Gives the oldest element back to the producer.
+ *
+ * @param ring Ring to consume from
+ */
+void miRingRelease(MiRing_t *ring)
+{
+	if (ring->tail != ring->head)
+	{
+		/* Done with the element before the producer can reuse it */
+		MI_RING_BARRIER();
+		ring->tail = ring->tail + 1;
+	}
+}
+
+/* EOF */
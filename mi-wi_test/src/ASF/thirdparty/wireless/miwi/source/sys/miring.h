@@ -0,0 +1,158 @@
+/**
+* \file  miring.h
+*
+* \brief Single producer, single consumer ring for MiWi Protocol interface
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries. 
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products. 
+* It is your responsibility to comply with third party license terms applicable 
+* to your use of third party software (including open source software) that 
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, 
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, 
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, 
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE 
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL 
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE 
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE 
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT 
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY 
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY, 
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+
+/* Prevent double inclusion */
+#ifndef __MIRING_H
+#define __MIRING_H
+
+/* === Includes ============================================================ */
+#include "compiler.h"
+
+/**
+ * \ingroup group_resources
+ * \defgroup group_ring  Ring Buffer
+ * Ring Buffer: fixed size elements passed from one producer to one consumer,
+ * for example from an interrupt to the main loop, without disabling
+ * interrupts. The producer fills a reserved element in place and commits it,
+ * the consumer reads the oldest element in place and releases it, so nothing
+ * is copied by the ring itself.
+ *  @{
+ */
+
+/* === Macros ============================================================== */
+/**
+ * Keeps the compiler from moving element accesses across the index
+ * updates. A single core needs no hardware barrier.
+ */
+#define MI_RING_BARRIER()    __asm__ __volatile__ ("" ::: "memory")
+
+/* === Types =============================================================== */
+
+/**
+ * @brief Ring structure
+ *
+ * The indices run freely and are masked on access, so the capacity must be a
+ * power of two of at most 128. head is only written by the producer and tail
+ * only by the consumer.
+ */
+typedef struct MiRing
+{
+	/** Element storage, capacity * elementSize bytes */
+	uint8_t *elements;
+	/** Size of one element in bytes */
+	uint8_t elementSize;
+	/** Number of elements, a power of two */
+	uint8_t capacity;
+	/** Count of committed elements, written by the producer */
+	volatile uint8_t head;
+	/** Count of released elements, written by the consumer */
+	volatile uint8_t tail;
+	/** Elements the producer could not reserve because the ring was full */
+	volatile uint16_t overruns;
+} MiRing_t;
+
+/* === Prototypes ========================================================== */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Initializes the ring.
+ *
+ * @param ring The ring which should be initialized.
+ *
+ * @param elements Storage for capacity elements of elementSize bytes.
+ *
+ * @param elementSize Size of one element in bytes.
+ *
+ * @param capacity Number of elements, a power of two up to 128.
+ */
+void miRingInit(MiRing_t *ring, void *elements, uint8_t elementSize, uint8_t capacity);
+
+/**
+ * @brief Reserves the next free element for the producer.
+ *
+ * The element becomes visible to the consumer with miRingCommit. A full ring
+ * counts an overrun.
+ *
+ * @param ring Ring to produce into
+ *
+ * @return Pointer to the element to fill, NULL if the ring is full.
+ */
+void *miRingReserve(MiRing_t *ring);
+
+/**
+ * @brief Hands the element reserved last over to the consumer.
+ *
+ * @param ring Ring to produce into
+ */
+void miRingCommit(MiRing_t *ring);
+
+/**
+ * @brief Reads the oldest element without removing it.
+ *
+ * @param ring Ring to consume from
+ *
+ * @return Pointer to the element, NULL if the ring is empty.
+ */
+void *miRingPeek(MiRing_t *ring);
+
+/**
+ * @brief Gives the oldest element back to the producer.
+ *
+ * @param ring Ring to consume from
+ */
+void miRingRelease(MiRing_t *ring);
+
+/**
+ * @brief Number of elements waiting for the consumer.
+ *
+ * @param ring The ring
+ *
+ * @return Element count
+ */
+static inline uint8_t miRingCount(MiRing_t *ring)
+{
+	return (uint8_t)(ring->head - ring->tail);
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/* ! @} */
+#endif /* __MIRING_H */
+
+/* EOF */
@@ -32,20 +32,46 @@
 */
 
 /*- Includes ---------------------------------------------------------------*/
+#include <string.h>
 #include "compiler.h"
+#include "miwi_config.h"
 #include "common_hw_timer.h"
 #include "sysTimer.h"
 
 
+/*- Definitions ------------------------------------------------------------*/
+#if (SYS_TIMER_WHEEL_SIZE < 2) || (SYS_TIMER_WHEEL_SIZE > 256) || \
+	(SYS_TIMER_WHEEL_SIZE & (SYS_TIMER_WHEEL_SIZE - 1))
+#error "SYS_TIMER_WHEEL_SIZE must be a power of two up to 256"
+#endif
+
+#define TIMER_WHEEL_MASK        (SYS_TIMER_WHEEL_SIZE - 1)
+
 /*****************************************************************************
 *****************************************************************************/
-static void placeTimer(SYS_Timer_t *timer);
+static bool timerLinked(SYS_Timer_t *timer);
+static void linkTimer(SYS_Timer_t *timer, uint32_t expiry);
+static void unlinkTimer(SYS_Timer_t *timer);
+static void expireTimers(void);
 static void SYS_HwExpiry_Cb(void);
 static void SYS_HwOverflow_Cb(void);
 
 /*- Variables --------------------------------------------------------------*/
-static SYS_Timer_t *timers;
+/* Hashed timer wheel: slot n holds, as a circular list, the timers that
+ * expire in the ticks n, n + SYS_TIMER_WHEEL_SIZE, ... of SYS_TIMER_INTERVAL.
+ * The timeout of an armed timer is its expiry time in milliseconds. */
+static SYS_Timer_t *timerWheel[SYS_TIMER_WHEEL_SIZE];
+static uint32_t timerTick;
+static uint32_t timerNow;
+/* Time the timers started now are relative to. While a timer expires,
+ * this is its expiry time, like the delta list of the timers had it. */
+static uint32_t timerBase;
+static uint16_t timersArmed;
+static bool timersExpiring;
 volatile uint32_t SysTimerIrqCount;
+/* Hardware timer count at the last tick, the part of a tick elapsed
+ * before a sleep is counted in the slept time */
+static volatile uint16_t timerTickCount;
 
 volatile uint8_t timerExtension1,timerExtension2;
 
@@ -62,15 +88,21 @@ void SYS_TimerInit(void)
 	set_common_tc_expiry_callback(SYS_HwExpiry_Cb);
 	common_tc_init();
 	common_tc_delay(SYS_TIMER_INTERVAL * MS);
-	timers = NULL;
+	timerTickCount = common_tc_read_count();
+	memset(timerWheel, 0, sizeof(timerWheel));
+	timerTick = 0;
+	timerNow = 0;
+	timerBase = 0;
+	timersArmed = 0;
+	timersExpiring = false;
 }
 
 /*************************************************************************//**
 *****************************************************************************/
 void SYS_TimerStart(SYS_Timer_t *timer)
 {
-	if (!SYS_TimerStarted(timer)) {
-		placeTimer(timer);
+	if (!timerLinked(timer)) {
+		linkTimer(timer, timerBase + timer->interval);
 	}
 }
 
@@ -78,24 +110,8 @@ void SYS_TimerStart(SYS_Timer_t *timer)
 *****************************************************************************/
 void SYS_TimerStop(SYS_Timer_t *timer)
 {
-	SYS_Timer_t *prev = NULL;
-
-	for (SYS_Timer_t *t = timers; t; t = t->next) {
-		if (t == timer) {
-			if (prev) {
-				prev->next = t->next;
-			} else {
-				timers = t->next;
-			}
-
-			if (t->next) {
-				t->next->timeout += timer->timeout;
-			}
-
-			break;
-		}
-
-		prev = t;
+	if (timerLinked(timer)) {
+		unlinkTimer(timer);
 	}
 }
 
@@ -103,19 +119,13 @@ void SYS_TimerStop(SYS_Timer_t *timer)
 *****************************************************************************/
 bool SYS_TimerStarted(SYS_Timer_t *timer)
 {
-	for (SYS_Timer_t *t = timers; t; t = t->next) {
-		if (t == timer) {
-			return true;
-		}
-	}
-	return false;
+	return timerLinked(timer);
 }
 
 /*************************************************************************//**
 *****************************************************************************/
 void SYS_TimerTaskHandler(void)
 {
-	uint32_t elapsed;
 	uint32_t cnt;
 	irqflags_t flags;
 
@@ -130,60 +140,140 @@ void SYS_TimerTaskHandler(void)
 	/* Leave the critical section */
 	cpu_irq_restore(flags);
 
-	elapsed = cnt * SYS_TIMER_INTERVAL;
+	/* Visit the slot of every elapsed tick, also after a long sleep, so
+	 * that the timers expire in order */
+	while (cnt--) {
+		timerTick++;
+		timerNow += SYS_TIMER_INTERVAL;
+		timerBase = timerNow;
+		if (timersArmed) {
+			expireTimers();
+		}
+	}
+}
 
-	while (timers && (timers->timeout <= elapsed)) {
-		SYS_Timer_t *timer = timers;
+/*********************************************************************
+* Function:         static bool timerLinked(SYS_Timer_t *timer)
+*
+* Overview:         Tells if the timer is armed by looking for it in the
+*                   wheel, so the internal data of a timer that has never
+*                   been started may hold anything
+********************************************************************/
+static bool timerLinked(SYS_Timer_t *timer)
+{
+	SYS_Timer_t *head = timerWheel[timer->slot & TIMER_WHEEL_MASK];
+	SYS_Timer_t *t = head;
 
-		elapsed -= timers->timeout;
-		timers = timers->next;
-		if (SYS_TIMER_PERIODIC_MODE == timer->mode) {
-			placeTimer(timer);
-		}
+	if (t) {
+		do {
+			if (t == timer) {
+				return true;
+			}
+			t = t->next;
+		} while (t != head);
+	}
+	return false;
+}
 
-		if (timer->handler) {
-			timer->handler(timer);
-		}
+/*********************************************************************
+* Function:         static void linkTimer(SYS_Timer_t *timer, uint32_t expiry)
+*
+* Overview:         Arms the timer to expire at the given time. The timer
+*                   goes to the tail of the slot of the tick it expires
+*                   in, so timers of equal expiry keep their order. An
+*                   expiry that has passed already takes the next tick,
+*                   or the current one while its timers expire.
+********************************************************************/
+static void linkTimer(SYS_Timer_t *timer, uint32_t expiry)
+{
+	int32_t delta = (int32_t)(expiry - timerNow);
+	uint32_t ticks;
+	SYS_Timer_t **slot;
+
+	if (delta > 0) {
+		ticks = ((uint32_t)delta + SYS_TIMER_INTERVAL - 1) / SYS_TIMER_INTERVAL;
+	} else {
+		ticks = timersExpiring ? 0 : 1;
 	}
 
-	if (timers) {
-		timers->timeout -= elapsed;
+	timer->timeout = expiry;
+	timer->slot = (uint8_t)((timerTick + ticks) & TIMER_WHEEL_MASK);
+	slot = &timerWheel[timer->slot];
+	if (*slot) {
+		timer->next = *slot;
+		timer->prev = (*slot)->prev;
+		timer->prev->next = timer;
+		(*slot)->prev = timer;
+	} else {
+		timer->next = timer;
+		timer->prev = timer;
+		*slot = timer;
 	}
+	timersArmed++;
 }
 
-/*************************************************************************//**
+/*****************************************************************************
 *****************************************************************************/
-static void placeTimer(SYS_Timer_t *timer)
+static void unlinkTimer(SYS_Timer_t *timer)
+{
+	SYS_Timer_t **slot = &timerWheel[timer->slot];
+
+	if (timer->next == timer) {
+		*slot = NULL;
+	} else {
+		timer->prev->next = timer->next;
+		timer->next->prev = timer->prev;
+		if (*slot == timer) {
+			*slot = timer->next;
+		}
+	}
+	timer->next = NULL;
+	timer->prev = NULL;
+	timersArmed--;
+}
+
+/*********************************************************************
+* Function:         static void expireTimers(void)
+*
+* Overview:         Expires the timers of the current tick, the earliest
+*                   first. The slot also holds timers of later rounds of
+*                   the wheel, these stay. The slot is searched again
+*                   after every handler, since a handler may stop or start
+*                   any timer.
+********************************************************************/
+static void expireTimers(void)
 {
-	if (timers) {
-		SYS_Timer_t *prev = NULL;
-		uint32_t timeout = timer->interval;
-
-		for (SYS_Timer_t *t = timers; t; t = t->next) {
-			if (timeout < t->timeout) {
-				t->timeout -= timeout;
-				break;
-			} else {
-				timeout -= t->timeout;
+	SYS_Timer_t **slot = &timerWheel[timerTick & TIMER_WHEEL_MASK];
+
+	timersExpiring = true;
+	while (*slot) {
+		SYS_Timer_t *timer = NULL;
+		SYS_Timer_t *t = *slot;
+
+		do {
+			if (((int32_t)(t->timeout - timerNow) <= 0) &&
+				((NULL == timer) || ((int32_t)(t->timeout - timer->timeout) < 0))) {
+				timer = t;
 			}
+			t = t->next;
+		} while (t != *slot);
 
-			prev = t;
+		if (NULL == timer) {
+			break;
 		}
 
-		timer->timeout = timeout;
+		unlinkTimer(timer);
+		timerBase = timer->timeout;
+		if (SYS_TIMER_PERIODIC_MODE == timer->mode) {
+			linkTimer(timer, timer->timeout + timer->interval);
+		}
 
-		if (prev) {
-			timer->next = prev->next;
-			prev->next = timer;
-		} else {
-			timer->next = timers;
-			timers = timer;
+		if (timer->handler) {
+			timer->handler(timer);
 		}
-	} else {
-		timer->next = NULL;
-		timer->timeout = timer->interval;
-		timers = timer;
 	}
+	timerBase = timerNow;
+	timersExpiring = false;
 }
 
 /*********************************************************************
@@ -271,6 +361,7 @@ uint32_t MiWi_TickGetDiff(MIWI_TICK current_tick, MIWI_TICK previous_tick)
 static void SYS_HwExpiry_Cb(void)
 {
 	SysTimerIrqCount++;
+	timerTickCount = common_tc_read_count();
 	common_tc_delay(SYS_TIMER_INTERVAL * MS);
 }
 
@@ -298,15 +389,21 @@ static void SYS_HwOverflow_Cb(void)
 * Overview:		    This function adjusts the duration for which
 *                   application slept and correct the timers
 *
-* Note:			    none
+* Note:			    The part of the tick elapsed before the sleep and
+*                   the part of a tick left after it are carried over,
+*                   so that the ticks keep their pace over many short
+*                   sleeps
 ********************************************************************/
 void SYS_TimerAdjust_SleptTime(uint32_t sleeptime)
 {
     irqflags_t flags;
+    /* The timer count stands still from the start of the sleep */
+    uint32_t slept = (uint32_t)(uint16_t)(common_tc_read_count() - timerTickCount) + sleeptime * MS;
+    uint32_t remainder = slept % (SYS_TIMER_INTERVAL * MS);
 
     /* Enter a critical section */
     flags = cpu_irq_save();
-    SysTimerIrqCount = (sleeptime / SYS_TIMER_INTERVAL);
+    SysTimerIrqCount += (slept / (SYS_TIMER_INTERVAL * MS));
     /* Leave the critical section */
     cpu_irq_restore(flags);
 
@@ -316,7 +413,8 @@ void SYS_TimerAdjust_SleptTime(uint32_t sleeptime)
     set_common_tc_overflow_callback(SYS_HwOverflow_Cb);
     set_common_tc_expiry_callback(SYS_HwExpiry_Cb);
     common_tc_init();
-    common_tc_delay(SYS_TIMER_INTERVAL * MS);
+    common_tc_delay(SYS_TIMER_INTERVAL * MS - remainder);
+    timerTickCount = common_tc_read_count() - remainder;
 }
 
 /*********************************************************************
@@ -332,21 +430,72 @@ void SYS_TimerAdjust_SleptTime(uint32_t sleeptime)
 * Side Effects:	    none
 *
 * Overview:		    This function returns total timeout for the requested
-*                   timer to expire by traversing through the list
+*                   timer to expire, from its expiry time
 *
 * Note:			    none
 ********************************************************************/
 uint32_t SYS_TimerRemainingTimeout(struct SYS_Timer_t *timer)
 {
-	uint32_t remainingTime = 0;
-	SYS_Timer_t *currTimer = timers;
-	while (currTimer){
-		remainingTime += currTimer->timeout;
-		if (currTimer == timer)
+	int32_t remainingTime;
+
+	if (!timerLinked(timer))
+	{
+		return 0;
+	}
+	remainingTime = (int32_t)(timer->timeout - timerNow);
+	return (remainingTime > 0) ? (uint32_t)remainingTime : 0;
+}
+
+/*********************************************************************
+* Function:         uint32_t SYS_TimerNextExpiry
+*
+* PreCondition:     none
+*
+* Input:		    SYS_Timer_t *except - Timer left out, NULL for none
+*
+* Output:		    uint32_t - Time in milliseconds until the earliest
+*                              armed timer expires, SYS_TIMER_NO_EXPIRY
+*                              if none is armed
+*
+* Side Effects:	    none
+*
+* Overview:		    This function returns how long the device may
+*                   sleep before a timer is due, counted like
+*                   SYS_TimerRemainingTimeout()
+*
+* Note:			    Every slot of the wheel is visited, since the
+*                   timers of a slot may belong to later rounds
+********************************************************************/
+uint32_t SYS_TimerNextExpiry(SYS_Timer_t *except)
+{
+	uint32_t next = SYS_TIMER_NO_EXPIRY;
+	uint16_t i;
+
+	for (i = 0; i < SYS_TIMER_WHEEL_SIZE; i++)
+	{
+		SYS_Timer_t *t = timerWheel[i];
+
+		if (NULL == t)
 		{
-			return remainingTime;
+			continue;
 		}
-		currTimer = currTimer->next;
+		do
+		{
+			if (t != except)
+			{
+				int32_t remainingTime = (int32_t)(t->timeout - timerNow);
+
+				if (remainingTime <= 0)
+				{
+					return 0;
+				}
+				if ((uint32_t)remainingTime < next)
+				{
+					next = (uint32_t)remainingTime;
+				}
+			}
+			t = t->next;
+		} while (t != timerWheel[i]);
 	}
-	return 0;
-}
\ No newline at end of file
+	return next;
+}
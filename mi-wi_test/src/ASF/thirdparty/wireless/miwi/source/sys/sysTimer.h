@@ -46,6 +46,8 @@
 
 #define SYS_TIMER_INTERVAL      10ul /* ms */
 #define MS 1000
+/* SYS_TimerNextExpiry() without any timer to wait for */
+#define SYS_TIMER_NO_EXPIRY     0xFFFFFFFFul
 
 #define ONE_SECOND              ((uint32_t)1000000)
 
@@ -69,9 +71,11 @@ typedef enum SYS_TimerMode_t {
 } SYS_TimerMode_t;
 
 typedef struct SYS_Timer_t {
-	/* Internal data */
+	/* Internal data, only valid while the timer is started */
 	struct SYS_Timer_t *next;
+	struct SYS_Timer_t *prev;
 	uint32_t timeout;
+	uint8_t slot;
 
 	/* Timer parameters */
 	uint32_t interval;
@@ -105,6 +109,7 @@ bool SYS_TimerStarted(SYS_Timer_t *timer);
 void SYS_TimerTaskHandler(void);
 void SYS_TimerAdjust_SleptTime(uint32_t sleeptime);
 uint32_t SYS_TimerRemainingTimeout(struct SYS_Timer_t *timer);
+uint32_t SYS_TimerNextExpiry(SYS_Timer_t *except);
 
 uint32_t MiWi_TickGet(void);
 uint32_t MiWi_TickGetDiff(MIWI_TICK current_tick, MIWI_TICK previous_tick);
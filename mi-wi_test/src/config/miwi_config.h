@@ -71,12 +71,36 @@
 
 #define ENABLE_PERIODIC_CONNECTIONTABLE_SHARE
 
+// The PAN Co shares the changes of its connection table rather than
+// the whole table, each change moving the table to a new generation.
+// CONNECTION_TABLE_DELTA_LOG_SIZE last changes are kept, an End device
+// which missed fewer updates catches up from the next one, otherwise it
+// asks for the whole table. Must be a power of two; the changes must
+// fit in a TX_BUFFER_SIZE frame.
+
+#define CONNECTION_TABLE_DELTA_LOG_SIZE 8
+
 // Link status only used by END Devices in Star Network
 // Link status will confirm Pan CO that the device sending
 // link status is active in network.
 
 #define ENABLE_LINK_STATUS
 
+// Link status aggregation, Pan CO takes any frame exchanged with an END
+// Device as its link status, the END Device only sends link status when
+// no other frame of it was acknowledged by Pan CO for its keepalive
+// interval. Pan CO stretches the keepalive interval by LINK_STATUS_TIMEOUT
+// for every LINK_STATUS_AGGREGATION_DEVICES END Devices, one step at each
+// periodic connection table share which carries it, up to
+// LINK_STATUS_AGGREGATION_MAX_TIMEOUT seconds. Inactive devices are
+// found over four keepalive intervals. The keepalive interval is carried
+// in the connection table shares, so every device of the network must
+// be built with the same setting.
+
+//#define ENABLE_LINK_STATUS_AGGREGATION
+#define LINK_STATUS_AGGREGATION_DEVICES       16
+#define LINK_STATUS_AGGREGATION_MAX_TIMEOUT   120
+
 // App layer ack will be used when a user wants
 // generate a SW ack. Pan Co generates the sw ack
 
@@ -137,7 +161,20 @@
 // P2P_CONNECTION_SIZE defines the maximum P2P connections that this
 // device allowes at the same time.
 /*********************************************************************/
+#if !defined(CONNECTION_SIZE)
 #define CONNECTION_SIZE             10
+#endif
+
+
+/*********************************************************************/
+// CONNECTION_HASH_SIZE defines the number of buckets of the index that
+// finds a connection from the long or short address of a device
+// without scanning the connection table. It must be a power of two
+// and at least twice CONNECTION_SIZE.
+/*********************************************************************/
+#if !defined(CONNECTION_HASH_SIZE)
+#define CONNECTION_HASH_SIZE        32
+#endif
 
 
 /*********************************************************************/
@@ -156,6 +193,27 @@
 //#define ENABLE_PA_LNA
 
 
+/*********************************************************************/
+// ENABLE_TX_POWER_CONTROL sends the unicast frames of every connection
+// at the lowest power which keeps the link at
+// TX_POWER_CONTROL_TARGET_RSSI dBm. The power is lowered by as many dB
+// as the frames of the peer arrive above the target (smoothed over
+// about 1 << TX_POWER_CONTROL_RSSI_SHIFT frames), by
+// TX_POWER_CONTROL_MAX_REDUCTION dB at most. As the peer never sends
+// above full power, the link stays at the target whatever the peer
+// does, provided both use the same transmit power setting. A frame
+// without acknowledgement sets the connection back to full power.
+// Broadcasts and acknowledgements always go at full power.
+/*********************************************************************/
+#define ENABLE_TX_POWER_CONTROL
+
+#if defined(ENABLE_TX_POWER_CONTROL)
+#define TX_POWER_CONTROL_TARGET_RSSI    (-75)
+#define TX_POWER_CONTROL_RSSI_SHIFT     2
+#define TX_POWER_CONTROL_MAX_REDUCTION  24
+#endif
+
+
 /*********************************************************************/
 // ENABLE_HAND_SHAKE enables the protocol stack to hand-shake before
 // communicating with each other. Without a handshake process, RF
@@ -170,6 +228,23 @@
 /*********************************************************************/
 #define ENABLE_ED_SCAN
 
+/*********************************************************************/
+// ENABLE_BACKGROUND_ED_SCAN adds MiApp_EdScanStart, an energy detection
+// scan that does not block the main loop. Every ED_SCAN_SAMPLE_INTERVAL
+// milliseconds it measures the energy of the channel being scanned,
+// when the stack has no frame to send or to confirm; the transceiver
+// interrupt ends the measurement. The minimum, mean and maximum energy
+// of each channel is reported through a callback, with the number of
+// samples of ED_SCAN_BUSY_LEVEL dBm or more. It needs
+// ENABLE_PHY_RX_IRQ.
+/*********************************************************************/
+#define ENABLE_BACKGROUND_ED_SCAN
+
+#if defined(ENABLE_BACKGROUND_ED_SCAN)
+#define ED_SCAN_SAMPLE_INTERVAL     10
+#define ED_SCAN_BUSY_LEVEL          (-85)
+#endif
+
 
 /*********************************************************************/
 // ENABLE_ACTIVE_SCAN will enable the device to do an active scan to
@@ -185,6 +260,16 @@
 #define ENABLE_SECURITY
 
 
+/*********************************************************************/
+// ENABLE_SOFTWARE_AES secures the frames with a table driven AES-128
+// on the MCU instead of the AES engine of the transceiver, e.g. for
+// host builds or to keep the SPI bus free. It adds the software
+// backend to the transceiver one, MiMAC_CcmSetBackend() switches
+// between them at run time.
+/*********************************************************************/
+//#define ENABLE_SOFTWARE_AES
+
+
 /*********************************************************************/
 // ENABLE_INDIRECT_MESSAGE will enable the device to store the packets
 // for the sleeping devices temporily until they wake up and ask for
@@ -208,12 +293,140 @@
 /*********************************************************************/
 #define RFD_WAKEUP_INTERVAL     8
 
+/*********************************************************************/
+// ENABLE_TICKLESS_IDLE lets a sleeping device sleep until the earliest
+// deadline of its timers instead of until its next data request. The
+// application timers and the pending protocol timeouts wake it when
+// they are due.
+/*********************************************************************/
+#define ENABLE_TICKLESS_IDLE
+
 /*********************************************************************/
 // ENABLE_FREQUENCY_AGILITY will enable the device to change operating
 // channel to bypass the sudden change of noise
 /*********************************************************************/
 //#define ENABLE_FREQUENCY_AGILITY
 
+/*********************************************************************/
+// ENABLE_CHANNEL_QUALITY_MONITOR lets the device that started the
+// network hop to another channel by itself when its channel degrades,
+// with the channel hopping of ENABLE_FREQUENCY_AGILITY, which has to be
+// enabled as well. Every
+// CHANNEL_MONITOR_PERIOD seconds it looks at its acknowledged frames
+// of the period and at a background energy scan of its channel. The
+// period is degraded when CHANNEL_MONITOR_FAILURE_PERCENT of at least
+// CHANNEL_MONITOR_MIN_FRAMES frames got no acknowledgement or no
+// channel access, or when the channel was busy (ED_SCAN_BUSY_LEVEL)
+// in CHANNEL_MONITOR_BUSY_PERCENT of the samples. After
+// CHANNEL_MONITOR_DEGRADED_PERIODS degraded periods in a row the
+// channels of CHANNEL_MONITOR_CHANNEL_MAP are scanned, each for
+// CHANNEL_MONITOR_SCAN_DURATION. The network hops to the least busy
+// one if it is busy at most half of CHANNEL_MONITOR_BUSY_PERCENT and
+// less busy or CHANNEL_MONITOR_NOISE_MARGIN dB quieter than the
+// current one. The next scan of all channels waits for at least
+// CHANNEL_MONITOR_HOLDOFF_PERIODS periods. The default map holds the
+// channels of the 915 MHz band. Sleeping devices cannot monitor; they
+// miss the channel hopping command and have to find the network again
+// with MiApp_ResyncConnection.
+/*********************************************************************/
+//#define ENABLE_CHANNEL_QUALITY_MONITOR
+
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR)
+#define CHANNEL_MONITOR_PERIOD              10
+#define CHANNEL_MONITOR_MIN_FRAMES          8
+#define CHANNEL_MONITOR_FAILURE_PERCENT     25
+#define CHANNEL_MONITOR_BUSY_PERCENT        15
+#define CHANNEL_MONITOR_DEGRADED_PERIODS    2
+#define CHANNEL_MONITOR_CHANNEL_MAP         0x000007FE
+#define CHANNEL_MONITOR_SCAN_DURATION       5
+#define CHANNEL_MONITOR_NOISE_MARGIN        6
+#define CHANNEL_MONITOR_HOLDOFF_PERIODS     12
+#endif
+
+
+/*********************************************************************/
+// ENABLE_MIMEM_SLAB serves the frequent fixed size allocations of the
+// stack (data frames, transmit entries, PHY requests, command frames,
+// small command frames such as the data requests of sleeping devices
+// and the entries of frames held for sleeping devices) from pools of equal blocks taken from the MiMem heap at
+// initialization, with constant time allocation and free. Other sizes
+// and allocations beyond the pools still use the heap. The MIMEM_SLAB_*
+// definitions give the number of blocks of each pool.
+/*********************************************************************/
+#define ENABLE_MIMEM_SLAB
+
+#if defined(ENABLE_MIMEM_SLAB)
+#define MIMEM_SLAB_DATA_FRAMES      8
+#define MIMEM_SLAB_TX_FRAMES        8
+#define MIMEM_SLAB_PHY_FRAMES       4
+#define MIMEM_SLAB_CMD_FRAMES       4
+#define MIMEM_SLAB_SMALL_CMD_FRAMES 8
+#define MIMEM_SLAB_INDIRECT_FRAMES  16
+
+// One size class for each pool above, also when two pools have the
+// same block size. The indirect frames are only pooled by devices
+// holding frames for sleeping ones
+#if defined(ENABLE_INDIRECT_MESSAGE)
+#define MIMEM_SLAB_CLASSES          6
+#else
+#define MIMEM_SLAB_CLASSES          5
+#endif
+#endif
+
+
+/*********************************************************************/
+// ENABLE_PHY_RX_IRQ runs the transceiver driver from its interrupt.
+// The interrupt reads every received frame, with RSSI, LQI and time
+// stamp, into a ring of PHY_RX_RING_SIZE frames (a power of two) and
+// leaves the transceiver receiving, so back-to-back frames are not
+// lost while the main loop is busy. PHY_TaskHandler moves them to the
+// MiMAC receive banks.
+/*********************************************************************/
+#define ENABLE_PHY_RX_IRQ
+
+#if defined(ENABLE_PHY_RX_IRQ)
+#define PHY_RX_RING_SIZE            4
+#endif
+
+
+/*********************************************************************/
+// MIMAC_TX_PIPELINE_DEPTH defines the number of frames MiMAC keeps in
+// its transmit pipeline (a power of two). The next frame is built and
+// secured while the previous one waits for its acknowledgement, and
+// is written to the transceiver as soon as that one is confirmed.
+// 1 transmits stop-and-wait.
+/*********************************************************************/
+#define MIMAC_TX_PIPELINE_DEPTH     2
+
+
+/*********************************************************************/
+// BANK_SIZE is the number of MiMAC receive banks. The application keeps
+// up to SUBGHZ_BUFF_SZ (8) received frames in their banks until it has
+// processed them, the remaining banks take new packets meanwhile.
+/*********************************************************************/
+#define BANK_SIZE                   12
+
+
+/*********************************************************************/
+// SYS_TIMER_WHEEL_SIZE is the number of slots of the system timer
+// wheel, a power of two up to 256. A timer waits in the slot of the
+// SYS_TIMER_INTERVAL tick it expires in, so starting and stopping take
+// constant time and each tick only looks at the timers of its slot.
+// With more slots than running timers, hardly any two of them share a
+// slot.
+/*********************************************************************/
+#define SYS_TIMER_WHEEL_SIZE        32
+
+
+/*********************************************************************/
+// ENABLE_MIMEM_STATS keeps statistics of the MiMem heap: lowest free
+// memory, largest free block, block counts, failed allocations per
+// call site and a histogram of buffer lifetimes, available through
+// MiMem_GetStats() and MiMem_StatsPrint(). Each buffer grows by a
+// time stamp, so size the heap accordingly.
+/*********************************************************************/
+//#define ENABLE_MIMEM_STATS
+
 
 #if !defined(PROTOCOL_P2P) && !defined(PROTOCOL_STAR)
 #error "One Microchip proprietary protocol must be defined for the wireless application."
@@ -229,10 +442,34 @@
 #endif
 
 
+#if defined(ENABLE_LINK_STATUS_AGGREGATION) && (!defined(ENABLE_LINK_STATUS) || (LINK_STATUS_AGGREGATION_MAX_TIMEOUT > 255))
+#error "Link Status aggregation needs Link Status and a keepalive interval of at most 255 seconds"
+#endif
+
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR) && defined(ENABLE_SLEEP_FEATURE)
+#error "Channel quality monitor cannot be enabled on sleeping devices, they miss the channel hopping"
+#endif
+
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR) && !defined(ENABLE_FREQUENCY_AGILITY)
+#error "Channel quality monitor needs frequency agility"
+#endif
+
 #if defined(ENABLE_FREQUENCY_AGILITY)
 #define ENABLE_ED_SCAN
 #endif
 
+#if defined(ENABLE_BACKGROUND_ED_SCAN) && (!defined(ENABLE_ED_SCAN) || !defined(ENABLE_PHY_RX_IRQ))
+#error "Background ED scan needs ED scan and the interrupt driven transceiver driver"
+#endif
+
+#if defined(ENABLE_CHANNEL_QUALITY_MONITOR) && !defined(ENABLE_BACKGROUND_ED_SCAN)
+#error "Channel quality monitor needs the background ED scan"
+#endif
+
+#if defined(ENABLE_TX_POWER_CONTROL) && (TX_POWER_CONTROL_MAX_REDUCTION > 31)
+#error "The transmit power can be lowered by 31 steps at most"
+#endif
+
 #if MY_ADDRESS_LENGTH > 8
 #error "Maximum address length is 8"
 #endif
@@ -291,4 +528,12 @@
 #error NETWORK TABLE SIZE too large.  Must be < 0xFF.
 #endif
 
+#if ((CONNECTION_HASH_SIZE & (CONNECTION_HASH_SIZE - 1)) || (CONNECTION_HASH_SIZE < 2 * CONNECTION_SIZE))
+#error CONNECTION HASH SIZE must be a power of two and at least twice CONNECTION_SIZE.
+#endif
+
+#if defined(PROTOCOL_STAR) && ((CONNECTION_TABLE_DELTA_LOG_SIZE & (CONNECTION_TABLE_DELTA_LOG_SIZE - 1)) || (5 + 4 * CONNECTION_TABLE_DELTA_LOG_SIZE > TX_BUFFER_SIZE))
+#error CONNECTION TABLE DELTA LOG SIZE must be a power of two and fit in TX_BUFFER_SIZE.
+#endif
+
 #endif
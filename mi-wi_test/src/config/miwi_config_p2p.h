@@ -56,6 +56,13 @@
         // sleep to conserve battery power.
         /*********************************************************************/
         #define RFD_DATA_WAIT                   0x00006FFF
+
+        /*********************************************************************/
+        // RFD_PENDING_DATA_WAIT is the timeout for the next message after
+        // a message with the frame pending bit. It covers the acknowledgement
+        // and a frame of maximum length from the associate device.
+        /*********************************************************************/
+        #define RFD_PENDING_DATA_WAIT           0x00013880
         
         
         /*********************************************************************/
@@ -112,6 +119,30 @@
         #define INDIRECT_MESSAGE_TIMEOUT (RFD_WAKEUP_INTERVAL * (INDIRECT_MESSAGE_SIZE + 1))
         
         
+        /*********************************************************************/
+        // Queued frames are sent by transmit class: stack commands (CONTROL)
+        // first, then application alarms (ALARM), normal and bulk data.
+        // TX_CLASS_<class>_DEPTH is the maximum number of queued frames of a
+        // class, further frames are refused. A frame of the NORMAL or BULK
+        // class moves up one class for every TX_CLASS_<class>_AGING
+        // milliseconds it waits, up to ALARM. A frame still queued after
+        // TX_CLASS_<class>_DEADLINE milliseconds is dropped and confirmed with
+        // TRANSACTION_EXPIRED. 0 disables the deadline.
+        /*********************************************************************/
+        #define TX_CLASS_CONTROL_DEPTH      8
+        #define TX_CLASS_ALARM_DEPTH        4
+        #define TX_CLASS_NORMAL_DEPTH       8
+        #define TX_CLASS_BULK_DEPTH         4
+
+        #define TX_CLASS_NORMAL_AGING       1000
+        #define TX_CLASS_BULK_AGING         2000
+
+        #define TX_CLASS_CONTROL_DEADLINE   0
+        #define TX_CLASS_ALARM_DEADLINE     0
+        #define TX_CLASS_NORMAL_DEADLINE    0
+        #define TX_CLASS_BULK_DEADLINE      10000
+        
+        
         /*********************************************************************/
         // ENABLE_TIME_SYNC enables the Time Synchronizaiton feature of P2P
         // stack. It allows the FFD to coordinate the check-in interval of
@@ -36,46 +36,11 @@
 
 #include "dutyCycling.h"
 #include "sysTimer.h"
-
-/* Refer	Table 14-20 : PPDU Timing of SAMR30 Datasheet  
-			Table 37-2  : PPDU Timing of SAMR21 Datasheet 
-			
-   Note to change the corresponding configuration in PHY_Init() (in phy.c)
-*/
-
-/* PHY Synchronization header duration in us */
-#define phySHRDurationMicroSec			2000
-
-/* PHY header duration in us */
-#define phyPHRDurationMicroSec			400
-
-/* PHY time taken to transmit max PSDU in us */
-#define phyMaxPSDUDurationMicroSec		(50.8 * MS)
-
-/* PHY max PSDU length in bytes */
-#define phyMaxPSDULength				127
-
-/* Time taken to transmit one byte of PSDU in us */
-#define phyPerPSDUTxDurationMicroSec	(phyMaxPSDUDurationMicroSec / phyMaxPSDULength)
-
-/* Time taken to transmit 2 bytes of PHY footer (CRC) in us */
-#define phyFooterTxDurationMicroSec		(2 * phyPerPSDUTxDurationMicroSec) /* 2-FCS */
-
-/* Number of retries attempted when ACK is not received */
-#define phyNumOfRetires					3
-
-/* Number of bytes added by MAC for constructing P2P frame in bytes
-   includes - FCF, seq.no., src & dst addresses... 
-   refer 14.3.1.2 MAC Protocol Data Unit (MPDU) of SAMR30 datasheet
- */
-#define p2pMacHeader					21
+#include "phyTiming.h"
 
 /* Duty cycling percentage - range : 1 to 99 */
 #define dutyCyclePercentage				1
 
-/* Macro to calculate the transmit duration of a P2P application frame based on payload length */
-#define phyPacketTxDuration(packetLength) (phySHRDurationMicroSec + phyPHRDurationMicroSec + (phyPerPSDUTxDurationMicroSec * p2pMacHeader) + (packetLength * phyPerPSDUTxDurationMicroSec) + phyFooterTxDurationMicroSec)
-
 /* Total size of Data request frame from sleeping device in bytes */
 #define macDataRequestFrameSize			22
 
@@ -133,7 +98,7 @@ uint32_t MiApp_SendDutyCycledData(uint8_t addr_len, uint8_t *addr, uint8_t msgle
 	uint16_t currDataReqInterval = MiApp_CurrentDataRequestIntervalSec();
 	/* In sleeping device - when we detect that stack is about to send data request in less than or equal 1 sec,
 	   we pro actively avoid sending the data for duty cycling duration calculated for data request frame 
-	   Note: currDataReqInterval <= 2 is intentional as dataRequestInterval is decremented and compared to 0.
+	   Note: currDataReqInterval <= 2 is intentional as the interval is rounded up to whole seconds.
 	   So to detect less than or equal 1 sec is to check if the value is less than 2. */
 	if ((dataRequestDutyCyclingInterval > currDataReqInterval) || (currDataReqInterval <= 2))
 	{
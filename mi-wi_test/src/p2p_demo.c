@@ -41,6 +41,7 @@
 #include "task.h"
 #include "p2p_demo.h"
 #include "mimem.h"
+#include "miring.h"
 #include "asf.h"
 #if defined(ENABLE_SLEEP_FEATURE)
 #include "sleep_mgr.h"
@@ -79,16 +80,15 @@ unsigned char flag;
 bool upState;
 bool lastUpState;
 
-#define SUBGHZ_BUFF_SZ		(75)
+/* Messages held by the application, each keeps one receive buffer */
+#define SUBGHZ_BUFF_SZ		(8)
 
-typedef struct
-{
-	subghz_rx_data_frame_t subghz_rx_buff[SUBGHZ_BUFF_SZ];
-	uint8_t wr_index;
-	uint8_t rd_index;
-}subghz_rx_packet_t;
+#if SUBGHZ_BUFF_SZ >= BANK_SIZE
+#error "SUBGHZ_BUFF_SZ must leave MiMAC receive banks for new packets, raise BANK_SIZE"
+#endif
 
-volatile subghz_rx_packet_t rx_packet;
+static RECEIVED_MESSAGE subghz_rx_buff[SUBGHZ_BUFF_SZ];
+static MiRing_t subghz_rx_ring;
 
 /************************ FUNCTION DEFINITIONS ****************************************/
 /*********************************************************************
@@ -246,28 +246,60 @@ void com_miwi_uint_to_bytes(uint32_t input, uint8_t* bytes, uint8_t num_bytes, u
 	memcpy(bytes, out_bytes, num_bytes);
 }
 
-void subghz_rx_queue_push(subghz_rx_data_frame_t* push_packet)
+void subghz_rx_queue_init(void)
 {
-	memcpy(&rx_packet.subghz_rx_buff[rx_packet.wr_index++], push_packet, sizeof(subghz_rx_data_frame_t));
-	// printf("Write index : %d \r\n",rx_packet.wr_index);
-	if(rx_packet.wr_index == SUBGHZ_BUFF_SZ)
+	miRingInit(&subghz_rx_ring, subghz_rx_buff, sizeof(RECEIVED_MESSAGE), SUBGHZ_BUFF_SZ);
+}
+
+/* Oldest received message, NULL if there is none */
+RECEIVED_MESSAGE* subghz_rx_queue_peek(void)
+{
+	return (RECEIVED_MESSAGE*)miRingPeek(&subghz_rx_ring);
+}
+
+/* Hands the receive buffer of the oldest message back to the stack */
+void subghz_rx_queue_release(void)
+{
+	RECEIVED_MESSAGE* frame = subghz_rx_queue_peek();
+
+	if (NULL != frame)
 	{
-		rx_packet.wr_index = 0;
+		MiApp_MessageRelease(frame);
+		miRingRelease(&subghz_rx_ring);
 	}
 }
 
+/* Copying variant for callers that keep the frame beyond the next one */
 bool subghz_rx_queue_pop(subghz_rx_data_frame_t* pop_packet)
 {
-	if(rx_packet.rd_index != rx_packet.wr_index)
+	RECEIVED_MESSAGE* frame = subghz_rx_queue_peek();
+	uint8_t len;
+
+	if (NULL == frame)
 	{
-		memcpy(pop_packet, &rx_packet.subghz_rx_buff[rx_packet.rd_index++], sizeof(subghz_rx_data_frame_t));
-		if(rx_packet.rd_index == SUBGHZ_BUFF_SZ)
-		{
-			rx_packet.rd_index = 0;
-		}
-		return true;
+		return false;
+	}
+	len = (frame->PayloadSize > RX_BUFFER_SIZE) ? RX_BUFFER_SIZE : frame->PayloadSize;
+	if (frame->flags.bits.altSrcAddr)
+	{
+		memcpy(pop_packet->src_short_addr, frame->SourceAddress, SHORT_ADDR_LEN);
+		pop_packet->addr_type = 2; /* Short address */
+	}
+	else
+	{
+		memcpy(pop_packet->src_long_addr, frame->SourceAddress, LONG_ADDR_LEN);
+		pop_packet->addr_type = 1; /* Long address */
 	}
-	return false;
+	memcpy(pop_packet->data, frame->Payload, len);
+	pop_packet->len = len;
+	subghz_rx_queue_release();
+	return true;
+}
+
+/* Frames dropped because the application did not keep up */
+uint16_t subghz_rx_queue_overruns(void)
+{
+	return subghz_rx_ring.overruns;
 }
 
 
@@ -282,23 +314,19 @@ bool subghz_rx_queue_pop(subghz_rx_data_frame_t* pop_packet)
 ********************************************************************/
 void ReceivedDataIndication (RECEIVED_MESSAGE *ind)
 {
-	volatile subghz_rx_data_frame_t rx_packet;
-	
-	if( rxMessage.flags.bits.srcPrsnt )
+	RECEIVED_MESSAGE* frame;
+
+	if( ind->flags.bits.srcPrsnt )
     {
-        if( rxMessage.flags.bits.altSrcAddr )
-        {
-			memcpy(rx_packet.src_short_addr, rxMessage.SourceAddress, SHORT_ADDR_LEN);
-			rx_packet.addr_type = 2; /* Short address */
-        }
-        else
-        {    
-			memcpy(rx_packet.src_long_addr, rxMessage.SourceAddress, LONG_ADDR_LEN);
-			rx_packet.addr_type = 1; /* Long address */
-        }
-		memcpy(rx_packet.data, rxMessage.Payload, rxMessage.PayloadSize);		
-		rx_packet.len = rxMessage.PayloadSize;
-		subghz_rx_queue_push(&rx_packet);
+		/* Full ring: the message is counted as overrun and its buffer freed */
+		frame = (RECEIVED_MESSAGE*)miRingReserve(&subghz_rx_ring);
+		if ((NULL == frame) || !MiApp_MessageHold(ind))
+		{
+			return;
+		}
+		/* Keep the message in its receive buffer instead of copying it */
+		*frame = *ind;
+		miRingCommit(&subghz_rx_ring);
     }
 	
 // 	volatile subghz_rx_data_frame_t rx_packet;
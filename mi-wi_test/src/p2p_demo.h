@@ -54,9 +54,17 @@ typedef struct  __attribute__((packed))
 	uint8_t data[RX_BUFFER_SIZE];
 }subghz_rx_data_frame_t;
 
-
-void subghz_rx_queue_push(subghz_rx_data_frame_t* push_packet);
+/* Received messages are held in the receive buffers of the stack
+ * (MiApp_MessageHold) until the application consumes them with
+ * subghz_rx_queue_peek()/subghz_rx_queue_release() or
+ * subghz_rx_queue_pop(). The pointers of a message stay valid until it
+ * is released. While the queue is full new messages are dropped and
+ * counted by subghz_rx_queue_overruns(). */
+void subghz_rx_queue_init(void);
+RECEIVED_MESSAGE* subghz_rx_queue_peek(void);
+void subghz_rx_queue_release(void);
 bool subghz_rx_queue_pop(subghz_rx_data_frame_t* pop_packet);
+uint16_t subghz_rx_queue_overruns(void);
 
 uint32_t com_miwi_bytes_to_uint(uint8_t* bytes, uint8_t num_bytes, uint8_t endian);
 void com_miwi_uint_to_bytes(uint32_t input, uint8_t* bytes, uint8_t num_bytes, uint8_t endian);
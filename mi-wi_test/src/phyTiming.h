@@ -0,0 +1,76 @@
+/**
+* \file  phyTiming.h
+*
+* \brief PPDU timing of the sub-GHz PHY used by duty cycling
+*
+* Copyright (c) 2020 Microchip Technology Inc. and its subsidiaries.
+*
+* \asf_license_start
+*
+* \page License
+*
+* Subject to your compliance with these terms, you may use Microchip
+* software and any derivatives exclusively with Microchip products.
+* It is your responsibility to comply with third party license terms applicable
+* to your use of third party software (including open source software) that
+* may accompany Microchip software.
+*
+* THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES,
+* WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE,
+* INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY,
+* AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE
+* LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL
+* LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND WHATSOEVER RELATED TO THE
+* SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS BEEN ADVISED OF THE
+* POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE FULLEST EXTENT
+* ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN ANY WAY
+* RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+* THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+*
+* \asf_license_stop
+*
+*/
+/*
+* Support and FAQ: visit <a href="https://www.microchip.com/support/">Microchip Support</a>
+*/
+
+#ifndef PHY_TIMING_H
+#define PHY_TIMING_H
+
+/* Refer	Table 14-20 : PPDU Timing of SAMR30 Datasheet  
+			Table 37-2  : PPDU Timing of SAMR21 Datasheet 
+			
+   Note to change the corresponding configuration in PHY_Init() (in phy.c)
+*/
+
+/* PHY Synchronization header duration in us */
+#define phySHRDurationMicroSec			2000
+
+/* PHY header duration in us */
+#define phyPHRDurationMicroSec			400
+
+/* PHY time taken to transmit max PSDU in us */
+#define phyMaxPSDUDurationMicroSec		(50.8 * MS)
+
+/* PHY max PSDU length in bytes */
+#define phyMaxPSDULength				127
+
+/* Time taken to transmit one byte of PSDU in us */
+#define phyPerPSDUTxDurationMicroSec	(phyMaxPSDUDurationMicroSec / phyMaxPSDULength)
+
+/* Time taken to transmit 2 bytes of PHY footer (CRC) in us */
+#define phyFooterTxDurationMicroSec		(2 * phyPerPSDUTxDurationMicroSec) /* 2-FCS */
+
+/* Number of retries attempted when ACK is not received */
+#define phyNumOfRetires					3
+
+/* Number of bytes added by MAC for constructing P2P frame in bytes
+   includes - FCF, seq.no., src & dst addresses... 
+   refer 14.3.1.2 MAC Protocol Data Unit (MPDU) of SAMR30 datasheet
+ */
+#define p2pMacHeader					21
+
+/* Macro to calculate the transmit duration of a P2P application frame based on payload length */
+#define phyPacketTxDuration(packetLength) (phySHRDurationMicroSec + phyPHRDurationMicroSec + (phyPerPSDUTxDurationMicroSec * p2pMacHeader) + (packetLength * phyPerPSDUTxDurationMicroSec) + phyFooterTxDurationMicroSec)
+
+#endif /* PHY_TIMING_H */
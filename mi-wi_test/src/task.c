@@ -355,7 +355,10 @@ static void appLinkFailureCallback(void)
 bool Initialize_Demo(bool freezer_enable)
 {
 //    uint16_t broadcastAddr = 0xFFFF;
+    miwi_status_t initStatus;
+
     /* Subscribe for data indication */
+    subghz_rx_queue_init();
     MiApp_SubscribeDataIndicationCallback(ReceivedDataIndication);
 	MiApp_SubscribeLinkFailureCallback(appLinkFailureCallback);
 
@@ -368,7 +371,13 @@ bool Initialize_Demo(bool freezer_enable)
     defaultParamsRomOrRam.networkFreezerRestore = freezer_enable;
 
     /* Initialize the P2P and Star Protocol */
-    if (MiApp_ProtocolInit(&defaultParamsRomOrRam, &defaultParamsRamOnly) == RECONNECTED)
+    initStatus = MiApp_ProtocolInit(&defaultParamsRomOrRam, &defaultParamsRamOnly);
+    if ((SUCCESS != initStatus) && (RECONNECTED != initStatus))
+    {
+		printf("[T][ERROR] Protocol init fail \n");
+		return false;
+    }
+    if (initStatus == RECONNECTED)
     {	
         printf("\r\nPANID:");
         printf("%X",myPANID.v[1]);